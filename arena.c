@@ -0,0 +1,115 @@
+#include "include/opentac.h"
+
+#define DEFAULT_CHUNK_CAP ((size_t) 64 * 1024)
+
+static size_t opentac_arena_round(size_t size) {
+    size_t align = sizeof(max_align_t);
+    return (size + align - 1) & ~(align - 1);
+}
+
+static struct OpentacArenaChunk *opentac_arena_chunk(size_t cap) {
+    struct OpentacArenaChunk *chunk = malloc(sizeof(struct OpentacArenaChunk) + cap);
+    opentac_assert(chunk);
+    chunk->next = NULL;
+    chunk->cap = cap;
+    chunk->len = 0;
+    return chunk;
+}
+
+void opentac_arena(struct OpentacArena *arena) {
+    opentac_arena_with_cap(arena, DEFAULT_CHUNK_CAP);
+}
+
+void opentac_arena_with_cap(struct OpentacArena *arena, size_t cap) {
+    opentac_assert(arena);
+    opentac_assert(cap > 0);
+
+    arena->head = opentac_arena_chunk(opentac_arena_round(cap));
+    arena->current = arena->head;
+}
+
+void *opentac_arena_alloc(struct OpentacArena *arena, size_t size) {
+    opentac_assert(arena);
+
+    size = opentac_arena_round(size);
+    struct OpentacArenaChunk *chunk = arena->current;
+    while (chunk->cap - chunk->len < size) {
+        // chunks left over from before a reset are recycled in order
+        struct OpentacArenaChunk *next = chunk->next;
+        if (!next || next->cap < size) {
+            size_t cap = size > DEFAULT_CHUNK_CAP ? size : DEFAULT_CHUNK_CAP;
+            next = opentac_arena_chunk(cap);
+            next->next = chunk->next;
+            chunk->next = next;
+        }
+        next->len = 0;
+        chunk = next;
+    }
+    arena->current = chunk;
+
+    void *ptr = (uint8_t *) chunk->data + chunk->len;
+    chunk->len += size;
+    return ptr;
+}
+
+void *opentac_arena_calloc(struct OpentacArena *arena, size_t len, size_t size) {
+    void *ptr = opentac_arena_alloc(arena, len * size);
+    memset(ptr, 0, len * size);
+    return ptr;
+}
+
+void *opentac_arena_realloc(struct OpentacArena *arena, void *ptr, size_t oldsize, size_t newsize) {
+    opentac_assert(arena);
+
+    if (!ptr) {
+        return opentac_arena_alloc(arena, newsize);
+    }
+
+    // the most recent allocation can grow in place
+    struct OpentacArenaChunk *chunk = arena->current;
+    uint8_t *end = (uint8_t *) chunk->data + chunk->len;
+    oldsize = opentac_arena_round(oldsize);
+    if ((uint8_t *) ptr + oldsize == end) {
+        size_t len = chunk->len - oldsize + opentac_arena_round(newsize);
+        if (len <= chunk->cap) {
+            chunk->len = len;
+            return ptr;
+        }
+    }
+
+    void *newptr = opentac_arena_alloc(arena, newsize);
+    memcpy(newptr, ptr, oldsize < newsize ? oldsize : newsize);
+    return newptr;
+}
+
+OpentacString *opentac_arena_string(struct OpentacArena *arena, const char *str) {
+    opentac_assert(str);
+
+    size_t len = strlen(str);
+    size_t cap = len + 1;
+    OpentacString *string = opentac_arena_alloc(arena, sizeof(OpentacString) + cap);
+    string->len = len;
+    string->cap = cap;
+    memcpy(string->data, str, cap);
+    return string;
+}
+
+void opentac_arena_reset(struct OpentacArena *arena) {
+    opentac_assert(arena);
+
+    arena->head->len = 0;
+    arena->current = arena->head;
+}
+
+void opentac_arena_destroy(struct OpentacArena *arena) {
+    opentac_assert(arena);
+
+    struct OpentacArenaChunk *chunk = arena->head;
+    while (chunk) {
+        struct OpentacArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->head = NULL;
+    arena->current = NULL;
+}
@@ -0,0 +1,157 @@
+#include "include/opentac.h"
+
+static bool opentac_cfg_is_jump(const OpentacStmt *stmt) {
+    return stmt->tag.opcode == (OPENTAC_OP_BRANCH | OPENTAC_OP_NOP) && stmt->tag.left == OPENTAC_VAL_ERROR;
+}
+
+static bool opentac_cfg_ends_block(const OpentacStmt *stmt) {
+    return (stmt->tag.opcode & OPENTAC_OP_BRANCH) == OPENTAC_OP_BRANCH || stmt->tag.opcode == OPENTAC_OP_RETURN;
+}
+
+static size_t opentac_cfg_target(const struct OpentacCfg *cfg, OpentacLabel label) {
+    opentac_assertf(label < cfg->nlabels && cfg->labels[label] != SIZE_MAX, "branch to label %u which was never placed", label);
+    return cfg->labels[label];
+}
+
+// writes the successors of `block` to `succs` unless it is NULL and returns
+// how many there are
+static size_t opentac_cfg_visit_succs(struct OpentacCfg *cfg, const OpentacFnBuilder *fn, size_t block, size_t *succs) {
+    const OpentacStmt *last = fn->stmts + cfg->blocks[block].end - 1;
+    size_t len = 0;
+    bool fallthrough = true;
+
+    if (last->tag.opcode == OPENTAC_OP_RETURN) {
+        fallthrough = false;
+    } else if (opentac_cfg_is_jump(last)) {
+        if (succs) {
+            succs[len] = opentac_cfg_target(cfg, last->label);
+        }
+        ++len;
+        fallthrough = false;
+    } else if (last->tag.opcode == (OPENTAC_OP_BRANCH | OPENTAC_OP_NOP)) {
+        // indirect branches may go to any placed label
+        for (size_t i = 0; i < cfg->nlabels; i++) {
+            if (cfg->labels[i] != SIZE_MAX) {
+                if (succs) {
+                    succs[len] = cfg->labels[i];
+                }
+                ++len;
+            }
+        }
+        fallthrough = false;
+    } else if ((last->tag.opcode & OPENTAC_OP_BRANCH) == OPENTAC_OP_BRANCH) {
+        size_t target = opentac_cfg_target(cfg, last->label);
+        if (succs) {
+            succs[len] = target;
+        }
+        ++len;
+        // a branch to the next statement only has one successor
+        if (target == block + 1) {
+            fallthrough = false;
+        }
+    }
+
+    if (fallthrough && block + 1 < cfg->len) {
+        if (succs) {
+            succs[len] = block + 1;
+        }
+        ++len;
+    }
+
+    return len;
+}
+
+const struct OpentacCfg *opentac_fn_cfg(OpentacFnBuilder *fn) {
+    opentac_assert(fn);
+
+    struct OpentacCfg *cfg = &fn->cfg;
+    if (cfg->valid) {
+        return cfg;
+    }
+    opentac_cfg_destroy(cfg);
+
+    // a block starts at the entry, at every label and after every branch
+    // or return
+    size_t len = 0;
+    for (size_t i = 0; i < fn->len; i++) {
+        if (i == 0 || fn->stmts[i].tag.opcode == OPENTAC_OP_LABEL || opentac_cfg_ends_block(fn->stmts + i - 1)) {
+            ++len;
+        }
+    }
+
+    cfg->len = len;
+    cfg->blocks = malloc(sizeof(struct OpentacBlock) * (len ? len : 1));
+    cfg->nlabels = fn->label;
+    cfg->labels = malloc(sizeof(size_t) * (fn->label ? fn->label : 1));
+    opentac_assert(cfg->blocks && cfg->labels);
+    for (size_t i = 0; i < cfg->nlabels; i++) {
+        cfg->labels[i] = SIZE_MAX;
+    }
+
+    size_t block = 0;
+    for (size_t i = 0; i < fn->len; i++) {
+        if (i == 0 || fn->stmts[i].tag.opcode == OPENTAC_OP_LABEL || opentac_cfg_ends_block(fn->stmts + i - 1)) {
+            if (i) {
+                cfg->blocks[block++].end = i;
+            }
+            cfg->blocks[block].start = i;
+        }
+        if (fn->stmts[i].tag.opcode == OPENTAC_OP_LABEL) {
+            cfg->labels[fn->stmts[i].label] = block;
+        }
+    }
+    if (len) {
+        cfg->blocks[block].end = fn->len;
+    }
+
+    // successors first, in the same order as the blocks
+    size_t nedges = 0;
+    for (size_t i = 0; i < len; i++) {
+        cfg->blocks[i].succ = nedges;
+        cfg->blocks[i].nsucc = opentac_cfg_visit_succs(cfg, fn, i, NULL);
+        cfg->blocks[i].npred = 0;
+        nedges += cfg->blocks[i].nsucc;
+    }
+    cfg->succs = malloc(sizeof(size_t) * (nedges ? nedges : 1));
+    cfg->preds = malloc(sizeof(size_t) * (nedges ? nedges : 1));
+    opentac_assert(cfg->succs && cfg->preds);
+    for (size_t i = 0; i < len; i++) {
+        opentac_cfg_visit_succs(cfg, fn, i, cfg->succs + cfg->blocks[i].succ);
+        for (size_t j = 0; j < cfg->blocks[i].nsucc; j++) {
+            ++cfg->blocks[cfg->succs[cfg->blocks[i].succ + j]].npred;
+        }
+    }
+
+    // then predecessors from a running offset, which keeps them sorted
+    size_t offset = 0;
+    for (size_t i = 0; i < len; i++) {
+        cfg->blocks[i].pred = offset;
+        offset += cfg->blocks[i].npred;
+        cfg->blocks[i].npred = 0;
+    }
+    for (size_t i = 0; i < len; i++) {
+        for (size_t j = 0; j < cfg->blocks[i].nsucc; j++) {
+            struct OpentacBlock *succ = cfg->blocks + cfg->succs[cfg->blocks[i].succ + j];
+            cfg->preds[succ->pred + succ->npred++] = i;
+        }
+    }
+
+    cfg->valid = true;
+    return cfg;
+}
+
+void opentac_fn_invalidate(OpentacFnBuilder *fn) {
+    opentac_assert(fn);
+
+    fn->cfg.valid = false;
+}
+
+void opentac_cfg_destroy(struct OpentacCfg *cfg) {
+    opentac_assert(cfg);
+
+    free(cfg->blocks);
+    free(cfg->preds);
+    free(cfg->succs);
+    free(cfg->labels);
+    memset(cfg, 0, sizeof(struct OpentacCfg));
+}
@@ -0,0 +1,835 @@
+#include <inttypes.h>
+#include <math.h>
+#include "include/opentac.h"
+
+// registers are C locals of the type of their kind; integers and floats of
+// every width, with everything else (pointers, functions, aggregates) held
+// as a machine word like the interpreter holds it
+enum {
+    OPENTAC_C_I8,
+    OPENTAC_C_I16,
+    OPENTAC_C_I32,
+    OPENTAC_C_I64,
+    OPENTAC_C_U8,
+    OPENTAC_C_U16,
+    OPENTAC_C_U32,
+    OPENTAC_C_U64,
+    OPENTAC_C_F32,
+    OPENTAC_C_F64,
+};
+
+static const char *const opentac_c_types[] = {
+    "int8_t", "int16_t", "int32_t", "int64_t", "uint8_t", "uint16_t", "uint32_t", "uint64_t", "float", "double",
+};
+
+// members of opentac_slot, which registers whose address is taken live in
+static const char *const opentac_c_members[] = {
+    "i8", "i16", "i32", "i64", "u8", "u16", "u32", "u64", "f32", "f64",
+};
+
+// arguments pushed by param are kept in locals of their own, this tag marks
+// one of them as an operand with the index of its param in `ui64val`
+#define OPENTAC_C_PENDING 0x10
+
+// the helpers give operations the meaning the interpreter gives them where
+// C leaves it undefined or to the implementation
+static const char opentac_c_prelude[] =
+    "#include <stdint.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "#include <math.h>\n"
+    "\n"
+    "typedef union {\n"
+    "    int8_t i8; int16_t i16; int32_t i32; int64_t i64;\n"
+    "    uint8_t u8; uint16_t u16; uint32_t u32; uint64_t u64;\n"
+    "    float f32; double f64;\n"
+    "} opentac_slot;\n"
+    "\n"
+    "static inline uint64_t opentac_sdiv(uint64_t a, uint64_t b) {\n"
+    "    return (int64_t) b == -1 ? 0 - a : (uint64_t) ((int64_t) a / (int64_t) b);\n"
+    "}\n"
+    "static inline uint64_t opentac_smod(uint64_t a, uint64_t b) {\n"
+    "    return (int64_t) b == -1 ? 0 : (uint64_t) ((int64_t) a % (int64_t) b);\n"
+    "}\n"
+    "static inline uint64_t opentac_shl(uint64_t a, uint64_t n) {\n"
+    "    return n >= 64 ? 0 : a << n;\n"
+    "}\n"
+    "static inline uint64_t opentac_shr(uint64_t a, uint64_t n) {\n"
+    "    return n >= 64 ? 0 : a >> n;\n"
+    "}\n"
+    "static inline uint64_t opentac_sar(uint64_t a, uint64_t n) {\n"
+    "    uint64_t sign = a >> 63 ? UINT64_MAX : 0;\n"
+    "    return n >= 64 ? sign : ((a ^ sign) >> n) ^ sign;\n"
+    "}\n"
+    "static inline uint64_t opentac_rol(uint64_t a, uint64_t n, unsigned width) {\n"
+    "    uint64_t mask = width == 64 ? UINT64_MAX : ((uint64_t) 1 << width) - 1;\n"
+    "    a &= mask;\n"
+    "    n %= width;\n"
+    "    return n ? ((a << n) | (a >> (width - n))) & mask : a;\n"
+    "}\n"
+    "static inline uint64_t opentac_ror(uint64_t a, uint64_t n, unsigned width) {\n"
+    "    return opentac_rol(a, width - n % width, width);\n"
+    "}\n"
+    "static inline uint64_t opentac_bits32(float value) {\n"
+    "    uint32_t bits;\n"
+    "    memcpy(&bits, &value, sizeof(bits));\n"
+    "    return bits;\n"
+    "}\n"
+    "static inline uint64_t opentac_bits64(double value) {\n"
+    "    uint64_t bits;\n"
+    "    memcpy(&bits, &value, sizeof(bits));\n"
+    "    return bits;\n"
+    "}\n"
+    "static inline float opentac_f32(uint64_t bits) {\n"
+    "    uint32_t low = (uint32_t) bits;\n"
+    "    float value;\n"
+    "    memcpy(&value, &low, sizeof(value));\n"
+    "    return value;\n"
+    "}\n"
+    "static inline double opentac_f64(uint64_t bits) {\n"
+    "    double value;\n"
+    "    memcpy(&value, &bits, sizeof(value));\n"
+    "    return value;\n"
+    "}\n";
+
+static int opentac_c_kind(const OpentacType *type) {
+    switch (type->tag) {
+    case OPENTAC_TYPE_BOOL:
+        return OPENTAC_C_U8;
+    case OPENTAC_TYPE_I8:
+    case OPENTAC_TYPE_I16:
+    case OPENTAC_TYPE_I32:
+    case OPENTAC_TYPE_I64:
+    case OPENTAC_TYPE_UI8:
+    case OPENTAC_TYPE_UI16:
+    case OPENTAC_TYPE_UI32:
+    case OPENTAC_TYPE_UI64:
+    case OPENTAC_TYPE_F32:
+    case OPENTAC_TYPE_F64:
+        return OPENTAC_C_I8 + (type->tag - OPENTAC_TYPE_I8);
+    }
+    return OPENTAC_C_U64;
+}
+
+static int opentac_c_tag_kind(int tag) {
+    if (tag >= OPENTAC_VAL_I8 && tag <= OPENTAC_VAL_F64) {
+        return OPENTAC_C_I8 + (tag - OPENTAC_VAL_I8);
+    }
+    return tag == OPENTAC_VAL_BOOL ? OPENTAC_C_U8 : OPENTAC_C_U64;
+}
+
+static bool opentac_c_float(int kind) {
+    return kind >= OPENTAC_C_F32;
+}
+
+static bool opentac_c_signed(int kind) {
+    return kind <= OPENTAC_C_I64;
+}
+
+// item names get a prefix, so that none of them is a keyword, a name the
+// C library has or the main C looks for; underscores are doubled and dots
+// written as _d, which keeps distinct names distinct
+static void opentac_c_name(FILE *file, const OpentacString *name) {
+    fputs(OPENTAC_EMIT_C_PREFIX, file);
+    for (const char *c = name->data; *c; c++) {
+        if (*c == '.' || *c == '_') {
+            fputs(*c == '.' ? "_d" : "__", file);
+        } else {
+            fputc(*c, file);
+        }
+    }
+}
+
+// types of the typeset are emitted on demand, each after the types it holds
+// by value; `index` is the typedef number, or zero while not emitted yet
+struct OpentacCType {
+    const OpentacType *type;
+    size_t index;
+    bool busy;
+};
+
+struct OpentacCEmit {
+    OpentacBuilder *builder;
+    FILE *file;
+    // open addressing, power of two capacity
+    size_t cap;
+    struct OpentacCType *types;
+    size_t ntypes;
+    // the function being emitted
+    OpentacFnBuilder *fn;
+    OpentacType **regs;
+    bool *refd;
+    int *pending_kinds;
+};
+
+static struct OpentacCType *opentac_c_type_entry(struct OpentacCEmit *emit, const OpentacType *type) {
+    size_t mask = emit->cap - 1;
+    size_t slot = ((uintptr_t) type >> 4) & mask;
+    while (emit->types[slot].type && emit->types[slot].type != type) {
+        slot = (slot + 1) & mask;
+    }
+    emit->types[slot].type = type;
+    return emit->types + slot;
+}
+
+static void opentac_c_type_define(struct OpentacCEmit *emit, const OpentacType *type);
+
+// the name of `type` as C knows it
+static void opentac_c_type_name(struct OpentacCEmit *emit, const OpentacType *type) {
+    switch (type->tag) {
+    case OPENTAC_TYPE_UNIT:
+    case OPENTAC_TYPE_NEVER:
+    case OPENTAC_TYPE_BOOL:
+        fputs("uint8_t", emit->file);
+        return;
+    case OPENTAC_TYPE_I8:
+    case OPENTAC_TYPE_I16:
+    case OPENTAC_TYPE_I32:
+    case OPENTAC_TYPE_I64:
+    case OPENTAC_TYPE_UI8:
+    case OPENTAC_TYPE_UI16:
+    case OPENTAC_TYPE_UI32:
+    case OPENTAC_TYPE_UI64:
+    case OPENTAC_TYPE_F32:
+    case OPENTAC_TYPE_F64:
+        fputs(opentac_c_types[opentac_c_kind(type)], emit->file);
+        return;
+    case OPENTAC_TYPE_STRUCT:
+    case OPENTAC_TYPE_UNION:
+        fputs(type->tag == OPENTAC_TYPE_STRUCT ? "struct " : "union ", emit->file);
+        opentac_c_name(emit->file, type->struc.name);
+        return;
+    }
+    fprintf(emit->file, "opentac_t%zu", opentac_c_type_entry(emit, type)->index);
+}
+
+// emits the definition of `type`, and before it of everything it needs to
+// be complete; pointers only need their pointee declared, which is what
+// breaks the cycles named types can form
+static void opentac_c_type_define(struct OpentacCEmit *emit, const OpentacType *type) {
+    if (type->tag < OPENTAC_TYPE_PTR) {
+        return;
+    }
+    struct OpentacCType *entry = opentac_c_type_entry(emit, type);
+    if (entry->index || entry->busy) {
+        return;
+    }
+    entry->busy = true;
+
+    FILE *file = emit->file;
+    switch (type->tag) {
+    case OPENTAC_TYPE_PTR:
+        if (type->ptr.pointee->tag == OPENTAC_TYPE_FN) {
+            // function types already are pointers in C
+            opentac_c_type_define(emit, type->ptr.pointee);
+            entry->index = ++emit->ntypes;
+            fputs("typedef ", file);
+            opentac_c_type_name(emit, type->ptr.pointee);
+            fprintf(file, " opentac_t%zu;\n", entry->index);
+            break;
+        }
+        if (type->ptr.pointee->tag != OPENTAC_TYPE_STRUCT && type->ptr.pointee->tag != OPENTAC_TYPE_UNION) {
+            opentac_c_type_define(emit, type->ptr.pointee);
+        }
+        entry->index = ++emit->ntypes;
+        fputs("typedef ", file);
+        opentac_c_type_name(emit, type->ptr.pointee);
+        fprintf(file, " *opentac_t%zu;\n", entry->index);
+        break;
+    case OPENTAC_TYPE_FN:
+        for (size_t i = 0; i < type->fn.len; i++) {
+            opentac_c_type_define(emit, type->fn.params[i]);
+        }
+        opentac_c_type_define(emit, type->fn.result);
+        entry->index = ++emit->ntypes;
+        fputs("typedef ", file);
+        opentac_c_type_name(emit, type->fn.result);
+        fprintf(file, " (*opentac_t%zu)(", entry->index);
+        for (size_t i = 0; i < type->fn.len; i++) {
+            fputs(i ? ", " : "", file);
+            opentac_c_type_name(emit, type->fn.params[i]);
+        }
+        fputs(type->fn.len ? ");\n" : "void);\n", file);
+        break;
+    case OPENTAC_TYPE_ARRAY:
+        opentac_c_type_define(emit, type->array.elem_type);
+        entry->index = ++emit->ntypes;
+        fputs("typedef ", file);
+        opentac_c_type_name(emit, type->array.elem_type);
+        // C has no empty arrays
+        fprintf(file, " opentac_t%zu[%" PRIu64 "];\n", entry->index, type->array.len ? type->array.len : 1);
+        break;
+    case OPENTAC_TYPE_TUPLE:
+    case OPENTAC_TYPE_STRUCT:
+    case OPENTAC_TYPE_UNION: {
+        size_t len = type->tag == OPENTAC_TYPE_TUPLE ? type->tuple.len : type->struc.len;
+        OpentacType *const *elems = type->tag == OPENTAC_TYPE_TUPLE ? type->tuple.elems : type->struc.elems;
+        for (size_t i = 0; i < len; i++) {
+            opentac_c_type_define(emit, elems[i]);
+        }
+        if (type->tag == OPENTAC_TYPE_TUPLE) {
+            entry->index = ++emit->ntypes;
+            fprintf(file, "typedef struct {\n");
+        } else {
+            // named types are complete once their definition is out; until
+            // then they keep a nonzero index for being done
+            entry->index = SIZE_MAX;
+            opentac_c_type_name(emit, type);
+            fputs(" {\n", file);
+        }
+        for (size_t i = 0; i < len; i++) {
+            fputs("    ", file);
+            opentac_c_type_name(emit, elems[i]);
+            fprintf(file, " e%zu;\n", i);
+        }
+        if (!len) {
+            // nor empty structs
+            fputs("    uint8_t e0;\n", file);
+        }
+        if (type->tag == OPENTAC_TYPE_TUPLE) {
+            fprintf(file, "} opentac_t%zu;\n", entry->index);
+        } else {
+            fputs("};\n", file);
+        }
+        break;
+    }
+    }
+    entry->busy = false;
+}
+
+// an integer `value` extended to 64 bits, as an expression of type uint64_t
+static void opentac_c_word(FILE *file, uint64_t value) {
+    if ((int64_t) value < 0 && (int64_t) value > INT64_MIN) {
+        fprintf(file, "(uint64_t) INT64_C(%" PRId64 ")", (int64_t) value);
+    } else {
+        fprintf(file, "UINT64_C(%" PRIu64 ")", value);
+    }
+}
+
+// the 64 bit pattern the interpreter would hold a constant as
+static uint64_t opentac_c_constant(int tag, OpentacVal val) {
+    switch (tag) {
+    case OPENTAC_VAL_BOOL:
+        return val.bval;
+    case OPENTAC_VAL_I8:
+        return (uint64_t) (int64_t) val.i8val;
+    case OPENTAC_VAL_I16:
+        return (uint64_t) (int64_t) val.i16val;
+    case OPENTAC_VAL_I32:
+        return (uint64_t) (int64_t) val.i32val;
+    case OPENTAC_VAL_UI8:
+        return val.ui8val;
+    case OPENTAC_VAL_UI16:
+        return val.ui16val;
+    case OPENTAC_VAL_UI32:
+    case OPENTAC_VAL_F32:
+        return val.ui32val;
+    case OPENTAC_VAL_I64:
+    case OPENTAC_VAL_UI64:
+    case OPENTAC_VAL_F64:
+    case OPENTAC_VAL_PTR:
+        return val.ui64val;
+    }
+    return 0;
+}
+
+static int opentac_c_operand_kind(const struct OpentacCEmit *emit, int tag, OpentacVal val) {
+    if (tag == OPENTAC_VAL_REG) {
+        return opentac_c_kind(emit->regs[opentac_liveness_index(emit->fn, val.regval)]);
+    }
+    if (tag == OPENTAC_C_PENDING) {
+        return emit->pending_kinds[val.ui64val];
+    }
+    return opentac_c_tag_kind(tag);
+}
+
+static void opentac_c_reg(const struct OpentacCEmit *emit, size_t index) {
+    fprintf(emit->file, index < (size_t) emit->fn->reg ? "t%zu" : "a%zu", index < (size_t) emit->fn->reg ? index : index - emit->fn->reg);
+    if (emit->refd[index]) {
+        fprintf(emit->file, ".%s", opentac_c_members[opentac_c_kind(emit->regs[index])]);
+    }
+}
+
+static void opentac_c_local(const struct OpentacCEmit *emit, int tag, OpentacVal val) {
+    if (tag == OPENTAC_C_PENDING) {
+        fprintf(emit->file, "p%" PRIu64, val.ui64val);
+    } else {
+        opentac_c_reg(emit, opentac_liveness_index(emit->fn, val.regval));
+    }
+}
+
+// the operand as the 64 bit pattern the interpreter would hold it as, an
+// expression of type uint64_t
+static void opentac_c_slot(struct OpentacCEmit *emit, int tag, OpentacVal val) {
+    FILE *file = emit->file;
+    if (tag == OPENTAC_VAL_NAMED) {
+        OpentacItem *fn = opentac_builder_find(emit->builder, val.name, OPENTAC_ITEM_FN);
+        OpentacItem *decl = opentac_builder_find(emit->builder, val.name, OPENTAC_ITEM_DECL);
+        if (fn || (decl && decl->decl.type->tag != OPENTAC_TYPE_FN)) {
+            fputs("(uint64_t) (uintptr_t) &", file);
+            opentac_c_name(file, val.name);
+        } else {
+            fputs("UINT64_C(0)", file);
+        }
+        return;
+    }
+    if (tag != OPENTAC_VAL_REG && tag != OPENTAC_C_PENDING) {
+        opentac_c_word(file, opentac_c_constant(tag, val));
+        return;
+    }
+
+    int kind = opentac_c_operand_kind(emit, tag, val);
+    fputs(kind == OPENTAC_C_F32 ? "opentac_bits32(" : kind == OPENTAC_C_F64 ? "opentac_bits64(" : "(uint64_t) ", file);
+    opentac_c_local(emit, tag, val);
+    fputs(opentac_c_float(kind) ? ")" : "", file);
+}
+
+// brackets an expression of type uint64_t to turn it into one of `kind`
+static void opentac_c_from(FILE *file, int kind) {
+    fprintf(file, kind == OPENTAC_C_F32 ? "opentac_f32(" : kind == OPENTAC_C_F64 ? "opentac_f64(" : "(%s) (", opentac_c_types[kind]);
+}
+
+// the operand as an expression of type `kind`
+static void opentac_c_value(struct OpentacCEmit *emit, int kind, int tag, OpentacVal val) {
+    FILE *file = emit->file;
+    if ((tag == OPENTAC_VAL_REG || tag == OPENTAC_C_PENDING) && opentac_c_operand_kind(emit, tag, val) == kind) {
+        opentac_c_local(emit, tag, val);
+        return;
+    }
+    if (tag == OPENTAC_VAL_F64 + (kind - OPENTAC_C_F64) && opentac_c_float(kind) && isfinite(kind == OPENTAC_C_F32 ? val.fval : val.dval)) {
+        // exact in hexadecimal
+        fprintf(file, kind == OPENTAC_C_F32 ? "%af" : "%a", kind == OPENTAC_C_F32 ? (double) val.fval : val.dval);
+        return;
+    }
+    opentac_c_from(file, kind);
+    opentac_c_slot(emit, tag, val);
+    fputs(")", file);
+}
+
+static void opentac_c_assign(struct OpentacCEmit *emit, size_t t) {
+    fputs("    ", emit->file);
+    opentac_c_reg(emit, t);
+    fputs(" = ", emit->file);
+}
+
+static void opentac_c_compare(struct OpentacCEmit *emit, int relop, const OpentacStmt *stmt) {
+    static const char *const ops[] = { "<", "<=", "==", "!=", ">", ">=" };
+    FILE *file = emit->file;
+    int kind = opentac_c_operand_kind(emit, stmt->tag.left, stmt->left);
+    if (opentac_c_float(kind)) {
+        opentac_c_value(emit, kind, stmt->tag.left, stmt->left);
+        fprintf(file, " %s ", ops[relop - OPENTAC_OP_LT]);
+        opentac_c_value(emit, kind, stmt->tag.right, stmt->right);
+        return;
+    }
+    const char *cast = opentac_c_signed(kind) ? "(int64_t) " : "";
+    fputs(cast, file);
+    opentac_c_slot(emit, stmt->tag.left, stmt->left);
+    fprintf(file, " %s %s", ops[relop - OPENTAC_OP_LT], cast);
+    opentac_c_slot(emit, stmt->tag.right, stmt->right);
+}
+
+static void opentac_c_call(struct OpentacCEmit *emit, const OpentacStmt *stmt, size_t t, const size_t *pending, size_t npending) {
+    FILE *file = emit->file;
+    size_t n = stmt->right.ui64val;
+    opentac_assertf(n <= npending, "call in %s takes %zu arguments but only %zu were pushed before it", emit->fn->name->data, n, npending);
+    const size_t *args = pending + npending - n;
+    int kind = opentac_c_kind(emit->regs[t]);
+
+    // calls to functions of the module go to them directly, anything else
+    // through a pointer of the type the arguments make up
+    OpentacItem *item = stmt->tag.left == OPENTAC_VAL_NAMED ? opentac_builder_find(emit->builder, stmt->left.name, OPENTAC_ITEM_FN) : NULL;
+    const OpentacFnBuilder *target = item && item->fn.params.len == n ? &item->fn : NULL;
+    int result = kind;
+    if (target) {
+        OpentacItem *decl = opentac_builder_find(emit->builder, target->name, OPENTAC_ITEM_DECL);
+        result = decl && decl->decl.type->tag == OPENTAC_TYPE_FN ? opentac_c_kind(decl->decl.type->fn.result) : OPENTAC_C_I64;
+    }
+
+    opentac_c_assign(emit, t);
+    if (result != kind) {
+        opentac_c_from(file, kind);
+        fputs(result == OPENTAC_C_F32 ? "opentac_bits32(" : result == OPENTAC_C_F64 ? "opentac_bits64(" : "(uint64_t) (", file);
+    }
+    if (target) {
+        opentac_c_name(file, target->name);
+        fputs("(", file);
+    } else {
+        fprintf(file, "((%s (*)(", opentac_c_types[kind]);
+        for (size_t k = 0; k < n; k++) {
+            fprintf(file, "%s%s", k ? ", " : "", opentac_c_types[emit->pending_kinds[args[k]]]);
+        }
+        fputs(n ? ")) (uintptr_t) " : "void)) (uintptr_t) ", file);
+        opentac_c_slot(emit, stmt->tag.left, stmt->left);
+        fputs(")(", file);
+    }
+    for (size_t k = 0; k < n; k++) {
+        fputs(k ? ", " : "", file);
+        int param = target ? opentac_c_kind(target->params.params[k]) : emit->pending_kinds[args[k]];
+        opentac_c_value(emit, param, OPENTAC_C_PENDING, (OpentacVal) { .ui64val = args[k] });
+    }
+    fputs(result != kind ? ")));\n" : ");\n", file);
+}
+
+static void opentac_c_stmt(struct OpentacCEmit *emit, size_t i, size_t *pending, size_t *npending, const bool *placed, const bool *targeted) {
+    static const char *const arith[] = { "+", "-", "*", "/" };
+    FILE *file = emit->file;
+    OpentacFnBuilder *fn = emit->fn;
+    const OpentacStmt *stmt = fn->stmts + i;
+    int opcode = stmt->tag.opcode;
+    size_t t = 0;
+    int kind = OPENTAC_C_U64;
+    OpentacRegister reg;
+    if (opentac_stmt_def(stmt, &reg)) {
+        t = opentac_liveness_index(fn, reg);
+        kind = opentac_c_kind(emit->regs[t]);
+    }
+
+    if ((opcode & OPENTAC_OP_BRANCH) == OPENTAC_OP_BRANCH) {
+        int relop = opcode & ~OPENTAC_OP_BRANCH;
+        if (relop == OPENTAC_OP_NOP && stmt->tag.left == OPENTAC_VAL_ERROR) {
+            fprintf(file, "    goto l%" PRIu32 ";\n", stmt->label);
+        } else if (relop == OPENTAC_OP_NOP) {
+            // indirect branches to labels that were never placed abort
+            fputs("    switch (", file);
+            opentac_c_slot(emit, stmt->tag.left, stmt->left);
+            fputs(") {\n", file);
+            for (size_t label = 0; label < fn->label; label++) {
+                if (placed[label]) {
+                    fprintf(file, "    case %zu: goto l%zu;\n", label, label);
+                }
+            }
+            fputs("    default: abort();\n    }\n", file);
+        } else {
+            fputs("    if (", file);
+            opentac_c_compare(emit, relop, stmt);
+            fprintf(file, ") goto l%" PRIu32 ";\n", stmt->label);
+        }
+        return;
+    }
+
+    switch (opcode) {
+    case OPENTAC_OP_NOP:
+        return;
+    case OPENTAC_OP_LABEL:
+        if (targeted[stmt->label]) {
+            fprintf(file, "l%" PRIu32 ":;\n", stmt->label);
+        }
+        return;
+    case OPENTAC_OP_LT:
+    case OPENTAC_OP_LE:
+    case OPENTAC_OP_EQ:
+    case OPENTAC_OP_NE:
+    case OPENTAC_OP_GT:
+    case OPENTAC_OP_GE:
+        opentac_c_assign(emit, t);
+        opentac_c_from(file, kind);
+        opentac_c_compare(emit, opcode, stmt);
+        fputs(");\n", file);
+        return;
+    case OPENTAC_OP_BITAND:
+    case OPENTAC_OP_BITXOR:
+    case OPENTAC_OP_BITOR:
+    case OPENTAC_OP_SHL:
+    case OPENTAC_OP_SHR:
+    case OPENTAC_OP_ROL:
+    case OPENTAC_OP_ROR: {
+        static const char *const ops[] = { "&", "^", "|" };
+        // floats are shifted and masked as their bits
+        int width = opentac_c_float(kind) ? 64 : 8 << (kind % 4);
+        const char *shift = opcode == OPENTAC_OP_SHL ? "opentac_shl"
+            : opcode == OPENTAC_OP_SHR ? (opentac_c_signed(kind) ? "opentac_sar" : "opentac_shr")
+            : opcode == OPENTAC_OP_ROL ? "opentac_rol" : "opentac_ror";
+        opentac_c_assign(emit, t);
+        opentac_c_from(file, kind);
+        if (opcode <= OPENTAC_OP_BITOR) {
+            opentac_c_slot(emit, stmt->tag.left, stmt->left);
+            fprintf(file, " %s ", ops[opcode - OPENTAC_OP_BITAND]);
+            opentac_c_slot(emit, stmt->tag.right, stmt->right);
+        } else {
+            fprintf(file, "%s(", shift);
+            opentac_c_slot(emit, stmt->tag.left, stmt->left);
+            fputs(", ", file);
+            opentac_c_slot(emit, stmt->tag.right, stmt->right);
+            fprintf(file, opcode >= OPENTAC_OP_ROL ? ", %d)" : ")", width);
+        }
+        fputs(");\n", file);
+        return;
+    }
+    case OPENTAC_OP_ADD:
+    case OPENTAC_OP_SUB:
+    case OPENTAC_OP_MUL:
+    case OPENTAC_OP_DIV:
+    case OPENTAC_OP_MOD:
+        opentac_c_assign(emit, t);
+        if (opentac_c_float(kind)) {
+            if (opcode == OPENTAC_OP_MOD) {
+                fputs(kind == OPENTAC_C_F32 ? "fmodf(" : "fmod(", file);
+                opentac_c_value(emit, kind, stmt->tag.left, stmt->left);
+                fputs(", ", file);
+                opentac_c_value(emit, kind, stmt->tag.right, stmt->right);
+                fputs(");\n", file);
+                return;
+            }
+            opentac_c_value(emit, kind, stmt->tag.left, stmt->left);
+            fprintf(file, " %s ", arith[opcode - OPENTAC_OP_ADD]);
+            opentac_c_value(emit, kind, stmt->tag.right, stmt->right);
+            fputs(";\n", file);
+            return;
+        }
+        opentac_c_from(file, kind);
+        if ((opcode == OPENTAC_OP_DIV || opcode == OPENTAC_OP_MOD) && opentac_c_signed(kind)) {
+            // division by zero is left undefined, as in C
+            fputs(opcode == OPENTAC_OP_DIV ? "opentac_sdiv(" : "opentac_smod(", file);
+            opentac_c_slot(emit, stmt->tag.left, stmt->left);
+            fputs(", ", file);
+            opentac_c_slot(emit, stmt->tag.right, stmt->right);
+            fputs(")", file);
+        } else {
+            opentac_c_slot(emit, stmt->tag.left, stmt->left);
+            fprintf(file, " %s ", opcode == OPENTAC_OP_MOD ? "%" : arith[opcode - OPENTAC_OP_ADD]);
+            opentac_c_slot(emit, stmt->tag.right, stmt->right);
+        }
+        fputs(");\n", file);
+        return;
+    case OPENTAC_OP_NOT:
+    case OPENTAC_OP_NEG:
+        opentac_c_assign(emit, t);
+        if (opcode == OPENTAC_OP_NEG && opentac_c_float(kind)) {
+            fputs("-", file);
+            opentac_c_value(emit, kind, stmt->tag.left, stmt->left);
+            fputs(";\n", file);
+            return;
+        }
+        opentac_c_from(file, kind);
+        bool logical = opcode == OPENTAC_OP_NOT && (stmt->tag.left == OPENTAC_VAL_BOOL
+            || (stmt->tag.left == OPENTAC_VAL_REG && emit->regs[opentac_liveness_index(fn, stmt->left.regval)]->tag == OPENTAC_TYPE_BOOL));
+        fputs(logical ? "!" : opcode == OPENTAC_OP_NOT ? "~" : "0 - ", file);
+        opentac_c_slot(emit, stmt->tag.left, stmt->left);
+        fputs(");\n", file);
+        return;
+    case OPENTAC_OP_COPY:
+        opentac_c_assign(emit, t);
+        opentac_c_value(emit, kind, stmt->tag.left, stmt->left);
+        fputs(";\n", file);
+        return;
+    case OPENTAC_OP_REF:
+        opentac_c_assign(emit, t);
+        opentac_c_from(file, kind);
+        if (stmt->tag.left == OPENTAC_VAL_NAMED) {
+            // the name already is the address
+            opentac_c_slot(emit, stmt->tag.left, stmt->left);
+        } else {
+            size_t index = opentac_liveness_index(fn, stmt->left.regval);
+            fprintf(file, index < (size_t) fn->reg ? "(uint64_t) (uintptr_t) &t%zu" : "(uint64_t) (uintptr_t) &a%zu", index < (size_t) fn->reg ? index : index - fn->reg);
+        }
+        fputs(");\n", file);
+        return;
+    case OPENTAC_OP_DEREF:
+    case OPENTAC_OP_ASSIGN_INDEX:
+        fputs("    memcpy(&", file);
+        opentac_c_reg(emit, t);
+        fputs(", (const void *) (uintptr_t) (", file);
+        opentac_c_slot(emit, stmt->tag.left, stmt->left);
+        if (opcode == OPENTAC_OP_ASSIGN_INDEX) {
+            fputs(" + ", file);
+            opentac_c_slot(emit, stmt->tag.right, stmt->right);
+        }
+        fputs("), sizeof(", file);
+        opentac_c_reg(emit, t);
+        fputs("));\n", file);
+        return;
+    case OPENTAC_OP_INDEX_ASSIGN: {
+        // stores are as wide as the value stored
+        int value = opentac_c_operand_kind(emit, stmt->tag.right, stmt->right);
+        fprintf(file, "    { %s value = ", opentac_c_types[value]);
+        opentac_c_value(emit, value, stmt->tag.right, stmt->right);
+        fputs("; memcpy((void *) (uintptr_t) (", file);
+        opentac_c_slot(emit, OPENTAC_VAL_REG, (OpentacVal) { .regval = stmt->target });
+        fputs(" + ", file);
+        opentac_c_slot(emit, stmt->tag.left, stmt->left);
+        fputs("), &value, sizeof(value)); }\n", file);
+        return;
+    }
+    case OPENTAC_OP_PARAM:
+        fprintf(file, "    p%zu = ", i);
+        opentac_c_value(emit, emit->pending_kinds[i], stmt->tag.left, stmt->left);
+        fputs(";\n", file);
+        pending[(*npending)++] = i;
+        return;
+    case OPENTAC_OP_CALL:
+        opentac_c_call(emit, stmt, t, pending, *npending);
+        *npending -= stmt->right.ui64val;
+        return;
+    case OPENTAC_OP_RETURN: {
+        OpentacItem *decl = opentac_builder_find(emit->builder, fn->name, OPENTAC_ITEM_DECL);
+        int result = decl && decl->decl.type->tag == OPENTAC_TYPE_FN ? opentac_c_kind(decl->decl.type->fn.result) : OPENTAC_C_I64;
+        fputs("    return ", file);
+        opentac_c_value(emit, result, stmt->tag.left, stmt->left);
+        fputs(";\n", file);
+        return;
+    }
+    }
+
+    opentac_assertf(false, "cannot emit opcode %#x", (unsigned) opcode);
+}
+
+static void opentac_c_signature(struct OpentacCEmit *emit, const OpentacFnBuilder *fn, const bool *refd) {
+    FILE *file = emit->file;
+    OpentacItem *decl = opentac_builder_find(emit->builder, fn->name, OPENTAC_ITEM_DECL);
+    int result = decl && decl->decl.type->tag == OPENTAC_TYPE_FN ? opentac_c_kind(decl->decl.type->fn.result) : OPENTAC_C_I64;
+    fprintf(file, "%s ", opentac_c_types[result]);
+    opentac_c_name(file, fn->name);
+    fputs("(", file);
+    for (size_t k = 0; k < fn->params.len; k++) {
+        // parameters whose address is taken are moved to a slot
+        fprintf(file, refd && refd[fn->reg + k] ? "%s%s arg%zu" : "%s%s a%zu", k ? ", " : "", opentac_c_types[opentac_c_kind(fn->params.params[k])], k);
+    }
+    fputs(fn->params.len ? ")" : "void)", file);
+}
+
+static void opentac_c_fn(struct OpentacCEmit *emit, OpentacFnBuilder *fn) {
+    opentac_assertf(!fn->ssa, "%s has to leave ssa form before it can be emitted", fn->name->data);
+    FILE *file = emit->file;
+    size_t nregs = (size_t) fn->reg + (size_t) -fn->param;
+    emit->fn = fn;
+    emit->regs = malloc((nregs ? nregs : 1) * sizeof(OpentacType *));
+    emit->refd = calloc(nregs ? nregs : 1, sizeof(bool));
+    emit->pending_kinds = malloc((fn->len ? fn->len : 1) * sizeof(int));
+    size_t *pending = malloc((fn->len ? fn->len : 1) * sizeof(size_t));
+    bool *placed = calloc(fn->label ? fn->label : 1, sizeof(bool));
+    // temporaries optimizing left no statement for are not declared, nor
+    // labels no branch goes to
+    bool *used = calloc(nregs ? nregs : 1, sizeof(bool));
+    bool *targeted = calloc(fn->label ? fn->label : 1, sizeof(bool));
+    opentac_assert(emit->regs && emit->refd && emit->pending_kinds && pending && placed && used && targeted);
+    opentac_fn_infer(emit->builder, fn, emit->regs);
+
+    for (size_t i = 0; i < fn->len; i++) {
+        const OpentacStmt *stmt = fn->stmts + i;
+        OpentacRegister reg;
+        if (opentac_stmt_def(stmt, &reg) || stmt->tag.opcode == OPENTAC_OP_INDEX_ASSIGN) {
+            used[opentac_liveness_index(fn, stmt->tag.opcode == OPENTAC_OP_INDEX_ASSIGN ? stmt->target : reg)] = true;
+        }
+        if (stmt->tag.left == OPENTAC_VAL_REG) {
+            used[opentac_liveness_index(fn, stmt->left.regval)] = true;
+        }
+        if (stmt->tag.right == OPENTAC_VAL_REG) {
+            used[opentac_liveness_index(fn, stmt->right.regval)] = true;
+        }
+        if ((stmt->tag.opcode & OPENTAC_OP_BRANCH) == OPENTAC_OP_BRANCH) {
+            // an indirect branch may go to any label that is placed
+            if (stmt->tag.opcode == OPENTAC_OP_BRANCH && stmt->tag.left != OPENTAC_VAL_ERROR) {
+                memset(targeted, true, fn->label * sizeof(bool));
+            } else {
+                targeted[stmt->label] = true;
+            }
+        }
+        if (stmt->tag.opcode == OPENTAC_OP_REF && stmt->tag.left == OPENTAC_VAL_REG) {
+            emit->refd[opentac_liveness_index(fn, stmt->left.regval)] = true;
+        } else if (stmt->tag.opcode == OPENTAC_OP_LABEL) {
+            placed[stmt->label] = true;
+        } else if (stmt->tag.opcode == OPENTAC_OP_PARAM) {
+            emit->pending_kinds[i] = opentac_c_operand_kind(emit, stmt->tag.left, stmt->left);
+        }
+    }
+
+    opentac_c_signature(emit, fn, emit->refd);
+    fputs(" {\n", file);
+    // locals start out zeroed, like the interpreter's frames
+    for (size_t index = 0; index < nregs; index++) {
+        bool param = index >= (size_t) fn->reg;
+        size_t n = param ? index - fn->reg : index;
+        if (emit->refd[index]) {
+            fprintf(file, "    opentac_slot %s%zu = { 0 };\n", param ? "a" : "t", n);
+            if (param) {
+                fprintf(file, "    a%zu.%s = arg%zu;\n", n, opentac_c_members[opentac_c_kind(emit->regs[index])], n);
+            }
+        } else if (!param && used[index]) {
+            fprintf(file, "    %s t%zu = 0;\n", opentac_c_types[opentac_c_kind(emit->regs[index])], n);
+        } else if (param && !used[index]) {
+            fprintf(file, "    (void) a%zu;\n", n);
+        }
+    }
+    for (size_t i = 0; i < fn->len; i++) {
+        if (fn->stmts[i].tag.opcode == OPENTAC_OP_PARAM) {
+            fprintf(file, "    %s p%zu = 0;\n", opentac_c_types[emit->pending_kinds[i]], i);
+        }
+    }
+
+    size_t npending = 0;
+    for (size_t i = 0; i < fn->len; i++) {
+        opentac_c_stmt(emit, i, pending, &npending, placed, targeted);
+    }
+    // falling off the end returns zero
+    fputs("    return 0;\n}\n\n", file);
+
+    free(emit->regs);
+    free(emit->refd);
+    free(emit->pending_kinds);
+    free(pending);
+    free(placed);
+    free(used);
+    free(targeted);
+}
+
+int opentac_emit_c(OpentacBuilder *builder, FILE *file) {
+    opentac_assert(builder);
+    opentac_assert(file);
+
+    struct OpentacCEmit emit = { .builder = builder, .file = file, .cap = 16 };
+    while (emit.cap < builder->typeset.len * 2) {
+        emit.cap *= 2;
+    }
+    emit.types = calloc(emit.cap, sizeof(struct OpentacCType));
+    opentac_assert(emit.types);
+
+    fputs(opentac_c_prelude, file);
+    fputs("\n", file);
+
+    // named types first, so pointers can refer to them before they are
+    // complete
+    for (size_t i = 0; i < builder->typeset.len; i++) {
+        const OpentacType *type = builder->typeset.types[i];
+        if (type->tag == OPENTAC_TYPE_STRUCT || type->tag == OPENTAC_TYPE_UNION) {
+            opentac_c_type_name(&emit, type);
+            fputs(";\n", file);
+        }
+    }
+    for (size_t i = 0; i < builder->len; i++) {
+        const OpentacDecl *decl = &builder->items[i]->decl;
+        if (builder->items[i]->tag == OPENTAC_ITEM_DECL && decl->type->tag != OPENTAC_TYPE_FN) {
+            opentac_c_type_define(&emit, decl->type);
+        }
+    }
+    fputs("\n", file);
+
+    // declarations are zeroed storage of their type, functions are exported
+    // under their prefixed names
+    for (size_t i = 0; i < builder->len; i++) {
+        const OpentacDecl *decl = &builder->items[i]->decl;
+        if (builder->items[i]->tag == OPENTAC_ITEM_DECL && decl->type->tag != OPENTAC_TYPE_FN
+            && !opentac_builder_find(builder, decl->name, OPENTAC_ITEM_FN)) {
+            opentac_c_type_name(&emit, decl->type);
+            fputs(" ", file);
+            opentac_c_name(file, decl->name);
+            fputs(";\n", file);
+        }
+    }
+    for (size_t i = 0; i < builder->len; i++) {
+        if (builder->items[i]->tag == OPENTAC_ITEM_FN) {
+            opentac_c_signature(&emit, &builder->items[i]->fn, NULL);
+            fputs(";\n", file);
+        }
+    }
+    fputs("\n", file);
+
+    for (size_t i = 0; i < builder->len; i++) {
+        if (builder->items[i]->tag == OPENTAC_ITEM_FN) {
+            opentac_c_fn(&emit, &builder->items[i]->fn);
+        }
+    }
+
+    free(emit.types);
+    return ferror(file) ? 1 : 0;
+}
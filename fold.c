@@ -0,0 +1,322 @@
+#include <math.h>
+#include "include/opentac.h"
+
+static bool opentac_fold_is_int(int tag) {
+    return tag >= OPENTAC_VAL_I8 && tag <= OPENTAC_VAL_UI64;
+}
+
+static bool opentac_fold_is_signed(int tag) {
+    return tag >= OPENTAC_VAL_I8 && tag <= OPENTAC_VAL_I64;
+}
+
+static bool opentac_fold_is_float(int tag) {
+    return tag == OPENTAC_VAL_F32 || tag == OPENTAC_VAL_F64;
+}
+
+static unsigned opentac_fold_width(int tag) {
+    switch (tag) {
+    case OPENTAC_VAL_I8:
+    case OPENTAC_VAL_UI8:
+        return 8;
+    case OPENTAC_VAL_I16:
+    case OPENTAC_VAL_UI16:
+        return 16;
+    case OPENTAC_VAL_I32:
+    case OPENTAC_VAL_UI32:
+        return 32;
+    default:
+        return 64;
+    }
+}
+
+// integers are widened to 64 bits, sign extended when signed
+static uint64_t opentac_fold_raw(OpentacValue value) {
+    switch (value.tag) {
+    case OPENTAC_VAL_I8:
+        return (uint64_t) (int64_t) value.val.i8val;
+    case OPENTAC_VAL_I16:
+        return (uint64_t) (int64_t) value.val.i16val;
+    case OPENTAC_VAL_I32:
+        return (uint64_t) (int64_t) value.val.i32val;
+    case OPENTAC_VAL_I64:
+        return (uint64_t) value.val.i64val;
+    case OPENTAC_VAL_UI8:
+        return value.val.ui8val;
+    case OPENTAC_VAL_UI16:
+        return value.val.ui16val;
+    case OPENTAC_VAL_UI32:
+        return value.val.ui32val;
+    case OPENTAC_VAL_UI64:
+        return value.val.ui64val;
+    case OPENTAC_VAL_BOOL:
+        return value.val.bval;
+    }
+    return 0;
+}
+
+// truncates `raw` to the width of `tag`
+static OpentacValue opentac_fold_int(int tag, uint64_t raw) {
+    OpentacValue value = { .tag = tag, .val.ui64val = 0 };
+    switch (tag) {
+    case OPENTAC_VAL_I8:
+        value.val.i8val = (int8_t) raw;
+        break;
+    case OPENTAC_VAL_I16:
+        value.val.i16val = (int16_t) raw;
+        break;
+    case OPENTAC_VAL_I32:
+        value.val.i32val = (int32_t) raw;
+        break;
+    case OPENTAC_VAL_I64:
+        value.val.i64val = (int64_t) raw;
+        break;
+    case OPENTAC_VAL_UI8:
+        value.val.ui8val = (uint8_t) raw;
+        break;
+    case OPENTAC_VAL_UI16:
+        value.val.ui16val = (uint16_t) raw;
+        break;
+    case OPENTAC_VAL_UI32:
+        value.val.ui32val = (uint32_t) raw;
+        break;
+    case OPENTAC_VAL_UI64:
+        value.val.ui64val = raw;
+        break;
+    }
+    return value;
+}
+
+static OpentacValue opentac_fold_bool(bool b) {
+    OpentacValue value = { .tag = OPENTAC_VAL_BOOL, .val.ui64val = 0 };
+    value.val.bval = b;
+    return value;
+}
+
+static double opentac_fold_real(OpentacValue value) {
+    return value.tag == OPENTAC_VAL_F32 ? value.val.fval : value.val.dval;
+}
+
+static OpentacValue opentac_fold_float(int tag, double d) {
+    OpentacValue value = { .tag = tag, .val.ui64val = 0 };
+    if (tag == OPENTAC_VAL_F32) {
+        value.val.fval = (float) d;
+    } else {
+        value.val.dval = d;
+    }
+    return value;
+}
+
+static bool opentac_fold_compare(int opcode, int cmp, OpentacValue *result) {
+    switch (opcode) {
+    case OPENTAC_OP_LT:
+        *result = opentac_fold_bool(cmp < 0);
+        return true;
+    case OPENTAC_OP_LE:
+        *result = opentac_fold_bool(cmp <= 0);
+        return true;
+    case OPENTAC_OP_EQ:
+        *result = opentac_fold_bool(cmp == 0);
+        return true;
+    case OPENTAC_OP_NE:
+        *result = opentac_fold_bool(cmp != 0);
+        return true;
+    case OPENTAC_OP_GT:
+        *result = opentac_fold_bool(cmp > 0);
+        return true;
+    case OPENTAC_OP_GE:
+        *result = opentac_fold_bool(cmp >= 0);
+        return true;
+    }
+    return false;
+}
+
+static bool opentac_fold_ints(int opcode, OpentacValue left, OpentacValue right, OpentacValue *result) {
+    int tag = left.tag;
+    unsigned width = opentac_fold_width(tag);
+    uint64_t mask = width == 64 ? UINT64_MAX : ((uint64_t) 1 << width) - 1;
+    bool sign = opentac_fold_is_signed(tag);
+    uint64_t a = opentac_fold_raw(left);
+    uint64_t b = opentac_fold_raw(right);
+
+    // shift amounts may be of any integer type, everything else has to match
+    switch (opcode) {
+    case OPENTAC_OP_SHL:
+    case OPENTAC_OP_SHR:
+        if (opentac_fold_is_signed(right.tag) && (int64_t) b < 0) {
+            return false;
+        }
+        if (b >= width) {
+            return false;
+        }
+        if (opcode == OPENTAC_OP_SHL) {
+            *result = opentac_fold_int(tag, a << b);
+        } else if (sign) {
+            *result = opentac_fold_int(tag, (uint64_t) ((int64_t) a >> b));
+        } else {
+            *result = opentac_fold_int(tag, (a & mask) >> b);
+        }
+        return true;
+    case OPENTAC_OP_ROL:
+    case OPENTAC_OP_ROR: {
+        if (opentac_fold_is_signed(right.tag) && (int64_t) b < 0) {
+            return false;
+        }
+        uint64_t n = b % width;
+        uint64_t x = a & mask;
+        if (opcode == OPENTAC_OP_ROR) {
+            n = (width - n) % width;
+        }
+        *result = opentac_fold_int(tag, n ? ((x << n) | (x >> (width - n))) & mask : x);
+        return true;
+    }
+    }
+
+    if (right.tag != tag) {
+        return false;
+    }
+
+    // the smallest value of a signed type divided by -1 overflows
+    bool overflow = sign && b == UINT64_MAX && a == (uint64_t) 0 - ((mask >> 1) + 1);
+    switch (opcode) {
+    case OPENTAC_OP_ADD:
+        *result = opentac_fold_int(tag, a + b);
+        return true;
+    case OPENTAC_OP_SUB:
+        *result = opentac_fold_int(tag, a - b);
+        return true;
+    case OPENTAC_OP_MUL:
+        *result = opentac_fold_int(tag, a * b);
+        return true;
+    case OPENTAC_OP_DIV:
+        if (!b || overflow) {
+            return false;
+        }
+        *result = opentac_fold_int(tag, sign ? (uint64_t) ((int64_t) a / (int64_t) b) : a / b);
+        return true;
+    case OPENTAC_OP_MOD:
+        if (!b || overflow) {
+            return false;
+        }
+        *result = opentac_fold_int(tag, sign ? (uint64_t) ((int64_t) a % (int64_t) b) : a % b);
+        return true;
+    case OPENTAC_OP_BITAND:
+        *result = opentac_fold_int(tag, a & b);
+        return true;
+    case OPENTAC_OP_BITXOR:
+        *result = opentac_fold_int(tag, a ^ b);
+        return true;
+    case OPENTAC_OP_BITOR:
+        *result = opentac_fold_int(tag, a | b);
+        return true;
+    }
+
+    int cmp;
+    if (sign) {
+        cmp = (int64_t) a < (int64_t) b ? -1 : (int64_t) a > (int64_t) b;
+    } else {
+        cmp = a < b ? -1 : a > b;
+    }
+    return opentac_fold_compare(opcode, cmp, result);
+}
+
+bool opentac_fold_binary(int opcode, OpentacValue left, OpentacValue right, OpentacValue *result) {
+    opentac_assert(result);
+
+    if (opentac_fold_is_int(left.tag) && opentac_fold_is_int(right.tag)) {
+        return opentac_fold_ints(opcode, left, right, result);
+    }
+
+    if (left.tag != right.tag) {
+        return false;
+    }
+
+    if (opentac_fold_is_float(left.tag)) {
+        double a = opentac_fold_real(left);
+        double b = opentac_fold_real(right);
+        switch (opcode) {
+        case OPENTAC_OP_ADD:
+            *result = opentac_fold_float(left.tag, a + b);
+            return true;
+        case OPENTAC_OP_SUB:
+            *result = opentac_fold_float(left.tag, a - b);
+            return true;
+        case OPENTAC_OP_MUL:
+            *result = opentac_fold_float(left.tag, a * b);
+            return true;
+        case OPENTAC_OP_DIV:
+            *result = opentac_fold_float(left.tag, a / b);
+            return true;
+        case OPENTAC_OP_MOD:
+            *result = opentac_fold_float(left.tag, fmod(a, b));
+            return true;
+        }
+        // unordered operands only compare unequal
+        if (isnan(a) || isnan(b)) {
+            if (opcode >= OPENTAC_OP_LT && opcode <= OPENTAC_OP_GE) {
+                *result = opentac_fold_bool(opcode == OPENTAC_OP_NE);
+                return true;
+            }
+            return false;
+        }
+        return opentac_fold_compare(opcode, a < b ? -1 : a > b, result);
+    }
+
+    if (left.tag == OPENTAC_VAL_BOOL) {
+        bool a = left.val.bval;
+        bool b = right.val.bval;
+        switch (opcode) {
+        case OPENTAC_OP_BITAND:
+            *result = opentac_fold_bool(a && b);
+            return true;
+        case OPENTAC_OP_BITXOR:
+            *result = opentac_fold_bool(a != b);
+            return true;
+        case OPENTAC_OP_BITOR:
+            *result = opentac_fold_bool(a || b);
+            return true;
+        }
+        return opentac_fold_compare(opcode, (int) a - (int) b, result);
+    }
+
+    return false;
+}
+
+bool opentac_fold_unary(int opcode, OpentacValue value, OpentacValue *result) {
+    opentac_assert(result);
+
+    if (opcode == OPENTAC_OP_COPY) {
+        if (opentac_fold_constant(value.tag)) {
+            *result = value;
+            return true;
+        }
+        return false;
+    }
+
+    if (opentac_fold_is_int(value.tag)) {
+        uint64_t a = opentac_fold_raw(value);
+        switch (opcode) {
+        case OPENTAC_OP_NOT:
+            *result = opentac_fold_int(value.tag, ~a);
+            return true;
+        case OPENTAC_OP_NEG:
+            *result = opentac_fold_int(value.tag, -a);
+            return true;
+        }
+    } else if (opentac_fold_is_float(value.tag)) {
+        if (opcode == OPENTAC_OP_NEG) {
+            *result = opentac_fold_float(value.tag, -opentac_fold_real(value));
+            return true;
+        }
+    } else if (value.tag == OPENTAC_VAL_BOOL) {
+        if (opcode == OPENTAC_OP_NOT) {
+            *result = opentac_fold_bool(!value.val.bval);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool opentac_fold_constant(int tag) {
+    return opentac_fold_is_int(tag) || opentac_fold_is_float(tag) || tag == OPENTAC_VAL_BOOL;
+}
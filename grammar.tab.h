@@ -1,8 +1,8 @@
-/* A Bison parser, made by GNU Bison 3.5.1.  */
+/* A Bison parser, made by GNU Bison 3.8.2.  */
 
 /* Bison interface for Yacc-like parsers in C
 
-   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2020 Free Software Foundation,
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
    Inc.
 
    This program is free software: you can redistribute it and/or modify
@@ -16,7 +16,7 @@
    GNU General Public License for more details.
 
    You should have received a copy of the GNU General Public License
-   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
 
 /* As a special exception, you may create a larger work that contains
    part or all of the Bison parser skeleton and distribute that work
@@ -31,8 +31,9 @@
    This special exception was added by the Free Software Foundation in
    version 2.2 of Bison.  */
 
-/* Undocumented macros, especially those whose name start with YY_,
-   are private implementation details.  Do not rely on them.  */
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
 
 #ifndef YY_YY_GRAMMAR_TAB_H_INCLUDED
 # define YY_YY_GRAMMAR_TAB_H_INCLUDED
@@ -43,80 +44,114 @@
 #if YYDEBUG
 extern int yydebug;
 #endif
+/* "%code requires" blocks.  */
+#line 1 "grammar.y"
 
-/* Token type.  */
+#include "include/opentac.h"
+
+typedef void *yyscan_t;
+
+// all state of one parse, reachable from both the grammar actions and the
+// lexer (as yyextra) so that parses can run concurrently
+typedef struct OpentacParser {
+    OpentacBuilder *builder;
+    int status;
+    OpentacString *strval;
+    unsigned int opval;
+    int64_t ival;
+    double dval;
+    OpentacString *declname;
+    OpentacString *argname;
+    OpentacString *regval;
+    OpentacString *lblval;
+    int valc;
+    OpentacValue vals[2];
+    OpentacType *tval;
+    size_t tplen;
+    size_t tpcap;
+    OpentacType **tpval;
+} OpentacParser;
+
+#line 76 "grammar.tab.h"
+
+/* Token kinds.  */
 #ifndef YYTOKENTYPE
 # define YYTOKENTYPE
   enum yytokentype
   {
-    ERROR = 258,
-    INTEGER = 259,
-    REAL = 260,
-    STRING = 261,
-    IDENT = 262,
-    KW_IF = 263,
-    KW_BRANCH = 264,
-    KW_RETURN = 265,
-    KW_I8 = 266,
-    KW_I16 = 267,
-    KW_I32 = 268,
-    KW_I64 = 269,
-    KW_I128 = 270,
-    KW_U8 = 271,
-    KW_U16 = 272,
-    KW_U32 = 273,
-    KW_U64 = 274,
-    KW_U128 = 275,
-    KW_F32 = 276,
-    KW_F64 = 277,
-    KW_BOOL = 278,
-    KW_UNIT = 279,
-    KW_NEVER = 280,
-    KW_STRUCT = 281,
-    KW_UNION = 282,
-    KW_TUPLE = 283,
-    KW_PARAM = 284,
-    KW_TRUE = 285,
-    KW_FALSE = 286,
-    SYM_DEF = 287,
-    SYM_LET = 288,
-    SYM_DARROW = 289,
-    SYM_SARROW = 290,
-    SYM_SEMICOLON = 291,
-    SYM_COLON = 292,
-    SYM_COMMA = 293,
-    SYM_CARET = 294,
-    SYM_PARENL = 295,
-    SYM_PARENR = 296,
-    SYM_CURLYL = 297,
-    SYM_CURLYR = 298,
-    SYM_SQUAREL = 299,
-    SYM_SQUARER = 300,
-    KW_LT = 301,
-    KW_LE = 302,
-    KW_EQ = 303,
-    KW_NE = 304,
-    KW_GT = 305,
-    KW_GE = 306,
-    KW_BITAND = 307,
-    KW_BITXOR = 308,
-    KW_BITOR = 309,
-    KW_SHL = 310,
-    KW_SHR = 311,
-    KW_ROL = 312,
-    KW_ROR = 313,
-    KW_ADD = 314,
-    KW_SUB = 315,
-    KW_MUL = 316,
-    KW_DIV = 317,
-    KW_MOD = 318,
-    KW_CALL = 319,
-    KW_NOT = 320,
-    KW_NEG = 321,
-    KW_REF = 322,
-    KW_DEREF = 323,
-    KW_COPY = 324
+    YYEMPTY = -2,
+    YYEOF = 0,                     /* "end of file"  */
+    YYerror = 256,                 /* error  */
+    YYUNDEF = 257,                 /* "invalid token"  */
+    ERROR = 258,                   /* ERROR  */
+    INTEGER = 259,                 /* INTEGER  */
+    REAL = 260,                    /* REAL  */
+    STRING = 261,                  /* STRING  */
+    IDENT = 262,                   /* IDENT  */
+    KW_IF = 263,                   /* KW_IF  */
+    KW_BRANCH = 264,               /* KW_BRANCH  */
+    KW_RETURN = 265,               /* KW_RETURN  */
+    KW_I8 = 266,                   /* KW_I8  */
+    KW_I16 = 267,                  /* KW_I16  */
+    KW_I32 = 268,                  /* KW_I32  */
+    KW_I64 = 269,                  /* KW_I64  */
+    KW_I128 = 270,                 /* KW_I128  */
+    KW_U8 = 271,                   /* KW_U8  */
+    KW_U16 = 272,                  /* KW_U16  */
+    KW_U32 = 273,                  /* KW_U32  */
+    KW_U64 = 274,                  /* KW_U64  */
+    KW_U128 = 275,                 /* KW_U128  */
+    KW_F32 = 276,                  /* KW_F32  */
+    KW_F64 = 277,                  /* KW_F64  */
+    KW_BOOL = 278,                 /* KW_BOOL  */
+    KW_UNIT = 279,                 /* KW_UNIT  */
+    KW_NEVER = 280,                /* KW_NEVER  */
+    KW_STRUCT = 281,               /* KW_STRUCT  */
+    KW_UNION = 282,                /* KW_UNION  */
+    KW_TUPLE = 283,                /* KW_TUPLE  */
+    KW_PARAM = 284,                /* KW_PARAM  */
+    KW_TRUE = 285,                 /* KW_TRUE  */
+    KW_FALSE = 286,                /* KW_FALSE  */
+    SYM_DEF = 287,                 /* SYM_DEF  */
+    SYM_LET = 288,                 /* SYM_LET  */
+    SYM_DARROW = 289,              /* SYM_DARROW  */
+    SYM_SARROW = 290,              /* SYM_SARROW  */
+    SYM_SEMICOLON = 291,           /* SYM_SEMICOLON  */
+    SYM_COLON = 292,               /* SYM_COLON  */
+    SYM_COMMA = 293,               /* SYM_COMMA  */
+    SYM_CARET = 294,               /* SYM_CARET  */
+    SYM_PARENL = 295,              /* SYM_PARENL  */
+    SYM_PARENR = 296,              /* SYM_PARENR  */
+    SYM_CURLYL = 297,              /* SYM_CURLYL  */
+    SYM_CURLYR = 298,              /* SYM_CURLYR  */
+    SYM_SQUAREL = 299,             /* SYM_SQUAREL  */
+    SYM_SQUARER = 300,             /* SYM_SQUARER  */
+    KW_LT = 301,                   /* KW_LT  */
+    KW_LE = 302,                   /* KW_LE  */
+    KW_EQ = 303,                   /* KW_EQ  */
+    KW_NE = 304,                   /* KW_NE  */
+    KW_GT = 305,                   /* KW_GT  */
+    KW_GE = 306,                   /* KW_GE  */
+    KW_BITAND = 307,               /* KW_BITAND  */
+    KW_BITXOR = 308,               /* KW_BITXOR  */
+    KW_BITOR = 309,                /* KW_BITOR  */
+    KW_SHL = 310,                  /* KW_SHL  */
+    KW_SHR = 311,                  /* KW_SHR  */
+    KW_ROL = 312,                  /* KW_ROL  */
+    KW_ROR = 313,                  /* KW_ROR  */
+    KW_ADD = 314,                  /* KW_ADD  */
+    KW_SUB = 315,                  /* KW_SUB  */
+    KW_MUL = 316,                  /* KW_MUL  */
+    KW_DIV = 317,                  /* KW_DIV  */
+    KW_MOD = 318,                  /* KW_MOD  */
+    KW_CALL = 319,                 /* KW_CALL  */
+    KW_NOT = 320,                  /* KW_NOT  */
+    KW_NEG = 321,                  /* KW_NEG  */
+    KW_REF = 322,                  /* KW_REF  */
+    KW_DEREF = 323,                /* KW_DEREF  */
+    KW_COPY = 324                  /* KW_COPY  */
   };
+  typedef enum yytokentype yytoken_kind_t;
 #endif
 
 /* Value type.  */
@@ -127,8 +162,9 @@ typedef OpentacBuilder YYSTYPE;
 #endif
 
 
-extern YYSTYPE yylval;
 
-int yyparse (void);
+
+int yyparse (yyscan_t scanner, OpentacParser *ctx);
+
 
 #endif /* !YY_YY_GRAMMAR_TAB_H_INCLUDED  */
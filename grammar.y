@@ -1,28 +1,44 @@
-%{
+%code requires {
 #include "include/opentac.h"
-#define DEFAULT_TYPES_CAP 8
 
-int yylex(void);
-void yyerror(char const *);
+typedef void *yyscan_t;
+
+// all state of one parse, reachable from both the grammar actions and the
+// lexer (as yyextra) so that parses can run concurrently
+typedef struct OpentacParser {
+    OpentacBuilder *builder;
+    int status;
+    OpentacString *strval;
+    unsigned int opval;
+    int64_t ival;
+    double dval;
+    OpentacString *declname;
+    OpentacString *argname;
+    OpentacString *regval;
+    OpentacString *lblval;
+    int valc;
+    OpentacValue vals[2];
+    OpentacType *tval;
+    size_t tplen;
+    size_t tpcap;
+    OpentacType **tpval;
+} OpentacParser;
+}
 
-OpentacBuilder *opentac_b = NULL;
-OpentacString *yystrval = NULL;
-unsigned int yyopval;
-int64_t yyival = 0;
-double yydval = 0.0;
-int yystatus = 0;
-static OpentacString *yydeclname;
-static OpentacString *yyargname;
-static OpentacString *yyregval;
-static OpentacString *yylblval;
-static int yyvalc = 0;
-static OpentacValue yyvals[2];
-static OpentacType *yytval;
-static size_t yytplen;
-static size_t yytpcap;
-static OpentacType **yytpval;
+%{
+#define DEFAULT_TYPES_CAP 8
 %}
 
+%code {
+int yylex(YYSTYPE *lvalp, yyscan_t scanner);
+static void yyerror(yyscan_t scanner, OpentacParser *ctx, char const *error);
+static void opentac_parser_assign(OpentacParser *ctx, OpentacValue target);
+}
+
+%define api.pure full
+%param {yyscan_t scanner}
+%parse-param {OpentacParser *ctx}
+
 %define api.value.type {OpentacBuilder}
 %token ERROR
 %token INTEGER
@@ -106,13 +122,13 @@ item:
 
 declaration:
                 declname SYM_COLON type SYM_SEMICOLON {
-                    opentac_build_decl(opentac_b, yydeclname, yytval);
+                    opentac_build_decl(ctx->builder, ctx->declname, ctx->tval);
                   }
         ;
 
 function:
                 fndef SYM_DARROW SYM_CURLYL stmts SYM_CURLYR {
-                    opentac_finish_function(opentac_b);
+                    opentac_finish_function(ctx->builder);
                   }
         ;
 
@@ -121,12 +137,12 @@ fndef:
         ;
 
 declname:
-                IDENT { yydeclname = yystrval; }
+                IDENT { ctx->declname = ctx->strval; }
         ;
 
 fndefname:
                 IDENT {
-                    opentac_build_function(opentac_b, yystrval);
+                    opentac_build_function(ctx->builder, ctx->strval);
                   }
         ;
 
@@ -143,48 +159,48 @@ paramslist_inner:
 
 arg:
                 argname SYM_COLON type {
-                    opentac_build_function_param(opentac_b, yyargname, yytval);
+                    opentac_build_function_param(ctx->builder, ctx->argname, ctx->tval);
                   }
         ;
 
 argname:
-                IDENT { yyargname = yystrval; }
+                IDENT { ctx->argname = ctx->strval; }
         ;
 
 type:
-                KW_I8 { yytval = opentac_type_i8(opentac_b); }
-        |       KW_I16 { yytval = opentac_type_i16(opentac_b); }
-        |       KW_I32 { yytval = opentac_type_i32(opentac_b); }
-        |       KW_I64 { yytval = opentac_type_i64(opentac_b); }
-        |       KW_U8 { yytval = opentac_type_ui8(opentac_b); }
-        |       KW_U16 { yytval = opentac_type_ui16(opentac_b); }
-        |       KW_U32 { yytval = opentac_type_ui32(opentac_b); }
-        |       KW_U64 { yytval = opentac_type_ui64(opentac_b); }
-        |       KW_F32 { yytval = opentac_type_f32(opentac_b); }
-        |       KW_F64 { yytval = opentac_type_f64(opentac_b); }
-        |       KW_BOOL { yytval = opentac_type_bool(opentac_b); }
-        |       KW_UNIT { yytval = opentac_type_unit(opentac_b); }
-        |       KW_NEVER { yytval = opentac_type_never(opentac_b); }
-        |       SYM_CARET type { yytval = opentac_type_ptr(opentac_b, yytval); }
-        |       KW_TUPLE typelist1 { yytval = opentac_type_tuple(opentac_b, yytplen, yytpval); }
+                KW_I8 { ctx->tval = opentac_type_i8(ctx->builder); }
+        |       KW_I16 { ctx->tval = opentac_type_i16(ctx->builder); }
+        |       KW_I32 { ctx->tval = opentac_type_i32(ctx->builder); }
+        |       KW_I64 { ctx->tval = opentac_type_i64(ctx->builder); }
+        |       KW_U8 { ctx->tval = opentac_type_ui8(ctx->builder); }
+        |       KW_U16 { ctx->tval = opentac_type_ui16(ctx->builder); }
+        |       KW_U32 { ctx->tval = opentac_type_ui32(ctx->builder); }
+        |       KW_U64 { ctx->tval = opentac_type_ui64(ctx->builder); }
+        |       KW_F32 { ctx->tval = opentac_type_f32(ctx->builder); }
+        |       KW_F64 { ctx->tval = opentac_type_f64(ctx->builder); }
+        |       KW_BOOL { ctx->tval = opentac_type_bool(ctx->builder); }
+        |       KW_UNIT { ctx->tval = opentac_type_unit(ctx->builder); }
+        |       KW_NEVER { ctx->tval = opentac_type_never(ctx->builder); }
+        |       SYM_CARET type { ctx->tval = opentac_type_ptr(ctx->builder, ctx->tval); }
+        |       KW_TUPLE typelist1 { ctx->tval = opentac_type_tuple(ctx->builder, ctx->tplen, ctx->tpval); }
         |       KW_STRUCT IDENT {
-                    yytval = opentac_type_named(opentac_b, OPENTAC_TYPE_STRUCT, yystrval);
+                    ctx->tval = opentac_type_named(ctx->builder, OPENTAC_TYPE_STRUCT, ctx->strval);
                   }
         |       KW_UNION IDENT {
-                    yytval = opentac_type_named(opentac_b, OPENTAC_TYPE_UNION, yystrval);
+                    ctx->tval = opentac_type_named(ctx->builder, OPENTAC_TYPE_UNION, ctx->strval);
                   }
         |       SYM_SQUAREL type SYM_COMMA INTEGER SYM_SQUARER {
-                    yytval = opentac_type_array(opentac_b, yytval, yyival);
+                    ctx->tval = opentac_type_array(ctx->builder, ctx->tval, ctx->ival);
                   }
         |       typelist0 SYM_SARROW type {
-                    yytval = opentac_type_fn(opentac_b, yytplen, yytpval, yytval);
+                    ctx->tval = opentac_type_fn(ctx->builder, ctx->tplen, ctx->tpval, ctx->tval);
                   }
         ;
 
 typelist0:
                 SYM_PARENL SYM_PARENR {
-                    yytplen = 0;
-                    yytpval = malloc(sizeof(OpentacType *));
+                    ctx->tplen = 0;
+                    ctx->tpval = opentac_arena_alloc(&ctx->builder->arena, sizeof(OpentacType *));
                   }
         |       SYM_PARENL typelist_inner SYM_PARENR
         |       SYM_PARENL typelist_inner SYM_COMMA SYM_PARENR
@@ -197,17 +213,17 @@ typelist1:
 
 typelist_inner:
                 type {
-                    yytpcap = DEFAULT_TYPES_CAP;
-                    yytplen = 0;
-                    yytpval = malloc(yytpcap * sizeof(OpentacType));
-                    yytpval[yytplen++] = yytval;
+                    ctx->tpcap = DEFAULT_TYPES_CAP;
+                    ctx->tplen = 0;
+                    ctx->tpval = opentac_arena_alloc(&ctx->builder->arena, ctx->tpcap * sizeof(OpentacType *));
+                    ctx->tpval[ctx->tplen++] = ctx->tval;
                   }
         |       typelist_inner SYM_COMMA type {
-                    if (yytplen == yytpcap) {
-                      yytpcap *= 2;
-                      yytpval = realloc(yytpval, yytpcap * sizeof(OpentacType));
+                    if (ctx->tplen == ctx->tpcap) {
+                      ctx->tpval = opentac_arena_realloc(&ctx->builder->arena, ctx->tpval, ctx->tpcap * sizeof(OpentacType *), ctx->tpcap * 2 * sizeof(OpentacType *));
+                      ctx->tpcap *= 2;
                     }
-                    yytpval[yytplen++] = yytval;
+                    ctx->tpval[ctx->tplen++] = ctx->tval;
                   }
         ;
 
@@ -218,163 +234,188 @@ stmts:
 
 stmt:
                 reg SYM_LET binary value SYM_COMMA value SYM_SEMICOLON {
-                    OpentacValue target = opentac_build_binary(opentac_b, yyopval, yyvals[0], yyvals[1]);
-                    opentac_fn_bind_int(opentac_b, yyregval, target.val.regval);
-                    yyvalc = 0;
+                    OpentacValue target = opentac_build_binary(ctx->builder, ctx->opval, ctx->vals[0], ctx->vals[1]);
+                    opentac_parser_assign(ctx, target);
+                    ctx->valc = 0;
                   }
         |       reg SYM_LET unary value SYM_SEMICOLON {
-                    OpentacValue target = opentac_build_unary(opentac_b, yyopval, yyvals[0]);
-                    opentac_fn_bind_int(opentac_b, yyregval, target.val.regval);
-                    yyvalc = 0;
+                    OpentacValue target = opentac_build_unary(ctx->builder, ctx->opval, ctx->vals[0]);
+                    opentac_parser_assign(ctx, target);
+                    ctx->valc = 0;
                   }
         |       reg SYM_SQUAREL value SYM_SQUARER SYM_LET value SYM_SEMICOLON {
-                    OpentacRegister reg = opentac_fn_get_int(opentac_b, yyregval);
-                    opentac_del_string(yyregval);
-                    opentac_build_index_assign(opentac_b, reg, yyvals[0], yyvals[1]);
-                    yyvalc = 0;
+                    OpentacRegister reg = opentac_fn_get_int(ctx->builder, ctx->regval);
+                    opentac_build_index_assign(ctx->builder, reg, ctx->vals[0], ctx->vals[1]);
+                    ctx->valc = 0;
                   }
         |       reg SYM_LET value SYM_SQUAREL value SYM_SQUARER SYM_SEMICOLON {
-                    OpentacValue target = opentac_build_assign_index(opentac_b, yyvals[0], yyvals[1]);
-                    opentac_fn_bind_int(opentac_b, yyregval, target.val.regval);
-                    yyvalc = 0;
+                    OpentacValue target = opentac_build_assign_index(ctx->builder, ctx->vals[0], ctx->vals[1]);
+                    opentac_parser_assign(ctx, target);
+                    ctx->valc = 0;
                   }
         |       KW_PARAM value SYM_SEMICOLON {
-                    opentac_build_param(opentac_b, yyvals[0]);
-                    yyvalc = 0;
+                    opentac_build_param(ctx->builder, ctx->vals[0]);
+                    ctx->valc = 0;
                   }
         |       KW_RETURN value SYM_SEMICOLON {
-                    opentac_build_return(opentac_b, yyvals[0]);
-                    yyvalc = 0;
+                    opentac_build_return(ctx->builder, ctx->vals[0]);
+                    ctx->valc = 0;
                   }
         |       KW_IF binary value SYM_COMMA value KW_BRANCH label SYM_SEMICOLON {
-                    OpentacLabel label = opentac_fn_get_int(opentac_b, yylblval);
-                    opentac_del_string(yyregval);
-                    opentac_build_if_branch(opentac_b, yyopval, yyvals[0], yyvals[1], label);
-                    yyvalc = 0;
+                    OpentacLabel label = opentac_fn_label(ctx->builder, ctx->lblval);
+                    opentac_build_if_branch(ctx->builder, ctx->opval, ctx->vals[0], ctx->vals[1], label);
+                    ctx->valc = 0;
+                  }
+        |       KW_BRANCH label SYM_SEMICOLON {
+                    opentac_build_jump(ctx->builder, opentac_fn_label(ctx->builder, ctx->lblval));
                   }
-        |       KW_BRANCH value SYM_SEMICOLON {
-                    opentac_build_branch(opentac_b, yyvals[0]);
-                    yyvalc = 0;
+        |       label SYM_COLON {
+                    opentac_build_label(ctx->builder, opentac_fn_label(ctx->builder, ctx->lblval));
                   }
         ;
 
 reg:
-                IDENT { yyregval = yystrval; }
+                IDENT { ctx->regval = ctx->strval; }
         ;
 
 label:
-                IDENT { yylblval = yystrval; }
+                IDENT { ctx->lblval = ctx->strval; }
         ;
 
 value:
                 IDENT {
-                    yyvals[yyvalc].tag = OPENTAC_VAL_NAMED;
-                    yyvals[yyvalc++].val.name = yystrval;
+                    // names bound in the function are registers, anything
+                    // else refers to an item
+                    uint32_t reg;
+                    if (opentac_fn_lookup_int(ctx->builder, ctx->strval, &reg)) {
+                      ctx->vals[ctx->valc].tag = OPENTAC_VAL_REG;
+                      ctx->vals[ctx->valc++].val.regval = reg;
+                    } else {
+                      ctx->vals[ctx->valc].tag = OPENTAC_VAL_NAMED;
+                      ctx->vals[ctx->valc++].val.name = ctx->strval;
+                    }
                   }
         |       INTEGER SYM_COLON type {
-                    switch (yytval->tag) {
+                    switch (ctx->tval->tag) {
                     case OPENTAC_TYPE_I8:
-                      yyvals[yyvalc].tag = OPENTAC_VAL_I8;
-                      yyvals[yyvalc++].val.i8val = yyival;
+                      ctx->vals[ctx->valc].tag = OPENTAC_VAL_I8;
+                      ctx->vals[ctx->valc++].val.i8val = ctx->ival;
                       break;
                     case OPENTAC_TYPE_I16:
-                      yyvals[yyvalc].tag = OPENTAC_VAL_I16;
-                      yyvals[yyvalc++].val.i16val = yyival;
+                      ctx->vals[ctx->valc].tag = OPENTAC_VAL_I16;
+                      ctx->vals[ctx->valc++].val.i16val = ctx->ival;
                       break;
                     case OPENTAC_TYPE_I32:
-                      yyvals[yyvalc].tag = OPENTAC_VAL_I32;
-                      yyvals[yyvalc++].val.i32val = yyival;
+                      ctx->vals[ctx->valc].tag = OPENTAC_VAL_I32;
+                      ctx->vals[ctx->valc++].val.i32val = ctx->ival;
                       break;
                     case OPENTAC_TYPE_I64:
-                      yyvals[yyvalc].tag = OPENTAC_VAL_I64;
-                      yyvals[yyvalc++].val.i64val = yyival;
+                      ctx->vals[ctx->valc].tag = OPENTAC_VAL_I64;
+                      ctx->vals[ctx->valc++].val.i64val = ctx->ival;
                       break;
                     case OPENTAC_TYPE_UI8:
-                      yyvals[yyvalc].tag = OPENTAC_VAL_UI8;
-                      yyvals[yyvalc++].val.ui8val = yyival;
+                      ctx->vals[ctx->valc].tag = OPENTAC_VAL_UI8;
+                      ctx->vals[ctx->valc++].val.ui8val = ctx->ival;
                       break;
                     case OPENTAC_TYPE_UI16:
-                      yyvals[yyvalc].tag = OPENTAC_VAL_UI16;
-                      yyvals[yyvalc++].val.ui16val = yyival;
+                      ctx->vals[ctx->valc].tag = OPENTAC_VAL_UI16;
+                      ctx->vals[ctx->valc++].val.ui16val = ctx->ival;
                       break;
                     case OPENTAC_TYPE_UI32:
-                      yyvals[yyvalc].tag = OPENTAC_VAL_UI32;
-                      yyvals[yyvalc++].val.ui32val = yyival;
+                      ctx->vals[ctx->valc].tag = OPENTAC_VAL_UI32;
+                      ctx->vals[ctx->valc++].val.ui32val = ctx->ival;
                       break;
                     case OPENTAC_TYPE_UI64:
-                      yyvals[yyvalc].tag = OPENTAC_VAL_UI64;
-                      yyvals[yyvalc++].val.ui64val = yyival;
+                      ctx->vals[ctx->valc].tag = OPENTAC_VAL_UI64;
+                      ctx->vals[ctx->valc++].val.ui64val = ctx->ival;
                       break;
                     case OPENTAC_TYPE_F32:
-                      yyvals[yyvalc].tag = OPENTAC_VAL_F32;
-                      yyvals[yyvalc++].val.fval = (float) yyival;
+                      ctx->vals[ctx->valc].tag = OPENTAC_VAL_F32;
+                      ctx->vals[ctx->valc++].val.fval = (float) ctx->ival;
                       break;
                     case OPENTAC_TYPE_F64:
-                      yyvals[yyvalc].tag = OPENTAC_VAL_F64;
-                      yyvals[yyvalc++].val.dval = (double) yyival;
+                      ctx->vals[ctx->valc].tag = OPENTAC_VAL_F64;
+                      ctx->vals[ctx->valc++].val.dval = (double) ctx->ival;
                       break;
                     default:
-                      yyerror("type error: integers can only be declared as integer or floating point types");
-                      yystatus = 1;
-                      yyvals[yyvalc++].tag = OPENTAC_VAL_ERROR;
+                      yyerror(scanner, ctx, "type error: integers can only be declared as integer or floating point types");
+                      ctx->status = 1;
+                      ctx->vals[ctx->valc++].tag = OPENTAC_VAL_ERROR;
                       break;
                     }
                   }
         |       REAL SYM_COLON type {
-                    switch (yytval->tag) {
+                    switch (ctx->tval->tag) {
                     case OPENTAC_TYPE_F32:
-                      yyvals[yyvalc].tag = OPENTAC_VAL_F32;
-                      yyvals[yyvalc++].val.fval = (float) yydval;
+                      ctx->vals[ctx->valc].tag = OPENTAC_VAL_F32;
+                      ctx->vals[ctx->valc++].val.fval = (float) ctx->dval;
                       break;
                     case OPENTAC_TYPE_F64:
-                      yyvals[yyvalc].tag = OPENTAC_VAL_F64;
-                      yyvals[yyvalc++].val.dval = yydval;
+                      ctx->vals[ctx->valc].tag = OPENTAC_VAL_F64;
+                      ctx->vals[ctx->valc++].val.dval = ctx->dval;
                       break;
                     default:
-                      yyerror("type error: real numbers can only be declared as floating point types");
-                      yystatus = 1;
-                      yyvals[yyvalc++].tag = OPENTAC_VAL_ERROR;
+                      yyerror(scanner, ctx, "type error: real numbers can only be declared as floating point types");
+                      ctx->status = 1;
+                      ctx->vals[ctx->valc++].tag = OPENTAC_VAL_ERROR;
                       break;
                     }
                   }
         |       KW_TRUE {
-                    yyvals[yyvalc].tag = OPENTAC_VAL_BOOL;
-                    yyvals[yyvalc++].val.bval = 1;
+                    ctx->vals[ctx->valc].tag = OPENTAC_VAL_BOOL;
+                    ctx->vals[ctx->valc++].val.bval = 1;
                   }
         |       KW_FALSE {
-                    yyvals[yyvalc].tag = OPENTAC_VAL_BOOL;
-                    yyvals[yyvalc++].val.bval = 0;
+                    ctx->vals[ctx->valc].tag = OPENTAC_VAL_BOOL;
+                    ctx->vals[ctx->valc++].val.bval = 0;
                   }
         ;
 
 binary:
-	  	KW_LT { yyopval = OPENTAC_OP_LT; }
-	| 	KW_LE { yyopval = OPENTAC_OP_LE; }
-	| 	KW_EQ { yyopval = OPENTAC_OP_EQ; }
-	| 	KW_NE { yyopval = OPENTAC_OP_NE; }
-	| 	KW_GT { yyopval = OPENTAC_OP_GT; }
-	| 	KW_GE { yyopval = OPENTAC_OP_GE; }
-	| 	KW_BITAND { yyopval = OPENTAC_OP_BITAND; }
-	| 	KW_BITXOR { yyopval = OPENTAC_OP_BITXOR; }
-	| 	KW_BITOR { yyopval = OPENTAC_OP_BITOR; }
-	| 	KW_SHL { yyopval = OPENTAC_OP_SHL; }
-	| 	KW_SHR { yyopval = OPENTAC_OP_SHR; }
-	| 	KW_ROL { yyopval = OPENTAC_OP_ROL; }
-	| 	KW_ROR { yyopval = OPENTAC_OP_ROR; }
-	| 	KW_ADD { yyopval = OPENTAC_OP_ADD; }
-	| 	KW_SUB { yyopval = OPENTAC_OP_SUB; }
-	| 	KW_MUL { yyopval = OPENTAC_OP_MUL; }
-	| 	KW_DIV { yyopval = OPENTAC_OP_DIV; }
-	| 	KW_MOD { yyopval = OPENTAC_OP_MOD; }
-	| 	KW_CALL { yyopval = OPENTAC_OP_CALL; }
+	  	KW_LT { ctx->opval = OPENTAC_OP_LT; }
+	| 	KW_LE { ctx->opval = OPENTAC_OP_LE; }
+	| 	KW_EQ { ctx->opval = OPENTAC_OP_EQ; }
+	| 	KW_NE { ctx->opval = OPENTAC_OP_NE; }
+	| 	KW_GT { ctx->opval = OPENTAC_OP_GT; }
+	| 	KW_GE { ctx->opval = OPENTAC_OP_GE; }
+	| 	KW_BITAND { ctx->opval = OPENTAC_OP_BITAND; }
+	| 	KW_BITXOR { ctx->opval = OPENTAC_OP_BITXOR; }
+	| 	KW_BITOR { ctx->opval = OPENTAC_OP_BITOR; }
+	| 	KW_SHL { ctx->opval = OPENTAC_OP_SHL; }
+	| 	KW_SHR { ctx->opval = OPENTAC_OP_SHR; }
+	| 	KW_ROL { ctx->opval = OPENTAC_OP_ROL; }
+	| 	KW_ROR { ctx->opval = OPENTAC_OP_ROR; }
+	| 	KW_ADD { ctx->opval = OPENTAC_OP_ADD; }
+	| 	KW_SUB { ctx->opval = OPENTAC_OP_SUB; }
+	| 	KW_MUL { ctx->opval = OPENTAC_OP_MUL; }
+	| 	KW_DIV { ctx->opval = OPENTAC_OP_DIV; }
+	| 	KW_MOD { ctx->opval = OPENTAC_OP_MOD; }
+	| 	KW_CALL { ctx->opval = OPENTAC_OP_CALL; }
 ;
 
 unary:
-	  	KW_NOT { yyopval = OPENTAC_OP_NOT; }
-	| 	KW_NEG { yyopval = OPENTAC_OP_NEG; }
-	| 	KW_REF { yyopval = OPENTAC_OP_REF; }
-	| 	KW_DEREF { yyopval = OPENTAC_OP_DEREF; }
-	| 	KW_COPY { yyopval = OPENTAC_OP_COPY; }
+	  	KW_NOT { ctx->opval = OPENTAC_OP_NOT; }
+	| 	KW_NEG { ctx->opval = OPENTAC_OP_NEG; }
+	| 	KW_REF { ctx->opval = OPENTAC_OP_REF; }
+	| 	KW_DEREF { ctx->opval = OPENTAC_OP_DEREF; }
+	| 	KW_COPY { ctx->opval = OPENTAC_OP_COPY; }
         ;
 
 %%
+
+// assigning to a name that is already bound writes its register again, so
+// variables keep one register across loops and branches
+static void opentac_parser_assign(OpentacParser *ctx, OpentacValue target) {
+    uint32_t reg;
+    if (opentac_fn_lookup_int(ctx->builder, ctx->regval, &reg)) {
+        opentac_fn_retarget(ctx->builder, reg);
+    } else {
+        opentac_fn_bind_int(ctx->builder, ctx->regval, target.val.regval);
+    }
+}
+
+static void yyerror(yyscan_t scanner, OpentacParser *ctx, char const *error) {
+    (void) scanner;
+    (void) ctx;
+    fprintf(stderr, "error: %s\n", error);
+}
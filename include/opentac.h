@@ -33,10 +33,37 @@ typedef struct OpentacRegalloc OpentacRegalloc;
 typedef int32_t OpentacRegister;
 typedef uint32_t OpentacLabel;
 
+// types are hash-consed: structurally equal types share one OpentacType
 struct OpentacTypeset {
     size_t len;
     size_t cap;
     OpentacType **types;
+    // open addressing, power of two capacity, NULL marks an empty slot
+    size_t table_cap;
+    OpentacType **table;
+};
+
+struct OpentacArenaChunk {
+    struct OpentacArenaChunk *next;
+    size_t cap;
+    size_t len;
+    max_align_t data[];
+};
+
+// region allocator; everything allocated from an arena is released at once
+// by opentac_arena_reset (which keeps the chunks for reuse) or
+// opentac_arena_destroy
+struct OpentacArena {
+    struct OpentacArenaChunk *head;
+    struct OpentacArenaChunk *current;
+};
+
+// interned strings are unique per builder and compare by address
+struct OpentacInterner {
+    size_t len;
+    // open addressing, power of two capacity, NULL marks an empty slot
+    size_t cap;
+    OpentacString **table;
 };
 
 struct OpentacBuilder {
@@ -45,6 +72,9 @@ struct OpentacBuilder {
     OpentacItem **items;
     OpentacItem **current;
     struct OpentacTypeset typeset;
+    struct OpentacInterner interner;
+    // owns every item, statement, type and interned string of the module
+    struct OpentacArena arena;
 };
 
 struct OpentacDecl {
@@ -60,21 +90,94 @@ struct OpentacEntry {
     };
 };
 
+// keyed by interned name; open addressing, power of two capacity, a NULL
+// key marks an empty slot
 struct OpentacNameTable {
     size_t len;
     size_t cap;
     struct OpentacEntry *entries;
 };
 
+struct OpentacRegName {
+    OpentacRegister reg;
+    OpentacString *name;
+};
+
+// maps registers back to the names bound to them with opentac_fn_bind_int;
+// open addressing, power of two capacity, a NULL name marks an empty slot
+struct OpentacRegNames {
+    size_t len;
+    size_t cap;
+    struct OpentacRegName *entries;
+};
+
 struct OpentacParams {
     size_t len;
     size_t cap;
     OpentacType **params;
 };
 
+struct OpentacBlock {
+    // statements [start, end) of the function
+    size_t start;
+    size_t end;
+    // ranges of OpentacCfg.preds and OpentacCfg.succs
+    size_t pred;
+    size_t npred;
+    size_t succ;
+    size_t nsucc;
+};
+
+// basic blocks of a function in statement order, block 0 is the entry; built
+// on demand by opentac_fn_cfg and cached until the function is modified
+struct OpentacCfg {
+    bool valid;
+    size_t len;
+    struct OpentacBlock *blocks;
+    size_t *preds;
+    size_t *succs;
+    // label -> block, SIZE_MAX for labels that were never placed
+    size_t nlabels;
+    size_t *labels;
+};
+
+// bitsets over the registers of a function, one per block and `words` words
+// long; registers are numbered with opentac_liveness_index, temporaries
+// first and parameters after them
+struct OpentacLiveness {
+    size_t nregs;
+    size_t words;
+    uint64_t *live_in;
+    uint64_t *live_out;
+};
+
+// operands of every phi of a function, a phi has `right.ui64val` of them
+// starting at `left.ui64val`
+struct OpentacPhiArgs {
+    size_t len;
+    size_t cap;
+    struct OpentacPhiArg *args;
+};
+
+// dominator tree of a function's cfg; unreachable blocks have an idom of
+// SIZE_MAX and are left out of `rpo`
+struct OpentacDominators {
+    size_t len;
+    size_t *idom;
+    // reachable blocks in reverse postorder
+    size_t nrpo;
+    size_t *rpo;
+    // the children of block b are children[child[b]] to children[child[b + 1]]
+    size_t *child;
+    size_t *children;
+};
+
 struct OpentacFnBuilder {
     OpentacString *name;
     struct OpentacNameTable name_table;
+    // labels live in their own namespace
+    struct OpentacNameTable labels;
+    struct OpentacRegNames reg_names;
     struct OpentacParams params;
     OpentacRegister param;
     OpentacRegister reg;
@@ -83,6 +186,10 @@ struct OpentacFnBuilder {
     size_t cap;
     OpentacStmt *stmts;
     OpentacStmt *current;
+    struct OpentacCfg cfg;
+    struct OpentacPhiArgs phis;
+    // set by opentac_fn_to_ssa, every register has a single definition
+    bool ssa;
 };
 
 enum {
@@ -128,6 +235,14 @@ enum {
     OPENTAC_OP_REF,
     OPENTAC_OP_DEREF,
     OPENTAC_OP_COPY,
+    // marks the position of `label`, starts a basic block
+    OPENTAC_OP_LABEL,
+    // selects the operand flowing in from the predecessor block that was
+    // taken, see OpentacPhiArgs; only present in ssa form
+    OPENTAC_OP_PHI,
+    // jumps to `label` if the relop is true, with a relop of NOP and an error
+    // operand it jumps unconditionally and with a NOP relop and a value
+    // operand it is an indirect branch
     OPENTAC_OP_BRANCH = 0xff00,
 };
 
@@ -179,6 +294,12 @@ struct OpentacValue {
     OpentacVal val;
 };
 
+struct OpentacPhiArg {
+    // block of the cfg that the value flows in from
+    size_t pred;
+    OpentacValue value;
+};
+
 // size should be 32 + 32 + 64 + 64 bits = 24 bytes
 struct OpentacStmt {
     OpentacOpcode tag;
@@ -270,6 +391,13 @@ enum {
     OPENTAC_REG_SPILLED,
 };
 
+// register classes, an interval takes registers of the class of its type
+enum {
+    OPENTAC_REGCLASS_INT,
+    OPENTAC_REGCLASS_FLOAT,
+    OPENTAC_REGCLASSES,
+};
+
 // machine register
 struct OpentacMReg {
     const char *name;
@@ -283,9 +411,18 @@ struct OpentacPurpose {
     };
 };
 
+typedef uint64_t OpentacLifetime;
+
 struct OpentacRegEntry {
+    // debug name, only set by opentac_alloc_regtable_names
     OpentacString *key;
+    OpentacRegister reg;
     struct OpentacPurpose purpose;
+    // the lifetimes the entry covers; a register whose interval was split
+    // has an entry per piece
+    bool split;
+    OpentacLifetime start;
+    OpentacLifetime end;
 };
 
 struct OpentacRegisterTable {
@@ -294,15 +431,43 @@ struct OpentacRegisterTable {
     struct OpentacRegEntry *entries;
 };
 
-typedef uint64_t OpentacLifetime;
+// inclusive
+struct OpentacRange {
+    OpentacLifetime start;
+    OpentacLifetime end;
+};
 
 struct OpentacInterval {
     int stack;
-    const char *name;
+    int regclass;
+    OpentacRegister reg;
     OpentacTypeInfo ti;
     struct OpentacPurpose purpose;
     OpentacLifetime start;
     OpentacLifetime end;
+    // the ranges in which the register is live, in increasing order and
+    // covered by start and end; the gaps are holes in the interval
+    size_t nranges;
+    struct OpentacRange *ranges;
+    // set when the interval starts with a copy from `hint`, whose machine
+    // register it takes over if the source dies at that copy
+    bool hinted;
+    OpentacRegister hint;
+    // the number of calls the value lives across, which then only fit in
+    // registers calls leave alone
+    size_t calls;
+    // the register a call passes or returns the value in, taken when free
+    const char *prefer;
+    // the positions of the statements using or defining the value, in
+    // increasing order; where none are given the interval counts as used
+    // at its end only
+    size_t nuses;
+    OpentacLifetime *uses;
+    // set on every piece of an interval the allocator split, which then
+    // links to the piece after it in `next`, the index of a live interval,
+    // or holds 0 for the last one
+    bool split;
+    size_t next;
 };
 
 struct OpentacPool {
@@ -320,6 +485,7 @@ struct OpentacIntervals {
 struct OpentacActive {
     size_t index;
     struct OpentacMReg reg;
+    bool clobbered;
 };
 
 struct OpentacActives {
@@ -328,26 +494,297 @@ struct OpentacActives {
     struct OpentacActive *actives;
 };
 
-struct OpentacRegalloc {
+struct OpentacRegFile {
+    size_t len;
+    const char **registers;
+};
+
+// what the allocator is told about a target, by register class: the
+// registers it may use, and of the calling convention the ones calls
+// clobber, pass arguments in and return results in. A class given no
+// registers takes the integer ones
+struct OpentacTarget {
+    struct OpentacRegFile files[OPENTAC_REGCLASSES];
+    struct OpentacRegFile clobbered[OPENTAC_REGCLASSES];
+    struct OpentacRegFile args[OPENTAC_REGCLASSES];
+    const char *results[OPENTAC_REGCLASSES];
+};
+
+// the free registers of a class, with those calls clobber kept apart, and
+// the intervals holding the others
+struct OpentacRegClass {
+    bool shared;
     struct OpentacPool registers;
+    struct OpentacPool clobbered;
+    struct OpentacActives active;
+    // intervals holding a register that are in a hole where the scan is;
+    // the register is back in its pool until their next range
+    struct OpentacActives inactive;
+};
+
+// a stack slot shared by spilled intervals that are never live at once,
+// large and aligned enough for each of them
+struct OpentacSlot {
+    OpentacTypeInfo ti;
+    uint64_t offset;
+    // the ranges of the intervals in the slot, in increasing order
+    size_t nranges;
+    size_t cap;
+    struct OpentacRange *ranges;
+};
+
+struct OpentacSlots {
+    size_t len;
+    size_t cap;
+    struct OpentacSlot *slots;
+};
+
+// a copy of `reg` between the places the allocator gave two pieces of its
+// interval, made before the statement at `pos`, or for an edge on the way
+// from the block ending with the statement at `pos` to the one starting at
+// `succ`. The moves at one place happen at once
+struct OpentacMove {
+    OpentacRegister reg;
+    bool edge;
+    OpentacLifetime pos;
+    OpentacLifetime succ;
+    struct OpentacPurpose src;
+    struct OpentacPurpose dst;
+};
+
+struct OpentacMoves {
+    size_t len;
+    size_t cap;
+    struct OpentacMove *moves;
+};
+
+// a function whose registers were added to an allocator, kept to resolve
+// split intervals across its blocks
+struct OpentacAllocFn {
+    OpentacFnBuilder *fn;
+    OpentacLifetime base;
+    struct OpentacLiveness liveness;
+};
+
+struct OpentacAllocFns {
+    size_t len;
+    size_t cap;
+    struct OpentacAllocFn *fns;
+};
+
+struct OpentacRegalloc {
+    // owns the intervals and any register table built from them
+    struct OpentacArena arena;
+    struct OpentacTarget target;
+    struct OpentacRegClass classes[OPENTAC_REGCLASSES];
     struct OpentacIntervals live;
     struct OpentacIntervals stack;
-    struct OpentacActives active;
+    struct OpentacSlots slots;
+    // the size of the stack frame taken by spill slots so far
     uint64_t offset;
+    // first lifetime of the next function added to this allocator
+    OpentacLifetime base;
+    struct OpentacAllocFns fns;
+    // the positions of the calls in those functions, in increasing order
+    size_t ncalls;
+    size_t callcap;
+    OpentacLifetime *calls;
+    // moves within blocks in increasing order of position, and moves on
+    // edges in increasing order of the position ending their block
+    struct OpentacMoves moves;
+    struct OpentacMoves edges;
+};
+
+// allocation of a single function, see opentac_alloc_parallel
+struct OpentacFnAlloc {
+    OpentacFnBuilder *fn;
+    struct OpentacRegalloc alloc;
+    struct OpentacRegisterTable table;
+};
+
+struct OpentacFnAllocs {
+    size_t len;
+    struct OpentacFnAlloc *allocs;
+};
+
+// binary modules: a builder written out so that it can be mapped and read in
+// place. All references are byte offsets from the start of the file, with 0
+// standing for none, and everything is aligned to 8 bytes. Statements keep
+// the OpentacStmt layout, except that named operands hold the offset of
+// their string instead of a pointer
+#define OPENTAC_MODULE_MAGIC "OPENTAC\x1a"
+#define OPENTAC_MODULE_VERSION 1
+#define OPENTAC_MODULE_BYTE_ORDER 0x0102030405060708ull
+
+enum {
+    OPENTAC_MODULE_OK,
+    OPENTAC_MODULE_IO,
+    OPENTAC_MODULE_BAD_MAGIC,
+    // another version, or written by a machine with another byte order or
+    // statement layout
+    OPENTAC_MODULE_BAD_VERSION,
+    OPENTAC_MODULE_CORRUPT,
+};
+
+struct OpentacModuleHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t stmt_size;
+    uint64_t byte_order;
+    // of the whole file
+    uint64_t size;
+    uint64_t nitems;
+    uint64_t items;
+    uint64_t ntypes;
+    uint64_t types;
+    // strings are OpentacStrings followed by their terminated data and lie
+    // in [strings, strings + strings_size)
+    uint64_t strings;
+    uint64_t strings_size;
+};
+
+struct OpentacModuleType {
+    uint64_t size;
+    uint64_t align;
+    uint32_t tag;
+    uint32_t pad;
+    // pointee, element or result type
+    uint64_t type;
+    // struct or union name
+    uint64_t name;
+    // array length, or how many types `elems` holds
+    uint64_t len;
+    // offset of the parameter or element type offsets
+    uint64_t elems;
+};
+
+struct OpentacModuleParam {
+    uint64_t name;
+    uint64_t type;
+};
+
+struct OpentacModulePhiArg {
+    uint64_t pred;
+    uint32_t tag;
+    uint32_t pad;
+    OpentacVal val;
+};
+
+struct OpentacModuleRegName {
+    OpentacRegister reg;
+    uint32_t pad;
+    uint64_t name;
+};
+
+struct OpentacModuleItem {
+    uint32_t tag;
+    uint32_t ssa;
+    uint64_t name;
+    // declared type, declarations only
+    uint64_t type;
+    OpentacRegister param;
+    OpentacRegister reg;
+    OpentacLabel label;
+    uint32_t pad;
+    uint64_t nparams;
+    uint64_t params;
+    uint64_t len;
+    uint64_t stmts;
+    uint64_t nphis;
+    uint64_t phis;
+    uint64_t nreg_names;
+    uint64_t reg_names;
+};
+
+// a module in memory, usually mapped from a file
+struct OpentacModule {
+    const uint8_t *data;
+    size_t size;
+    bool mapped;
+    // set once opentac_module_load_in_place has resolved the named operands
+    // of the statements to pointers
+    bool resolved;
+    const struct OpentacModuleHeader *header;
+    const struct OpentacModuleItem *items;
+    const struct OpentacModuleType *types;
 };
 
 OpentacBuilder *opentac_parse(FILE *file);
+// parses `file` into `builder`, returning non-zero on error; all parser state
+// lives on the stack, so files may be parsed concurrently into distinct builders
+int opentac_parse_ctx(OpentacBuilder *builder, FILE *file);
+
+// writes `builder` to `file` as a binary module, returning an
+// OPENTAC_MODULE_* status; label names are not kept
+int opentac_module_write(OpentacBuilder *builder, FILE *file);
+// maps the module at `path` copy-on-write, so the file itself is never
+// written; only the header, items and types are checked, statements are left
+// untouched until they are read
+int opentac_module_open(struct OpentacModule *module, const char *path);
+// like opentac_module_open for a module already in memory, which has to stay
+// there and be aligned to 8 bytes
+int opentac_module_view(struct OpentacModule *module, const void *data, size_t size);
+void opentac_module_close(struct OpentacModule *module);
+// the data at `offset`, or NULL for offset 0
+const void *opentac_module_at(const struct OpentacModule *module, uint64_t offset);
+// the string at `offset`, or NULL if there is none in bounds
+const OpentacString *opentac_module_string(const struct OpentacModule *module, uint64_t offset);
+// copies the module into `builder`, which should be empty, for passes that
+// change it
+int opentac_module_load(OpentacBuilder *builder, const struct OpentacModule *module);
+// like opentac_module_load for a mapped module, except that statements are not
+// copied: the functions of `builder` use them where they are mapped, and only
+// the pages holding named operands, which are resolved there, or pages a pass
+// writes to are ever copied. Works once per module, which has to stay open as
+// long as `builder` is used
+int opentac_module_load_in_place(OpentacBuilder *builder, struct OpentacModule *module);
+
+// every item of a module emitted as C is named OPENTAC_EMIT_C_PREFIX followed
+// by its own name, with underscores doubled and dots written as _d
+#define OPENTAC_EMIT_C_PREFIX "tac_"
+
+// writes `builder` to `file` as a self-contained C translation unit that
+// exports every function under its prefixed name, returning non-zero on
+// error; functions have to be out of ssa form
+int opentac_emit_c(OpentacBuilder *builder, FILE *file);
 
 void opentac_builder(OpentacBuilder *builder);
 void opentac_builder_with_cap(OpentacBuilder *builder, size_t cap);
 OpentacBuilder *opentac_builderp();
 OpentacBuilder *opentac_builderp_with_cap(size_t cap);
-
+void opentac_builder_reset(OpentacBuilder *builder);
+void opentac_builder_destroy(OpentacBuilder *builder);
+void opentac_builderp_destroy(OpentacBuilder *builder);
+
+void opentac_arena(struct OpentacArena *arena);
+// like opentac_arena with a first chunk of `cap` bytes; later chunks are the
+// default size
+void opentac_arena_with_cap(struct OpentacArena *arena, size_t cap);
+void *opentac_arena_alloc(struct OpentacArena *arena, size_t size);
+void *opentac_arena_calloc(struct OpentacArena *arena, size_t len, size_t size);
+void *opentac_arena_realloc(struct OpentacArena *arena, void *ptr, size_t oldsize, size_t newsize);
+OpentacString *opentac_arena_string(struct OpentacArena *arena, const char *str);
+void opentac_arena_reset(struct OpentacArena *arena);
+void opentac_arena_destroy(struct OpentacArena *arena);
+
+// integer registers only, which every class shares, and no calling
+// convention
 void opentac_alloc_linscan(struct OpentacRegalloc *alloc, size_t len, const char **registers);
+void opentac_alloc_linscan_target(struct OpentacRegalloc *alloc, const struct OpentacTarget *target);
 void opentac_alloc_add(struct OpentacRegalloc *alloc, struct OpentacInterval *interval);
 void opentac_alloc_allocate(struct OpentacRegalloc *alloc);
 void opentac_alloc_find(struct OpentacRegalloc *alloc, OpentacBuilder *builder);
+void opentac_alloc_function(struct OpentacRegalloc *alloc, OpentacBuilder *builder, OpentacFnBuilder *fn);
+// allocates every function of `builder` with its own allocator, spread over
+// `nthreads` threads (0 for one per online CPU); types are inferred and laid
+// out on the calling thread first, after that the builder is only read,
+// apart from each function building its own cfg
+void opentac_alloc_parallel(struct OpentacFnAllocs *dest, OpentacBuilder *builder, size_t len, const char **registers, size_t nthreads);
+void opentac_alloc_parallel_target(struct OpentacFnAllocs *dest, OpentacBuilder *builder, const struct OpentacTarget *target, size_t nthreads);
+void opentac_alloc_parallel_destroy(struct OpentacFnAllocs *dest);
 void opentac_alloc_regtable(struct OpentacRegisterTable *dest, struct OpentacRegalloc *alloc);
+void opentac_alloc_regtable_names(struct OpentacRegisterTable *table, struct OpentacRegalloc *alloc);
+void opentac_alloc_destroy(struct OpentacRegalloc *alloc);
 
 void opentac_build_decl(OpentacBuilder *builder, OpentacString *name, OpentacType *type);
 void opentac_build_function(OpentacBuilder *builder, OpentacString *name);
@@ -367,6 +804,8 @@ OpentacValue opentac_build_call(OpentacBuilder *builder, OpentacValue func, uint
 void opentac_build_return(OpentacBuilder *builder, OpentacValue value);
 void opentac_build_if_branch(OpentacBuilder *builder, int relop, OpentacValue left, OpentacValue right, OpentacLabel label);
 void opentac_build_branch(OpentacBuilder *builder, OpentacValue value);
+void opentac_build_jump(OpentacBuilder *builder, OpentacLabel label);
+void opentac_build_label(OpentacBuilder *builder, OpentacLabel label);
 
 void opentac_fn_insert(OpentacBuilder *builder, size_t index);
 void opentac_fn_goto(OpentacBuilder *builder, size_t index);
@@ -374,7 +813,72 @@ void opentac_fn_goto_end(OpentacBuilder *builder);
 void opentac_fn_bind_int(OpentacBuilder *builder, OpentacString *name, uint32_t val);
 void opentac_fn_bind_ptr(OpentacBuilder *builder, OpentacString *name, void *val);
 uint32_t opentac_fn_get_int(OpentacBuilder *builder, OpentacString *name);
+bool opentac_fn_lookup_int(OpentacBuilder *builder, OpentacString *name, uint32_t *val);
 void *opentac_fn_get_ptr(OpentacBuilder *builder, OpentacString *name);
+OpentacString *opentac_fn_name_of(const OpentacFnBuilder *fn, OpentacRegister reg);
+// returns the label called `name`, creating it on first use so that forward
+// branches can refer to it before it is placed
+OpentacLabel opentac_fn_label(OpentacBuilder *builder, OpentacString *name);
+// makes the statement just built define `target` instead of a new register,
+// for frontends that assign to the same variable more than once
+void opentac_fn_retarget(OpentacBuilder *builder, OpentacRegister target);
+
+// builds the cfg of `fn` unless the cached one is still valid; statements
+// changed through opentac_stmt_ptr require a call to opentac_fn_invalidate
+const struct OpentacCfg *opentac_fn_cfg(OpentacFnBuilder *fn);
+void opentac_fn_invalidate(OpentacFnBuilder *fn);
+void opentac_cfg_destroy(struct OpentacCfg *cfg);
+
+// writes the registers read by `stmt` to `uses`, which has room for three,
+// and returns how many there are; phi operands are not included
+size_t opentac_stmt_uses(const OpentacStmt *stmt, OpentacRegister *uses);
+// like opentac_stmt_uses, but with pointers to the operands for rewriting
+size_t opentac_stmt_use_refs(OpentacStmt *stmt, OpentacRegister **uses);
+bool opentac_stmt_def(const OpentacStmt *stmt, OpentacRegister *def);
+
+// live-in and live-out sets of every block of `fn`, allocated from `arena`
+void opentac_liveness(struct OpentacLiveness *dest, struct OpentacArena *arena, OpentacFnBuilder *fn);
+bool opentac_liveness_live_in(const struct OpentacLiveness *live, size_t block, size_t index);
+bool opentac_liveness_live_out(const struct OpentacLiveness *live, size_t block, size_t index);
+size_t opentac_liveness_index(const OpentacFnBuilder *fn, OpentacRegister reg);
+OpentacRegister opentac_liveness_reg(const OpentacFnBuilder *fn, size_t index);
+
+void opentac_dominators(struct OpentacDominators *dest, struct OpentacArena *arena, OpentacFnBuilder *fn);
+// rewrites `fn` into pruned ssa form; registers whose address is taken with
+// ref keep their single name and get no phis
+void opentac_fn_to_ssa(OpentacBuilder *builder, OpentacFnBuilder *fn);
+// replaces the phis of `fn` with copies on the incoming edges, splitting
+// critical edges where needed
+void opentac_fn_from_ssa(OpentacBuilder *builder, OpentacFnBuilder *fn);
+
+// folds `left op right` or `op value` into `result`, returning false when the
+// operation has no constant result, like a division by zero
+bool opentac_fold_binary(int opcode, OpentacValue left, OpentacValue right, OpentacValue *result);
+bool opentac_fold_unary(int opcode, OpentacValue value, OpentacValue *result);
+// whether values tagged `tag` are constants that can be folded
+bool opentac_fold_constant(int tag);
+
+// sparse conditional constant propagation over `fn`, which must be in ssa
+// form; constant definitions become nops and constant branches jumps or nops
+void opentac_fn_sccp(OpentacBuilder *builder, OpentacFnBuilder *fn);
+// global value numbering over the dominator tree of `fn`, which must be in
+// ssa form; a computation repeated where the first one is available reuses
+// its register instead, and copies between registers are propagated
+void opentac_fn_gvn(OpentacBuilder *builder, OpentacFnBuilder *fn);
+// removes statements without side effects whose result is never read and
+// blocks that cannot be reached from the entry, compacting the statements
+void opentac_fn_dce(OpentacBuilder *builder, OpentacFnBuilder *fn);
+// runs the optimization passes over `fn`, going through ssa form if it is
+// not in it already
+void opentac_fn_optimize(OpentacBuilder *builder, OpentacFnBuilder *fn);
+void opentac_optimize(OpentacBuilder *builder);
+// the item of kind `tag` named `name`, or NULL
+OpentacItem *opentac_builder_find(OpentacBuilder *builder, OpentacString *name, int tag);
+// the type of a constant of value tag `tag`, or NULL when it has none
+OpentacType *opentac_type_of_tag(OpentacBuilder *builder, int tag);
+// fills `types`, indexed like opentac_liveness_index, with the type of every
+// register of `fn`; registers nothing gives a type to are taken as i64
+void opentac_fn_infer(OpentacBuilder *builder, OpentacFnBuilder *fn, OpentacType **types);
 
 OpentacType *opentac_type_unit(OpentacBuilder *builder);
 OpentacType *opentac_type_never(OpentacBuilder *builder);
@@ -389,6 +893,7 @@ OpentacType *opentac_type_ui32(OpentacBuilder *builder);
 OpentacType *opentac_type_ui64(OpentacBuilder *builder);
 OpentacType *opentac_type_f32(OpentacBuilder *builder);
 OpentacType *opentac_type_f64(OpentacBuilder *builder);
+// aggregate types copy `params` and `elems`, the caller keeps ownership
 OpentacType *opentac_type_named(OpentacBuilder *builder, int tag, OpentacString *name);
 OpentacType *opentac_type_ptr(OpentacBuilder *builder, OpentacType *pointee);
 OpentacType *opentac_type_fn(OpentacBuilder *builder, size_t len, OpentacType **params, OpentacType *result);
@@ -396,6 +901,20 @@ OpentacType *opentac_type_tuple(OpentacBuilder *builder, size_t len, OpentacType
 OpentacType *opentac_type_struct(OpentacBuilder *builder, OpentacString *name, size_t len, OpentacType **elems);
 OpentacType *opentac_type_union(OpentacBuilder *builder, OpentacString *name, size_t len, OpentacType **elems);
 OpentacType *opentac_type_array(OpentacBuilder *builder, OpentacType *elem_type, uint64_t len);
+// computes the size and alignment of `type` the first time and fills them in;
+// an empty named type lays out as a unit, and completing it later drops the
+// layouts that were computed from that
+OpentacTypeInfo opentac_type_layout(OpentacType *type);
+// the offset of member `index` of a tuple, struct, union or array
+uint64_t opentac_type_offset(OpentacType *type, size_t index);
+// lays out every type of the builder, after which layouts are only read
+void opentac_typeset_layout(OpentacBuilder *builder);
+
+// names handed to a builder (items, name tables, named types and values)
+// must be interned through that builder and are owned by it
+OpentacString *opentac_intern(OpentacBuilder *builder, const char *str);
+// like opentac_intern, but returns NULL instead of inserting
+OpentacString *opentac_interned(const OpentacBuilder *builder, const char *str);
 
 OpentacString *opentac_string(const char *str);
 void opentac_del_string(OpentacString *str);
@@ -0,0 +1,154 @@
+#ifndef OPENTAC_INTERP_H
+#define OPENTAC_INTERP_H 1
+
+#include "opentac.h"
+
+enum {
+    OPENTAC_INTERP_OK,
+    OPENTAC_INTERP_DIVIDE_BY_ZERO,
+    OPENTAC_INTERP_STACK_OVERFLOW,
+    // a call to something that is not a function with a body, or with the
+    // wrong number of parameters
+    OPENTAC_INTERP_BAD_CALL,
+    // an indirect branch to a label that was never placed
+    OPENTAC_INTERP_BAD_BRANCH,
+};
+
+// integers of every width live in their slot extended to 64 bits, so only
+// the instructions that produce them need to know the width
+enum {
+    OPENTAC_KIND_I8,
+    OPENTAC_KIND_I16,
+    OPENTAC_KIND_I32,
+    OPENTAC_KIND_I64,
+    OPENTAC_KIND_U8,
+    OPENTAC_KIND_U16,
+    OPENTAC_KIND_U32,
+    OPENTAC_KIND_U64,
+    OPENTAC_KIND_F32,
+    OPENTAC_KIND_F64,
+};
+
+#define OPENTAC_INSN_INTS(X, op) \
+    X(op##_I8) X(op##_I16) X(op##_I32) X(op##_I64) \
+    X(op##_U8) X(op##_U16) X(op##_U32) X(op##_U64)
+// integer variants followed by floating point ones, indexed by kind
+#define OPENTAC_INSN_NUMS(X, op) OPENTAC_INSN_INTS(X, op) X(op##_F32) X(op##_F64)
+// signed, unsigned and floating point comparisons
+#define OPENTAC_INSN_CMPS(X, op) X(op##_S) X(op##_U) X(op##_F32) X(op##_F64)
+#define OPENTAC_INSN_ICMPS(X, op) X(op##_S) X(op##_U)
+
+#define OPENTAC_INSNS(X) \
+    X(MOV) X(JMP) X(JMPI) X(RET) X(PARAM) X(CALL) X(CALLI) X(REF) \
+    X(BITAND) X(BITXOR) X(BITOR) X(BNOT) \
+    X(STORE8) X(STORE16) X(STORE32) X(STORE64) \
+    OPENTAC_INSN_NUMS(X, ADD) OPENTAC_INSN_NUMS(X, SUB) OPENTAC_INSN_NUMS(X, MUL) \
+    OPENTAC_INSN_NUMS(X, DIV) OPENTAC_INSN_NUMS(X, MOD) OPENTAC_INSN_NUMS(X, NEG) \
+    OPENTAC_INSN_NUMS(X, LOAD) \
+    OPENTAC_INSN_INTS(X, SHL) OPENTAC_INSN_INTS(X, SHR) OPENTAC_INSN_INTS(X, ROL) \
+    OPENTAC_INSN_INTS(X, ROR) OPENTAC_INSN_INTS(X, NOT) OPENTAC_INSN_INTS(X, NORM) \
+    OPENTAC_INSN_CMPS(X, LT) OPENTAC_INSN_CMPS(X, LE) OPENTAC_INSN_CMPS(X, EQ) \
+    OPENTAC_INSN_CMPS(X, NE) OPENTAC_INSN_CMPS(X, GT) OPENTAC_INSN_CMPS(X, GE) \
+    OPENTAC_INSN_CMPS(X, BLT) OPENTAC_INSN_CMPS(X, BLE) OPENTAC_INSN_CMPS(X, BEQ) \
+    OPENTAC_INSN_CMPS(X, BNE) OPENTAC_INSN_CMPS(X, BGT) OPENTAC_INSN_CMPS(X, BGE) \
+    OPENTAC_INSN_SUPER(X)
+
+// superinstructions: arithmetic and branches against an immediate held in
+// `b`, comparisons whose result a branch right after tests (SB branches when
+// it is true, SBN when it is false) and a load, add and store to one address
+#define OPENTAC_INSN_SUPER(X) \
+    OPENTAC_INSN_INTS(X, ADDI) OPENTAC_INSN_INTS(X, MULI) OPENTAC_INSN_INTS(X, LADDS) \
+    OPENTAC_INSN_ICMPS(X, BLTI) OPENTAC_INSN_ICMPS(X, BLEI) OPENTAC_INSN_ICMPS(X, BEQI) \
+    OPENTAC_INSN_ICMPS(X, BNEI) OPENTAC_INSN_ICMPS(X, BGTI) OPENTAC_INSN_ICMPS(X, BGEI) \
+    OPENTAC_INSN_CMPS(X, SBLT) OPENTAC_INSN_CMPS(X, SBLE) OPENTAC_INSN_CMPS(X, SBEQ) \
+    OPENTAC_INSN_CMPS(X, SBNE) OPENTAC_INSN_CMPS(X, SBGT) OPENTAC_INSN_CMPS(X, SBGE) \
+    OPENTAC_INSN_CMPS(X, SBNLT) OPENTAC_INSN_CMPS(X, SBNLE) OPENTAC_INSN_CMPS(X, SBNEQ) \
+    OPENTAC_INSN_CMPS(X, SBNNE) OPENTAC_INSN_CMPS(X, SBNGT) OPENTAC_INSN_CMPS(X, SBNGE)
+
+#define OPENTAC_INSN_ENUM(name) OPENTAC_INSN_##name,
+enum {
+    OPENTAC_INSNS(OPENTAC_INSN_ENUM)
+    OPENTAC_INSN_COUNT
+};
+#undef OPENTAC_INSN_ENUM
+
+struct OpentacInterpFn;
+
+// every operand is a slot of the frame, constants included, so executing an
+// instruction never looks at operand tags
+struct OpentacInsn {
+    // address of the handler with threaded dispatch
+    const void *handler;
+    uint32_t op;
+    uint32_t t;
+    uint32_t a;
+    uint32_t b;
+    union {
+        // instruction index of a branch target
+        size_t jump;
+        const struct OpentacInterpFn *fn;
+        // further slots of a load, add and store: the addend, then where the
+        // loaded value goes
+        uint32_t slots[2];
+    };
+};
+
+// frames are the registers (temporaries, then parameters) followed by the
+// constants, which are copied in on every call
+struct OpentacInterpFn {
+    OpentacString *name;
+    size_t nparams;
+    uint32_t param;
+    uint32_t nregs;
+    uint32_t nslots;
+    OpentacVal *consts;
+    size_t len;
+    struct OpentacInsn *code;
+    // instruction index of every label, SIZE_MAX for those never placed
+    size_t nlabels;
+    size_t *labels;
+};
+
+struct OpentacInterpFrame {
+    const struct OpentacInterpFn *fn;
+    OpentacVal *r;
+    const struct OpentacInsn *ip;
+    uint32_t target;
+};
+
+// named items by interned name: functions map to their OpentacInterpFn and
+// declarations to zeroed storage; open addressing, power of two capacity
+struct OpentacInterpSymbol {
+    OpentacString *name;
+    void *address;
+};
+
+struct OpentacInterp {
+    OpentacBuilder *builder;
+    struct OpentacArena arena;
+    size_t len;
+    struct OpentacInterpFn *fns;
+    size_t nsymbols;
+    struct OpentacInterpSymbol *symbols;
+    size_t stack_len;
+    OpentacVal *stack;
+    // arguments pushed by param and not yet taken by a call
+    size_t nargs;
+    size_t args_cap;
+    OpentacVal *args;
+    size_t depth;
+    size_t frames_cap;
+    struct OpentacInterpFrame *frames;
+};
+
+// lowers every function of `builder`, none of which may be in ssa form; the
+// builder has to outlive the interpreter
+void opentac_interp(struct OpentacInterp *interp, OpentacBuilder *builder);
+void opentac_interp_destroy(struct OpentacInterp *interp);
+const struct OpentacInterpFn *opentac_interp_fn(const struct OpentacInterp *interp, const char *name);
+// runs `fn` on `args` and stores what it returns in `result`, returning
+// OPENTAC_INTERP_OK or the error that stopped it; values are in the slot
+// representation, read back through the member of their type
+int opentac_interp_call(struct OpentacInterp *interp, const struct OpentacInterpFn *fn, const OpentacVal *args, size_t nargs, OpentacVal *result);
+
+#endif /* OPENTAC_INTERP_H */
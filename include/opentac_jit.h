@@ -0,0 +1,60 @@
+#ifndef OPENTAC_JIT_H
+#define OPENTAC_JIT_H 1
+
+#include "opentac.h"
+
+// names of the machine registers the jit accepts from the allocator, to be
+// passed (all of them or a prefix) to opentac_alloc_parallel; r10 and r11 are
+// kept as scratch and rsp and rbp hold the frame
+#define OPENTAC_JIT_REGISTERS 12
+extern const char *opentac_jit_registers[OPENTAC_JIT_REGISTERS];
+
+// the floating point class; xmm0 and xmm1 are kept as scratch
+#define OPENTAC_JIT_FLOAT_REGISTERS 14
+extern const char *opentac_jit_float_registers[OPENTAC_JIT_FLOAT_REGISTERS];
+
+// both classes with the SysV calling convention, for
+// opentac_alloc_parallel_target; copy it to give a prefix of the registers
+extern const struct OpentacTarget opentac_jit_target;
+
+struct OpentacJitFn {
+    OpentacString *name;
+    size_t nparams;
+    // of the entry point from the start of the code
+    size_t offset;
+    // follows the SysV calling convention, cast it to the function's type;
+    // integers come back extended to 64 bits, floats in xmm0
+    void (*entry)(void);
+};
+
+// named items by interned name: functions map to their index plus one and
+// declarations to zeroed storage; open addressing, power of two capacity
+struct OpentacJitSymbol {
+    OpentacString *name;
+    size_t fn;
+    void *address;
+};
+
+struct OpentacJit {
+    OpentacBuilder *builder;
+    struct OpentacArena arena;
+    size_t len;
+    struct OpentacJitFn *fns;
+    size_t nsymbols;
+    struct OpentacJitSymbol *symbols;
+    // mapped read-only and executable, never writable at the same time
+    uint8_t *code;
+    size_t size;
+};
+
+// compiles every function of `builder`, none of which may be in ssa form,
+// using the allocation of each one in `allocs` as made by
+// opentac_alloc_parallel with registers from opentac_jit_registers, or by
+// opentac_alloc_parallel_target with opentac_jit_target. Values
+// are kept like the interpreter keeps them, so the two agree, except that
+// division by zero traps as it does in C
+void opentac_jit(struct OpentacJit *jit, OpentacBuilder *builder, const struct OpentacFnAllocs *allocs);
+void opentac_jit_destroy(struct OpentacJit *jit);
+const struct OpentacJitFn *opentac_jit_fn(const struct OpentacJit *jit, const char *name);
+
+#endif /* OPENTAC_JIT_H */
@@ -0,0 +1,175 @@
+#include "include/opentac.h"
+
+OpentacItem *opentac_builder_find(OpentacBuilder *builder, OpentacString *name, int tag) {
+    opentac_assert(builder);
+
+    for (size_t i = 0; i < builder->len; i++) {
+        OpentacItem *item = builder->items[i];
+        if (item->tag != tag) {
+            continue;
+        }
+        if ((tag == OPENTAC_ITEM_DECL ? item->decl.name : item->fn.name) == name) {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+OpentacType *opentac_type_of_tag(OpentacBuilder *builder, int tag) {
+    switch (tag) {
+    case OPENTAC_VAL_BOOL:
+        return opentac_type_bool(builder);
+    case OPENTAC_VAL_I8:
+        return opentac_type_i8(builder);
+    case OPENTAC_VAL_I16:
+        return opentac_type_i16(builder);
+    case OPENTAC_VAL_I32:
+        return opentac_type_i32(builder);
+    case OPENTAC_VAL_I64:
+        return opentac_type_i64(builder);
+    case OPENTAC_VAL_UI8:
+        return opentac_type_ui8(builder);
+    case OPENTAC_VAL_UI16:
+        return opentac_type_ui16(builder);
+    case OPENTAC_VAL_UI32:
+        return opentac_type_ui32(builder);
+    case OPENTAC_VAL_UI64:
+        return opentac_type_ui64(builder);
+    case OPENTAC_VAL_F32:
+        return opentac_type_f32(builder);
+    case OPENTAC_VAL_F64:
+        return opentac_type_f64(builder);
+    }
+    return NULL;
+}
+
+// named values are the addresses of the items they name
+static OpentacType *opentac_infer_named(OpentacBuilder *builder, OpentacString *name) {
+    OpentacItem *decl = opentac_builder_find(builder, name, OPENTAC_ITEM_DECL);
+    if (!decl) {
+        return NULL;
+    }
+    return opentac_type_ptr(builder, decl->decl.type);
+}
+
+static OpentacType *opentac_infer_operand(OpentacBuilder *builder, OpentacFnBuilder *fn, OpentacType **types, int tag, OpentacVal val) {
+    switch (tag) {
+    case OPENTAC_VAL_REG:
+        return types[opentac_liveness_index(fn, val.regval)];
+    case OPENTAC_VAL_NAMED:
+        return opentac_infer_named(builder, val.name);
+    }
+    return opentac_type_of_tag(builder, tag);
+}
+
+static OpentacType *opentac_infer_pointee(OpentacType *type) {
+    if (!type || type->tag != OPENTAC_TYPE_PTR) {
+        return NULL;
+    }
+    type = type->ptr.pointee;
+    // indexing into an array through a pointer to it reads an element
+    if (type && type->tag == OPENTAC_TYPE_ARRAY) {
+        type = type->array.elem_type;
+    }
+    return type;
+}
+
+static OpentacType *opentac_infer_stmt(OpentacBuilder *builder, OpentacFnBuilder *fn, OpentacType **types, const OpentacStmt *stmt) {
+    int opcode = stmt->tag.opcode;
+    OpentacType *left = opentac_infer_operand(builder, fn, types, stmt->tag.left, stmt->left);
+
+    switch (opcode) {
+    case OPENTAC_OP_LT:
+    case OPENTAC_OP_LE:
+    case OPENTAC_OP_EQ:
+    case OPENTAC_OP_NE:
+    case OPENTAC_OP_GT:
+    case OPENTAC_OP_GE:
+        return opentac_type_bool(builder);
+    case OPENTAC_OP_SHL:
+    case OPENTAC_OP_SHR:
+    case OPENTAC_OP_ROL:
+    case OPENTAC_OP_ROR:
+    case OPENTAC_OP_NOT:
+    case OPENTAC_OP_NEG:
+    case OPENTAC_OP_COPY:
+        return left;
+    case OPENTAC_OP_BITAND:
+    case OPENTAC_OP_BITXOR:
+    case OPENTAC_OP_BITOR:
+    case OPENTAC_OP_ADD:
+    case OPENTAC_OP_SUB:
+    case OPENTAC_OP_MUL:
+    case OPENTAC_OP_DIV:
+    case OPENTAC_OP_MOD:
+        return left ? left : opentac_infer_operand(builder, fn, types, stmt->tag.right, stmt->right);
+    case OPENTAC_OP_REF:
+        if (stmt->tag.left == OPENTAC_VAL_NAMED) {
+            return left;
+        }
+        return left ? opentac_type_ptr(builder, left) : NULL;
+    case OPENTAC_OP_DEREF:
+    case OPENTAC_OP_ASSIGN_INDEX:
+        return opentac_infer_pointee(left);
+    case OPENTAC_OP_CALL: {
+        OpentacType *callee = left;
+        if (callee && callee->tag == OPENTAC_TYPE_PTR) {
+            callee = callee->ptr.pointee;
+        }
+        return callee && callee->tag == OPENTAC_TYPE_FN ? callee->fn.result : NULL;
+    }
+    case OPENTAC_OP_PHI: {
+        const struct OpentacPhiArg *args = fn->phis.args + stmt->left.ui64val;
+        for (size_t k = 0; k < stmt->right.ui64val; k++) {
+            OpentacType *type = opentac_infer_operand(builder, fn, types, args[k].value.tag, args[k].value.val);
+            if (type) {
+                return type;
+            }
+        }
+        return NULL;
+    }
+    }
+    return NULL;
+}
+
+void opentac_fn_infer(OpentacBuilder *builder, OpentacFnBuilder *fn, OpentacType **types) {
+    opentac_assert(builder);
+    opentac_assert(fn);
+    opentac_assert(types);
+
+    size_t nregs = (size_t) fn->reg + (size_t) -fn->param;
+    for (size_t index = 0; index < nregs; index++) {
+        types[index] = NULL;
+    }
+    for (size_t k = 0; k < fn->params.len; k++) {
+        types[fn->reg + k] = fn->params.params[k];
+    }
+
+    // a register takes the type of the first definition that has one, and
+    // since types are never replaced this ends once a pass adds none; code
+    // in statement order needs a single pass, loops one more each
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < fn->len; i++) {
+            const OpentacStmt *stmt = fn->stmts + i;
+            OpentacRegister reg;
+            if (!opentac_stmt_def(stmt, &reg)) {
+                continue;
+            }
+            size_t index = opentac_liveness_index(fn, reg);
+            if (types[index]) {
+                continue;
+            }
+            types[index] = opentac_infer_stmt(builder, fn, types, stmt);
+            changed = changed || types[index];
+        }
+    }
+
+    // whatever is left was never given a type, so it is taken as a machine word
+    for (size_t index = 0; index < nregs; index++) {
+        if (!types[index]) {
+            types[index] = opentac_type_i64(builder);
+        }
+    }
+}
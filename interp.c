@@ -0,0 +1,955 @@
+#include <math.h>
+#include "include/opentac_interp.h"
+
+#define DEFAULT_STACK_LEN ((size_t) 1 << 20)
+#define DEFAULT_ARGS_CAP 256
+#define DEFAULT_FRAMES_CAP ((size_t) 1 << 16)
+
+// computed goto is a GNU extension, anything else dispatches with a switch
+#if defined(__GNUC__) && !defined(OPENTAC_INTERP_SWITCH)
+#define OPENTAC_INTERP_THREADED 1
+#endif
+
+static int opentac_interp_exec(struct OpentacInterp *interp, const struct OpentacInterpFn *fn, OpentacVal *result, const void *const **table);
+
+static int opentac_interp_kind(const OpentacType *type) {
+    switch (type->tag) {
+    case OPENTAC_TYPE_BOOL:
+        return OPENTAC_KIND_U8;
+    case OPENTAC_TYPE_I8:
+    case OPENTAC_TYPE_I16:
+    case OPENTAC_TYPE_I32:
+    case OPENTAC_TYPE_I64:
+    case OPENTAC_TYPE_UI8:
+    case OPENTAC_TYPE_UI16:
+    case OPENTAC_TYPE_UI32:
+    case OPENTAC_TYPE_UI64:
+    case OPENTAC_TYPE_F32:
+    case OPENTAC_TYPE_F64:
+        return OPENTAC_KIND_I8 + (type->tag - OPENTAC_TYPE_I8);
+    }
+    // pointers, functions and anything else are machine words
+    return OPENTAC_KIND_U64;
+}
+
+static int opentac_interp_tag_kind(int tag) {
+    if (tag >= OPENTAC_VAL_I8 && tag <= OPENTAC_VAL_F64) {
+        return OPENTAC_KIND_I8 + (tag - OPENTAC_VAL_I8);
+    }
+    return tag == OPENTAC_VAL_BOOL ? OPENTAC_KIND_U8 : OPENTAC_KIND_U64;
+}
+
+// index of the comparison variant for operands of `kind`
+static int opentac_interp_cmp_class(int kind) {
+    if (kind <= OPENTAC_KIND_I64) {
+        return 0;
+    }
+    if (kind <= OPENTAC_KIND_U64) {
+        return 1;
+    }
+    return kind == OPENTAC_KIND_F32 ? 2 : 3;
+}
+
+static uint64_t opentac_interp_norm(int kind, uint64_t raw) {
+    switch (kind) {
+    case OPENTAC_KIND_I8:
+        return (uint64_t) (int8_t) raw;
+    case OPENTAC_KIND_I16:
+        return (uint64_t) (int16_t) raw;
+    case OPENTAC_KIND_I32:
+        return (uint64_t) (int32_t) raw;
+    case OPENTAC_KIND_U8:
+        return (uint8_t) raw;
+    case OPENTAC_KIND_U16:
+        return (uint16_t) raw;
+    case OPENTAC_KIND_U32:
+        return (uint32_t) raw;
+    }
+    return raw;
+}
+
+// storage for declarations, at least a slot so that any scalar fits
+static size_t opentac_interp_sizeof(OpentacType *type) {
+    size_t size = opentac_type_layout(type).size;
+    return size > sizeof(OpentacVal) ? size : sizeof(OpentacVal);
+}
+
+static void *opentac_interp_lookup(const struct OpentacInterp *interp, OpentacString *name) {
+    size_t mask = interp->nsymbols - 1;
+    for (size_t slot = ((uintptr_t) name >> 4) & mask; interp->symbols[slot].name; slot = (slot + 1) & mask) {
+        if (interp->symbols[slot].name == name) {
+            return interp->symbols[slot].address;
+        }
+    }
+    return NULL;
+}
+
+static void opentac_interp_define(struct OpentacInterp *interp, OpentacString *name, void *address) {
+    size_t mask = interp->nsymbols - 1;
+    size_t slot = ((uintptr_t) name >> 4) & mask;
+    while (interp->symbols[slot].name) {
+        // a function and its declaration share a name, the function wins
+        if (interp->symbols[slot].name == name) {
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+    interp->symbols[slot].name = name;
+    interp->symbols[slot].address = address;
+}
+
+struct OpentacLower {
+    struct OpentacInterp *interp;
+    OpentacFnBuilder *fn;
+    OpentacType **types;
+    bool *refd;
+    size_t len;
+    size_t cap;
+    struct OpentacInsn *code;
+    size_t nconsts;
+    size_t consts_cap;
+    OpentacVal *consts;
+    // constants by their bits, holding the index plus one
+    size_t table_cap;
+    uint32_t *table;
+};
+
+static struct OpentacInsn *opentac_lower_emit(struct OpentacLower *lower, int op, uint32_t t, uint32_t a, uint32_t b) {
+    if (lower->len == lower->cap) {
+        size_t cap = lower->cap * 2;
+        lower->code = opentac_arena_realloc(&lower->interp->arena, lower->code, lower->cap * sizeof(struct OpentacInsn), cap * sizeof(struct OpentacInsn));
+        lower->cap = cap;
+    }
+    struct OpentacInsn *insn = lower->code + lower->len++;
+    *insn = (struct OpentacInsn) { .op = op, .t = t, .a = a, .b = b };
+    return insn;
+}
+
+// slots of equal bits are shared whatever their type, since every type
+// reads its value from the same bits
+static uint32_t opentac_lower_const(struct OpentacLower *lower, uint64_t bits) {
+    size_t mask = lower->table_cap - 1;
+    size_t slot = (bits * 0x9e3779b97f4a7c15) >> 32 & mask;
+    while (lower->table[slot]) {
+        size_t index = lower->table[slot] - 1;
+        if (lower->consts[index].ui64val == bits) {
+            return lower->fn->reg + (uint32_t) -lower->fn->param + index;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    if (lower->nconsts == lower->consts_cap) {
+        size_t cap = lower->consts_cap * 2;
+        lower->consts = opentac_arena_realloc(&lower->interp->arena, lower->consts, lower->consts_cap * sizeof(OpentacVal), cap * sizeof(OpentacVal));
+        lower->consts_cap = cap;
+    }
+    lower->consts[lower->nconsts].ui64val = bits;
+    lower->table[slot] = ++lower->nconsts;
+
+    // kept at most half full
+    if (lower->nconsts * 2 > lower->table_cap) {
+        size_t cap = lower->table_cap * 2;
+        uint32_t *table = opentac_arena_calloc(&lower->interp->arena, cap, sizeof(uint32_t));
+        for (size_t index = 0; index < lower->nconsts; index++) {
+            size_t s = (lower->consts[index].ui64val * 0x9e3779b97f4a7c15) >> 32 & (cap - 1);
+            while (table[s]) {
+                s = (s + 1) & (cap - 1);
+            }
+            table[s] = index + 1;
+        }
+        lower->table = table;
+        lower->table_cap = cap;
+    }
+    return lower->fn->reg + (uint32_t) -lower->fn->param + lower->nconsts - 1;
+}
+
+static int opentac_lower_kind(const struct OpentacLower *lower, int tag, OpentacVal val) {
+    if (tag == OPENTAC_VAL_REG) {
+        return opentac_interp_kind(lower->types[opentac_liveness_index(lower->fn, val.regval)]);
+    }
+    return opentac_interp_tag_kind(tag);
+}
+
+static bool opentac_lower_bool(const struct OpentacLower *lower, int tag, OpentacVal val) {
+    if (tag == OPENTAC_VAL_REG) {
+        return lower->types[opentac_liveness_index(lower->fn, val.regval)]->tag == OPENTAC_TYPE_BOOL;
+    }
+    return tag == OPENTAC_VAL_BOOL;
+}
+
+// the slot representation of a constant operand
+static uint64_t opentac_lower_bits(const struct OpentacLower *lower, int tag, OpentacVal val) {
+    switch (tag) {
+    case OPENTAC_VAL_NAMED:
+        return (uint64_t) (uintptr_t) opentac_interp_lookup(lower->interp, val.name);
+    case OPENTAC_VAL_BOOL:
+        return val.bval;
+    case OPENTAC_VAL_I8:
+        return (uint64_t) (int64_t) val.i8val;
+    case OPENTAC_VAL_I16:
+        return (uint64_t) (int64_t) val.i16val;
+    case OPENTAC_VAL_I32:
+        return (uint64_t) (int64_t) val.i32val;
+    case OPENTAC_VAL_UI8:
+        return val.ui8val;
+    case OPENTAC_VAL_UI16:
+        return val.ui16val;
+    case OPENTAC_VAL_UI32:
+        return val.ui32val;
+    case OPENTAC_VAL_F32: {
+        OpentacVal slot = { .ui64val = 0 };
+        slot.fval = val.fval;
+        return slot.ui64val;
+    }
+    case OPENTAC_VAL_I64:
+    case OPENTAC_VAL_UI64:
+    case OPENTAC_VAL_F64:
+    case OPENTAC_VAL_PTR:
+        return val.ui64val;
+    }
+    return 0;
+}
+
+// the slot holding an operand; registers whose address is taken may have
+// been written through a pointer with a narrower store, so they are
+// extended again before every read
+static uint32_t opentac_lower_operand(struct OpentacLower *lower, int tag, OpentacVal val) {
+    if (tag == OPENTAC_VAL_REG) {
+        size_t index = opentac_liveness_index(lower->fn, val.regval);
+        int kind = opentac_lower_kind(lower, tag, val);
+        if (lower->refd[index] && kind <= OPENTAC_KIND_U64) {
+            opentac_lower_emit(lower, OPENTAC_INSN_NORM_I8 + kind, index, 0, 0);
+        }
+        return index;
+    }
+    return opentac_lower_const(lower, opentac_lower_bits(lower, tag, val));
+}
+
+static void opentac_lower_stmt(struct OpentacLower *lower, struct OpentacInterpFn *dest, const OpentacStmt *stmt) {
+    OpentacFnBuilder *fn = lower->fn;
+    int opcode = stmt->tag.opcode;
+    uint32_t t = 0;
+    OpentacRegister reg;
+    if (opentac_stmt_def(stmt, &reg)) {
+        t = opentac_liveness_index(fn, reg);
+    }
+
+    if ((opcode & OPENTAC_OP_BRANCH) == OPENTAC_OP_BRANCH) {
+        int relop = opcode & ~OPENTAC_OP_BRANCH;
+        if (relop == OPENTAC_OP_NOP) {
+            if (stmt->tag.left == OPENTAC_VAL_ERROR) {
+                opentac_lower_emit(lower, OPENTAC_INSN_JMP, 0, 0, 0)->jump = stmt->label;
+            } else {
+                uint32_t a = opentac_lower_operand(lower, stmt->tag.left, stmt->left);
+                opentac_lower_emit(lower, OPENTAC_INSN_JMPI, 0, a, 0);
+            }
+            return;
+        }
+        int kind = opentac_lower_kind(lower, stmt->tag.left, stmt->left);
+        uint32_t a = opentac_lower_operand(lower, stmt->tag.left, stmt->left);
+        uint32_t b = opentac_lower_operand(lower, stmt->tag.right, stmt->right);
+        int op = OPENTAC_INSN_BLT_S + (relop - OPENTAC_OP_LT) * 4 + opentac_interp_cmp_class(kind);
+        opentac_lower_emit(lower, op, 0, a, b)->jump = stmt->label;
+        return;
+    }
+
+    switch (opcode) {
+    case OPENTAC_OP_NOP:
+        return;
+    case OPENTAC_OP_LABEL:
+        dest->labels[stmt->label] = lower->len;
+        return;
+    case OPENTAC_OP_LT:
+    case OPENTAC_OP_LE:
+    case OPENTAC_OP_EQ:
+    case OPENTAC_OP_NE:
+    case OPENTAC_OP_GT:
+    case OPENTAC_OP_GE: {
+        int kind = opentac_lower_kind(lower, stmt->tag.left, stmt->left);
+        uint32_t a = opentac_lower_operand(lower, stmt->tag.left, stmt->left);
+        uint32_t b = opentac_lower_operand(lower, stmt->tag.right, stmt->right);
+        opentac_lower_emit(lower, OPENTAC_INSN_LT_S + (opcode - OPENTAC_OP_LT) * 4 + opentac_interp_cmp_class(kind), t, a, b);
+        return;
+    }
+    case OPENTAC_OP_BITAND:
+    case OPENTAC_OP_BITXOR:
+    case OPENTAC_OP_BITOR: {
+        uint32_t a = opentac_lower_operand(lower, stmt->tag.left, stmt->left);
+        uint32_t b = opentac_lower_operand(lower, stmt->tag.right, stmt->right);
+        opentac_lower_emit(lower, OPENTAC_INSN_BITAND + (opcode - OPENTAC_OP_BITAND), t, a, b);
+        return;
+    }
+    case OPENTAC_OP_SHL:
+    case OPENTAC_OP_SHR:
+    case OPENTAC_OP_ROL:
+    case OPENTAC_OP_ROR: {
+        static const int ops[] = { OPENTAC_INSN_SHL_I8, OPENTAC_INSN_SHR_I8, OPENTAC_INSN_ROL_I8, OPENTAC_INSN_ROR_I8 };
+        int kind = opentac_interp_kind(lower->types[t]);
+        uint32_t a = opentac_lower_operand(lower, stmt->tag.left, stmt->left);
+        uint32_t b = opentac_lower_operand(lower, stmt->tag.right, stmt->right);
+        // shifting floats is not meaningful, they shift their bits
+        opentac_lower_emit(lower, ops[opcode - OPENTAC_OP_SHL] + (kind > OPENTAC_KIND_U64 ? OPENTAC_KIND_U64 : kind), t, a, b);
+        return;
+    }
+    case OPENTAC_OP_ADD:
+    case OPENTAC_OP_SUB:
+    case OPENTAC_OP_MUL:
+    case OPENTAC_OP_DIV:
+    case OPENTAC_OP_MOD: {
+        static const int ops[] = { OPENTAC_INSN_ADD_I8, OPENTAC_INSN_SUB_I8, OPENTAC_INSN_MUL_I8, OPENTAC_INSN_DIV_I8, OPENTAC_INSN_MOD_I8 };
+        int kind = opentac_interp_kind(lower->types[t]);
+        uint32_t a = opentac_lower_operand(lower, stmt->tag.left, stmt->left);
+        uint32_t b = opentac_lower_operand(lower, stmt->tag.right, stmt->right);
+        opentac_lower_emit(lower, ops[opcode - OPENTAC_OP_ADD] + kind, t, a, b);
+        return;
+    }
+    case OPENTAC_OP_NOT:
+    case OPENTAC_OP_NEG: {
+        int kind = opentac_interp_kind(lower->types[t]);
+        bool b = opentac_lower_bool(lower, stmt->tag.left, stmt->left);
+        uint32_t a = opentac_lower_operand(lower, stmt->tag.left, stmt->left);
+        int op;
+        if (opcode == OPENTAC_OP_NOT) {
+            op = b ? OPENTAC_INSN_BNOT : OPENTAC_INSN_NOT_I8 + (kind > OPENTAC_KIND_U64 ? OPENTAC_KIND_U64 : kind);
+        } else {
+            op = OPENTAC_INSN_NEG_I8 + kind;
+        }
+        opentac_lower_emit(lower, op, t, a, 0);
+        return;
+    }
+    case OPENTAC_OP_COPY:
+        opentac_lower_emit(lower, OPENTAC_INSN_MOV, t, opentac_lower_operand(lower, stmt->tag.left, stmt->left), 0);
+        return;
+    case OPENTAC_OP_REF:
+        if (stmt->tag.left == OPENTAC_VAL_NAMED) {
+            // the name already is the address
+            opentac_lower_emit(lower, OPENTAC_INSN_MOV, t, opentac_lower_operand(lower, stmt->tag.left, stmt->left), 0);
+        } else {
+            opentac_lower_emit(lower, OPENTAC_INSN_REF, t, opentac_lower_operand(lower, stmt->tag.left, stmt->left), 0);
+        }
+        return;
+    case OPENTAC_OP_DEREF:
+    case OPENTAC_OP_ASSIGN_INDEX: {
+        int kind = opentac_interp_kind(lower->types[t]);
+        uint32_t a = opentac_lower_operand(lower, stmt->tag.left, stmt->left);
+        uint32_t b = opcode == OPENTAC_OP_DEREF ? opentac_lower_const(lower, 0) : opentac_lower_operand(lower, stmt->tag.right, stmt->right);
+        opentac_lower_emit(lower, OPENTAC_INSN_LOAD_I8 + kind, t, a, b);
+        return;
+    }
+    case OPENTAC_OP_INDEX_ASSIGN: {
+        static const int ops[] = {
+            [OPENTAC_KIND_I8] = OPENTAC_INSN_STORE8,
+            [OPENTAC_KIND_I16] = OPENTAC_INSN_STORE16,
+            [OPENTAC_KIND_I32] = OPENTAC_INSN_STORE32,
+            [OPENTAC_KIND_I64] = OPENTAC_INSN_STORE64,
+            [OPENTAC_KIND_U8] = OPENTAC_INSN_STORE8,
+            [OPENTAC_KIND_U16] = OPENTAC_INSN_STORE16,
+            [OPENTAC_KIND_U32] = OPENTAC_INSN_STORE32,
+            [OPENTAC_KIND_U64] = OPENTAC_INSN_STORE64,
+            [OPENTAC_KIND_F32] = OPENTAC_INSN_STORE32,
+            [OPENTAC_KIND_F64] = OPENTAC_INSN_STORE64,
+        };
+        int kind = opentac_lower_kind(lower, stmt->tag.right, stmt->right);
+        OpentacVal base = { .regval = stmt->target };
+        uint32_t target = opentac_lower_operand(lower, OPENTAC_VAL_REG, base);
+        uint32_t a = opentac_lower_operand(lower, stmt->tag.left, stmt->left);
+        uint32_t b = opentac_lower_operand(lower, stmt->tag.right, stmt->right);
+        opentac_lower_emit(lower, ops[kind], target, a, b);
+        return;
+    }
+    case OPENTAC_OP_PARAM:
+        opentac_lower_emit(lower, OPENTAC_INSN_PARAM, 0, opentac_lower_operand(lower, stmt->tag.left, stmt->left), 0);
+        return;
+    case OPENTAC_OP_CALL: {
+        void *callee = stmt->tag.left == OPENTAC_VAL_NAMED ? opentac_interp_lookup(lower->interp, stmt->left.name) : NULL;
+        struct OpentacInterp *interp = lower->interp;
+        uint32_t nparams = stmt->right.ui64val;
+        // calls to functions of this module are bound now
+        if (callee >= (void *) interp->fns && callee < (void *) (interp->fns + interp->len)) {
+            opentac_lower_emit(lower, OPENTAC_INSN_CALL, t, 0, nparams)->fn = callee;
+        } else {
+            uint32_t a = opentac_lower_operand(lower, stmt->tag.left, stmt->left);
+            opentac_lower_emit(lower, OPENTAC_INSN_CALLI, t, a, nparams);
+        }
+        return;
+    }
+    case OPENTAC_OP_RETURN:
+        opentac_lower_emit(lower, OPENTAC_INSN_RET, 0, opentac_lower_operand(lower, stmt->tag.left, stmt->left), 0);
+        return;
+    }
+
+    opentac_assertf(false, "cannot interpret opcode %#x", (unsigned) opcode);
+}
+
+static bool opentac_lower_is_const(int tag) {
+    return tag != OPENTAC_VAL_ERROR && tag != OPENTAC_VAL_REG && tag != OPENTAC_VAL_NAMED;
+}
+
+static bool opentac_lower_same(const struct OpentacLower *lower, int ltag, OpentacVal lval, int rtag, OpentacVal rval) {
+    if (ltag != rtag) {
+        return false;
+    }
+    if (ltag == OPENTAC_VAL_REG) {
+        return lval.regval == rval.regval;
+    }
+    return opentac_lower_bits(lower, ltag, lval) == opentac_lower_bits(lower, rtag, rval);
+}
+
+// an integer constant usable as an immediate in arithmetic of `kind`; only
+// the low bits of the result are kept, so any value congruent to it modulo
+// the width will do
+static bool opentac_lower_imm(const struct OpentacLower *lower, int kind, int tag, OpentacVal val, bool negate, uint32_t *imm) {
+    if (!opentac_lower_is_const(tag) || tag == OPENTAC_VAL_F32 || tag == OPENTAC_VAL_F64 || kind > OPENTAC_KIND_U64) {
+        return false;
+    }
+    uint64_t bits = opentac_lower_bits(lower, tag, val);
+    if (negate) {
+        bits = 0 - bits;
+    }
+    bits = opentac_interp_norm(OPENTAC_KIND_I8 + kind % 4, bits);
+    if ((uint64_t) (int64_t) (int32_t) bits != bits) {
+        return false;
+    }
+    *imm = (uint32_t) bits;
+    return true;
+}
+
+// like opentac_lower_imm, but a comparison needs the exact slot value
+static bool opentac_lower_cmp_imm(const struct OpentacLower *lower, int tag, OpentacVal val, uint32_t *imm) {
+    if (!opentac_lower_is_const(tag) || tag == OPENTAC_VAL_F32 || tag == OPENTAC_VAL_F64) {
+        return false;
+    }
+    uint64_t bits = opentac_lower_bits(lower, tag, val);
+    if ((uint64_t) (int64_t) (int32_t) bits != bits) {
+        return false;
+    }
+    *imm = (uint32_t) bits;
+    return true;
+}
+
+static bool opentac_lower_plain(const struct OpentacLower *lower, OpentacRegister reg) {
+    return !lower->refd[opentac_liveness_index(lower->fn, reg)];
+}
+
+// lowers `stmt`, together with the statements after it up to `end` where
+// they make up one, into a superinstruction; returns how many statements it
+// took, or zero when they are to be lowered one by one
+static size_t opentac_lower_fused(struct OpentacLower *lower, const OpentacStmt *stmt, const OpentacStmt *end) {
+    // operators swapped along with their operands
+    static const int swapped[] = { OPENTAC_OP_GT, OPENTAC_OP_GE, OPENTAC_OP_EQ, OPENTAC_OP_NE, OPENTAC_OP_LT, OPENTAC_OP_LE };
+    OpentacFnBuilder *fn = lower->fn;
+    int opcode = stmt->tag.opcode;
+    const OpentacStmt *next = stmt + 1 < end ? stmt + 1 : NULL;
+
+    // x := p[i]; y := add x, k; p[i] := y
+    if (opcode == OPENTAC_OP_ASSIGN_INDEX && next && next + 1 < end && stmt->tag.left == OPENTAC_VAL_REG) {
+        const OpentacStmt *add = next;
+        const OpentacStmt *store = next + 1;
+        OpentacRegister x = stmt->target;
+        OpentacRegister y = add->target;
+        OpentacRegister p = stmt->left.regval;
+        bool operand = add->tag.opcode == OPENTAC_OP_ADD
+            && ((add->tag.left == OPENTAC_VAL_REG && add->left.regval == x) || (add->tag.right == OPENTAC_VAL_REG && add->right.regval == x));
+        bool matches = operand
+            && store->tag.opcode == OPENTAC_OP_INDEX_ASSIGN
+            && store->target == p
+            && opentac_lower_same(lower, store->tag.left, store->left, stmt->tag.right, stmt->right)
+            && store->tag.right == OPENTAC_VAL_REG && store->right.regval == y
+            && x != p && y != p
+            && !(stmt->tag.right == OPENTAC_VAL_REG && (stmt->right.regval == x || stmt->right.regval == y))
+            && opentac_lower_plain(lower, x) && opentac_lower_plain(lower, y) && opentac_lower_plain(lower, p);
+        int kind = opentac_interp_kind(lower->types[opentac_liveness_index(fn, x)]);
+        if (matches && kind <= OPENTAC_KIND_U64 && kind == opentac_interp_kind(lower->types[opentac_liveness_index(fn, y)])) {
+            bool left = add->tag.left == OPENTAC_VAL_REG && add->left.regval == x;
+            uint32_t k = left ? opentac_lower_operand(lower, add->tag.right, add->right) : opentac_lower_operand(lower, add->tag.left, add->left);
+            uint32_t a = opentac_lower_operand(lower, OPENTAC_VAL_REG, stmt->left);
+            uint32_t b = opentac_lower_operand(lower, stmt->tag.right, stmt->right);
+            struct OpentacInsn *insn = opentac_lower_emit(lower, OPENTAC_INSN_LADDS_I8 + kind, opentac_liveness_index(fn, y), a, b);
+            insn->slots[0] = k;
+            insn->slots[1] = opentac_liveness_index(fn, x);
+            return 3;
+        }
+    }
+
+    // c := lt a, b; if ne c, false branch L
+    if (opcode >= OPENTAC_OP_LT && opcode <= OPENTAC_OP_GE && next && opentac_lower_plain(lower, stmt->target)) {
+        int relop = next->tag.opcode & ~OPENTAC_OP_BRANCH;
+        bool matches = (next->tag.opcode & OPENTAC_OP_BRANCH) == OPENTAC_OP_BRANCH
+            && (relop == OPENTAC_OP_EQ || relop == OPENTAC_OP_NE)
+            && next->tag.left == OPENTAC_VAL_REG && next->left.regval == stmt->target
+            && next->tag.right == OPENTAC_VAL_BOOL;
+        if (matches) {
+            bool taken = (relop == OPENTAC_OP_NE) != next->right.bval;
+            int kind = opentac_lower_kind(lower, stmt->tag.left, stmt->left);
+            uint32_t a = opentac_lower_operand(lower, stmt->tag.left, stmt->left);
+            uint32_t b = opentac_lower_operand(lower, stmt->tag.right, stmt->right);
+            int op = (taken ? OPENTAC_INSN_SBLT_S : OPENTAC_INSN_SBNLT_S) + (opcode - OPENTAC_OP_LT) * 4 + opentac_interp_cmp_class(kind);
+            opentac_lower_emit(lower, op, opentac_liveness_index(fn, stmt->target), a, b)->jump = next->label;
+            return 2;
+        }
+    }
+
+    // if lt i, 10:i32 branch L
+    bool branch = (opcode & OPENTAC_OP_BRANCH) == OPENTAC_OP_BRANCH && (opcode & ~OPENTAC_OP_BRANCH) != OPENTAC_OP_NOP;
+    if (branch && (stmt->tag.left == OPENTAC_VAL_REG) != (stmt->tag.right == OPENTAC_VAL_REG)) {
+        int relop = opcode & ~OPENTAC_OP_BRANCH;
+        int tag = stmt->tag.right;
+        OpentacVal reg = stmt->left;
+        OpentacVal val = stmt->right;
+        if (stmt->tag.left != OPENTAC_VAL_REG) {
+            relop = swapped[relop - OPENTAC_OP_LT];
+            tag = stmt->tag.left;
+            reg = stmt->right;
+            val = stmt->left;
+        }
+        uint32_t imm;
+        int kind = opentac_lower_kind(lower, OPENTAC_VAL_REG, reg);
+        if (kind <= OPENTAC_KIND_U64 && opentac_lower_cmp_imm(lower, tag, val, &imm)) {
+            uint32_t a = opentac_lower_operand(lower, OPENTAC_VAL_REG, reg);
+            int op = OPENTAC_INSN_BLTI_S + (relop - OPENTAC_OP_LT) * 2 + opentac_interp_cmp_class(kind);
+            opentac_lower_emit(lower, op, 0, a, imm)->jump = stmt->label;
+            return 1;
+        }
+    }
+
+    // x := add y, 1:i32
+    if (opcode == OPENTAC_OP_ADD || opcode == OPENTAC_OP_SUB || opcode == OPENTAC_OP_MUL) {
+        uint32_t t = opentac_liveness_index(fn, stmt->target);
+        int kind = opentac_interp_kind(lower->types[t]);
+        int op = opcode == OPENTAC_OP_MUL ? OPENTAC_INSN_MULI_I8 : OPENTAC_INSN_ADDI_I8;
+        uint32_t imm;
+        if (opentac_lower_imm(lower, kind, stmt->tag.right, stmt->right, opcode == OPENTAC_OP_SUB, &imm)) {
+            opentac_lower_emit(lower, op + kind, t, opentac_lower_operand(lower, stmt->tag.left, stmt->left), imm);
+            return 1;
+        }
+        if (opcode != OPENTAC_OP_SUB && opentac_lower_imm(lower, kind, stmt->tag.left, stmt->left, false, &imm)) {
+            opentac_lower_emit(lower, op + kind, t, opentac_lower_operand(lower, stmt->tag.right, stmt->right), imm);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static bool opentac_insn_jumps(int op) {
+    return op == OPENTAC_INSN_JMP
+        || (op >= OPENTAC_INSN_BLT_S && op <= OPENTAC_INSN_BGE_F64)
+        || (op >= OPENTAC_INSN_BLTI_S && op <= OPENTAC_INSN_SBNGE_F64);
+}
+
+static void opentac_lower_fn(struct OpentacInterp *interp, OpentacFnBuilder *fn, struct OpentacInterpFn *dest, const void *const *handlers) {
+    opentac_assertf(!fn->ssa, "%s has to leave ssa form before it can be interpreted", fn->name->data);
+
+    size_t nregs = (size_t) fn->reg + (size_t) -fn->param;
+    struct OpentacLower lower = {
+        .interp = interp,
+        .fn = fn,
+        .types = malloc((nregs ? nregs : 1) * sizeof(OpentacType *)),
+        .refd = calloc(nregs ? nregs : 1, sizeof(bool)),
+        .cap = fn->len + 16,
+        .consts_cap = 16,
+        .table_cap = 32,
+    };
+    opentac_assert(lower.types && lower.refd);
+    lower.code = opentac_arena_alloc(&interp->arena, lower.cap * sizeof(struct OpentacInsn));
+    lower.consts = opentac_arena_alloc(&interp->arena, lower.consts_cap * sizeof(OpentacVal));
+    lower.table = opentac_arena_calloc(&interp->arena, lower.table_cap, sizeof(uint32_t));
+    opentac_fn_infer(interp->builder, fn, lower.types);
+
+    for (size_t i = 0; i < fn->len; i++) {
+        if (fn->stmts[i].tag.opcode == OPENTAC_OP_REF && fn->stmts[i].tag.left == OPENTAC_VAL_REG) {
+            lower.refd[opentac_liveness_index(fn, fn->stmts[i].left.regval)] = true;
+        }
+    }
+
+    dest->name = fn->name;
+    dest->nparams = fn->params.len;
+    dest->param = fn->reg;
+    dest->nregs = nregs;
+    dest->nlabels = fn->label;
+    dest->labels = opentac_arena_alloc(&interp->arena, (fn->label ? fn->label : 1) * sizeof(size_t));
+    for (size_t i = 0; i < fn->label; i++) {
+        dest->labels[i] = SIZE_MAX;
+    }
+
+    // arguments arrive as the caller had them, so narrow parameters are
+    // brought to their own width first
+    for (size_t k = 0; k < fn->params.len; k++) {
+        int kind = opentac_interp_kind(fn->params.params[k]);
+        if (kind <= OPENTAC_KIND_U64) {
+            opentac_lower_emit(&lower, OPENTAC_INSN_NORM_I8 + kind, fn->reg + k, 0, 0);
+        }
+    }
+    for (size_t i = 0; i < fn->len; i++) {
+        size_t fused = opentac_lower_fused(&lower, fn->stmts + i, fn->stmts + fn->len);
+        if (fused) {
+            i += fused - 1;
+            continue;
+        }
+        opentac_lower_stmt(&lower, dest, fn->stmts + i);
+    }
+    // falling off the end returns zero
+    opentac_lower_emit(&lower, OPENTAC_INSN_RET, 0, opentac_lower_const(&lower, 0), 0);
+
+    for (size_t i = 0; i < lower.len; i++) {
+        struct OpentacInsn *insn = lower.code + i;
+        if (opentac_insn_jumps(insn->op)) {
+            opentac_assertf(insn->jump < fn->label && dest->labels[insn->jump] != SIZE_MAX, "branch to label %zu which was never placed", insn->jump);
+            insn->jump = dest->labels[insn->jump];
+        }
+        if (handlers) {
+            insn->handler = handlers[insn->op];
+        }
+    }
+
+    dest->nslots = nregs + lower.nconsts;
+    dest->consts = lower.consts;
+    dest->len = lower.len;
+    dest->code = lower.code;
+
+    free(lower.types);
+    free(lower.refd);
+}
+
+void opentac_interp(struct OpentacInterp *interp, OpentacBuilder *builder) {
+    opentac_assert(interp);
+    opentac_assert(builder);
+
+    interp->builder = builder;
+    opentac_arena(&interp->arena);
+
+    size_t len = 0;
+    for (size_t i = 0; i < builder->len; i++) {
+        if (builder->items[i]->tag == OPENTAC_ITEM_FN) {
+            ++len;
+        }
+    }
+    interp->len = len;
+    interp->fns = opentac_arena_calloc(&interp->arena, len ? len : 1, sizeof(struct OpentacInterpFn));
+
+    interp->nsymbols = 16;
+    while (interp->nsymbols < builder->len * 2) {
+        interp->nsymbols *= 2;
+    }
+    interp->symbols = opentac_arena_calloc(&interp->arena, interp->nsymbols, sizeof(struct OpentacInterpSymbol));
+    len = 0;
+    for (size_t i = 0; i < builder->len; i++) {
+        if (builder->items[i]->tag == OPENTAC_ITEM_FN) {
+            opentac_interp_define(interp, builder->items[i]->fn.name, interp->fns + len++);
+        }
+    }
+    for (size_t i = 0; i < builder->len; i++) {
+        const OpentacDecl *decl = &builder->items[i]->decl;
+        if (builder->items[i]->tag == OPENTAC_ITEM_DECL && decl->type->tag != OPENTAC_TYPE_FN) {
+            void *storage = opentac_arena_calloc(&interp->arena, 1, opentac_interp_sizeof(decl->type));
+            opentac_interp_define(interp, decl->name, storage);
+        }
+    }
+
+    const void *const *handlers = NULL;
+#ifdef OPENTAC_INTERP_THREADED
+    opentac_interp_exec(interp, NULL, NULL, &handlers);
+#endif
+    len = 0;
+    for (size_t i = 0; i < builder->len; i++) {
+        if (builder->items[i]->tag == OPENTAC_ITEM_FN) {
+            opentac_lower_fn(interp, &builder->items[i]->fn, interp->fns + len++, handlers);
+        }
+    }
+
+    interp->stack_len = DEFAULT_STACK_LEN;
+    interp->stack = malloc(interp->stack_len * sizeof(OpentacVal));
+    interp->nargs = 0;
+    interp->args_cap = DEFAULT_ARGS_CAP;
+    interp->args = malloc(interp->args_cap * sizeof(OpentacVal));
+    interp->depth = 0;
+    interp->frames_cap = DEFAULT_FRAMES_CAP;
+    interp->frames = malloc(interp->frames_cap * sizeof(struct OpentacInterpFrame));
+    opentac_assert(interp->stack && interp->args && interp->frames);
+}
+
+void opentac_interp_destroy(struct OpentacInterp *interp) {
+    opentac_assert(interp);
+
+    free(interp->stack);
+    free(interp->args);
+    free(interp->frames);
+    opentac_arena_destroy(&interp->arena);
+}
+
+const struct OpentacInterpFn *opentac_interp_fn(const struct OpentacInterp *interp, const char *name) {
+    opentac_assert(interp);
+    opentac_assert(name);
+
+    for (size_t i = 0; i < interp->len; i++) {
+        if (!strcmp(interp->fns[i].name->data, name)) {
+            return interp->fns + i;
+        }
+    }
+    return NULL;
+}
+
+int opentac_interp_call(struct OpentacInterp *interp, const struct OpentacInterpFn *fn, const OpentacVal *args, size_t nargs, OpentacVal *result) {
+    opentac_assert(interp);
+    opentac_assert(fn);
+    opentac_assert(result);
+
+    if (nargs != fn->nparams) {
+        return OPENTAC_INTERP_BAD_CALL;
+    }
+    if (fn->nslots > interp->stack_len) {
+        return OPENTAC_INTERP_STACK_OVERFLOW;
+    }
+    memcpy(interp->stack + fn->nregs, fn->consts, (fn->nslots - fn->nregs) * sizeof(OpentacVal));
+    memcpy(interp->stack + fn->param, args, nargs * sizeof(OpentacVal));
+    interp->nargs = 0;
+    interp->depth = 0;
+    return opentac_interp_exec(interp, fn, result, NULL);
+}
+
+static uint64_t opentac_interp_sdiv(int64_t a, int64_t b) {
+    // the one quotient that does not fit wraps around
+    return b == -1 ? (uint64_t) 0 - (uint64_t) a : (uint64_t) (a / b);
+}
+
+static uint64_t opentac_interp_udiv(uint64_t a, uint64_t b) {
+    return a / b;
+}
+
+static uint64_t opentac_interp_smod(int64_t a, int64_t b) {
+    return b == -1 ? 0 : (uint64_t) (a % b);
+}
+
+static uint64_t opentac_interp_umod(uint64_t a, uint64_t b) {
+    return a % b;
+}
+
+// shifting by the width or more shifts every bit out
+static uint64_t opentac_interp_sshr(int64_t a, uint64_t n) {
+    return (uint64_t) (n >= 64 ? (a < 0 ? -1 : 0) : a >> n);
+}
+
+static uint64_t opentac_interp_ushr(uint64_t a, uint64_t n) {
+    return n >= 64 ? 0 : a >> n;
+}
+
+static uint64_t opentac_interp_shl(uint64_t a, uint64_t n) {
+    return n >= 64 ? 0 : a << n;
+}
+
+static uint64_t opentac_interp_rol(uint64_t a, uint64_t n, unsigned width) {
+    uint64_t mask = width == 64 ? UINT64_MAX : ((uint64_t) 1 << width) - 1;
+    a &= mask;
+    n %= width;
+    return n ? ((a << n) | (a >> (width - n))) & mask : a;
+}
+
+#define OPENTAC_INTERP_KINDS(X) \
+    X(I8, int8_t, s, i64val) X(I16, int16_t, s, i64val) X(I32, int32_t, s, i64val) X(I64, int64_t, s, i64val) \
+    X(U8, uint8_t, u, ui64val) X(U16, uint16_t, u, ui64val) X(U32, uint32_t, u, ui64val) X(U64, uint64_t, u, ui64val)
+
+#define R(x) r[ip->x]
+#ifdef OPENTAC_INTERP_THREADED
+#define OPENTAC_DISPATCH() __extension__ ({ goto *ip->handler; })
+#define OPENTAC_HANDLER(name) opentac_insn_##name:
+#else
+#define OPENTAC_DISPATCH() goto dispatch
+#define OPENTAC_HANDLER(name) case OPENTAC_INSN_##name:
+#endif
+#define OPENTAC_NEXT() do { ++ip; OPENTAC_DISPATCH(); } while (0)
+#define OPENTAC_JUMP(cond) do { ip = (cond) ? code + ip->jump : ip + 1; OPENTAC_DISPATCH(); } while (0)
+// immediates are sign extended from 32 bits
+#define OPENTAC_IMM() ((uint64_t) (int64_t) (int32_t) ip->b)
+
+#define OPENTAC_INT_HANDLERS(K, T, S, M) \
+    OPENTAC_HANDLER(ADD_##K) R(t).ui64val = (uint64_t) (T) (R(a).ui64val + R(b).ui64val); OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(SUB_##K) R(t).ui64val = (uint64_t) (T) (R(a).ui64val - R(b).ui64val); OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(MUL_##K) R(t).ui64val = (uint64_t) (T) (R(a).ui64val * R(b).ui64val); OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(DIV_##K) \
+        if (!R(b).ui64val) { status = OPENTAC_INTERP_DIVIDE_BY_ZERO; goto fail; } \
+        R(t).ui64val = (uint64_t) (T) opentac_interp_##S##div(R(a).M, R(b).M); OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(MOD_##K) \
+        if (!R(b).ui64val) { status = OPENTAC_INTERP_DIVIDE_BY_ZERO; goto fail; } \
+        R(t).ui64val = (uint64_t) (T) opentac_interp_##S##mod(R(a).M, R(b).M); OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(NEG_##K) R(t).ui64val = (uint64_t) (T) ((uint64_t) 0 - R(a).ui64val); OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(NOT_##K) R(t).ui64val = (uint64_t) (T) ~R(a).ui64val; OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(SHL_##K) R(t).ui64val = (uint64_t) (T) opentac_interp_shl(R(a).ui64val, R(b).ui64val); OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(SHR_##K) R(t).ui64val = (uint64_t) (T) opentac_interp_##S##shr(R(a).M, R(b).ui64val); OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(ROL_##K) R(t).ui64val = (uint64_t) (T) opentac_interp_rol(R(a).ui64val, R(b).ui64val, sizeof(T) * 8); OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(ROR_##K) \
+        R(t).ui64val = (uint64_t) (T) opentac_interp_rol(R(a).ui64val, sizeof(T) * 8 - R(b).ui64val % (sizeof(T) * 8), sizeof(T) * 8); OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(NORM_##K) R(t).ui64val = (uint64_t) (T) R(t).ui64val; OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(LOAD_##K) { \
+        T value; \
+        memcpy(&value, R(a).ptrval + R(b).i64val, sizeof(value)); \
+        R(t).ui64val = (uint64_t) value; \
+        OPENTAC_NEXT(); \
+    } \
+    OPENTAC_HANDLER(ADDI_##K) R(t).ui64val = (uint64_t) (T) (R(a).ui64val + OPENTAC_IMM()); OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(MULI_##K) R(t).ui64val = (uint64_t) (T) (R(a).ui64val * OPENTAC_IMM()); OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(LADDS_##K) { \
+        T value; \
+        uint8_t *address = R(a).ptrval + R(b).i64val; \
+        memcpy(&value, address, sizeof(value)); \
+        r[ip->slots[1]].ui64val = (uint64_t) value; \
+        value = (T) (r[ip->slots[1]].ui64val + r[ip->slots[0]].ui64val); \
+        R(t).ui64val = (uint64_t) value; \
+        memcpy(address, &value, sizeof(value)); \
+        OPENTAC_NEXT(); \
+    }
+
+#define OPENTAC_FLOAT_HANDLERS(K, T, M, MOD) \
+    OPENTAC_HANDLER(ADD_##K) R(t).M = R(a).M + R(b).M; OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(SUB_##K) R(t).M = R(a).M - R(b).M; OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(MUL_##K) R(t).M = R(a).M * R(b).M; OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(DIV_##K) R(t).M = R(a).M / R(b).M; OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(MOD_##K) R(t).M = MOD(R(a).M, R(b).M); OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(NEG_##K) R(t).M = -R(a).M; OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(LOAD_##K) memcpy(&R(t).M, R(a).ptrval + R(b).i64val, sizeof(T)); OPENTAC_NEXT();
+
+#define OPENTAC_CMP_HANDLERS(op, cmp) \
+    OPENTAC_HANDLER(op##_S) R(t).ui64val = R(a).i64val cmp R(b).i64val; OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(op##_U) R(t).ui64val = R(a).ui64val cmp R(b).ui64val; OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(op##_F32) R(t).ui64val = R(a).fval cmp R(b).fval; OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(op##_F64) R(t).ui64val = R(a).dval cmp R(b).dval; OPENTAC_NEXT(); \
+    OPENTAC_HANDLER(B##op##_S) OPENTAC_JUMP(R(a).i64val cmp R(b).i64val); \
+    OPENTAC_HANDLER(B##op##_U) OPENTAC_JUMP(R(a).ui64val cmp R(b).ui64val); \
+    OPENTAC_HANDLER(B##op##_F32) OPENTAC_JUMP(R(a).fval cmp R(b).fval); \
+    OPENTAC_HANDLER(B##op##_F64) OPENTAC_JUMP(R(a).dval cmp R(b).dval); \
+    OPENTAC_HANDLER(SB##op##_S) { bool value = R(a).i64val cmp R(b).i64val; R(t).ui64val = value; OPENTAC_JUMP(value); } \
+    OPENTAC_HANDLER(SB##op##_U) { bool value = R(a).ui64val cmp R(b).ui64val; R(t).ui64val = value; OPENTAC_JUMP(value); } \
+    OPENTAC_HANDLER(SB##op##_F32) { bool value = R(a).fval cmp R(b).fval; R(t).ui64val = value; OPENTAC_JUMP(value); } \
+    OPENTAC_HANDLER(SB##op##_F64) { bool value = R(a).dval cmp R(b).dval; R(t).ui64val = value; OPENTAC_JUMP(value); } \
+    OPENTAC_HANDLER(SBN##op##_S) { bool value = R(a).i64val cmp R(b).i64val; R(t).ui64val = value; OPENTAC_JUMP(!value); } \
+    OPENTAC_HANDLER(SBN##op##_U) { bool value = R(a).ui64val cmp R(b).ui64val; R(t).ui64val = value; OPENTAC_JUMP(!value); } \
+    OPENTAC_HANDLER(SBN##op##_F32) { bool value = R(a).fval cmp R(b).fval; R(t).ui64val = value; OPENTAC_JUMP(!value); } \
+    OPENTAC_HANDLER(SBN##op##_F64) { bool value = R(a).dval cmp R(b).dval; R(t).ui64val = value; OPENTAC_JUMP(!value); } \
+    OPENTAC_HANDLER(B##op##I_S) OPENTAC_JUMP(R(a).i64val cmp (int64_t) OPENTAC_IMM()); \
+    OPENTAC_HANDLER(B##op##I_U) OPENTAC_JUMP(R(a).ui64val cmp OPENTAC_IMM());
+
+#define OPENTAC_STORE_HANDLER(bits) \
+    OPENTAC_HANDLER(STORE##bits) { \
+        uint##bits##_t value = (uint##bits##_t) R(b).ui64val; \
+        memcpy(R(t).ptrval + R(a).i64val, &value, sizeof(value)); \
+        OPENTAC_NEXT(); \
+    }
+
+// with `table` set only hands out the handler addresses, which are local to
+// this function, for lowering to store in the instructions
+static int opentac_interp_exec(struct OpentacInterp *interp, const struct OpentacInterpFn *fn, OpentacVal *result, const void *const **table) {
+#ifdef OPENTAC_INTERP_THREADED
+#define OPENTAC_INSN_ADDRESS(name) __extension__ &&opentac_insn_##name,
+    static const void *const handlers[] = {
+        OPENTAC_INSNS(OPENTAC_INSN_ADDRESS)
+    };
+#undef OPENTAC_INSN_ADDRESS
+    if (table) {
+        *table = handlers;
+        return OPENTAC_INTERP_OK;
+    }
+#else
+    (void) table;
+#endif
+
+    int status = OPENTAC_INTERP_OK;
+    OpentacVal *r = interp->stack;
+    const struct OpentacInsn *code = fn->code;
+    const struct OpentacInsn *ip = code;
+    OpentacVal *end = interp->stack + interp->stack_len;
+    const struct OpentacInterpFn *callee;
+
+    OPENTAC_DISPATCH();
+#ifndef OPENTAC_INTERP_THREADED
+dispatch:
+    switch (ip->op) {
+#endif
+    OPENTAC_HANDLER(MOV) R(t) = R(a); OPENTAC_NEXT();
+    OPENTAC_HANDLER(JMP) ip = code + ip->jump; OPENTAC_DISPATCH();
+    OPENTAC_HANDLER(JMPI) {
+        uint64_t label = R(a).ui64val;
+        if (label >= fn->nlabels || fn->labels[label] == SIZE_MAX) {
+            status = OPENTAC_INTERP_BAD_BRANCH;
+            goto fail;
+        }
+        ip = code + fn->labels[label];
+        OPENTAC_DISPATCH();
+    }
+    OPENTAC_HANDLER(RET) {
+        OpentacVal value = R(a);
+        if (!interp->depth) {
+            *result = value;
+            return OPENTAC_INTERP_OK;
+        }
+        const struct OpentacInterpFrame *frame = interp->frames + --interp->depth;
+        fn = frame->fn;
+        code = fn->code;
+        r = frame->r;
+        ip = frame->ip;
+        r[frame->target] = value;
+        OPENTAC_DISPATCH();
+    }
+    OPENTAC_HANDLER(PARAM)
+        if (interp->nargs == interp->args_cap) {
+            status = OPENTAC_INTERP_STACK_OVERFLOW;
+            goto fail;
+        }
+        interp->args[interp->nargs++] = R(a);
+        OPENTAC_NEXT();
+    OPENTAC_HANDLER(CALLI) {
+        callee = (const struct OpentacInterpFn *) R(a).ptrval;
+        if (callee < interp->fns || callee >= interp->fns + interp->len) {
+            status = OPENTAC_INTERP_BAD_CALL;
+            goto fail;
+        }
+        // shares the rest of the call sequence
+        goto call;
+    }
+    OPENTAC_HANDLER(CALL) {
+        callee = ip->fn;
+    call:
+        if (ip->b != callee->nparams || interp->nargs < ip->b) {
+            status = OPENTAC_INTERP_BAD_CALL;
+            goto fail;
+        }
+        OpentacVal *base = r + fn->nslots;
+        if (interp->depth == interp->frames_cap || callee->nslots > (size_t) (end - base)) {
+            status = OPENTAC_INTERP_STACK_OVERFLOW;
+            goto fail;
+        }
+        interp->frames[interp->depth++] = (struct OpentacInterpFrame) { .fn = fn, .r = r, .ip = ip + 1, .target = ip->t };
+        interp->nargs -= ip->b;
+        memcpy(base + callee->param, interp->args + interp->nargs, ip->b * sizeof(OpentacVal));
+        memcpy(base + callee->nregs, callee->consts, (callee->nslots - callee->nregs) * sizeof(OpentacVal));
+        fn = callee;
+        code = fn->code;
+        r = base;
+        ip = code;
+        OPENTAC_DISPATCH();
+    }
+    OPENTAC_HANDLER(REF) R(t).ptrval = (uint8_t *) &R(a); OPENTAC_NEXT();
+    OPENTAC_HANDLER(BITAND) R(t).ui64val = R(a).ui64val & R(b).ui64val; OPENTAC_NEXT();
+    OPENTAC_HANDLER(BITXOR) R(t).ui64val = R(a).ui64val ^ R(b).ui64val; OPENTAC_NEXT();
+    OPENTAC_HANDLER(BITOR) R(t).ui64val = R(a).ui64val | R(b).ui64val; OPENTAC_NEXT();
+    OPENTAC_HANDLER(BNOT) R(t).ui64val = !R(a).ui64val; OPENTAC_NEXT();
+    OPENTAC_STORE_HANDLER(8)
+    OPENTAC_STORE_HANDLER(16)
+    OPENTAC_STORE_HANDLER(32)
+    OPENTAC_STORE_HANDLER(64)
+    OPENTAC_INTERP_KINDS(OPENTAC_INT_HANDLERS)
+    OPENTAC_FLOAT_HANDLERS(F32, float, fval, fmodf)
+    OPENTAC_FLOAT_HANDLERS(F64, double, dval, fmod)
+    OPENTAC_CMP_HANDLERS(LT, <)
+    OPENTAC_CMP_HANDLERS(LE, <=)
+    OPENTAC_CMP_HANDLERS(EQ, ==)
+    OPENTAC_CMP_HANDLERS(NE, !=)
+    OPENTAC_CMP_HANDLERS(GT, >)
+    OPENTAC_CMP_HANDLERS(GE, >=)
+#ifndef OPENTAC_INTERP_THREADED
+    }
+#endif
+
+fail:
+    interp->depth = 0;
+    interp->nargs = 0;
+    return status;
+}
@@ -0,0 +1,1878 @@
+#include <math.h>
+#include <sys/mman.h>
+#include "include/opentac_jit.h"
+
+// the allocator takes registers from the back, so callee-saved ones are
+// handed out first and the ones division and shifts need come last
+const char *opentac_jit_registers[OPENTAC_JIT_REGISTERS] = {
+    "rax", "rcx", "rdx", "rsi", "rdi", "r8", "r9", "rbx", "r12", "r13", "r14", "r15",
+};
+
+const char *opentac_jit_float_registers[OPENTAC_JIT_FLOAT_REGISTERS] = {
+    "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7", "xmm8",
+    "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15",
+};
+
+static const char *opentac_jit_clobbered[] = {
+    "rax", "rcx", "rdx", "rsi", "rdi", "r8", "r9",
+    "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7", "xmm8",
+    "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15",
+};
+
+static const char *opentac_jit_int_args[] = { "rdi", "rsi", "rdx", "rcx", "r8", "r9" };
+static const char *opentac_jit_float_args[] = { "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7" };
+
+// as the convention has it, scratch registers included, which are never
+// taken
+const struct OpentacTarget opentac_jit_target = {
+    .files = {
+        [OPENTAC_REGCLASS_INT] = { OPENTAC_JIT_REGISTERS, opentac_jit_registers },
+        [OPENTAC_REGCLASS_FLOAT] = { OPENTAC_JIT_FLOAT_REGISTERS, opentac_jit_float_registers },
+    },
+    .clobbered = {
+        [OPENTAC_REGCLASS_INT] = { 7, opentac_jit_clobbered },
+        [OPENTAC_REGCLASS_FLOAT] = { 14, opentac_jit_clobbered + 7 },
+    },
+    .args = {
+        [OPENTAC_REGCLASS_INT] = { 6, opentac_jit_int_args },
+        [OPENTAC_REGCLASS_FLOAT] = { 8, opentac_jit_float_args },
+    },
+    .results = { [OPENTAC_REGCLASS_INT] = "rax", [OPENTAC_REGCLASS_FLOAT] = "xmm0" },
+};
+
+enum {
+    OPENTAC_JIT_RAX,
+    OPENTAC_JIT_RCX,
+    OPENTAC_JIT_RDX,
+    OPENTAC_JIT_RBX,
+    OPENTAC_JIT_RSP,
+    OPENTAC_JIT_RBP,
+    OPENTAC_JIT_RSI,
+    OPENTAC_JIT_RDI,
+    OPENTAC_JIT_R8,
+    OPENTAC_JIT_R9,
+    OPENTAC_JIT_R10,
+    OPENTAC_JIT_R11,
+    OPENTAC_JIT_R12,
+    OPENTAC_JIT_R13,
+    OPENTAC_JIT_R14,
+    OPENTAC_JIT_R15,
+    // xmm registers follow where both kinds are tracked together
+    OPENTAC_JIT_XMM0,
+    // no register, or rip as the base of an address
+    OPENTAC_JIT_NONE = -1,
+    OPENTAC_JIT_RIP = -2,
+};
+
+static const char *const opentac_jit_names[] = {
+    "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+    "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15",
+};
+
+#define OPENTAC_JIT_BIT(reg) ((uint32_t) 1 << (reg))
+#define OPENTAC_JIT_CALLEE_SAVED (OPENTAC_JIT_BIT(OPENTAC_JIT_RBX) | OPENTAC_JIT_BIT(OPENTAC_JIT_R12) \
+    | OPENTAC_JIT_BIT(OPENTAC_JIT_R13) | OPENTAC_JIT_BIT(OPENTAC_JIT_R14) | OPENTAC_JIT_BIT(OPENTAC_JIT_R15))
+
+static const int opentac_jit_args[] = {
+    OPENTAC_JIT_RDI, OPENTAC_JIT_RSI, OPENTAC_JIT_RDX, OPENTAC_JIT_RCX, OPENTAC_JIT_R8, OPENTAC_JIT_R9,
+};
+#define OPENTAC_JIT_INT_ARGS 6
+#define OPENTAC_JIT_FLOAT_ARGS 8
+
+// condition codes, the low nibble of jcc and setcc
+enum {
+    OPENTAC_JIT_CC_B = 0x2,
+    OPENTAC_JIT_CC_AE,
+    OPENTAC_JIT_CC_E,
+    OPENTAC_JIT_CC_NE,
+    OPENTAC_JIT_CC_BE,
+    OPENTAC_JIT_CC_A,
+    OPENTAC_JIT_CC_P = 0xa,
+    OPENTAC_JIT_CC_NP,
+    OPENTAC_JIT_CC_L,
+    OPENTAC_JIT_CC_GE,
+    OPENTAC_JIT_CC_LE,
+    OPENTAC_JIT_CC_G,
+};
+
+// integers of every width are kept extended to 64 bits and floats in the low
+// bits of a general purpose register, as the interpreter keeps its slots
+enum {
+    OPENTAC_JIT_I8,
+    OPENTAC_JIT_I16,
+    OPENTAC_JIT_I32,
+    OPENTAC_JIT_I64,
+    OPENTAC_JIT_U8,
+    OPENTAC_JIT_U16,
+    OPENTAC_JIT_U32,
+    OPENTAC_JIT_U64,
+    OPENTAC_JIT_F32,
+    OPENTAC_JIT_F64,
+};
+
+static int opentac_jit_kind(const OpentacType *type) {
+    switch (type->tag) {
+    case OPENTAC_TYPE_BOOL:
+        return OPENTAC_JIT_U8;
+    case OPENTAC_TYPE_I8:
+    case OPENTAC_TYPE_I16:
+    case OPENTAC_TYPE_I32:
+    case OPENTAC_TYPE_I64:
+    case OPENTAC_TYPE_UI8:
+    case OPENTAC_TYPE_UI16:
+    case OPENTAC_TYPE_UI32:
+    case OPENTAC_TYPE_UI64:
+    case OPENTAC_TYPE_F32:
+    case OPENTAC_TYPE_F64:
+        return OPENTAC_JIT_I8 + (type->tag - OPENTAC_TYPE_I8);
+    }
+    return OPENTAC_JIT_U64;
+}
+
+static int opentac_jit_tag_kind(int tag) {
+    if (tag >= OPENTAC_VAL_I8 && tag <= OPENTAC_VAL_F64) {
+        return OPENTAC_JIT_I8 + (tag - OPENTAC_VAL_I8);
+    }
+    return tag == OPENTAC_VAL_BOOL ? OPENTAC_JIT_U8 : OPENTAC_JIT_U64;
+}
+
+static bool opentac_jit_float(int kind) {
+    return kind >= OPENTAC_JIT_F32;
+}
+
+static bool opentac_jit_fits32(uint64_t imm) {
+    return (uint64_t) (int64_t) (int32_t) imm == imm;
+}
+
+static bool opentac_jit_fits8(int64_t imm) {
+    return imm >= -128 && imm <= 127;
+}
+
+// storage for declarations, at least a slot so that any scalar fits
+static size_t opentac_jit_sizeof(OpentacType *type) {
+    size_t size = opentac_type_layout(type).size;
+    return size > sizeof(OpentacVal) ? size : sizeof(OpentacVal);
+}
+
+static const struct OpentacJitSymbol *opentac_jit_lookup(const struct OpentacJit *jit, OpentacString *name) {
+    size_t mask = jit->nsymbols - 1;
+    for (size_t slot = ((uintptr_t) name >> 4) & mask; jit->symbols[slot].name; slot = (slot + 1) & mask) {
+        if (jit->symbols[slot].name == name) {
+            return jit->symbols + slot;
+        }
+    }
+    return NULL;
+}
+
+static void opentac_jit_define(struct OpentacJit *jit, OpentacString *name, size_t fn, void *address) {
+    size_t mask = jit->nsymbols - 1;
+    size_t slot = ((uintptr_t) name >> 4) & mask;
+    while (jit->symbols[slot].name) {
+        // a function and its declaration share a name, the function wins
+        if (jit->symbols[slot].name == name) {
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+    jit->symbols[slot] = (struct OpentacJitSymbol) { .name = name, .fn = fn, .address = address };
+}
+
+struct OpentacJitCode {
+    size_t len;
+    size_t cap;
+    uint8_t *data;
+};
+
+static void opentac_jit_byte(struct OpentacJitCode *code, uint8_t byte) {
+    if (code->len == code->cap) {
+        code->cap = code->cap ? code->cap * 2 : 4096;
+        code->data = realloc(code->data, code->cap);
+        opentac_assert(code->data);
+    }
+    code->data[code->len++] = byte;
+}
+
+static void opentac_jit_u32(struct OpentacJitCode *code, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        opentac_jit_byte(code, (uint8_t) (value >> i * 8));
+    }
+}
+
+static void opentac_jit_u64(struct OpentacJitCode *code, uint64_t value) {
+    opentac_jit_u32(code, (uint32_t) value);
+    opentac_jit_u32(code, (uint32_t) (value >> 32));
+}
+
+// points the rel32 at `pos` to `target`
+static void opentac_jit_patch(struct OpentacJitCode *code, size_t pos, size_t target) {
+    uint32_t rel = (uint32_t) (target - (pos + 4));
+    for (int i = 0; i < 4; i++) {
+        code->data[pos + i] = (uint8_t) (rel >> i * 8);
+    }
+}
+
+// points the rel8 right before the end of the code so far at it
+static void opentac_jit_patch8(struct OpentacJitCode *code, size_t pos) {
+    opentac_assert(code->len - (pos + 1) <= 127);
+    code->data[pos] = (uint8_t) (code->len - (pos + 1));
+}
+
+// the operand of a ModRM byte: a register, or memory at
+// base + index * scale + disp
+struct OpentacJitRm {
+    bool mem;
+    int reg;
+    int base;
+    int index;
+    int scale;
+    int32_t disp;
+};
+
+static struct OpentacJitRm opentac_jit_r(int reg) {
+    return (struct OpentacJitRm) { .reg = reg, .base = OPENTAC_JIT_NONE, .index = OPENTAC_JIT_NONE };
+}
+
+static struct OpentacJitRm opentac_jit_m(int base, int index, int scale, int32_t disp) {
+    return (struct OpentacJitRm) { .mem = true, .reg = OPENTAC_JIT_NONE, .base = base, .index = index, .scale = scale, .disp = disp };
+}
+
+// emits an instruction with a ModRM operand: `prefix` is a mandatory prefix
+// or zero and `op` the opcode, escapes included, high byte first; `reg` is a
+// register or the opcode extension. `byte` marks byte registers, which need
+// a REX prefix for sil and dil instead of dh and bh
+static void opentac_jit_op(struct OpentacJitCode *code, int prefix, bool w, uint32_t op, int reg, struct OpentacJitRm rm, bool byte) {
+    if (prefix) {
+        opentac_jit_byte(code, (uint8_t) prefix);
+    }
+    int base = rm.mem ? rm.base : rm.reg;
+    int index = rm.mem && rm.index >= 0 ? rm.index : 0;
+    uint8_t rex = 0x40 | w << 3 | (reg >> 3 & 1) << 2 | (index >> 3 & 1) << 1 | (base >= 0 ? base >> 3 & 1 : 0);
+    bool low = (reg >= 4 && reg < 8) || (!rm.mem && rm.reg >= 4 && rm.reg < 8);
+    if (rex != 0x40 || (byte && low)) {
+        opentac_jit_byte(code, rex);
+    }
+    if (op > 0xffff) {
+        opentac_jit_byte(code, (uint8_t) (op >> 16));
+    }
+    if (op > 0xff) {
+        opentac_jit_byte(code, (uint8_t) (op >> 8));
+    }
+    opentac_jit_byte(code, (uint8_t) op);
+
+    if (!rm.mem) {
+        opentac_jit_byte(code, 0xc0 | (reg & 7) << 3 | (rm.reg & 7));
+        return;
+    }
+    if (rm.base == OPENTAC_JIT_RIP) {
+        opentac_jit_byte(code, 0x05 | (reg & 7) << 3);
+        opentac_jit_u32(code, (uint32_t) rm.disp);
+        return;
+    }
+    // rsp and r12 as the base need a SIB byte, rbp and r13 a displacement
+    bool sib = rm.index >= 0 || (rm.base & 7) == OPENTAC_JIT_RSP;
+    int mod = rm.disp == 0 && (rm.base & 7) != OPENTAC_JIT_RBP ? 0 : opentac_jit_fits8(rm.disp) ? 1 : 2;
+    opentac_jit_byte(code, (uint8_t) (mod << 6 | (reg & 7) << 3 | (sib ? 4 : rm.base & 7)));
+    if (sib) {
+        int scale = rm.scale == 8 ? 3 : rm.scale == 4 ? 2 : rm.scale == 2 ? 1 : 0;
+        opentac_jit_byte(code, (uint8_t) (scale << 6 | (rm.index >= 0 ? rm.index & 7 : 4) << 3 | (rm.base & 7)));
+    }
+    if (mod == 1) {
+        opentac_jit_byte(code, (uint8_t) rm.disp);
+    } else if (mod == 2) {
+        opentac_jit_u32(code, (uint32_t) rm.disp);
+    }
+}
+
+static void opentac_jit_mov(struct OpentacJitCode *code, int dst, int src) {
+    if (dst != src) {
+        opentac_jit_op(code, 0, true, 0x8b, dst, opentac_jit_r(src), false);
+    }
+}
+
+static void opentac_jit_imm(struct OpentacJitCode *code, int dst, uint64_t imm) {
+    if (!imm) {
+        opentac_jit_op(code, 0, false, 0x33, dst, opentac_jit_r(dst), false);
+    } else if (imm <= UINT32_MAX) {
+        if (dst >= 8) {
+            opentac_jit_byte(code, 0x41);
+        }
+        opentac_jit_byte(code, 0xb8 + (dst & 7));
+        opentac_jit_u32(code, (uint32_t) imm);
+    } else if (opentac_jit_fits32(imm)) {
+        opentac_jit_op(code, 0, true, 0xc7, 0, opentac_jit_r(dst), false);
+        opentac_jit_u32(code, (uint32_t) imm);
+    } else {
+        opentac_jit_byte(code, 0x48 | dst >> 3);
+        opentac_jit_byte(code, 0xb8 + (dst & 7));
+        opentac_jit_u64(code, imm);
+    }
+}
+
+static void opentac_jit_push(struct OpentacJitCode *code, int reg) {
+    if (reg >= 8) {
+        opentac_jit_byte(code, 0x41);
+    }
+    opentac_jit_byte(code, 0x50 + (reg & 7));
+}
+
+static void opentac_jit_pop(struct OpentacJitCode *code, int reg) {
+    if (reg >= 8) {
+        opentac_jit_byte(code, 0x41);
+    }
+    opentac_jit_byte(code, 0x58 + (reg & 7));
+}
+
+// moves between general purpose and xmm registers, 32 or 64 bits
+static void opentac_jit_to_xmm(struct OpentacJitCode *code, int kind, int xmm, int reg) {
+    opentac_jit_op(code, 0x66, kind == OPENTAC_JIT_F64, 0x0f6e, xmm, opentac_jit_r(reg), false);
+}
+
+static void opentac_jit_from_xmm(struct OpentacJitCode *code, int kind, int reg, int xmm) {
+    opentac_jit_op(code, 0x66, kind == OPENTAC_JIT_F64, 0x0f7e, xmm, opentac_jit_r(reg), false);
+}
+
+// movaps, which copies the whole register whatever it holds
+static void opentac_jit_movaps(struct OpentacJitCode *code, int dst, int src) {
+    if (dst != src) {
+        opentac_jit_op(code, 0, false, 0x0f28, dst, opentac_jit_r(src), false);
+    }
+}
+
+// reads a value of `kind` into `dst`, extended the way registers keep it
+static void opentac_jit_load_kind(struct OpentacJitCode *code, int kind, int dst, struct OpentacJitRm rm) {
+    switch (kind) {
+    case OPENTAC_JIT_I8:
+        opentac_jit_op(code, 0, true, 0x0fbe, dst, rm, true);
+        return;
+    case OPENTAC_JIT_I16:
+        opentac_jit_op(code, 0, true, 0x0fbf, dst, rm, false);
+        return;
+    case OPENTAC_JIT_I32:
+        opentac_jit_op(code, 0, true, 0x63, dst, rm, false);
+        return;
+    case OPENTAC_JIT_U8:
+        opentac_jit_op(code, 0, false, 0x0fb6, dst, rm, true);
+        return;
+    case OPENTAC_JIT_U16:
+        opentac_jit_op(code, 0, false, 0x0fb7, dst, rm, false);
+        return;
+    case OPENTAC_JIT_U32:
+    case OPENTAC_JIT_F32:
+        opentac_jit_op(code, 0, false, 0x8b, dst, rm, false);
+        return;
+    }
+    opentac_jit_op(code, 0, true, 0x8b, dst, rm, false);
+}
+
+// extends the low bits of `reg` the way a value of `kind` is kept
+static void opentac_jit_norm(struct OpentacJitCode *code, int kind, int reg) {
+    if (kind != OPENTAC_JIT_I64 && kind != OPENTAC_JIT_U64 && !opentac_jit_float(kind)) {
+        opentac_jit_load_kind(code, kind, reg, opentac_jit_r(reg));
+    }
+}
+
+static void opentac_jit_store_width(struct OpentacJitCode *code, int kind, int src, struct OpentacJitRm rm) {
+    switch (kind) {
+    case OPENTAC_JIT_I8:
+    case OPENTAC_JIT_U8:
+        opentac_jit_op(code, 0, false, 0x88, src, rm, true);
+        return;
+    case OPENTAC_JIT_I16:
+    case OPENTAC_JIT_U16:
+        opentac_jit_op(code, 0x66, false, 0x89, src, rm, false);
+        return;
+    case OPENTAC_JIT_I32:
+    case OPENTAC_JIT_U32:
+    case OPENTAC_JIT_F32:
+        opentac_jit_op(code, 0, false, 0x89, src, rm, false);
+        return;
+    }
+    opentac_jit_op(code, 0, true, 0x89, src, rm, false);
+}
+
+// a short forward jump, patched with opentac_jit_patch8 once its target is
+// emitted
+static size_t opentac_jit_jcc8(struct OpentacJitCode *code, int cc) {
+    opentac_jit_byte(code, 0x70 + cc);
+    opentac_jit_byte(code, 0);
+    return code->len - 1;
+}
+
+static size_t opentac_jit_jmp8(struct OpentacJitCode *code) {
+    opentac_jit_byte(code, 0xeb);
+    opentac_jit_byte(code, 0);
+    return code->len - 1;
+}
+
+struct OpentacJitFixup {
+    size_t pos;
+    size_t target;
+};
+
+struct OpentacJitFixups {
+    size_t len;
+    size_t cap;
+    struct OpentacJitFixup *fixups;
+};
+
+static void opentac_jit_fixup(struct OpentacArena *arena, struct OpentacJitFixups *fixups, size_t pos, size_t target) {
+    if (fixups->len == fixups->cap) {
+        size_t cap = fixups->cap ? fixups->cap * 2 : 16;
+        fixups->fixups = opentac_arena_realloc(arena, fixups->fixups, fixups->cap * sizeof(struct OpentacJitFixup), cap * sizeof(struct OpentacJitFixup));
+        fixups->cap = cap;
+    }
+    fixups->fixups[fixups->len++] = (struct OpentacJitFixup) { .pos = pos, .target = target };
+}
+
+enum {
+    OPENTAC_JIT_LOC_REG,
+    // xmm register `reg`, only ever holding floats
+    OPENTAC_JIT_LOC_XMM,
+    // at `disp` from rbp
+    OPENTAC_JIT_LOC_MEM,
+    OPENTAC_JIT_LOC_IMM,
+    // the address of function `imm` of the module
+    OPENTAC_JIT_LOC_FN,
+};
+
+struct OpentacJitLoc {
+    int tag;
+    int reg;
+    int32_t disp;
+    uint64_t imm;
+    // registers whose address is taken live in memory and may have been
+    // written through a pointer with a narrower store, so they are read
+    // with an extending load of `kind`; spill slots are only as wide as
+    // `kind`, with the value kept extended in registers
+    bool refd;
+    int kind;
+};
+
+// an interval in a caller-saved register, which calls have to preserve;
+// a piece of a split interval may take the value over by a move right
+// before its first statement, or hand it on right after its last
+struct OpentacJitLive {
+    int reg;
+    // liveness index of the register the interval belongs to
+    size_t index;
+    size_t nranges;
+    const struct OpentacRange *ranges;
+    bool entered;
+    bool handed;
+};
+
+// register `index` is at `loc` from statement `pos` on, where a piece of
+// its split interval starts
+struct OpentacJitEvent {
+    OpentacLifetime pos;
+    size_t index;
+    struct OpentacJitLoc loc;
+};
+
+// a taken branch along an edge that needs moves, which goes to a stub
+// making the moves from the allocator's edges [first, first + len) first
+struct OpentacJitStub {
+    size_t pos;
+    size_t label;
+    size_t first;
+    size_t len;
+};
+
+struct OpentacJitStubs {
+    size_t len;
+    size_t cap;
+    struct OpentacJitStub *stubs;
+};
+
+struct OpentacJitLower {
+    struct OpentacJit *jit;
+    OpentacFnBuilder *fn;
+    struct OpentacJitCode *code;
+    // calls and references to functions of the module, patched once they
+    // are all laid out
+    struct OpentacJitFixups *calls;
+    OpentacType **types;
+    struct OpentacJitLoc *locs;
+    // machine registers the allocation uses
+    uint32_t used;
+    OpentacLifetime base;
+    size_t nlive;
+    struct OpentacJitLive *live;
+    // where split intervals change places, by position, and the moves that
+    // take them there; `event` and `move` are the first still ahead
+    size_t nevents;
+    size_t event;
+    struct OpentacJitEvent *events;
+    const struct OpentacMoves *moves;
+    size_t move;
+    const struct OpentacMoves *edges;
+    // the block being compiled
+    size_t block;
+    struct OpentacJitStubs stubs;
+    // frame slots of saved registers and incoming parameters
+    int32_t saves[32];
+    int32_t *incoming;
+    // registers live on entry, by opentac_liveness_index
+    const uint64_t *entry;
+    // arguments pushed by param and not yet taken by a call go to frame
+    // slots, outgoing stack arguments to the bottom of the frame
+    size_t npending;
+    int32_t *pending;
+    int *pending_kinds;
+    int32_t frame;
+    size_t *labels;
+    struct OpentacJitFixups branches;
+    // indirect branches: the jumps to the trap and the references to the
+    // table of label offsets, which is the function's unless the branch
+    // needs moves on its edges and the target is its block + 1
+    struct OpentacJitFixups traps;
+    struct OpentacJitFixups tables;
+};
+
+static int opentac_jit_mreg(const char *name) {
+    for (int reg = 0; reg < 16; reg++) {
+        if (!strcmp(opentac_jit_names[reg], name)) {
+            opentac_assertf(reg != OPENTAC_JIT_RSP && reg != OPENTAC_JIT_RBP && reg != OPENTAC_JIT_R10 && reg != OPENTAC_JIT_R11, "%s is reserved by the jit", name);
+            return reg;
+        }
+    }
+    for (int k = 0; k < OPENTAC_JIT_FLOAT_REGISTERS; k++) {
+        if (!strcmp(opentac_jit_float_registers[k], name)) {
+            return OPENTAC_JIT_XMM0 + 2 + k;
+        }
+    }
+    opentac_assertf(strcmp(name, "xmm0") && strcmp(name, "xmm1"), "%s is reserved by the jit", name);
+    opentac_assertf(false, "%s is not an x86-64 register", name);
+    return OPENTAC_JIT_NONE;
+}
+
+static int opentac_jit_operand_kind(const struct OpentacJitLower *lower, int tag, OpentacVal val) {
+    if (tag == OPENTAC_VAL_REG) {
+        return opentac_jit_kind(lower->types[opentac_liveness_index(lower->fn, val.regval)]);
+    }
+    return opentac_jit_tag_kind(tag);
+}
+
+static bool opentac_jit_bool(const struct OpentacJitLower *lower, int tag, OpentacVal val) {
+    if (tag == OPENTAC_VAL_REG) {
+        return lower->types[opentac_liveness_index(lower->fn, val.regval)]->tag == OPENTAC_TYPE_BOOL;
+    }
+    return tag == OPENTAC_VAL_BOOL;
+}
+
+static struct OpentacJitLoc opentac_jit_operand(const struct OpentacJitLower *lower, int tag, OpentacVal val) {
+    struct OpentacJitLoc loc = { .tag = OPENTAC_JIT_LOC_IMM };
+    switch (tag) {
+    case OPENTAC_VAL_REG:
+        return lower->locs[opentac_liveness_index(lower->fn, val.regval)];
+    case OPENTAC_VAL_NAMED: {
+        const struct OpentacJitSymbol *symbol = opentac_jit_lookup(lower->jit, val.name);
+        if (symbol && symbol->fn) {
+            loc.tag = OPENTAC_JIT_LOC_FN;
+            loc.imm = symbol->fn - 1;
+        } else {
+            loc.imm = symbol ? (uint64_t) (uintptr_t) symbol->address : 0;
+        }
+        return loc;
+    }
+    case OPENTAC_VAL_BOOL:
+        loc.imm = val.bval;
+        return loc;
+    case OPENTAC_VAL_I8:
+        loc.imm = (uint64_t) (int64_t) val.i8val;
+        return loc;
+    case OPENTAC_VAL_I16:
+        loc.imm = (uint64_t) (int64_t) val.i16val;
+        return loc;
+    case OPENTAC_VAL_I32:
+        loc.imm = (uint64_t) (int64_t) val.i32val;
+        return loc;
+    case OPENTAC_VAL_UI8:
+        loc.imm = val.ui8val;
+        return loc;
+    case OPENTAC_VAL_UI16:
+        loc.imm = val.ui16val;
+        return loc;
+    case OPENTAC_VAL_UI32:
+    case OPENTAC_VAL_F32:
+        loc.imm = val.ui32val;
+        return loc;
+    case OPENTAC_VAL_I64:
+    case OPENTAC_VAL_UI64:
+    case OPENTAC_VAL_F64:
+    case OPENTAC_VAL_PTR:
+        loc.imm = val.ui64val;
+        return loc;
+    }
+    return loc;
+}
+
+static bool opentac_jit_imm32(struct OpentacJitLoc loc) {
+    return loc.tag == OPENTAC_JIT_LOC_IMM && opentac_jit_fits32(loc.imm);
+}
+
+// whether `loc` is a spill slot that can be used as a 64 bit operand directly
+static bool opentac_jit_word(struct OpentacJitLoc loc) {
+    return loc.tag == OPENTAC_JIT_LOC_MEM && !loc.refd && (loc.kind == OPENTAC_JIT_I64 || loc.kind == OPENTAC_JIT_U64);
+}
+
+static void opentac_jit_load(struct OpentacJitLower *lower, int dst, struct OpentacJitLoc loc) {
+    struct OpentacJitCode *code = lower->code;
+    switch (loc.tag) {
+    case OPENTAC_JIT_LOC_REG:
+        opentac_jit_mov(code, dst, loc.reg);
+        return;
+    case OPENTAC_JIT_LOC_XMM:
+        opentac_jit_from_xmm(code, loc.kind, dst, loc.reg);
+        return;
+    case OPENTAC_JIT_LOC_MEM:
+        opentac_jit_load_kind(code, loc.kind, dst, opentac_jit_m(OPENTAC_JIT_RBP, OPENTAC_JIT_NONE, 1, loc.disp));
+        return;
+    case OPENTAC_JIT_LOC_IMM:
+        opentac_jit_imm(code, dst, loc.imm);
+        return;
+    case OPENTAC_JIT_LOC_FN:
+        opentac_jit_op(code, 0, true, 0x8d, dst, opentac_jit_m(OPENTAC_JIT_RIP, OPENTAC_JIT_NONE, 1, 0), false);
+        opentac_jit_fixup(&lower->jit->arena, lower->calls, code->len - 4, loc.imm);
+        return;
+    }
+}
+
+// the register holding `loc`, loading it into `scratch` unless it already
+// is in one
+static int opentac_jit_reg(struct OpentacJitLower *lower, struct OpentacJitLoc loc, int scratch) {
+    if (loc.tag == OPENTAC_JIT_LOC_REG) {
+        return loc.reg;
+    }
+    opentac_jit_load(lower, scratch, loc);
+    return scratch;
+}
+
+static void opentac_jit_store(struct OpentacJitLower *lower, size_t index, int src) {
+    struct OpentacJitLoc loc = lower->locs[index];
+    if (loc.tag == OPENTAC_JIT_LOC_REG) {
+        opentac_jit_mov(lower->code, loc.reg, src);
+    } else if (loc.tag == OPENTAC_JIT_LOC_XMM) {
+        opentac_jit_to_xmm(lower->code, loc.kind, loc.reg, src);
+    } else {
+        // homes of registers whose address is taken are whole words
+        opentac_jit_store_width(lower->code, loc.refd ? OPENTAC_JIT_U64 : loc.kind, src, opentac_jit_m(OPENTAC_JIT_RBP, OPENTAC_JIT_NONE, 1, loc.disp));
+    }
+}
+
+static void opentac_jit_move(struct OpentacJitLower *lower, size_t index, struct OpentacJitLoc src) {
+    struct OpentacJitLoc dst = lower->locs[index];
+    if (dst.tag == OPENTAC_JIT_LOC_XMM && src.tag == OPENTAC_JIT_LOC_XMM) {
+        opentac_jit_movaps(lower->code, dst.reg, src.reg);
+    } else if (dst.tag == OPENTAC_JIT_LOC_REG) {
+        opentac_jit_load(lower, dst.reg, src);
+    } else {
+        opentac_jit_store(lower, index, opentac_jit_reg(lower, src, OPENTAC_JIT_R10));
+    }
+}
+
+// moves the float in `loc` into `xmm`, through `scratch` unless it is in
+// an xmm register already
+static void opentac_jit_xmm_load(struct OpentacJitLower *lower, int kind, int xmm, struct OpentacJitLoc loc, int scratch) {
+    if (loc.tag == OPENTAC_JIT_LOC_XMM) {
+        opentac_jit_movaps(lower->code, xmm, loc.reg);
+        return;
+    }
+    opentac_jit_load(lower, scratch, loc);
+    opentac_jit_to_xmm(lower->code, kind, xmm, scratch);
+}
+
+// the xmm register holding `loc`, loading it into `xmm` unless it already
+// is in one
+static int opentac_jit_xmm(struct OpentacJitLower *lower, int kind, struct OpentacJitLoc loc, int xmm, int scratch) {
+    if (loc.tag == OPENTAC_JIT_LOC_XMM) {
+        return loc.reg;
+    }
+    opentac_jit_xmm_load(lower, kind, xmm, loc, scratch);
+    return xmm;
+}
+
+static void opentac_jit_xmm_store(struct OpentacJitLower *lower, size_t index, int xmm) {
+    struct OpentacJitLoc loc = lower->locs[index];
+    if (loc.tag == OPENTAC_JIT_LOC_XMM) {
+        opentac_jit_movaps(lower->code, loc.reg, xmm);
+        return;
+    }
+    opentac_jit_from_xmm(lower->code, loc.kind, OPENTAC_JIT_R10, xmm);
+    opentac_jit_store(lower, index, OPENTAC_JIT_R10);
+}
+
+// the place the allocator gave a register, without its kind
+static struct OpentacJitLoc opentac_jit_place(struct OpentacPurpose purpose) {
+    if (purpose.tag != OPENTAC_REG_ALLOCATED) {
+        return (struct OpentacJitLoc) { .tag = OPENTAC_JIT_LOC_MEM, .disp = -(int32_t) purpose.stack };
+    }
+    int reg = opentac_jit_mreg(purpose.reg.name);
+    if (reg >= OPENTAC_JIT_XMM0) {
+        return (struct OpentacJitLoc) { .tag = OPENTAC_JIT_LOC_XMM, .reg = reg - OPENTAC_JIT_XMM0 };
+    }
+    return (struct OpentacJitLoc) { .tag = OPENTAC_JIT_LOC_REG, .reg = reg };
+}
+
+static bool opentac_jit_same(struct OpentacJitLoc a, struct OpentacJitLoc b) {
+    return a.tag == b.tag && (a.tag == OPENTAC_JIT_LOC_MEM ? a.disp == b.disp : a.reg == b.reg);
+}
+
+// copies a value between the places of two pieces of its interval, through
+// `scratch` when neither is a register the other can be moved to directly;
+// only moves are used, so the flags survive
+static void opentac_jit_copy(struct OpentacJitLower *lower, struct OpentacJitLoc dst, struct OpentacJitLoc src, int scratch) {
+    if (dst.tag == OPENTAC_JIT_LOC_XMM) {
+        opentac_jit_xmm_load(lower, dst.kind, dst.reg, src, scratch);
+    } else if (dst.tag == OPENTAC_JIT_LOC_REG) {
+        opentac_jit_load(lower, dst.reg, src);
+    } else {
+        opentac_jit_store_width(lower->code, dst.kind, opentac_jit_reg(lower, src, scratch), opentac_jit_m(OPENTAC_JIT_RBP, OPENTAC_JIT_NONE, 1, dst.disp));
+    }
+}
+
+// makes `moves` of the allocator at once: a move waits until no other one
+// still reads its destination, and when every one waits they go around in
+// cycles, one of which r10 breaks by holding a value; r11 carries the
+// copies between memory
+static void opentac_jit_parallel(struct OpentacJitLower *lower, const struct OpentacMove *moves, size_t len) {
+    struct OpentacJitLoc *dst = malloc((len ? 2 * len : 1) * sizeof(struct OpentacJitLoc));
+    opentac_assert(dst);
+    struct OpentacJitLoc *src = dst + len;
+    size_t n = 0;
+    for (size_t k = 0; k < len; k++) {
+        size_t index = opentac_liveness_index(lower->fn, moves[k].reg);
+        // registers whose address is taken stay at home throughout
+        if (lower->locs[index].refd) {
+            continue;
+        }
+        dst[n] = opentac_jit_place(moves[k].dst);
+        src[n] = opentac_jit_place(moves[k].src);
+        dst[n].kind = src[n].kind = opentac_jit_kind(lower->types[index]);
+        n += !opentac_jit_same(dst[n], src[n]);
+    }
+
+    while (n) {
+        size_t k = 0;
+        for (; k < n; k++) {
+            size_t j = 0;
+            while (j < n && (j == k || !opentac_jit_same(src[j], dst[k]))) {
+                j++;
+            }
+            if (j == n) {
+                break;
+            }
+        }
+        if (k == n) {
+            opentac_jit_load(lower, OPENTAC_JIT_R10, src[0]);
+            src[0] = (struct OpentacJitLoc) { .tag = OPENTAC_JIT_LOC_REG, .reg = OPENTAC_JIT_R10, .kind = src[0].kind };
+            continue;
+        }
+        opentac_jit_copy(lower, dst[k], src[k], OPENTAC_JIT_R11);
+        dst[k] = dst[--n];
+        src[k] = src[n];
+    }
+    free(dst);
+}
+
+// brings split intervals up to statement `i`: makes the moves before it
+// and moves on to the pieces starting there
+static void opentac_jit_advance(struct OpentacJitLower *lower, size_t i) {
+    OpentacLifetime pos = lower->base + i;
+    const struct OpentacMove *moves = lower->moves->moves;
+    while (lower->move < lower->moves->len && moves[lower->move].pos <= pos) {
+        size_t first = lower->move;
+        while (lower->move < lower->moves->len && moves[lower->move].pos == moves[first].pos) {
+            lower->move++;
+        }
+        opentac_jit_parallel(lower, moves + first, lower->move - first);
+    }
+    for (; lower->event < lower->nevents && lower->events[lower->event].pos <= pos; lower->event++) {
+        lower->locs[lower->events[lower->event].index] = lower->events[lower->event].loc;
+    }
+}
+
+// the allocator's moves on the edge from block `from` to block `to`, as the
+// index of the first one and how many there are
+static size_t opentac_jit_edge(const struct OpentacJitLower *lower, size_t from, size_t to, size_t *first) {
+    const struct OpentacCfg *cfg = &lower->fn->cfg;
+    OpentacLifetime pos = lower->base + cfg->blocks[from].end - 1;
+    OpentacLifetime succ = lower->base + cfg->blocks[to].start;
+    const struct OpentacMove *moves = lower->edges->moves;
+    size_t lo = 0;
+    size_t hi = lower->edges->len;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (moves[mid].pos < pos || (moves[mid].pos == pos && moves[mid].succ < succ)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    size_t len = 0;
+    while (lo + len < lower->edges->len && moves[lo + len].pos == pos && moves[lo + len].succ == succ) {
+        len++;
+    }
+    *first = lo;
+    return len;
+}
+
+// where to compute the value of register `index`: its own machine register
+// when it has one that `avoid` is not read from, r10 otherwise
+static int opentac_jit_work(const struct OpentacJitLower *lower, size_t index, struct OpentacJitLoc avoid) {
+    struct OpentacJitLoc loc = lower->locs[index];
+    if (loc.tag == OPENTAC_JIT_LOC_REG && !(avoid.tag == OPENTAC_JIT_LOC_REG && avoid.reg == loc.reg)) {
+        return loc.reg;
+    }
+    return OPENTAC_JIT_R10;
+}
+
+enum {
+    OPENTAC_JIT_ADD = 0,
+    OPENTAC_JIT_OR = 1,
+    OPENTAC_JIT_AND = 4,
+    OPENTAC_JIT_SUB = 5,
+    OPENTAC_JIT_XOR = 6,
+    OPENTAC_JIT_CMP = 7,
+};
+
+// `dst` op= `loc` for the arithmetic group operation `ext`
+static void opentac_jit_alu(struct OpentacJitLower *lower, int ext, int dst, struct OpentacJitLoc loc) {
+    static const uint8_t ops[] = { 0x03, 0x0b, 0, 0, 0x23, 0x2b, 0x33, 0x3b };
+    struct OpentacJitCode *code = lower->code;
+    if (opentac_jit_imm32(loc)) {
+        bool small = opentac_jit_fits8((int64_t) loc.imm);
+        opentac_jit_op(code, 0, true, small ? 0x83 : 0x81, ext, opentac_jit_r(dst), false);
+        if (small) {
+            opentac_jit_byte(code, (uint8_t) loc.imm);
+        } else {
+            opentac_jit_u32(code, (uint32_t) loc.imm);
+        }
+    } else if (opentac_jit_word(loc)) {
+        opentac_jit_op(code, 0, true, ops[ext], dst, opentac_jit_m(OPENTAC_JIT_RBP, OPENTAC_JIT_NONE, 1, loc.disp), false);
+    } else {
+        opentac_jit_op(code, 0, true, ops[ext], dst, opentac_jit_r(opentac_jit_reg(lower, loc, OPENTAC_JIT_R11)), false);
+    }
+}
+
+static void opentac_jit_imul(struct OpentacJitLower *lower, int dst, struct OpentacJitLoc loc) {
+    struct OpentacJitCode *code = lower->code;
+    if (opentac_jit_imm32(loc)) {
+        opentac_jit_op(code, 0, true, 0x69, dst, opentac_jit_r(dst), false);
+        opentac_jit_u32(code, (uint32_t) loc.imm);
+    } else if (opentac_jit_word(loc)) {
+        opentac_jit_op(code, 0, true, 0x0faf, dst, opentac_jit_m(OPENTAC_JIT_RBP, OPENTAC_JIT_NONE, 1, loc.disp), false);
+    } else {
+        opentac_jit_op(code, 0, true, 0x0faf, dst, opentac_jit_r(opentac_jit_reg(lower, loc, OPENTAC_JIT_R11)), false);
+    }
+}
+
+// the condition under which a comparison holds; unordered floating point
+// operands set the parity flag, which then has to be clear (`parity` 1) or
+// is enough on its own (`parity` 2)
+struct OpentacJitCond {
+    int cc;
+    int parity;
+};
+
+static struct OpentacJitCond opentac_jit_negate(struct OpentacJitCond cond) {
+    static const int parity[] = { 0, 2, 1 };
+    return (struct OpentacJitCond) { .cc = cond.cc ^ 1, .parity = parity[cond.parity] };
+}
+
+static struct OpentacJitCond opentac_jit_compare(struct OpentacJitLower *lower, int relop, int kind, struct OpentacJitLoc left, struct OpentacJitLoc right) {
+    static const int sccs[] = { OPENTAC_JIT_CC_L, OPENTAC_JIT_CC_LE, OPENTAC_JIT_CC_E, OPENTAC_JIT_CC_NE, OPENTAC_JIT_CC_G, OPENTAC_JIT_CC_GE };
+    static const int uccs[] = { OPENTAC_JIT_CC_B, OPENTAC_JIT_CC_BE, OPENTAC_JIT_CC_E, OPENTAC_JIT_CC_NE, OPENTAC_JIT_CC_A, OPENTAC_JIT_CC_AE };
+    struct OpentacJitCode *code = lower->code;
+    int index = relop - OPENTAC_OP_LT;
+    if (!opentac_jit_float(kind)) {
+        opentac_jit_alu(lower, OPENTAC_JIT_CMP, opentac_jit_reg(lower, left, OPENTAC_JIT_R10), right);
+        return (struct OpentacJitCond) { .cc = kind <= OPENTAC_JIT_I64 ? sccs[index] : uccs[index] };
+    }
+
+    int l = opentac_jit_xmm(lower, kind, left, 0, OPENTAC_JIT_R10);
+    int r = opentac_jit_xmm(lower, kind, right, 1, OPENTAC_JIT_R11);
+    // less than is greater than with the operands swapped, which keeps
+    // unordered operands false through the carry flag
+    bool swap = relop == OPENTAC_OP_LT || relop == OPENTAC_OP_LE;
+    opentac_jit_op(code, kind == OPENTAC_JIT_F64 ? 0x66 : 0, false, 0x0f2e, swap ? r : l, opentac_jit_r(swap ? l : r), false);
+    switch (relop) {
+    case OPENTAC_OP_LT:
+    case OPENTAC_OP_GT:
+        return (struct OpentacJitCond) { .cc = OPENTAC_JIT_CC_A };
+    case OPENTAC_OP_LE:
+    case OPENTAC_OP_GE:
+        return (struct OpentacJitCond) { .cc = OPENTAC_JIT_CC_AE };
+    case OPENTAC_OP_EQ:
+        return (struct OpentacJitCond) { .cc = OPENTAC_JIT_CC_E, .parity = 1 };
+    }
+    return (struct OpentacJitCond) { .cc = OPENTAC_JIT_CC_NE, .parity = 2 };
+}
+
+// sets `reg` to one if `cond` holds and to zero otherwise
+static void opentac_jit_setcc(struct OpentacJitCode *code, struct OpentacJitCond cond, int reg) {
+    opentac_jit_op(code, 0, false, 0x0f90 + cond.cc, 0, opentac_jit_r(reg), true);
+    if (cond.parity) {
+        opentac_jit_op(code, 0, false, 0x0f90 + (cond.parity == 1 ? OPENTAC_JIT_CC_NP : OPENTAC_JIT_CC_P), 0, opentac_jit_r(OPENTAC_JIT_R11), true);
+        opentac_jit_op(code, 0, false, cond.parity == 1 ? 0x22 : 0x0a, reg, opentac_jit_r(OPENTAC_JIT_R11), true);
+    }
+    opentac_jit_op(code, 0, false, 0x0fb6, reg, opentac_jit_r(reg), true);
+}
+
+static void opentac_jit_branch(struct OpentacJitLower *lower, int cc, size_t label) {
+    struct OpentacJitCode *code = lower->code;
+    if (cc < 0) {
+        opentac_jit_byte(code, 0xe9);
+    } else {
+        opentac_jit_byte(code, 0x0f);
+        opentac_jit_byte(code, 0x80 + cc);
+    }
+    opentac_jit_u32(code, 0);
+    opentac_jit_fixup(&lower->jit->arena, &lower->branches, code->len - 4, label);
+}
+
+// a branch out of the current block, which makes the moves its edge needs
+// right before it when it is unconditional and in a stub otherwise
+static void opentac_jit_goto(struct OpentacJitLower *lower, int cc, size_t label) {
+    const struct OpentacCfg *cfg = &lower->fn->cfg;
+    size_t first = 0;
+    size_t len = 0;
+    if (label < cfg->nlabels && cfg->labels[label] != SIZE_MAX) {
+        len = opentac_jit_edge(lower, lower->block, cfg->labels[label], &first);
+    }
+    if (!len || cc < 0) {
+        if (len) {
+            opentac_jit_parallel(lower, lower->edges->moves + first, len);
+        }
+        opentac_jit_branch(lower, cc, label);
+        return;
+    }
+
+    struct OpentacJitCode *code = lower->code;
+    opentac_jit_byte(code, 0x0f);
+    opentac_jit_byte(code, 0x80 + cc);
+    opentac_jit_u32(code, 0);
+    struct OpentacJitStubs *stubs = &lower->stubs;
+    if (stubs->len == stubs->cap) {
+        size_t cap = stubs->cap ? stubs->cap * 2 : 16;
+        stubs->stubs = opentac_arena_realloc(&lower->jit->arena, stubs->stubs, stubs->cap * sizeof(struct OpentacJitStub), cap * sizeof(struct OpentacJitStub));
+        stubs->cap = cap;
+    }
+    stubs->stubs[stubs->len++] = (struct OpentacJitStub) { .pos = code->len - 4, .label = label, .first = first, .len = len };
+}
+
+static void opentac_jit_jcc(struct OpentacJitLower *lower, struct OpentacJitCond cond, size_t label) {
+    if (cond.parity == 1) {
+        size_t skip = opentac_jit_jcc8(lower->code, OPENTAC_JIT_CC_P);
+        opentac_jit_goto(lower, cond.cc, label);
+        opentac_jit_patch8(lower->code, skip);
+        return;
+    }
+    if (cond.parity == 2) {
+        opentac_jit_goto(lower, OPENTAC_JIT_CC_P, label);
+    }
+    opentac_jit_goto(lower, cond.cc, label);
+}
+
+// whether the interval is live before `pos` and still needed after it; a
+// value defined there is written after the call
+static bool opentac_jit_live_across(const struct OpentacJitLive *live, OpentacLifetime pos) {
+    for (size_t r = 0; r < live->nranges; r++) {
+        OpentacLifetime start = live->ranges[r].start - (r == 0 && live->entered);
+        OpentacLifetime end = live->ranges[r].end + (r == live->nranges - 1 && live->handed);
+        if (start < pos && end > pos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// saves or restores the caller-saved registers still needed after a call
+// at statement `i`; the value the call defines never is, even where a
+// piece of its interval ends or starts at the call
+static void opentac_jit_preserve(struct OpentacJitLower *lower, size_t i, bool restore) {
+    OpentacRegister def;
+    size_t target = opentac_stmt_def(lower->fn->stmts + i, &def) ? opentac_liveness_index(lower->fn, def) : SIZE_MAX;
+    for (size_t k = 0; k < lower->nlive; k++) {
+        const struct OpentacJitLive *live = lower->live + k;
+        if (live->index == target || !opentac_jit_live_across(live, lower->base + i)) {
+            continue;
+        }
+        struct OpentacJitRm slot = opentac_jit_m(OPENTAC_JIT_RBP, OPENTAC_JIT_NONE, 1, lower->saves[live->reg]);
+        if (live->reg >= OPENTAC_JIT_XMM0) {
+            // movq xmm, m64 and movq m64, xmm
+            opentac_jit_op(lower->code, restore ? 0xf3 : 0x66, false, restore ? 0x0f7e : 0x0fd6, live->reg - OPENTAC_JIT_XMM0, slot, false);
+        } else {
+            opentac_jit_op(lower->code, 0, true, restore ? 0x8b : 0x89, live->reg, slot, false);
+        }
+    }
+}
+
+static void opentac_jit_epilogue(struct OpentacJitLower *lower) {
+    struct OpentacJitCode *code = lower->code;
+    for (int reg = 0; reg < 16; reg++) {
+        if (lower->used & OPENTAC_JIT_CALLEE_SAVED & OPENTAC_JIT_BIT(reg)) {
+            opentac_jit_op(code, 0, true, 0x8b, reg, opentac_jit_m(OPENTAC_JIT_RBP, OPENTAC_JIT_NONE, 1, lower->saves[reg]), false);
+        }
+    }
+    // leave; ret
+    opentac_jit_byte(code, 0xc9);
+    opentac_jit_byte(code, 0xc3);
+}
+
+// returns with the value both in rax and xmm0, so callers that guess its
+// type wrong still find it
+static void opentac_jit_return(struct OpentacJitLower *lower, struct OpentacJitLoc value) {
+    opentac_jit_load(lower, OPENTAC_JIT_RAX, value);
+    opentac_jit_to_xmm(lower->code, OPENTAC_JIT_F64, 0, OPENTAC_JIT_RAX);
+    opentac_jit_epilogue(lower);
+}
+
+static void opentac_jit_divide(struct OpentacJitLower *lower, const OpentacStmt *stmt, size_t t, int kind) {
+    struct OpentacJitCode *code = lower->code;
+    bool mod = stmt->tag.opcode == OPENTAC_OP_MOD;
+    opentac_jit_load(lower, OPENTAC_JIT_R11, opentac_jit_operand(lower, stmt->tag.right, stmt->right));
+    opentac_jit_load(lower, OPENTAC_JIT_R10, opentac_jit_operand(lower, stmt->tag.left, stmt->left));
+    bool rax = lower->used & OPENTAC_JIT_BIT(OPENTAC_JIT_RAX);
+    bool rdx = lower->used & OPENTAC_JIT_BIT(OPENTAC_JIT_RDX);
+    if (rax) {
+        opentac_jit_push(code, OPENTAC_JIT_RAX);
+    }
+    if (rdx) {
+        opentac_jit_push(code, OPENTAC_JIT_RDX);
+    }
+    opentac_jit_mov(code, OPENTAC_JIT_RAX, OPENTAC_JIT_R10);
+    if (kind <= OPENTAC_JIT_I64) {
+        // the one quotient that does not fit wraps around instead of trapping
+        opentac_jit_op(code, 0, true, 0x83, OPENTAC_JIT_CMP, opentac_jit_r(OPENTAC_JIT_R11), false);
+        opentac_jit_byte(code, 0xff);
+        size_t divide = opentac_jit_jcc8(code, OPENTAC_JIT_CC_NE);
+        if (mod) {
+            opentac_jit_imm(code, OPENTAC_JIT_RAX, 0);
+        } else {
+            opentac_jit_op(code, 0, true, 0xf7, 3, opentac_jit_r(OPENTAC_JIT_RAX), false);
+        }
+        size_t done = opentac_jit_jmp8(code);
+        opentac_jit_patch8(code, divide);
+        // cqo; idiv r11
+        opentac_jit_byte(code, 0x48);
+        opentac_jit_byte(code, 0x99);
+        opentac_jit_op(code, 0, true, 0xf7, 7, opentac_jit_r(OPENTAC_JIT_R11), false);
+        if (mod) {
+            opentac_jit_mov(code, OPENTAC_JIT_RAX, OPENTAC_JIT_RDX);
+        }
+        opentac_jit_patch8(code, done);
+    } else {
+        opentac_jit_imm(code, OPENTAC_JIT_RDX, 0);
+        opentac_jit_op(code, 0, true, 0xf7, 6, opentac_jit_r(OPENTAC_JIT_R11), false);
+        if (mod) {
+            opentac_jit_mov(code, OPENTAC_JIT_RAX, OPENTAC_JIT_RDX);
+        }
+    }
+    opentac_jit_mov(code, OPENTAC_JIT_R10, OPENTAC_JIT_RAX);
+    if (rdx) {
+        opentac_jit_pop(code, OPENTAC_JIT_RDX);
+    }
+    if (rax) {
+        opentac_jit_pop(code, OPENTAC_JIT_RAX);
+    }
+    opentac_jit_norm(code, kind, OPENTAC_JIT_R10);
+    opentac_jit_store(lower, t, OPENTAC_JIT_R10);
+}
+
+static void opentac_jit_shift(struct OpentacJitLower *lower, const OpentacStmt *stmt, size_t t, int kind) {
+    // rol, ror, shl, shr and sar
+    static const int exts[] = { 4, 5, 0, 1 };
+    struct OpentacJitCode *code = lower->code;
+    int opcode = stmt->tag.opcode;
+    // shifting floats is not meaningful, they shift their bits
+    if (opentac_jit_float(kind)) {
+        kind = OPENTAC_JIT_U64;
+    }
+    int ext = exts[opcode - OPENTAC_OP_SHL];
+    if (opcode == OPENTAC_OP_SHR && kind <= OPENTAC_JIT_I64) {
+        ext = 7;
+    }
+    opentac_jit_load(lower, OPENTAC_JIT_R11, opentac_jit_operand(lower, stmt->tag.right, stmt->right));
+    opentac_jit_load(lower, OPENTAC_JIT_R10, opentac_jit_operand(lower, stmt->tag.left, stmt->left));
+    if (ext == 7) {
+        // shifting by the width or more leaves only the sign
+        opentac_jit_op(code, 0, true, 0x83, OPENTAC_JIT_CMP, opentac_jit_r(OPENTAC_JIT_R11), false);
+        opentac_jit_byte(code, 63);
+        size_t skip = opentac_jit_jcc8(code, OPENTAC_JIT_CC_BE);
+        opentac_jit_imm(code, OPENTAC_JIT_R11, 63);
+        opentac_jit_patch8(code, skip);
+    }
+
+    bool rcx = lower->used & OPENTAC_JIT_BIT(OPENTAC_JIT_RCX);
+    if (rcx) {
+        opentac_jit_push(code, OPENTAC_JIT_RCX);
+    }
+    opentac_jit_op(code, 0, false, 0x8b, OPENTAC_JIT_RCX, opentac_jit_r(OPENTAC_JIT_R11), false);
+    struct OpentacJitRm rm = opentac_jit_r(OPENTAC_JIT_R10);
+    if (opcode == OPENTAC_OP_SHL || opcode == OPENTAC_OP_SHR) {
+        opentac_jit_op(code, 0, true, 0xd3, ext, rm, false);
+    } else {
+        // rotates go around the width of the type
+        switch (kind % 4) {
+        case 0:
+            opentac_jit_op(code, 0, false, 0xd2, ext, rm, true);
+            break;
+        case 1:
+            opentac_jit_op(code, 0x66, false, 0xd3, ext, rm, false);
+            break;
+        case 2:
+            opentac_jit_op(code, 0, false, 0xd3, ext, rm, false);
+            break;
+        default:
+            opentac_jit_op(code, 0, true, 0xd3, ext, rm, false);
+            break;
+        }
+    }
+    if (rcx) {
+        opentac_jit_pop(code, OPENTAC_JIT_RCX);
+    }
+    if (ext == 4 || ext == 5) {
+        // the hardware takes the count modulo 64, shifting everything out
+        // is up to us
+        opentac_jit_op(code, 0, true, 0x83, OPENTAC_JIT_CMP, opentac_jit_r(OPENTAC_JIT_R11), false);
+        opentac_jit_byte(code, 64);
+        size_t skip = opentac_jit_jcc8(code, OPENTAC_JIT_CC_B);
+        opentac_jit_imm(code, OPENTAC_JIT_R10, 0);
+        opentac_jit_patch8(code, skip);
+    }
+    opentac_jit_norm(code, kind, OPENTAC_JIT_R10);
+    opentac_jit_store(lower, t, OPENTAC_JIT_R10);
+}
+
+// calls `target`, the address of a C function, with the first two
+// floating point arguments already in xmm0 and xmm1 and the result left in
+// xmm0, which is never allocated
+static void opentac_jit_libcall(struct OpentacJitLower *lower, size_t i, void *target) {
+    struct OpentacJitCode *code = lower->code;
+    opentac_jit_preserve(lower, i, false);
+    opentac_jit_imm(code, OPENTAC_JIT_R11, (uint64_t) (uintptr_t) target);
+    opentac_jit_op(code, 0, false, 0xff, 2, opentac_jit_r(OPENTAC_JIT_R11), false);
+    opentac_jit_preserve(lower, i, true);
+}
+
+static void opentac_jit_arith(struct OpentacJitLower *lower, const OpentacStmt *stmt, size_t i, size_t t) {
+    struct OpentacJitCode *code = lower->code;
+    int opcode = stmt->tag.opcode;
+    int kind = opentac_jit_kind(lower->types[t]);
+    struct OpentacJitLoc left = opentac_jit_operand(lower, stmt->tag.left, stmt->left);
+    struct OpentacJitLoc right = opentac_jit_operand(lower, stmt->tag.right, stmt->right);
+
+    if (opentac_jit_float(kind)) {
+        // addss, mulss, subss and divss, with f2 instead of f3 for doubles
+        static const uint32_t ops[] = { 0x0f58, 0x0f5c, 0x0f59, 0x0f5e };
+        // the right operand is used where it is, unless fmod needs it in xmm1
+        int r = 1;
+        if (opcode == OPENTAC_OP_MOD) {
+            opentac_jit_xmm_load(lower, kind, 1, right, OPENTAC_JIT_R11);
+        } else {
+            r = opentac_jit_xmm(lower, kind, right, 1, OPENTAC_JIT_R11);
+        }
+        opentac_jit_xmm_load(lower, kind, 0, left, OPENTAC_JIT_R10);
+        if (opcode == OPENTAC_OP_MOD) {
+            void *target = kind == OPENTAC_JIT_F64 ? (void *) (uintptr_t) fmod : (void *) (uintptr_t) fmodf;
+            opentac_jit_libcall(lower, i, target);
+        } else {
+            opentac_jit_op(code, kind == OPENTAC_JIT_F64 ? 0xf2 : 0xf3, false, ops[opcode - OPENTAC_OP_ADD], 0, opentac_jit_r(r), false);
+        }
+        opentac_jit_xmm_store(lower, t, 0);
+        return;
+    }
+    if (opcode == OPENTAC_OP_DIV || opcode == OPENTAC_OP_MOD) {
+        opentac_jit_divide(lower, stmt, t, kind);
+        return;
+    }
+
+    int work = opentac_jit_work(lower, t, right);
+    opentac_jit_load(lower, work, left);
+    switch (opcode) {
+    case OPENTAC_OP_ADD:
+        opentac_jit_alu(lower, OPENTAC_JIT_ADD, work, right);
+        break;
+    case OPENTAC_OP_SUB:
+        opentac_jit_alu(lower, OPENTAC_JIT_SUB, work, right);
+        break;
+    case OPENTAC_OP_MUL:
+        opentac_jit_imul(lower, work, right);
+        break;
+    case OPENTAC_OP_BITAND:
+        opentac_jit_alu(lower, OPENTAC_JIT_AND, work, right);
+        break;
+    case OPENTAC_OP_BITXOR:
+        opentac_jit_alu(lower, OPENTAC_JIT_XOR, work, right);
+        break;
+    case OPENTAC_OP_BITOR:
+        opentac_jit_alu(lower, OPENTAC_JIT_OR, work, right);
+        break;
+    }
+    // bitwise operations keep the operands' extension
+    if (opcode >= OPENTAC_OP_ADD) {
+        opentac_jit_norm(code, kind, work);
+    }
+    opentac_jit_store(lower, t, work);
+}
+
+static void opentac_jit_call(struct OpentacJitLower *lower, const OpentacStmt *stmt, size_t i, size_t t) {
+    struct OpentacJitCode *code = lower->code;
+    size_t n = stmt->right.ui64val;
+    opentac_assertf(n <= lower->npending, "call in %s takes %zu arguments but only %zu were pushed before it", lower->fn->name->data, n, lower->npending);
+    size_t first = lower->npending - n;
+    struct OpentacJitLoc callee = opentac_jit_operand(lower, stmt->tag.left, stmt->left);
+
+    // arguments are classified by the parameters of the callee where it is
+    // known, and by what was pushed otherwise
+    const OpentacFnBuilder *target = NULL;
+    if (callee.tag == OPENTAC_JIT_LOC_FN) {
+        target = &opentac_builder_find(lower->jit->builder, stmt->left.name, OPENTAC_ITEM_FN)->fn;
+        if (target->params.len != n) {
+            target = NULL;
+        }
+    }
+
+    opentac_jit_preserve(lower, i, false);
+    if (callee.tag != OPENTAC_JIT_LOC_FN) {
+        opentac_jit_load(lower, OPENTAC_JIT_R11, callee);
+    }
+    size_t ngp = 0;
+    size_t nxmm = 0;
+    size_t nstack = 0;
+    for (size_t k = 0; k < n; k++) {
+        int kind = target ? opentac_jit_kind(target->params.params[k]) : lower->pending_kinds[first + k];
+        struct OpentacJitRm slot = opentac_jit_m(OPENTAC_JIT_RBP, OPENTAC_JIT_NONE, 1, lower->pending[first + k]);
+        if (opentac_jit_float(kind) ? nxmm < OPENTAC_JIT_FLOAT_ARGS : ngp < OPENTAC_JIT_INT_ARGS) {
+            if (opentac_jit_float(kind)) {
+                // movq xmm, m64
+                opentac_jit_op(code, 0xf3, false, 0x0f7e, nxmm++, slot, false);
+            } else {
+                opentac_jit_op(code, 0, true, 0x8b, opentac_jit_args[ngp++], slot, false);
+            }
+            continue;
+        }
+        opentac_jit_op(code, 0, true, 0x8b, OPENTAC_JIT_R10, slot, false);
+        opentac_jit_op(code, 0, true, 0x89, OPENTAC_JIT_R10, opentac_jit_m(OPENTAC_JIT_RSP, OPENTAC_JIT_NONE, 1, (int32_t) (8 * nstack++)), false);
+    }
+    // the number of vector registers used, for variadic callees
+    opentac_jit_imm(code, OPENTAC_JIT_RAX, nxmm);
+
+    if (callee.tag == OPENTAC_JIT_LOC_FN) {
+        opentac_jit_byte(code, 0xe8);
+        opentac_jit_u32(code, 0);
+        opentac_jit_fixup(&lower->jit->arena, lower->calls, code->len - 4, callee.imm);
+    } else {
+        opentac_jit_op(code, 0, false, 0xff, 2, opentac_jit_r(OPENTAC_JIT_R11), false);
+    }
+
+    // the result is never among the registers restored, so with a
+    // register of its own it is taken straight from rax
+    int kind = opentac_jit_kind(lower->types[t]);
+    lower->npending = first;
+    if (opentac_jit_float(kind)) {
+        opentac_jit_preserve(lower, i, true);
+        opentac_jit_xmm_store(lower, t, 0);
+        return;
+    }
+    int work = opentac_jit_work(lower, t, (struct OpentacJitLoc) { .tag = OPENTAC_JIT_LOC_IMM });
+    opentac_jit_mov(code, work, OPENTAC_JIT_RAX);
+    opentac_jit_preserve(lower, i, true);
+    opentac_jit_norm(code, kind, work);
+    opentac_jit_store(lower, t, work);
+}
+
+// loads the label number in `value` and jumps through the function's table
+// of label offsets, trapping on labels that were never placed
+static void opentac_jit_indirect(struct OpentacJitLower *lower, struct OpentacJitLoc value) {
+    struct OpentacJitCode *code = lower->code;
+    struct OpentacArena *arena = &lower->jit->arena;
+    opentac_jit_load(lower, OPENTAC_JIT_R10, value);
+    opentac_jit_alu(lower, OPENTAC_JIT_CMP, OPENTAC_JIT_R10, (struct OpentacJitLoc) { .tag = OPENTAC_JIT_LOC_IMM, .imm = lower->fn->label });
+    opentac_jit_byte(code, 0x0f);
+    opentac_jit_byte(code, 0x80 + OPENTAC_JIT_CC_AE);
+    opentac_jit_u32(code, 0);
+    opentac_jit_fixup(arena, &lower->traps, code->len - 4, 0);
+    // edges needing moves go through stubs of a table of the branch's own
+    const struct OpentacBlock *block = lower->fn->cfg.blocks + lower->block;
+    size_t site = 0;
+    for (size_t k = 0; k < block->nsucc && !site; k++) {
+        size_t first;
+        if (opentac_jit_edge(lower, lower->block, lower->fn->cfg.succs[block->succ + k], &first)) {
+            site = lower->block + 1;
+        }
+    }
+    opentac_jit_op(code, 0, true, 0x8d, OPENTAC_JIT_R11, opentac_jit_m(OPENTAC_JIT_RIP, OPENTAC_JIT_NONE, 1, 0), false);
+    opentac_jit_fixup(arena, &lower->tables, code->len - 4, site);
+    opentac_jit_op(code, 0, true, 0x63, OPENTAC_JIT_R10, opentac_jit_m(OPENTAC_JIT_R11, OPENTAC_JIT_R10, 4, 0), false);
+    opentac_jit_op(code, 0, true, 0x03, OPENTAC_JIT_R10, opentac_jit_r(OPENTAC_JIT_R11), false);
+    opentac_jit_op(code, 0, false, 0xff, 4, opentac_jit_r(OPENTAC_JIT_R10), false);
+}
+
+// c := lt a, b; if ne c, false branch L
+static bool opentac_jit_fused(const struct OpentacJitLower *lower, const OpentacStmt *stmt, const OpentacStmt *next) {
+    int opcode = stmt->tag.opcode;
+    if (opcode < OPENTAC_OP_LT || opcode > OPENTAC_OP_GE || !next || opentac_jit_float(opentac_jit_operand_kind(lower, stmt->tag.left, stmt->left))) {
+        return false;
+    }
+    int relop = next->tag.opcode & ~OPENTAC_OP_BRANCH;
+    return (next->tag.opcode & OPENTAC_OP_BRANCH) == OPENTAC_OP_BRANCH
+        && (relop == OPENTAC_OP_EQ || relop == OPENTAC_OP_NE)
+        && next->tag.left == OPENTAC_VAL_REG && next->left.regval == stmt->target
+        && next->tag.right == OPENTAC_VAL_BOOL;
+}
+
+// compiles `stmt`, or it and the one after it, and returns how many
+// statements it took
+static size_t opentac_jit_stmt(struct OpentacJitLower *lower, size_t i) {
+    struct OpentacJitCode *code = lower->code;
+    OpentacFnBuilder *fn = lower->fn;
+    const OpentacStmt *stmt = fn->stmts + i;
+    const OpentacStmt *next = i + 1 < fn->len ? stmt + 1 : NULL;
+    int opcode = stmt->tag.opcode;
+    size_t t = 0;
+    OpentacRegister reg;
+    if (opentac_stmt_def(stmt, &reg)) {
+        t = opentac_liveness_index(fn, reg);
+    }
+
+    if ((opcode & OPENTAC_OP_BRANCH) == OPENTAC_OP_BRANCH) {
+        int relop = opcode & ~OPENTAC_OP_BRANCH;
+        if (relop == OPENTAC_OP_NOP) {
+            if (stmt->tag.left == OPENTAC_VAL_ERROR) {
+                opentac_jit_goto(lower, -1, stmt->label);
+            } else {
+                opentac_jit_indirect(lower, opentac_jit_operand(lower, stmt->tag.left, stmt->left));
+            }
+            return 1;
+        }
+        int kind = opentac_jit_operand_kind(lower, stmt->tag.left, stmt->left);
+        struct OpentacJitLoc left = opentac_jit_operand(lower, stmt->tag.left, stmt->left);
+        struct OpentacJitLoc right = opentac_jit_operand(lower, stmt->tag.right, stmt->right);
+        opentac_jit_jcc(lower, opentac_jit_compare(lower, relop, kind, left, right), stmt->label);
+        return 1;
+    }
+
+    switch (opcode) {
+    case OPENTAC_OP_NOP:
+        return 1;
+    case OPENTAC_OP_LABEL:
+        lower->labels[stmt->label] = code->len;
+        return 1;
+    case OPENTAC_OP_LT:
+    case OPENTAC_OP_LE:
+    case OPENTAC_OP_EQ:
+    case OPENTAC_OP_NE:
+    case OPENTAC_OP_GT:
+    case OPENTAC_OP_GE: {
+        int kind = opentac_jit_operand_kind(lower, stmt->tag.left, stmt->left);
+        struct OpentacJitLoc left = opentac_jit_operand(lower, stmt->tag.left, stmt->left);
+        struct OpentacJitLoc right = opentac_jit_operand(lower, stmt->tag.right, stmt->right);
+        struct OpentacJitCond cond = opentac_jit_compare(lower, opcode, kind, left, right);
+        int work = opentac_jit_work(lower, t, (struct OpentacJitLoc) { .tag = OPENTAC_JIT_LOC_IMM });
+        // setcc, movzx and mov leave the flags alone for the branch
+        opentac_jit_setcc(code, cond, work);
+        opentac_jit_store(lower, t, work);
+        if (opentac_jit_fused(lower, stmt, next)) {
+            // moves leave the flags alone too
+            opentac_jit_advance(lower, i + 1);
+            bool taken = ((next->tag.opcode & ~OPENTAC_OP_BRANCH) == OPENTAC_OP_NE) != next->right.bval;
+            opentac_jit_jcc(lower, taken ? cond : opentac_jit_negate(cond), next->label);
+            return 2;
+        }
+        return 1;
+    }
+    case OPENTAC_OP_BITAND:
+    case OPENTAC_OP_BITXOR:
+    case OPENTAC_OP_BITOR:
+    case OPENTAC_OP_ADD:
+    case OPENTAC_OP_SUB:
+    case OPENTAC_OP_MUL:
+    case OPENTAC_OP_DIV:
+    case OPENTAC_OP_MOD:
+        opentac_jit_arith(lower, stmt, i, t);
+        return 1;
+    case OPENTAC_OP_SHL:
+    case OPENTAC_OP_SHR:
+    case OPENTAC_OP_ROL:
+    case OPENTAC_OP_ROR:
+        opentac_jit_shift(lower, stmt, t, opentac_jit_kind(lower->types[t]));
+        return 1;
+    case OPENTAC_OP_NOT:
+    case OPENTAC_OP_NEG: {
+        int kind = opentac_jit_kind(lower->types[t]);
+        struct OpentacJitLoc left = opentac_jit_operand(lower, stmt->tag.left, stmt->left);
+        int work = opentac_jit_work(lower, t, (struct OpentacJitLoc) { .tag = OPENTAC_JIT_LOC_IMM });
+        opentac_jit_load(lower, work, left);
+        if (opcode == OPENTAC_OP_NOT && opentac_jit_bool(lower, stmt->tag.left, stmt->left)) {
+            // test; sete
+            opentac_jit_op(code, 0, true, 0x85, work, opentac_jit_r(work), false);
+            opentac_jit_setcc(code, (struct OpentacJitCond) { .cc = OPENTAC_JIT_CC_E }, work);
+        } else if (opcode == OPENTAC_OP_NEG && opentac_jit_float(kind)) {
+            // btc flips the sign bit
+            opentac_jit_op(code, 0, kind == OPENTAC_JIT_F64, 0x0fba, 7, opentac_jit_r(work), false);
+            opentac_jit_byte(code, kind == OPENTAC_JIT_F64 ? 63 : 31);
+        } else {
+            opentac_jit_op(code, 0, true, 0xf7, opcode == OPENTAC_OP_NOT ? 2 : 3, opentac_jit_r(work), false);
+            opentac_jit_norm(code, kind, work);
+        }
+        opentac_jit_store(lower, t, work);
+        return 1;
+    }
+    case OPENTAC_OP_COPY:
+        opentac_jit_move(lower, t, opentac_jit_operand(lower, stmt->tag.left, stmt->left));
+        return 1;
+    case OPENTAC_OP_REF:
+        if (stmt->tag.left == OPENTAC_VAL_NAMED) {
+            // the name already is the address
+            opentac_jit_move(lower, t, opentac_jit_operand(lower, stmt->tag.left, stmt->left));
+        } else {
+            struct OpentacJitLoc home = opentac_jit_operand(lower, stmt->tag.left, stmt->left);
+            opentac_jit_op(code, 0, true, 0x8d, OPENTAC_JIT_R10, opentac_jit_m(OPENTAC_JIT_RBP, OPENTAC_JIT_NONE, 1, home.disp), false);
+            opentac_jit_store(lower, t, OPENTAC_JIT_R10);
+        }
+        return 1;
+    case OPENTAC_OP_DEREF:
+    case OPENTAC_OP_ASSIGN_INDEX: {
+        int kind = opentac_jit_kind(lower->types[t]);
+        int base = opentac_jit_reg(lower, opentac_jit_operand(lower, stmt->tag.left, stmt->left), OPENTAC_JIT_R10);
+        struct OpentacJitRm address = opentac_jit_m(base, OPENTAC_JIT_NONE, 1, 0);
+        if (opcode == OPENTAC_OP_ASSIGN_INDEX) {
+            struct OpentacJitLoc offset = opentac_jit_operand(lower, stmt->tag.right, stmt->right);
+            if (opentac_jit_imm32(offset)) {
+                address.disp = (int32_t) offset.imm;
+            } else {
+                address.index = opentac_jit_reg(lower, offset, OPENTAC_JIT_R11);
+            }
+        }
+        int work = opentac_jit_work(lower, t, (struct OpentacJitLoc) { .tag = OPENTAC_JIT_LOC_IMM });
+        opentac_jit_load_kind(code, kind, work, address);
+        opentac_jit_store(lower, t, work);
+        return 1;
+    }
+    case OPENTAC_OP_INDEX_ASSIGN: {
+        int kind = opentac_jit_operand_kind(lower, stmt->tag.right, stmt->right);
+        OpentacVal target = { .regval = stmt->target };
+        struct OpentacJitLoc base = opentac_jit_operand(lower, OPENTAC_VAL_REG, target);
+        struct OpentacJitLoc offset = opentac_jit_operand(lower, stmt->tag.left, stmt->left);
+        struct OpentacJitLoc value = opentac_jit_operand(lower, stmt->tag.right, stmt->right);
+        struct OpentacJitRm address;
+        if (opentac_jit_imm32(offset)) {
+            address = opentac_jit_m(opentac_jit_reg(lower, base, OPENTAC_JIT_R10), OPENTAC_JIT_NONE, 1, (int32_t) offset.imm);
+        } else if (value.tag == OPENTAC_JIT_LOC_REG || opentac_jit_imm32(value)) {
+            int reg = opentac_jit_reg(lower, base, OPENTAC_JIT_R10);
+            address = opentac_jit_m(reg, opentac_jit_reg(lower, offset, OPENTAC_JIT_R11), 1, 0);
+        } else {
+            // both scratch registers are taken by the address and the value
+            opentac_jit_load(lower, OPENTAC_JIT_R10, base);
+            opentac_jit_alu(lower, OPENTAC_JIT_ADD, OPENTAC_JIT_R10, offset);
+            address = opentac_jit_m(OPENTAC_JIT_R10, OPENTAC_JIT_NONE, 1, 0);
+        }
+        if (opentac_jit_imm32(value) && kind != OPENTAC_JIT_I64 && kind != OPENTAC_JIT_U64 && kind != OPENTAC_JIT_F64) {
+            // mov m, imm of the width of the store
+            bool narrow = kind % 4 == 0;
+            opentac_jit_op(code, kind % 4 == 1 ? 0x66 : 0, false, narrow ? 0xc6 : 0xc7, 0, address, false);
+            if (narrow) {
+                opentac_jit_byte(code, (uint8_t) value.imm);
+            } else if (kind % 4 == 1) {
+                opentac_jit_byte(code, (uint8_t) value.imm);
+                opentac_jit_byte(code, (uint8_t) (value.imm >> 8));
+            } else {
+                opentac_jit_u32(code, (uint32_t) value.imm);
+            }
+        } else {
+            opentac_jit_store_width(code, kind, opentac_jit_reg(lower, value, OPENTAC_JIT_R11), address);
+        }
+        return 1;
+    }
+    case OPENTAC_OP_PARAM: {
+        struct OpentacJitLoc value = opentac_jit_operand(lower, stmt->tag.left, stmt->left);
+        struct OpentacJitRm slot = opentac_jit_m(OPENTAC_JIT_RBP, OPENTAC_JIT_NONE, 1, lower->pending[lower->npending]);
+        opentac_jit_op(code, 0, true, 0x89, opentac_jit_reg(lower, value, OPENTAC_JIT_R10), slot, false);
+        lower->pending_kinds[lower->npending++] = opentac_jit_operand_kind(lower, stmt->tag.left, stmt->left);
+        return 1;
+    }
+    case OPENTAC_OP_CALL:
+        opentac_jit_call(lower, stmt, i, t);
+        return 1;
+    case OPENTAC_OP_RETURN:
+        opentac_jit_return(lower, opentac_jit_operand(lower, stmt->tag.left, stmt->left));
+        return 1;
+    }
+
+    opentac_assertf(false, "cannot compile opcode %#x", (unsigned) opcode);
+    return 1;
+}
+
+static int opentac_jit_event_cmp(const void *a, const void *b) {
+    const struct OpentacJitEvent *x = a;
+    const struct OpentacJitEvent *y = b;
+    return x->pos < y->pos ? -1 : x->pos > y->pos;
+}
+
+// lays the frame out below rbp: spill slots where the allocator put them,
+// then saved registers, registers whose address is taken, incoming
+// parameters and pushed arguments, with outgoing stack arguments at the
+// bottom
+static void opentac_jit_frame(struct OpentacJitLower *lower, const struct OpentacFnAlloc *alloc, bool *refd) {
+    OpentacFnBuilder *fn = lower->fn;
+    struct OpentacArena *arena = &lower->jit->arena;
+    size_t nregs = (size_t) fn->reg + (size_t) -fn->param;
+    lower->locs = opentac_arena_alloc(arena, (nregs ? nregs : 1) * sizeof(struct OpentacJitLoc));
+    bool *placed = opentac_arena_calloc(arena, nregs ? nregs : 1, sizeof(bool));
+
+    // a split register starts out where its first piece is, which comes
+    // before the others in the table, and the others become events
+    uint64_t size = 0;
+    lower->events = opentac_arena_alloc(arena, (alloc->table.len ? alloc->table.len : 1) * sizeof(struct OpentacJitEvent));
+    lower->nevents = 0;
+    for (size_t k = 0; k < alloc->table.len; k++) {
+        const struct OpentacRegEntry *entry = alloc->table.entries + k;
+        size_t index = opentac_liveness_index(fn, entry->reg);
+        struct OpentacJitLoc loc = opentac_jit_place(entry->purpose);
+        if (loc.tag == OPENTAC_JIT_LOC_MEM) {
+            size = entry->purpose.stack > size ? entry->purpose.stack : size;
+        } else {
+            lower->used |= OPENTAC_JIT_BIT(loc.tag == OPENTAC_JIT_LOC_XMM ? OPENTAC_JIT_XMM0 + loc.reg : loc.reg);
+        }
+        if (!placed[index]) {
+            lower->locs[index] = loc;
+        } else if (!refd[index]) {
+            loc.kind = opentac_jit_kind(lower->types[index]);
+            opentac_assertf(loc.tag != OPENTAC_JIT_LOC_XMM || opentac_jit_float(loc.kind), "an xmm register of %s holds something other than a float", fn->name->data);
+            lower->events[lower->nevents++] = (struct OpentacJitEvent) { .pos = entry->start, .index = index, .loc = loc };
+        }
+        placed[index] = true;
+    }
+    qsort(lower->events, lower->nevents, sizeof(struct OpentacJitEvent), opentac_jit_event_cmp);
+
+    // spill slots may be narrower than a word, everything below them is not
+    size = (size + 7) & ~(uint64_t) 7;
+    for (int reg = 0; reg < 32; reg++) {
+        if (lower->used & OPENTAC_JIT_BIT(reg)) {
+            size += 8;
+            lower->saves[reg] = -(int32_t) size;
+        }
+    }
+    for (size_t index = 0; index < nregs; index++) {
+        if (refd[index] || !placed[index]) {
+            size += 8;
+            lower->locs[index] = (struct OpentacJitLoc) { .tag = OPENTAC_JIT_LOC_MEM, .disp = -(int32_t) size };
+        }
+        lower->locs[index].refd = refd[index];
+        lower->locs[index].kind = opentac_jit_kind(lower->types[index]);
+        opentac_assertf(lower->locs[index].tag != OPENTAC_JIT_LOC_XMM || opentac_jit_float(lower->locs[index].kind), "an xmm register of %s holds something other than a float", fn->name->data);
+    }
+
+    lower->incoming = opentac_arena_alloc(arena, (fn->params.len ? fn->params.len : 1) * sizeof(int32_t));
+    for (size_t k = 0; k < fn->params.len; k++) {
+        size += 8;
+        lower->incoming[k] = -(int32_t) size;
+    }
+
+    // how many arguments are pushed at once, and the most one call takes
+    size_t npending = 0;
+    size_t maxpending = 0;
+    size_t maxargs = 0;
+    for (size_t i = 0; i < fn->len; i++) {
+        if (fn->stmts[i].tag.opcode == OPENTAC_OP_PARAM && ++npending > maxpending) {
+            maxpending = npending;
+        }
+        if (fn->stmts[i].tag.opcode == OPENTAC_OP_CALL) {
+            size_t n = fn->stmts[i].right.ui64val;
+            npending = n < npending ? npending - n : 0;
+            maxargs = n > maxargs ? n : maxargs;
+        }
+    }
+    lower->pending = opentac_arena_alloc(arena, (maxpending ? maxpending : 1) * sizeof(int32_t));
+    lower->pending_kinds = opentac_arena_alloc(arena, (maxpending ? maxpending : 1) * sizeof(int));
+    for (size_t k = 0; k < maxpending; k++) {
+        size += 8;
+        lower->pending[k] = -(int32_t) size;
+    }
+
+    size += 8 * maxargs;
+    size = (size + 15) & ~(uint64_t) 15;
+    opentac_assertf(size <= INT32_MAX, "frame of %s is too large", fn->name->data);
+    lower->frame = (int32_t) size;
+
+    // the intervals that calls have to save and restore
+    lower->base = alloc->alloc.base - fn->len;
+    const struct OpentacIntervals *live = &alloc->alloc.live;
+    bool *entered = opentac_arena_calloc(arena, live->len ? live->len : 1, sizeof(bool));
+    for (size_t k = 0; k < live->len; k++) {
+        const struct OpentacInterval *interval = live->intervals + k;
+        if (interval->next && interval->end + 1 == live->intervals[interval->next].start) {
+            entered[interval->next] = true;
+        }
+    }
+    lower->live = opentac_arena_alloc(arena, (live->len ? live->len : 1) * sizeof(struct OpentacJitLive));
+    lower->nlive = 0;
+    for (size_t k = 0; k < live->len; k++) {
+        const struct OpentacInterval *interval = live->intervals + k;
+        if (interval->purpose.tag != OPENTAC_REG_ALLOCATED || refd[opentac_liveness_index(fn, interval->reg)]) {
+            continue;
+        }
+        int reg = opentac_jit_mreg(interval->purpose.reg.name);
+        if (!(OPENTAC_JIT_CALLEE_SAVED & OPENTAC_JIT_BIT(reg))) {
+            lower->live[lower->nlive++] = (struct OpentacJitLive) {
+                .reg = reg,
+                .index = opentac_liveness_index(fn, interval->reg),
+                .nranges = interval->nranges,
+                .ranges = interval->ranges,
+                .entered = entered[k],
+                .handed = interval->next && interval->end + 1 == live->intervals[interval->next].start,
+            };
+        }
+    }
+}
+
+static void opentac_jit_prologue(struct OpentacJitLower *lower) {
+    struct OpentacJitCode *code = lower->code;
+    OpentacFnBuilder *fn = lower->fn;
+    // push rbp; mov rbp, rsp; sub rsp, frame
+    opentac_jit_push(code, OPENTAC_JIT_RBP);
+    opentac_jit_op(code, 0, true, 0x89, OPENTAC_JIT_RSP, opentac_jit_r(OPENTAC_JIT_RBP), false);
+    opentac_jit_op(code, 0, true, 0x81, OPENTAC_JIT_SUB, opentac_jit_r(OPENTAC_JIT_RSP), false);
+    opentac_jit_u32(code, (uint32_t) lower->frame);
+    for (int reg = 0; reg < 16; reg++) {
+        if (lower->used & OPENTAC_JIT_CALLEE_SAVED & OPENTAC_JIT_BIT(reg)) {
+            opentac_jit_op(code, 0, true, 0x89, reg, opentac_jit_m(OPENTAC_JIT_RBP, OPENTAC_JIT_NONE, 1, lower->saves[reg]), false);
+        }
+    }
+
+    // parameters in registers go to the frame first, since the registers
+    // they are allocated to may be the ones other parameters arrive in
+    size_t ngp = 0;
+    size_t nxmm = 0;
+    size_t nstack = 0;
+    for (size_t k = 0; k < fn->params.len; k++) {
+        int kind = opentac_jit_kind(fn->params.params[k]);
+        struct OpentacJitRm slot = opentac_jit_m(OPENTAC_JIT_RBP, OPENTAC_JIT_NONE, 1, lower->incoming[k]);
+        if (opentac_jit_float(kind) && nxmm < OPENTAC_JIT_FLOAT_ARGS) {
+            // movq m64, xmm
+            opentac_jit_op(code, 0x66, false, 0x0fd6, nxmm++, slot, false);
+        } else if (!opentac_jit_float(kind) && ngp < OPENTAC_JIT_INT_ARGS) {
+            opentac_jit_op(code, 0, true, 0x89, opentac_jit_args[ngp++], slot, false);
+        } else {
+            // above the return address and the saved rbp
+            lower->incoming[k] = (int32_t) (16 + 8 * nstack++);
+        }
+    }
+    // arguments arrive as the caller had them, so narrow parameters are
+    // brought to their own width
+    for (size_t k = 0; k < fn->params.len; k++) {
+        // a parameter that is redefined before it is read, or only read in
+        // unreachable code, may share its register or spill slot with one
+        // that is live
+        size_t index = fn->reg + k;
+        if (!lower->locs[index].refd && !(lower->entry && (lower->entry[index / 64] >> (index % 64)) & 1)) {
+            continue;
+        }
+        int kind = opentac_jit_kind(fn->params.params[k]);
+        opentac_jit_load_kind(code, kind, OPENTAC_JIT_R10, opentac_jit_m(OPENTAC_JIT_RBP, OPENTAC_JIT_NONE, 1, lower->incoming[k]));
+        opentac_jit_store(lower, index, OPENTAC_JIT_R10);
+    }
+}
+
+// lays out a table of label offsets for indirect branches; the one of the
+// branch ending block `site - 1` goes through stubs making the moves its
+// edges need, where `site` is not 0
+static size_t opentac_jit_table(struct OpentacJitLower *lower, size_t site, size_t trap) {
+    struct OpentacJitCode *code = lower->code;
+    const struct OpentacCfg *cfg = &lower->fn->cfg;
+    size_t nlabels = lower->fn->label;
+    size_t *targets = malloc((nlabels ? nlabels : 1) * sizeof(size_t));
+    opentac_assert(targets);
+    for (size_t label = 0; label < nlabels; label++) {
+        targets[label] = lower->labels[label] != SIZE_MAX ? lower->labels[label] : trap;
+        size_t first;
+        size_t len = site && lower->labels[label] != SIZE_MAX ? opentac_jit_edge(lower, site - 1, cfg->labels[label], &first) : 0;
+        if (len) {
+            targets[label] = code->len;
+            opentac_jit_parallel(lower, lower->edges->moves + first, len);
+            opentac_jit_branch(lower, -1, label);
+        }
+    }
+    while (code->len % 4) {
+        opentac_jit_byte(code, 0xcc);
+    }
+    size_t table = code->len;
+    for (size_t label = 0; label < nlabels; label++) {
+        opentac_jit_u32(code, (uint32_t) (targets[label] - table));
+    }
+    free(targets);
+    return table;
+}
+
+static void opentac_jit_function(struct OpentacJit *jit, struct OpentacJitCode *code, struct OpentacJitFixups *calls, const struct OpentacFnAlloc *alloc, struct OpentacJitFn *dest) {
+    OpentacFnBuilder *fn = alloc->fn;
+    opentac_assertf(!fn->ssa, "%s has to leave ssa form before it can be compiled", fn->name->data);
+
+    size_t nregs = (size_t) fn->reg + (size_t) -fn->param;
+    struct OpentacJitLower lower = {
+        .jit = jit,
+        .fn = fn,
+        .code = code,
+        .calls = calls,
+        .types = malloc((nregs ? nregs : 1) * sizeof(OpentacType *)),
+        .labels = malloc((fn->label ? fn->label : 1) * sizeof(size_t)),
+    };
+    bool *refd = calloc(nregs ? nregs : 1, sizeof(bool));
+    opentac_assert(lower.types && lower.labels && refd);
+    opentac_fn_infer(jit->builder, fn, lower.types);
+    for (size_t i = 0; i < fn->len; i++) {
+        if (fn->stmts[i].tag.opcode == OPENTAC_OP_REF && fn->stmts[i].tag.left == OPENTAC_VAL_REG) {
+            refd[opentac_liveness_index(fn, fn->stmts[i].left.regval)] = true;
+        }
+    }
+    for (size_t i = 0; i < fn->label; i++) {
+        lower.labels[i] = SIZE_MAX;
+    }
+    opentac_jit_frame(&lower, alloc, refd);
+    struct OpentacLiveness liveness;
+    opentac_liveness(&liveness, &jit->arena, fn);
+    lower.entry = fn->cfg.len ? liveness.live_in : NULL;
+
+    dest->name = fn->name;
+    dest->nparams = fn->params.len;
+    dest->offset = code->len;
+    lower.moves = &alloc->alloc.moves;
+    lower.edges = &alloc->alloc.edges;
+    opentac_jit_prologue(&lower);
+    for (size_t i = 0; i < fn->len;) {
+        // falling through into the next block makes the moves of that edge
+        while (lower.block + 1 < fn->cfg.len && fn->cfg.blocks[lower.block + 1].start <= i) {
+            const OpentacStmt *last = fn->stmts + fn->cfg.blocks[lower.block].end - 1;
+            size_t first;
+            size_t len = opentac_jit_edge(&lower, lower.block, lower.block + 1, &first);
+            if (len && last->tag.opcode != OPENTAC_OP_RETURN && last->tag.opcode != (OPENTAC_OP_BRANCH | OPENTAC_OP_NOP)) {
+                opentac_jit_parallel(&lower, lower.edges->moves + first, len);
+            }
+            lower.block++;
+        }
+        opentac_jit_advance(&lower, i);
+        i += opentac_jit_stmt(&lower, i);
+    }
+    // falling off the end returns zero
+    opentac_jit_return(&lower, (struct OpentacJitLoc) { .tag = OPENTAC_JIT_LOC_IMM });
+
+    for (size_t k = 0; k < lower.stubs.len; k++) {
+        const struct OpentacJitStub *stub = lower.stubs.stubs + k;
+        opentac_jit_patch(code, stub->pos, code->len);
+        opentac_jit_parallel(&lower, lower.edges->moves + stub->first, stub->len);
+        opentac_jit_branch(&lower, -1, stub->label);
+    }
+    if (lower.tables.len) {
+        // ud2
+        size_t trap = code->len;
+        opentac_jit_byte(code, 0x0f);
+        opentac_jit_byte(code, 0x0b);
+        size_t shared = SIZE_MAX;
+        for (size_t k = 0; k < lower.tables.len; k++) {
+            size_t site = lower.tables.fixups[k].target;
+            if (site || shared == SIZE_MAX) {
+                size_t table = opentac_jit_table(&lower, site, trap);
+                shared = site ? shared : table;
+                opentac_jit_patch(code, lower.tables.fixups[k].pos, table);
+            } else {
+                opentac_jit_patch(code, lower.tables.fixups[k].pos, shared);
+            }
+        }
+        for (size_t k = 0; k < lower.traps.len; k++) {
+            opentac_jit_patch(code, lower.traps.fixups[k].pos, trap);
+        }
+    }
+    for (size_t k = 0; k < lower.branches.len; k++) {
+        size_t label = lower.branches.fixups[k].target;
+        opentac_assertf(label < fn->label && lower.labels[label] != SIZE_MAX, "branch to label %zu which was never placed", label);
+        opentac_jit_patch(code, lower.branches.fixups[k].pos, lower.labels[label]);
+    }
+
+    free(lower.types);
+    free(lower.labels);
+    free(refd);
+}
+
+void opentac_jit(struct OpentacJit *jit, OpentacBuilder *builder, const struct OpentacFnAllocs *allocs) {
+    opentac_assert(jit);
+    opentac_assert(builder);
+    opentac_assert(allocs);
+
+    jit->builder = builder;
+    opentac_arena(&jit->arena);
+
+    size_t len = 0;
+    for (size_t i = 0; i < builder->len; i++) {
+        if (builder->items[i]->tag == OPENTAC_ITEM_FN) {
+            opentac_assertf(len < allocs->len && allocs->allocs[len].fn == &builder->items[i]->fn, "no allocation for %s", builder->items[i]->fn.name->data);
+            ++len;
+        }
+    }
+    jit->len = len;
+    jit->fns = opentac_arena_calloc(&jit->arena, len ? len : 1, sizeof(struct OpentacJitFn));
+
+    jit->nsymbols = 16;
+    while (jit->nsymbols < builder->len * 2) {
+        jit->nsymbols *= 2;
+    }
+    jit->symbols = opentac_arena_calloc(&jit->arena, jit->nsymbols, sizeof(struct OpentacJitSymbol));
+    len = 0;
+    for (size_t i = 0; i < builder->len; i++) {
+        if (builder->items[i]->tag == OPENTAC_ITEM_FN) {
+            opentac_jit_define(jit, builder->items[i]->fn.name, ++len, NULL);
+        }
+    }
+    for (size_t i = 0; i < builder->len; i++) {
+        const OpentacDecl *decl = &builder->items[i]->decl;
+        if (builder->items[i]->tag == OPENTAC_ITEM_DECL && decl->type->tag != OPENTAC_TYPE_FN) {
+            void *storage = opentac_arena_calloc(&jit->arena, 1, opentac_jit_sizeof(decl->type));
+            opentac_jit_define(jit, decl->name, 0, storage);
+        }
+    }
+
+    struct OpentacJitCode code = { 0 };
+    struct OpentacJitFixups calls = { 0 };
+    for (size_t k = 0; k < jit->len; k++) {
+        // functions start on a 16 byte boundary
+        while (code.len % 16) {
+            opentac_jit_byte(&code, 0xcc);
+        }
+        opentac_jit_function(jit, &code, &calls, allocs->allocs + k, jit->fns + k);
+    }
+    for (size_t k = 0; k < calls.len; k++) {
+        opentac_jit_patch(&code, calls.fixups[k].pos, jit->fns[calls.fixups[k].target].offset);
+    }
+
+    // written while writable, then only ever executable
+    jit->size = code.len ? code.len : 1;
+    void *mapping = mmap(NULL, jit->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    opentac_assert(mapping != MAP_FAILED);
+    memcpy(mapping, code.data, code.len);
+    opentac_assert(!mprotect(mapping, jit->size, PROT_READ | PROT_EXEC));
+    free(code.data);
+    jit->code = mapping;
+    for (size_t k = 0; k < jit->len; k++) {
+        jit->fns[k].entry = (void (*)(void)) (uintptr_t) (jit->code + jit->fns[k].offset);
+    }
+}
+
+void opentac_jit_destroy(struct OpentacJit *jit) {
+    opentac_assert(jit);
+
+    munmap(jit->code, jit->size);
+    opentac_arena_destroy(&jit->arena);
+}
+
+const struct OpentacJitFn *opentac_jit_fn(const struct OpentacJit *jit, const char *name) {
+    opentac_assert(jit);
+    opentac_assert(name);
+
+    for (size_t i = 0; i < jit->len; i++) {
+        if (!strcmp(jit->fns[i].name->data, name)) {
+            return jit->fns + i;
+        }
+    }
+    return NULL;
+}
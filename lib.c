@@ -1,23 +1,47 @@
 #include "include/opentac.h"
 #include "grammar.tab.h"
 
-extern FILE *yyin;
-extern OpentacBuilder *opentac_b;
+// reentrant scanner interface generated by flex
+int yylex_init_extra(OpentacParser *extra, yyscan_t *scanner);
+void yyset_in(FILE *file, yyscan_t scanner);
+int yylex_destroy(yyscan_t scanner);
 
 #define DEFAULT_BUILDER_CAP ((size_t) 32)
 #define DEFAULT_FN_CAP ((size_t) 32)
 #define DEFAULT_NAME_TABLE_CAP ((size_t) 32)
 #define DEFAULT_PARAMS_CAP ((size_t) 4)
+#define DEFAULT_INTERNER_CAP ((size_t) 256)
+
+static void opentac_builder_init(OpentacBuilder *builder, size_t cap);
+static void opentac_builder_free_cfgs(OpentacBuilder *builder);
+static void opentac_grow_fn(OpentacBuilder *builder, size_t newcap);
+static void opentac_grow_typeset_table(OpentacBuilder *builder, size_t newcap);
+static uint64_t opentac_hash_mix(uint64_t h, uint64_t v);
+static uint64_t opentac_hash_bytes(const char *data, size_t len);
 
 OpentacBuilder *opentac_parse(FILE *file) {
     opentac_assert(file);
     
-    yyin = file;
-    opentac_b = opentac_builderp();
-    if (yyparse()) {
+    OpentacBuilder *builder = opentac_builderp();
+    if (opentac_parse_ctx(builder, file)) {
+        opentac_builderp_destroy(builder);
         return NULL;
     }
-    return opentac_b;
+    return builder;
+}
+
+int opentac_parse_ctx(OpentacBuilder *builder, FILE *file) {
+    opentac_assert(builder);
+    opentac_assert(file);
+
+    OpentacParser ctx = { .builder = builder };
+    yyscan_t scanner;
+    opentac_assert(yylex_init_extra(&ctx, &scanner) == 0);
+    yyset_in(file, scanner);
+    int status = yyparse(scanner, &ctx);
+    yylex_destroy(scanner);
+
+    return status ? status : ctx.status;
 }
 
 void opentac_builder(OpentacBuilder *builder) {
@@ -30,13 +54,31 @@ void opentac_builder_with_cap(OpentacBuilder *builder, size_t cap) {
     opentac_assert(builder);
     opentac_assert(cap > 0);
     
+    opentac_arena(&builder->arena);
+    opentac_builder_init(builder, cap);
+}
+
+// (re)initializes the builder's tables inside its arena
+static void opentac_builder_init(OpentacBuilder *builder, size_t cap) {
     builder->len = 0;
     builder->cap = cap;
-    builder->items = malloc(cap * sizeof(OpentacItem *));
+    builder->items = opentac_arena_alloc(&builder->arena, cap * sizeof(OpentacItem *));
     builder->current = builder->items;
     builder->typeset.len = 0;
     builder->typeset.cap = cap;
-    builder->typeset.types = malloc(cap * sizeof(OpentacType *));
+    builder->typeset.types = opentac_arena_alloc(&builder->arena, cap * sizeof(OpentacType *));
+    builder->typeset.table_cap = 0;
+    builder->typeset.table = NULL;
+
+    size_t table_cap = 1;
+    while (table_cap < cap * 2) {
+        table_cap <<= 1;
+    }
+    opentac_grow_typeset_table(builder, table_cap);
+
+    builder->interner.len = 0;
+    builder->interner.cap = DEFAULT_INTERNER_CAP;
+    builder->interner.table = opentac_arena_calloc(&builder->arena, DEFAULT_INTERNER_CAP, sizeof(OpentacString *));
 }
 
 OpentacBuilder *opentac_builderp() {
@@ -49,13 +91,55 @@ OpentacBuilder *opentac_builderp_with_cap(size_t cap) {
     return builder;
 }
 
+void opentac_builder_reset(OpentacBuilder *builder) {
+    opentac_assert(builder);
+
+    opentac_builder_free_cfgs(builder);
+    opentac_arena_reset(&builder->arena);
+    opentac_builder_init(builder, DEFAULT_BUILDER_CAP);
+}
+
+void opentac_builder_destroy(OpentacBuilder *builder) {
+    opentac_assert(builder);
+
+    opentac_builder_free_cfgs(builder);
+    opentac_arena_destroy(&builder->arena);
+}
+
+// cfgs are malloc'd rather than taken from the arena, since they are built
+// lazily and possibly from several threads at once
+static void opentac_builder_free_cfgs(OpentacBuilder *builder) {
+    for (size_t i = 0; i < builder->len; i++) {
+        if (builder->items[i]->tag == OPENTAC_ITEM_FN) {
+            opentac_cfg_destroy(&builder->items[i]->fn.cfg);
+        }
+    }
+}
+
+void opentac_builderp_destroy(OpentacBuilder *builder) {
+    opentac_builder_destroy(builder);
+    free(builder);
+}
+
 static void opentac_grow_builder(OpentacBuilder *builder, size_t newcap) {
     opentac_assert(builder);
     opentac_assert(newcap >= builder->cap);
     
+    size_t offset = builder->current - builder->items;
+    builder->items = opentac_arena_realloc(&builder->arena, builder->items, builder->cap * sizeof(OpentacItem *), newcap * sizeof(OpentacItem *));
     builder->cap = newcap;
-    builder->items = realloc(builder->items, builder->cap * sizeof(OpentacItem));
-    builder->current = builder->items + builder->len;
+    builder->current = builder->items + offset;
+}
+
+// room for one more statement; anything that changes the statements goes
+// through here, so it also drops the cached cfg
+static OpentacFnBuilder *opentac_fn_reserve(OpentacBuilder *builder) {
+    OpentacFnBuilder *fn = &(*builder->current)->fn;
+    if (fn->len >= fn->cap) {
+        opentac_grow_fn(builder, fn->cap * 2);
+    }
+    opentac_fn_invalidate(fn);
+    return fn;
 }
 
 static void opentac_grow_fn(OpentacBuilder *builder, size_t newcap) {
@@ -65,43 +149,84 @@ static void opentac_grow_fn(OpentacBuilder *builder, size_t newcap) {
     
     opentac_assert(newcap >= fn->cap);
     
+    size_t offset = fn->current - fn->stmts;
+    fn->stmts = opentac_arena_realloc(&builder->arena, fn->stmts, fn->cap * sizeof(OpentacStmt), newcap * sizeof(OpentacStmt));
     fn->cap = newcap;
-    fn->stmts = realloc(fn->stmts, fn->cap * sizeof(OpentacStmt));
-    fn->current = fn->stmts + fn->len;
+    fn->current = fn->stmts + offset;
+}
+
+static size_t opentac_name_slot(const struct OpentacNameTable *table, const OpentacString *name) {
+    size_t mask = table->cap - 1;
+    size_t slot = opentac_hash_mix(0, (uintptr_t) name) & mask;
+    while (table->entries[slot].key && table->entries[slot].key != name) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static size_t opentac_reg_name_slot(const struct OpentacRegNames *names, OpentacRegister reg) {
+    size_t mask = names->cap - 1;
+    size_t slot = opentac_hash_mix(0, (uint32_t) reg) & mask;
+    while (names->entries[slot].name && names->entries[slot].reg != reg) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static void opentac_grow_name_table(OpentacBuilder *builder, struct OpentacNameTable *table, size_t newcap) {
+    opentac_assert(table);
+    opentac_assert(newcap > table->cap);
+    opentac_assert((newcap & (newcap - 1)) == 0);
+    
+    struct OpentacNameTable old = *table;
+    table->cap = newcap;
+    table->entries = opentac_arena_calloc(&builder->arena, newcap, sizeof(struct OpentacEntry));
+    for (size_t i = 0; i < old.cap; i++) {
+        if (old.entries[i].key) {
+            table->entries[opentac_name_slot(table, old.entries[i].key)] = old.entries[i];
+        }
+    }
 }
 
-static void opentac_grow_name_table(OpentacFnBuilder *fn, size_t newcap) {
+static void opentac_grow_reg_names(OpentacBuilder *builder, OpentacFnBuilder *fn, size_t newcap) {
     opentac_assert(fn);
-    opentac_assert(newcap >= fn->cap);
-    
-    fn->name_table.cap = newcap;
-    fn->name_table.entries = realloc(fn->name_table.entries, fn->name_table.cap * sizeof(struct OpentacEntry));
+    opentac_assert(newcap > fn->reg_names.cap);
+    opentac_assert((newcap & (newcap - 1)) == 0);
+
+    struct OpentacRegNames old = fn->reg_names;
+    fn->reg_names.cap = newcap;
+    fn->reg_names.entries = opentac_arena_calloc(&builder->arena, newcap, sizeof(struct OpentacRegName));
+    for (size_t i = 0; i < old.cap; i++) {
+        if (old.entries[i].name) {
+            fn->reg_names.entries[opentac_reg_name_slot(&fn->reg_names, old.entries[i].reg)] = old.entries[i];
+        }
+    }
 }
 
-static void opentac_grow_params(OpentacFnBuilder *fn, size_t newcap) {
+static void opentac_grow_params(OpentacBuilder *builder, OpentacFnBuilder *fn, size_t newcap) {
     opentac_assert(fn);
-    opentac_assert(newcap >= fn->cap);
+    opentac_assert(newcap >= fn->params.cap);
     
+    fn->params.params = opentac_arena_realloc(&builder->arena, fn->params.params, fn->params.cap * sizeof(OpentacType *), newcap * sizeof(OpentacType *));
     fn->params.cap = newcap;
-    fn->params.params = realloc(fn->params.params, fn->params.cap * sizeof(OpentacType *));
 }
 
 static void opentac_grow_typeset(OpentacBuilder *builder, size_t newcap) {
     opentac_assert(builder);
     opentac_assert(newcap >= builder->typeset.cap);
     
+    builder->typeset.types = opentac_arena_realloc(&builder->arena, builder->typeset.types, builder->typeset.cap * sizeof(OpentacType *), newcap * sizeof(OpentacType *));
     builder->typeset.cap = newcap;
-    builder->typeset.types = realloc(builder->typeset.types, builder->typeset.cap * sizeof(OpentacType *));
 }
 
 void opentac_build_decl(OpentacBuilder *builder, OpentacString *name, OpentacType *type) {
     opentac_assert(builder);
     
-    if ((size_t) (builder->current - builder->items) > builder->cap) {
+    if (builder->len >= builder->cap) {
         opentac_grow_builder(builder, builder->cap * 2);
     }
     
-    OpentacItem *item = malloc(sizeof(OpentacItem));
+    OpentacItem *item = opentac_arena_alloc(&builder->arena, sizeof(OpentacItem));
     item->tag = OPENTAC_ITEM_DECL;
     item->decl.name = name;
     item->decl.type = type;
@@ -113,30 +238,43 @@ void opentac_build_decl(OpentacBuilder *builder, OpentacString *name, OpentacTyp
 void opentac_build_function(OpentacBuilder *builder, OpentacString *name) {
     opentac_assert(builder);
     
-    if ((size_t) (builder->current - builder->items) > builder->cap) {
+    if (builder->len >= builder->cap) {
         opentac_grow_builder(builder, builder->cap * 2);
     }
 
     size_t cap = DEFAULT_FN_CAP;
-    OpentacItem *item = malloc(sizeof(OpentacItem));
+    OpentacItem *item = opentac_arena_alloc(&builder->arena, sizeof(OpentacItem));
     item->tag = OPENTAC_ITEM_FN;
     item->fn.name = name;
     item->fn.param = 0;
     item->fn.reg = 0;
+    item->fn.label = 0;
     item->fn.len = 0;
     item->fn.cap = cap;
-    item->fn.stmts = malloc(cap * sizeof(OpentacStmt));
+    item->fn.stmts = opentac_arena_alloc(&builder->arena, cap * sizeof(OpentacStmt));
     item->fn.current = item->fn.stmts;
     
     cap = DEFAULT_NAME_TABLE_CAP;
     item->fn.name_table.len = 0;
     item->fn.name_table.cap = cap;
-    item->fn.name_table.entries = malloc(cap * sizeof(struct OpentacEntry));
+    item->fn.name_table.entries = opentac_arena_calloc(&builder->arena, cap, sizeof(struct OpentacEntry));
+    item->fn.labels.len = 0;
+    item->fn.labels.cap = cap;
+    item->fn.labels.entries = opentac_arena_calloc(&builder->arena, cap, sizeof(struct OpentacEntry));
+    item->fn.reg_names.len = 0;
+    item->fn.reg_names.cap = cap;
+    item->fn.reg_names.entries = opentac_arena_calloc(&builder->arena, cap, sizeof(struct OpentacRegName));
     
     cap = DEFAULT_PARAMS_CAP;
     item->fn.params.len = 0;
     item->fn.params.cap = cap;
-    item->fn.params.params = malloc(cap * sizeof(OpentacType *));
+    item->fn.params.params = opentac_arena_alloc(&builder->arena, cap * sizeof(OpentacType *));
+
+    memset(&item->fn.cfg, 0, sizeof(struct OpentacCfg));
+    item->fn.phis.len = 0;
+    item->fn.phis.cap = 0;
+    item->fn.phis.args = NULL;
+    item->fn.ssa = false;
     
     *builder->current = item;
 }
@@ -158,7 +296,7 @@ void opentac_build_function_param(OpentacBuilder *builder, OpentacString *name,
     opentac_fn_bind_int(builder, name, param);
     
     if (fn->params.len == fn->params.cap) {
-        opentac_grow_params(fn, fn->params.cap * 2);
+        opentac_grow_params(builder, fn, fn->params.cap * 2);
     }
     
     fn->params.params[fn->params.len++] = type;
@@ -167,8 +305,12 @@ void opentac_build_function_param(OpentacBuilder *builder, OpentacString *name,
 void opentac_builder_insert(OpentacBuilder *builder, size_t index) {
     opentac_assert(builder);
     
+    if (builder->len >= builder->cap) {
+        opentac_grow_builder(builder, builder->cap * 2);
+    }
+
     size_t remaining_len = builder->len - index;
-    memmove(builder->items + index + 1, builder->items + index, sizeof(OpentacItem) * remaining_len);
+    memmove(builder->items + index + 1, builder->items + index, sizeof(OpentacItem *) * remaining_len);
     opentac_builder_goto(builder, index);
 }
 
@@ -197,10 +339,7 @@ OpentacValue opentac_build_binary(OpentacBuilder *builder, int opcode, OpentacVa
     opentac_assert(builder);
     opentac_assert((*builder->current)->tag == OPENTAC_ITEM_FN);
     
-    OpentacFnBuilder *fn = &(*builder->current)->fn;
-    if ((size_t) (fn->current - fn->stmts) > fn->cap) {
-        opentac_grow_fn(builder, fn->cap * 2);
-    }
+    OpentacFnBuilder *fn = opentac_fn_reserve(builder);
     
     OpentacRegister target = fn->reg++;
 
@@ -224,10 +363,7 @@ OpentacValue opentac_build_unary(OpentacBuilder *builder, int opcode, OpentacVal
     opentac_assert(builder);
     opentac_assert((*builder->current)->tag == OPENTAC_ITEM_FN);
     
-    OpentacFnBuilder *fn = &(*builder->current)->fn;
-    if ((size_t) (fn->current - fn->stmts) > fn->cap) {
-        opentac_grow_fn(builder, fn->cap * 2);
-    }
+    OpentacFnBuilder *fn = opentac_fn_reserve(builder);
     
     OpentacRegister target = fn->reg++;
 
@@ -249,10 +385,7 @@ void opentac_build_index_assign(OpentacBuilder *builder, OpentacRegister target,
     opentac_assert(builder);
     opentac_assert((*builder->current)->tag == OPENTAC_ITEM_FN);
     
-    OpentacFnBuilder *fn = &(*builder->current)->fn;
-    if ((size_t) (fn->current - fn->stmts) > fn->cap) {
-        opentac_grow_fn(builder, fn->cap * 2);
-    }
+    OpentacFnBuilder *fn = opentac_fn_reserve(builder);
     
     fn->current->tag.opcode = OPENTAC_OP_INDEX_ASSIGN;
     fn->current->tag.left = offset.tag;
@@ -268,10 +401,7 @@ OpentacValue opentac_build_assign_index(OpentacBuilder *builder, OpentacValue va
     opentac_assert(builder);
     opentac_assert((*builder->current)->tag == OPENTAC_ITEM_FN);
     
-    OpentacFnBuilder *fn = &(*builder->current)->fn;
-    if ((size_t) (fn->current - fn->stmts) > fn->cap) {
-        opentac_grow_fn(builder, fn->cap * 2);
-    }
+    OpentacFnBuilder *fn = opentac_fn_reserve(builder);
     
     OpentacRegister target = fn->reg++;
 
@@ -295,10 +425,7 @@ void opentac_build_param(OpentacBuilder *builder, OpentacValue value) {
     opentac_assert(builder);
     opentac_assert((*builder->current)->tag == OPENTAC_ITEM_FN);
     
-    OpentacFnBuilder *fn = &(*builder->current)->fn;
-    if ((size_t) (fn->current - fn->stmts) > fn->cap) {
-        opentac_grow_fn(builder, fn->cap * 2);
-    }
+    OpentacFnBuilder *fn = opentac_fn_reserve(builder);
     
     fn->current->tag.opcode = OPENTAC_OP_PARAM;
     fn->current->tag.left = value.tag;
@@ -311,10 +438,7 @@ OpentacValue opentac_build_call(OpentacBuilder *builder, OpentacValue func, uint
     opentac_assert(builder);
     opentac_assert((*builder->current)->tag == OPENTAC_ITEM_FN);
     
-    OpentacFnBuilder *fn = &(*builder->current)->fn;
-    if ((size_t) (fn->current - fn->stmts) > fn->cap) {
-        opentac_grow_fn(builder, fn->cap * 2);
-    }
+    OpentacFnBuilder *fn = opentac_fn_reserve(builder);
     
     OpentacRegister target = fn->reg++;
 
@@ -338,10 +462,7 @@ void opentac_build_return(OpentacBuilder *builder, OpentacValue value) {
     opentac_assert(builder);
     opentac_assert((*builder->current)->tag == OPENTAC_ITEM_FN);
     
-    OpentacFnBuilder *fn = &(*builder->current)->fn;
-    if ((size_t) (fn->current - fn->stmts) > fn->cap) {
-        opentac_grow_fn(builder, fn->cap * 2);
-    }
+    OpentacFnBuilder *fn = opentac_fn_reserve(builder);
     
     fn->current->tag.opcode = OPENTAC_OP_RETURN;
     fn->current->tag.left = value.tag;
@@ -355,10 +476,7 @@ void opentac_build_if_branch(OpentacBuilder *builder, int relop, OpentacValue le
     opentac_assert((*builder->current)->tag == OPENTAC_ITEM_FN);
     opentac_assert(relop >= OPENTAC_OP_LT && relop <= OPENTAC_OP_GE);
     
-    OpentacFnBuilder *fn = &(*builder->current)->fn;
-    if ((size_t) (fn->current - fn->stmts) > fn->cap) {
-        opentac_grow_fn(builder, fn->cap * 2);
-    }
+    OpentacFnBuilder *fn = opentac_fn_reserve(builder);
     
     fn->current->tag.opcode = OPENTAC_OP_BRANCH | relop;
     fn->current->tag.left = left.tag;
@@ -374,10 +492,7 @@ void opentac_build_branch(OpentacBuilder *builder, OpentacValue value) {
     opentac_assert(builder);
     opentac_assert((*builder->current)->tag == OPENTAC_ITEM_FN);
     
-    OpentacFnBuilder *fn = &(*builder->current)->fn;
-    if ((size_t) (fn->current - fn->stmts) > fn->cap) {
-        opentac_grow_fn(builder, fn->cap * 2);
-    }
+    OpentacFnBuilder *fn = opentac_fn_reserve(builder);
     
     fn->current->tag.opcode = OPENTAC_OP_BRANCH | OPENTAC_OP_NOP;
     fn->current->tag.left = value.tag;
@@ -386,11 +501,41 @@ void opentac_build_branch(OpentacBuilder *builder, OpentacValue value) {
     ++fn->current;
 }
 
+void opentac_build_jump(OpentacBuilder *builder, OpentacLabel label) {
+    opentac_assert(builder);
+    opentac_assert((*builder->current)->tag == OPENTAC_ITEM_FN);
+    
+    OpentacFnBuilder *fn = opentac_fn_reserve(builder);
+    
+    fn->current->tag.opcode = OPENTAC_OP_BRANCH | OPENTAC_OP_NOP;
+    fn->current->tag.left = OPENTAC_VAL_ERROR;
+    fn->current->tag.right = OPENTAC_VAL_ERROR;
+    fn->current->label = label;
+    ++fn->len;
+    ++fn->current;
+}
+
+void opentac_build_label(OpentacBuilder *builder, OpentacLabel label) {
+    opentac_assert(builder);
+    opentac_assert((*builder->current)->tag == OPENTAC_ITEM_FN);
+    
+    OpentacFnBuilder *fn = opentac_fn_reserve(builder);
+    opentac_assert(label < fn->label);
+    
+    fn->current->tag.opcode = OPENTAC_OP_LABEL;
+    fn->current->tag.left = OPENTAC_VAL_ERROR;
+    fn->current->tag.right = OPENTAC_VAL_ERROR;
+    fn->current->label = label;
+    ++fn->len;
+    ++fn->current;
+}
+
 void opentac_fn_insert(OpentacBuilder *builder, size_t index) {
     opentac_assert(builder);
     opentac_assert((*builder->current)->tag == OPENTAC_ITEM_FN);
     
-    OpentacFnBuilder *fn = &(*builder->current)->fn;
+    OpentacFnBuilder *fn = opentac_fn_reserve(builder);
+
     size_t remaining_len = fn->len - index;
     memmove(fn->stmts + index + 1, fn->stmts + index, sizeof(OpentacStmt) * remaining_len);
     opentac_fn_goto(builder, index);
@@ -412,17 +557,44 @@ void opentac_fn_goto_end(OpentacBuilder *builder) {
     opentac_fn_goto(builder, len);
 }
 
+static struct OpentacEntry *opentac_name_bind(OpentacBuilder *builder, struct OpentacNameTable *table, OpentacString *name, bool *found) {
+    opentac_assert(name);
+
+    size_t slot = opentac_name_slot(table, name);
+    if (found) {
+        *found = table->entries[slot].key != NULL;
+    }
+    if (!table->entries[slot].key) {
+        // keep the load factor at or below one half
+        if ((table->len + 1) * 2 > table->cap) {
+            opentac_grow_name_table(builder, table, table->cap * 2);
+            slot = opentac_name_slot(table, name);
+        }
+        table->entries[slot].key = name;
+        ++table->len;
+    }
+
+    return table->entries + slot;
+}
+
 void opentac_fn_bind_int(OpentacBuilder *builder, OpentacString *name, uint32_t val) {
     opentac_assert(builder);
     opentac_assert((*builder->current)->tag == OPENTAC_ITEM_FN);
     
     OpentacFnBuilder *fn = &(*builder->current)->fn;
-    if (fn->name_table.len == fn->name_table.cap) {
-        opentac_grow_name_table(fn, fn->name_table.cap * 2);
+    opentac_name_bind(builder, &fn->name_table, name, NULL)->ival = val;
+
+    OpentacRegister reg = (OpentacRegister) val;
+    size_t slot = opentac_reg_name_slot(&fn->reg_names, reg);
+    if (!fn->reg_names.entries[slot].name) {
+        if ((fn->reg_names.len + 1) * 2 > fn->reg_names.cap) {
+            opentac_grow_reg_names(builder, fn, fn->reg_names.cap * 2);
+            slot = opentac_reg_name_slot(&fn->reg_names, reg);
+        }
+        fn->reg_names.entries[slot].reg = reg;
+        ++fn->reg_names.len;
     }
-    
-    fn->name_table.entries[fn->name_table.len].key = name;
-    fn->name_table.entries[fn->name_table.len++].ival = val;
+    fn->reg_names.entries[slot].name = name;
 }
 
 void opentac_fn_bind_ptr(OpentacBuilder *builder, OpentacString *name, void *val) {
@@ -430,12 +602,7 @@ void opentac_fn_bind_ptr(OpentacBuilder *builder, OpentacString *name, void *val
     opentac_assert((*builder->current)->tag == OPENTAC_ITEM_FN);
     
     OpentacFnBuilder *fn = &(*builder->current)->fn;
-    if (fn->name_table.len == fn->name_table.cap) {
-        opentac_grow_name_table(fn, fn->name_table.cap * 2);
-    }
-    
-    fn->name_table.entries[fn->name_table.len].key = name;
-    fn->name_table.entries[fn->name_table.len++].pval = val;
+    opentac_name_bind(builder, &fn->name_table, name, NULL)->pval = val;
 }
 
 uint32_t opentac_fn_get_int(OpentacBuilder *builder, OpentacString *name) {
@@ -443,45 +610,238 @@ uint32_t opentac_fn_get_int(OpentacBuilder *builder, OpentacString *name) {
     opentac_assert((*builder->current)->tag == OPENTAC_ITEM_FN);
     
     OpentacFnBuilder *fn = &(*builder->current)->fn;
-    for (size_t i = 0; i < fn->name_table.len; i++) {
-        if (strcmp(fn->name_table.entries[i].key->data, name->data) == 0) {
-            return fn->name_table.entries[i].ival;
-        }
+    struct OpentacEntry *entry = fn->name_table.entries + opentac_name_slot(&fn->name_table, name);
+    if (entry->key) {
+        return entry->ival;
     }
 
     return -1;
 }
 
+bool opentac_fn_lookup_int(OpentacBuilder *builder, OpentacString *name, uint32_t *val) {
+    opentac_assert(builder);
+    opentac_assert((*builder->current)->tag == OPENTAC_ITEM_FN);
+    
+    OpentacFnBuilder *fn = &(*builder->current)->fn;
+    struct OpentacEntry *entry = fn->name_table.entries + opentac_name_slot(&fn->name_table, name);
+    if (entry->key) {
+        *val = entry->ival;
+        return true;
+    }
+
+    return false;
+}
+
 void *opentac_fn_get_ptr(OpentacBuilder *builder, OpentacString *name) {
     opentac_assert(builder);
     opentac_assert((*builder->current)->tag == OPENTAC_ITEM_FN);
     
     OpentacFnBuilder *fn = &(*builder->current)->fn;
-    for (size_t i = 0; i < fn->name_table.len; i++) {
-        if (strcmp(fn->name_table.entries[i].key->data, name->data) == 0) {
-            return fn->name_table.entries[i].pval;
-        }
+    struct OpentacEntry *entry = fn->name_table.entries + opentac_name_slot(&fn->name_table, name);
+    if (entry->key) {
+        return entry->pval;
     }
 
     return NULL;
 }
 
-#define BASIC_TYPE_FN(t) \
-    for (size_t i = 0; i < builder->typeset.len; i++) { \
-        OpentacType *type = builder->typeset.types[i]; \
-        if (type->tag == t) { \
-            return type; \
-        } \
-    } \
-\
-    if (builder->typeset.len == builder->typeset.cap) { \
-        opentac_grow_typeset(builder, builder->typeset.cap * 2); \
-    } \
-\
-    OpentacType *type = malloc(sizeof(OpentacType)); \
-    type->tag = t; \
-    builder->typeset.types[builder->typeset.len++] = type; \
+OpentacString *opentac_fn_name_of(const OpentacFnBuilder *fn, OpentacRegister reg) {
+    opentac_assert(fn);
+
+    return fn->reg_names.entries[opentac_reg_name_slot(&fn->reg_names, reg)].name;
+}
+
+void opentac_fn_retarget(OpentacBuilder *builder, OpentacRegister target) {
+    opentac_assert(builder);
+    opentac_assert((*builder->current)->tag == OPENTAC_ITEM_FN);
+    
+    OpentacFnBuilder *fn = &(*builder->current)->fn;
+    opentac_assert(fn->current > fn->stmts);
+
+    OpentacStmt *stmt = fn->current - 1;
+    OpentacRegister fresh;
+    opentac_assert(opentac_stmt_def(stmt, &fresh));
+    stmt->target = target;
+    // give the register back if nothing else was numbered after it
+    if (fresh == fn->reg - 1) {
+        --fn->reg;
+    }
+}
+
+OpentacLabel opentac_fn_label(OpentacBuilder *builder, OpentacString *name) {
+    opentac_assert(builder);
+    opentac_assert((*builder->current)->tag == OPENTAC_ITEM_FN);
+    
+    OpentacFnBuilder *fn = &(*builder->current)->fn;
+    bool found;
+    struct OpentacEntry *entry = opentac_name_bind(builder, &fn->labels, name, &found);
+    if (!found) {
+        entry->ival = fn->label++;
+    }
+
+    return entry->ival;
+}
+
+static uint64_t opentac_hash_mix(uint64_t h, uint64_t v) {
+    // splitmix64 finalizer over the running hash
+    h ^= v + 0x9e3779b97f4a7c15ull;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+}
+
+// children of a type are interned already, so they hash and compare by address
+static uint64_t opentac_type_hash(const OpentacType *type) {
+    uint64_t h = opentac_hash_mix(0, type->tag);
+    switch (type->tag) {
+    case OPENTAC_TYPE_PTR:
+        h = opentac_hash_mix(h, (uintptr_t) type->ptr.pointee);
+        break;
+    case OPENTAC_TYPE_FN:
+        h = opentac_hash_mix(h, (uintptr_t) type->fn.result);
+        h = opentac_hash_mix(h, type->fn.len);
+        for (size_t i = 0; i < type->fn.len; i++) {
+            h = opentac_hash_mix(h, (uintptr_t) type->fn.params[i]);
+        }
+        break;
+    case OPENTAC_TYPE_TUPLE:
+        h = opentac_hash_mix(h, type->tuple.len);
+        for (size_t i = 0; i < type->tuple.len; i++) {
+            h = opentac_hash_mix(h, (uintptr_t) type->tuple.elems[i]);
+        }
+        break;
+    case OPENTAC_TYPE_STRUCT:
+    case OPENTAC_TYPE_UNION:
+        // named types are nominal, their elements are not part of the key
+        h = opentac_hash_mix(h, (uintptr_t) type->struc.name);
+        break;
+    case OPENTAC_TYPE_ARRAY:
+        h = opentac_hash_mix(h, (uintptr_t) type->array.elem_type);
+        h = opentac_hash_mix(h, type->array.len);
+        break;
+    default:
+        break;
+    }
+    return h;
+}
+
+static bool opentac_type_eq(const OpentacType *a, const OpentacType *b) {
+    if (a->tag != b->tag) {
+        return false;
+    }
+
+    switch (a->tag) {
+    case OPENTAC_TYPE_PTR:
+        return a->ptr.pointee == b->ptr.pointee;
+    case OPENTAC_TYPE_FN:
+        return a->fn.result == b->fn.result
+            && a->fn.len == b->fn.len
+            && memcmp(a->fn.params, b->fn.params, a->fn.len * sizeof(OpentacType *)) == 0;
+    case OPENTAC_TYPE_TUPLE:
+        return a->tuple.len == b->tuple.len
+            && memcmp(a->tuple.elems, b->tuple.elems, a->tuple.len * sizeof(OpentacType *)) == 0;
+    case OPENTAC_TYPE_STRUCT:
+    case OPENTAC_TYPE_UNION:
+        return a->struc.name == b->struc.name;
+    case OPENTAC_TYPE_ARRAY:
+        return a->array.elem_type == b->array.elem_type && a->array.len == b->array.len;
+    default:
+        return true;
+    }
+}
+
+static void opentac_grow_typeset_table(OpentacBuilder *builder, size_t newcap) {
+    opentac_assert(builder);
+    opentac_assert(newcap > builder->typeset.table_cap);
+    opentac_assert((newcap & (newcap - 1)) == 0);
+
+    builder->typeset.table_cap = newcap;
+    builder->typeset.table = opentac_arena_calloc(&builder->arena, newcap, sizeof(OpentacType *));
+
+    size_t mask = newcap - 1;
+    for (size_t i = 0; i < builder->typeset.len; i++) {
+        OpentacType *type = builder->typeset.types[i];
+        size_t slot = opentac_type_hash(type) & mask;
+        while (builder->typeset.table[slot]) {
+            slot = (slot + 1) & mask;
+        }
+        builder->typeset.table[slot] = type;
+    }
+}
+
+// copies the child arrays of a type into the builder's arena
+static void opentac_type_own(OpentacBuilder *builder, OpentacType *type) {
+    OpentacType ***elems = NULL;
+    size_t len = 0;
+    switch (type->tag) {
+    case OPENTAC_TYPE_FN:
+        elems = &type->fn.params;
+        len = type->fn.len;
+        break;
+    case OPENTAC_TYPE_TUPLE:
+        elems = &type->tuple.elems;
+        len = type->tuple.len;
+        break;
+    case OPENTAC_TYPE_STRUCT:
+    case OPENTAC_TYPE_UNION:
+        elems = &type->struc.elems;
+        len = type->struc.len;
+        break;
+    default:
+        return;
+    }
+
+    if (*elems) {
+        OpentacType **copy = opentac_arena_alloc(&builder->arena, len * sizeof(OpentacType *));
+        memcpy(copy, *elems, len * sizeof(OpentacType *));
+        *elems = copy;
+    }
+}
+
+// looks up a type structurally equal to `key`, or inserts a copy of `key`;
+// `found`, if given, tells which of the two happened
+static OpentacType *opentac_typeset_intern(OpentacBuilder *builder, const OpentacType *key, bool *found) {
+    opentac_assert(builder);
+    opentac_assert(key);
+
+    size_t mask = builder->typeset.table_cap - 1;
+    size_t slot = opentac_type_hash(key) & mask;
+    OpentacType *type;
+    while ((type = builder->typeset.table[slot])) {
+        if (opentac_type_eq(type, key)) {
+            if (found) {
+                *found = true;
+            }
+            return type;
+        }
+        slot = (slot + 1) & mask;
+    }
+    if (found) {
+        *found = false;
+    }
+
+    if (builder->typeset.len == builder->typeset.cap) {
+        opentac_grow_typeset(builder, builder->typeset.cap * 2);
+    }
+
+    type = opentac_arena_alloc(&builder->arena, sizeof(OpentacType));
+    *type = *key;
+    opentac_type_own(builder, type);
+    builder->typeset.types[builder->typeset.len++] = type;
+
+    // keep the load factor at or below one half
+    if (builder->typeset.len * 2 > builder->typeset.table_cap) {
+        opentac_grow_typeset_table(builder, builder->typeset.table_cap * 2);
+    } else {
+        builder->typeset.table[slot] = type;
+    }
+
     return type;
+}
+
+#define BASIC_TYPE_FN(t) \
+    OpentacType key = { .tag = t }; \
+    return opentac_typeset_intern(builder, &key, NULL);
 
 OpentacType *opentac_type_unit(OpentacBuilder *builder) {
     opentac_assert(builder);
@@ -566,49 +926,23 @@ OpentacType *opentac_type_named(OpentacBuilder *builder, int tag, OpentacString
     opentac_assert(name);
     opentac_assert(tag == OPENTAC_TYPE_STRUCT || tag == OPENTAC_TYPE_UNION);
     
-    for (size_t i = 0; i < builder->typeset.len; i++) {
-        OpentacType *type = builder->typeset.types[i];
-        if (type->tag == tag && strcmp(type->struc.name->data, name->data)) {
-            opentac_del_string(name);
-            return type;
-        }
-    }
-
-    if (builder->typeset.len == builder->typeset.cap) {
-        opentac_grow_typeset(builder, builder->typeset.cap * 2);
-    }
-
-    OpentacType *type = malloc(sizeof(OpentacType));
-    type->tag = tag;
-    type->struc.name = name;
-    type->struc.len = 0;
-    type->struc.elems = NULL;
-    builder->typeset.types[builder->typeset.len++] = type;
+    OpentacType key = { .tag = tag };
+    key.struc.name = name;
+    key.struc.len = 0;
+    key.struc.cap = 0;
+    key.struc.elems = NULL;
 
-    return type;
+    return opentac_typeset_intern(builder, &key, NULL);
 }
 
 OpentacType *opentac_type_ptr(OpentacBuilder *builder, OpentacType *pointee) {
     opentac_assert(builder);
     opentac_assert(pointee);
     
-    for (size_t i = 0; i < builder->typeset.len; i++) {
-        OpentacType *type = builder->typeset.types[i];
-        if (type->tag == OPENTAC_TYPE_PTR && type->ptr.pointee == pointee) {
-            return type;
-        }
-    }
-
-    if (builder->typeset.len == builder->typeset.cap) {
-        opentac_grow_typeset(builder, builder->typeset.cap * 2);
-    }
-
-    OpentacType *type = malloc(sizeof(OpentacType));
-    type->tag = OPENTAC_TYPE_PTR;
-    type->ptr.pointee = pointee;
-    builder->typeset.types[builder->typeset.len++] = type;
+    OpentacType key = { .tag = OPENTAC_TYPE_PTR };
+    key.ptr.pointee = pointee;
 
-    return type;
+    return opentac_typeset_intern(builder, &key, NULL);
 }
 
 OpentacType *opentac_type_fn(OpentacBuilder *builder, size_t len, OpentacType **params, OpentacType *result) {
@@ -616,66 +950,71 @@ OpentacType *opentac_type_fn(OpentacBuilder *builder, size_t len, OpentacType **
     opentac_assert(params);
     opentac_assert(result);
     
-    for (size_t i = 0; i < builder->typeset.len; i++) {
-        OpentacType *type = builder->typeset.types[i];
-        if (type->tag == OPENTAC_TYPE_FN && type->fn.result == result && type->fn.len == len) {
-            for (size_t j = 0; j < type->fn.len; j++) {
-                OpentacType *param = type->fn.params[j];
-                if (param != params[j]) {
-                    goto cont;
-                }
-            }
-            free(params);
-            return type;
-        }
-cont:
-        (void) 0;
-    }
+    OpentacType key = { .tag = OPENTAC_TYPE_FN };
+    key.fn.result = result;
+    key.fn.len = len;
+    key.fn.cap = len;
+    key.fn.params = params;
 
-    if (builder->typeset.len == builder->typeset.cap) {
-        opentac_grow_typeset(builder, builder->typeset.cap * 2);
-    }
-
-    OpentacType *type = malloc(sizeof(OpentacType));
-    type->tag = OPENTAC_TYPE_FN;
-    type->fn.result = result;
-    type->fn.len = len;
-    type->fn.params = params;
-    builder->typeset.types[builder->typeset.len++] = type;
-
-    return type;
+    return opentac_typeset_intern(builder, &key, NULL);
 }
 
 OpentacType *opentac_type_tuple(OpentacBuilder *builder, size_t len, OpentacType **elems) {
     opentac_assert(builder);
     opentac_assert(elems);
     
+    OpentacType key = { .tag = OPENTAC_TYPE_TUPLE };
+    key.tuple.len = len;
+    key.tuple.cap = len;
+    key.tuple.elems = elems;
+
+    return opentac_typeset_intern(builder, &key, NULL);
+}
+
+// only aggregates and arrays can hold another type by value, everything
+// else keeps its layout
+static void opentac_typeset_forget_layouts(OpentacBuilder *builder) {
     for (size_t i = 0; i < builder->typeset.len; i++) {
         OpentacType *type = builder->typeset.types[i];
-        if (type->tag == OPENTAC_TYPE_TUPLE && type->tuple.len == len) {
-            for (size_t j = 0; j < type->tuple.len; j++) {
-                OpentacType *elem = type->tuple.elems[j];
-                if (elem != elems[j]) {
-                    goto cont;
-                }
-            }
-            free(elems);
-            return type;
+        switch (type->tag) {
+        case OPENTAC_TYPE_TUPLE:
+        case OPENTAC_TYPE_STRUCT:
+        case OPENTAC_TYPE_UNION:
+        case OPENTAC_TYPE_ARRAY:
+            type->size = 0;
+            type->align = 0;
+            break;
+        default:
+            break;
         }
-cont:
-        (void) 0;
     }
+}
 
-    if (builder->typeset.len == builder->typeset.cap) {
-        opentac_grow_typeset(builder, builder->typeset.cap * 2);
+static OpentacType *opentac_type_aggregate(OpentacBuilder *builder, int tag, OpentacString *name, size_t len, OpentacType **elems) {
+    OpentacType key = { .tag = tag };
+    key.struc.name = name;
+    key.struc.len = len;
+    key.struc.cap = len;
+    key.struc.elems = elems;
+
+    bool found;
+    OpentacType *type = opentac_typeset_intern(builder, &key, &found);
+    if (found) {
+        // a forward reference through `opentac_type_named` is completed
+        // here, and has to be laid out again, along with whatever holds it
+        // by value if it was laid out while still empty
+        bool laid_out = type->align != 0;
+        type->size = 0;
+        type->align = 0;
+        type->struc.len = len;
+        type->struc.cap = len;
+        type->struc.elems = elems;
+        opentac_type_own(builder, type);
+        if (laid_out) {
+            opentac_typeset_forget_layouts(builder);
+        }
     }
 
-    OpentacType *type = malloc(sizeof(OpentacType));
-    type->tag = OPENTAC_TYPE_TUPLE;
-    type->tuple.len = len;
-    type->tuple.elems = elems;
-    builder->typeset.types[builder->typeset.len++] = type;
-
     return type;
 }
 
@@ -684,81 +1023,216 @@ OpentacType *opentac_type_struct(OpentacBuilder *builder, OpentacString *name, s
     opentac_assert(name);
     opentac_assert(elems);
     
-    for (size_t i = 0; i < builder->typeset.len; i++) {
-        OpentacType *type = builder->typeset.types[i];
-        if (type->tag == OPENTAC_TYPE_STRUCT && strcmp(type->struc.name->data, name->data)) {
-            opentac_del_string(name);
-            type->struc.len = len;
-            type->struc.elems = elems;
-            return type;
-        }
+    return opentac_type_aggregate(builder, OPENTAC_TYPE_STRUCT, name, len, elems);
+}
+
+OpentacType *opentac_type_union(OpentacBuilder *builder, OpentacString *name, size_t len, OpentacType **elems) {
+    opentac_assert(builder);
+    opentac_assert(name);
+    opentac_assert(elems);
+    
+    return opentac_type_aggregate(builder, OPENTAC_TYPE_UNION, name, len, elems);
+}
+
+OpentacType *opentac_type_array(OpentacBuilder *builder, OpentacType *elem_type, uint64_t len) {
+    opentac_assert(builder);
+    opentac_assert(elem_type);
+    
+    OpentacType key = { .tag = OPENTAC_TYPE_ARRAY };
+    key.array.elem_type = elem_type;
+    key.array.len = len;
+
+    return opentac_typeset_intern(builder, &key, NULL);
+}
+
+static uint64_t opentac_align_up(uint64_t value, uint64_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+// the layout of the System V x86-64 ABI: scalars are aligned to their size,
+// members of tuples and structs follow each other with padding between
+// them, and aggregates are as aligned as their strictest member and padded
+// to a multiple of that; a type is laid out once and keeps the result until
+// a forward reference it holds is completed, with the size set but no
+// alignment yet while it is in progress
+OpentacTypeInfo opentac_type_layout(OpentacType *type) {
+    opentac_assert(type);
+
+    if (type->align) {
+        return (OpentacTypeInfo) { .size = type->size, .align = type->align };
+    }
+    opentac_assertf(type->size != UINT64_MAX, "type of tag %d contains itself", type->tag);
+
+    uint64_t size = 0;
+    uint64_t align = 1;
+    size_t len = 0;
+    OpentacType **elems = NULL;
+    switch (type->tag) {
+    case OPENTAC_TYPE_UNIT:
+    case OPENTAC_TYPE_NEVER:
+        break;
+    case OPENTAC_TYPE_BOOL:
+    case OPENTAC_TYPE_I8:
+    case OPENTAC_TYPE_UI8:
+        size = align = 1;
+        break;
+    case OPENTAC_TYPE_I16:
+    case OPENTAC_TYPE_UI16:
+        size = align = 2;
+        break;
+    case OPENTAC_TYPE_I32:
+    case OPENTAC_TYPE_UI32:
+    case OPENTAC_TYPE_F32:
+        size = align = 4;
+        break;
+    case OPENTAC_TYPE_I64:
+    case OPENTAC_TYPE_UI64:
+    case OPENTAC_TYPE_F64:
+    case OPENTAC_TYPE_PTR:
+    case OPENTAC_TYPE_FN:
+        size = align = 8;
+        break;
+    case OPENTAC_TYPE_TUPLE:
+        len = type->tuple.len;
+        elems = type->tuple.elems;
+        break;
+    case OPENTAC_TYPE_STRUCT:
+    case OPENTAC_TYPE_UNION:
+        len = type->struc.len;
+        elems = type->struc.elems;
+        break;
+    case OPENTAC_TYPE_ARRAY: {
+        type->size = UINT64_MAX;
+        OpentacTypeInfo elem = opentac_type_layout(type->array.elem_type);
+        size = elem.size * type->array.len;
+        align = elem.align;
+        break;
+    }
     }
 
-    if (builder->typeset.len == builder->typeset.cap) {
-        opentac_grow_typeset(builder, builder->typeset.cap * 2);
+    if (elems) {
+        type->size = UINT64_MAX;
+    }
+    for (size_t i = 0; i < len; i++) {
+        OpentacTypeInfo elem = opentac_type_layout(elems[i]);
+        if (type->tag == OPENTAC_TYPE_UNION) {
+            size = elem.size > size ? elem.size : size;
+        } else {
+            size = opentac_align_up(size, elem.align) + elem.size;
+        }
+        align = elem.align > align ? elem.align : align;
     }
 
-    OpentacType *type = malloc(sizeof(OpentacType));
-    type->tag = OPENTAC_TYPE_STRUCT;
-    type->struc.name = name;
-    type->struc.len = len;
-    type->struc.elems = elems;
-    builder->typeset.types[builder->typeset.len++] = type;
+    type->size = opentac_align_up(size, align);
+    type->align = align;
+    return (OpentacTypeInfo) { .size = type->size, .align = type->align };
+}
 
-    return type;
+uint64_t opentac_type_offset(OpentacType *type, size_t index) {
+    opentac_assert(type);
+
+    if (type->tag == OPENTAC_TYPE_UNION) {
+        return 0;
+    }
+    if (type->tag == OPENTAC_TYPE_ARRAY) {
+        return index * opentac_type_layout(type->array.elem_type).size;
+    }
+    opentac_assert(type->tag == OPENTAC_TYPE_TUPLE || type->tag == OPENTAC_TYPE_STRUCT);
+
+    size_t len = type->tag == OPENTAC_TYPE_TUPLE ? type->tuple.len : type->struc.len;
+    OpentacType **elems = type->tag == OPENTAC_TYPE_TUPLE ? type->tuple.elems : type->struc.elems;
+    opentac_assertf(index < len, "member %zu of a type with %zu", index, len);
+    uint64_t offset = 0;
+    for (size_t i = 0; i < index; i++) {
+        offset += opentac_type_layout(elems[i]).size;
+        offset = opentac_align_up(offset, opentac_type_layout(elems[i + 1]).align);
+    }
+    return offset;
 }
 
-OpentacType *opentac_type_union(OpentacBuilder *builder, OpentacString *name, size_t len, OpentacType **elems) {
+void opentac_typeset_layout(OpentacBuilder *builder) {
     opentac_assert(builder);
-    opentac_assert(name);
-    opentac_assert(elems);
-    
+
     for (size_t i = 0; i < builder->typeset.len; i++) {
-        OpentacType *type = builder->typeset.types[i];
-        if (type->tag == OPENTAC_TYPE_UNION && strcmp(type->struc.name->data, name->data)) {
-            opentac_del_string(name);
-            type->struc.len = len;
-            type->struc.elems = elems;
-            return type;
-        }
+        opentac_type_layout(builder->typeset.types[i]);
     }
-    
-    if (builder->typeset.len == builder->typeset.cap) {
-        opentac_grow_typeset(builder, builder->typeset.cap * 2);
+}
+
+static uint64_t opentac_hash_bytes(const char *data, size_t len) {
+    // FNV-1a
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t) data[i];
+        h *= 0x100000001b3ull;
     }
+    return h;
+}
 
-    OpentacType *type = malloc(sizeof(OpentacType));
-    type->tag = OPENTAC_TYPE_UNION;
-    type->struc.name = name;
-    type->struc.len = len;
-    type->struc.elems = elems;
-    builder->typeset.types[builder->typeset.len++] = type;
+static void opentac_grow_interner(OpentacBuilder *builder, size_t newcap) {
+    opentac_assert(builder);
+    opentac_assert(newcap > builder->interner.cap);
+    opentac_assert((newcap & (newcap - 1)) == 0);
+
+    OpentacString **table = opentac_arena_calloc(&builder->arena, newcap, sizeof(OpentacString *));
+    size_t mask = newcap - 1;
+    for (size_t i = 0; i < builder->interner.cap; i++) {
+        OpentacString *str = builder->interner.table[i];
+        if (!str) {
+            continue;
+        }
+        size_t slot = opentac_hash_bytes(str->data, str->len) & mask;
+        while (table[slot]) {
+            slot = (slot + 1) & mask;
+        }
+        table[slot] = str;
+    }
 
-    return type;
+    builder->interner.cap = newcap;
+    builder->interner.table = table;
 }
 
-OpentacType *opentac_type_array(OpentacBuilder *builder, OpentacType *elem_type, uint64_t len) {
+OpentacString *opentac_interned(const OpentacBuilder *builder, const char *str) {
     opentac_assert(builder);
-    opentac_assert(elem_type);
-    
-    for (size_t i = 0; i < builder->typeset.len; i++) {
-        OpentacType *type = builder->typeset.types[i];
-        if (type->tag == OPENTAC_TYPE_ARRAY && type->array.elem_type == elem_type && type->array.len == len) {
-            return type;
+    opentac_assert(str);
+
+    size_t len = strlen(str);
+    size_t mask = builder->interner.cap - 1;
+    size_t slot = opentac_hash_bytes(str, len) & mask;
+    OpentacString *string;
+    while ((string = builder->interner.table[slot])) {
+        if (string->len == len && memcmp(string->data, str, len) == 0) {
+            return string;
         }
+        slot = (slot + 1) & mask;
     }
 
-    if (builder->typeset.len == builder->typeset.cap) {
-        opentac_grow_typeset(builder, builder->typeset.cap * 2);
+    return NULL;
+}
+
+OpentacString *opentac_intern(OpentacBuilder *builder, const char *str) {
+    opentac_assert(builder);
+    opentac_assert(str);
+
+    size_t len = strlen(str);
+    size_t mask = builder->interner.cap - 1;
+    size_t slot = opentac_hash_bytes(str, len) & mask;
+    OpentacString *string;
+    while ((string = builder->interner.table[slot])) {
+        if (string->len == len && memcmp(string->data, str, len) == 0) {
+            return string;
+        }
+        slot = (slot + 1) & mask;
     }
 
-    OpentacType *type = malloc(sizeof(OpentacType));
-    type->tag = OPENTAC_TYPE_ARRAY;
-    type->array.elem_type = elem_type;
-    type->array.len = len;
-    builder->typeset.types[builder->typeset.len++] = type;
+    string = opentac_arena_string(&builder->arena, str);
+    builder->interner.table[slot] = string;
 
-    return type;
+    // keep the load factor at or below one half
+    if (++builder->interner.len * 2 > builder->interner.cap) {
+        opentac_grow_interner(builder, builder->interner.cap * 2);
+    }
+
+    return string;
 }
 
 OpentacString *opentac_string(const char *str) {
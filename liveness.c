@@ -0,0 +1,228 @@
+#include "include/opentac.h"
+
+#define OPENTAC_WORD_BITS 64
+
+size_t opentac_stmt_use_refs(OpentacStmt *stmt, OpentacRegister **uses) {
+    size_t len = 0;
+
+    switch (stmt->tag.opcode) {
+    case OPENTAC_OP_ASSIGN_INDEX:
+    case OPENTAC_OP_LT:
+    case OPENTAC_OP_LE:
+    case OPENTAC_OP_EQ:
+    case OPENTAC_OP_NE:
+    case OPENTAC_OP_GT:
+    case OPENTAC_OP_GE:
+    case OPENTAC_OP_BITAND:
+    case OPENTAC_OP_BITXOR:
+    case OPENTAC_OP_BITOR:
+    case OPENTAC_OP_SHL:
+    case OPENTAC_OP_SHR:
+    case OPENTAC_OP_ROL:
+    case OPENTAC_OP_ROR:
+    case OPENTAC_OP_ADD:
+    case OPENTAC_OP_SUB:
+    case OPENTAC_OP_MUL:
+    case OPENTAC_OP_DIV:
+    case OPENTAC_OP_MOD:
+    case OPENTAC_OP_CALL:
+    case OPENTAC_OP_BRANCH | OPENTAC_OP_LT:
+    case OPENTAC_OP_BRANCH | OPENTAC_OP_LE:
+    case OPENTAC_OP_BRANCH | OPENTAC_OP_EQ:
+    case OPENTAC_OP_BRANCH | OPENTAC_OP_NE:
+    case OPENTAC_OP_BRANCH | OPENTAC_OP_GT:
+    case OPENTAC_OP_BRANCH | OPENTAC_OP_GE:
+        if (stmt->tag.right == OPENTAC_VAL_REG) {
+            uses[len++] = &stmt->right.regval;
+        }
+        /* fallthrough */
+    case OPENTAC_OP_NOT:
+    case OPENTAC_OP_NEG:
+    case OPENTAC_OP_REF:
+    case OPENTAC_OP_DEREF:
+    case OPENTAC_OP_COPY:
+    case OPENTAC_OP_PARAM:
+    case OPENTAC_OP_RETURN:
+    case OPENTAC_OP_BRANCH:
+        if (stmt->tag.left == OPENTAC_VAL_REG) {
+            uses[len++] = &stmt->left.regval;
+        }
+        break;
+    case OPENTAC_OP_INDEX_ASSIGN:
+        // the target of an indexed store is the base address, a use
+        uses[len++] = &stmt->target;
+        if (stmt->tag.left == OPENTAC_VAL_REG) {
+            uses[len++] = &stmt->left.regval;
+        }
+        if (stmt->tag.right == OPENTAC_VAL_REG) {
+            uses[len++] = &stmt->right.regval;
+        }
+        break;
+    }
+
+    return len;
+}
+
+size_t opentac_stmt_uses(const OpentacStmt *stmt, OpentacRegister *uses) {
+    OpentacRegister *refs[3];
+    size_t len = opentac_stmt_use_refs((OpentacStmt *) stmt, refs);
+    for (size_t i = 0; i < len; i++) {
+        uses[i] = *refs[i];
+    }
+    return len;
+}
+
+bool opentac_stmt_def(const OpentacStmt *stmt, OpentacRegister *def) {
+    switch (stmt->tag.opcode) {
+    case OPENTAC_OP_ASSIGN_INDEX:
+    case OPENTAC_OP_LT:
+    case OPENTAC_OP_LE:
+    case OPENTAC_OP_EQ:
+    case OPENTAC_OP_NE:
+    case OPENTAC_OP_GT:
+    case OPENTAC_OP_GE:
+    case OPENTAC_OP_BITAND:
+    case OPENTAC_OP_BITXOR:
+    case OPENTAC_OP_BITOR:
+    case OPENTAC_OP_SHL:
+    case OPENTAC_OP_SHR:
+    case OPENTAC_OP_ROL:
+    case OPENTAC_OP_ROR:
+    case OPENTAC_OP_ADD:
+    case OPENTAC_OP_SUB:
+    case OPENTAC_OP_MUL:
+    case OPENTAC_OP_DIV:
+    case OPENTAC_OP_MOD:
+    case OPENTAC_OP_CALL:
+    case OPENTAC_OP_NOT:
+    case OPENTAC_OP_NEG:
+    case OPENTAC_OP_REF:
+    case OPENTAC_OP_DEREF:
+    case OPENTAC_OP_COPY:
+    case OPENTAC_OP_PHI:
+        *def = stmt->target;
+        return true;
+    }
+
+    return false;
+}
+
+size_t opentac_liveness_index(const OpentacFnBuilder *fn, OpentacRegister reg) {
+    if (reg >= 0) {
+        return reg;
+    }
+
+    return (size_t) fn->reg + (size_t) (-(reg + 1));
+}
+
+OpentacRegister opentac_liveness_reg(const OpentacFnBuilder *fn, size_t index) {
+    if (index < (size_t) fn->reg) {
+        return index;
+    }
+
+    return -(OpentacRegister) (index - fn->reg) - 1;
+}
+
+static void opentac_bitset_set(uint64_t *set, size_t bit) {
+    set[bit / OPENTAC_WORD_BITS] |= (uint64_t) 1 << (bit % OPENTAC_WORD_BITS);
+}
+
+static bool opentac_bitset_get(const uint64_t *set, size_t bit) {
+    return (set[bit / OPENTAC_WORD_BITS] >> (bit % OPENTAC_WORD_BITS)) & 1;
+}
+
+// in = use | (out & ~def), returning whether in changed; written as plain
+// word loops so that the compiler can vectorize them
+static bool opentac_bitset_transfer(uint64_t *restrict in, const uint64_t *restrict out, const uint64_t *restrict use, const uint64_t *restrict def, size_t words) {
+    uint64_t changed = 0;
+    for (size_t i = 0; i < words; i++) {
+        uint64_t word = use[i] | (out[i] & ~def[i]);
+        changed |= word ^ in[i];
+        in[i] = word;
+    }
+    return changed != 0;
+}
+
+static void opentac_bitset_union(uint64_t *restrict dest, const uint64_t *restrict src, size_t words) {
+    for (size_t i = 0; i < words; i++) {
+        dest[i] |= src[i];
+    }
+}
+
+void opentac_liveness(struct OpentacLiveness *dest, struct OpentacArena *arena, OpentacFnBuilder *fn) {
+    opentac_assert(dest);
+    opentac_assert(arena);
+    opentac_assert(fn);
+
+    const struct OpentacCfg *cfg = opentac_fn_cfg(fn);
+    size_t nregs = (size_t) fn->reg + (size_t) -fn->param;
+    size_t words = (nregs + OPENTAC_WORD_BITS - 1) / OPENTAC_WORD_BITS;
+    size_t size = cfg->len * words;
+
+    dest->nregs = nregs;
+    dest->words = words;
+    dest->live_in = opentac_arena_calloc(arena, size ? size : 1, sizeof(uint64_t));
+    dest->live_out = opentac_arena_calloc(arena, size ? size : 1, sizeof(uint64_t));
+    uint64_t *use = opentac_arena_calloc(arena, size ? size : 1, sizeof(uint64_t));
+    uint64_t *def = opentac_arena_calloc(arena, size ? size : 1, sizeof(uint64_t));
+
+    // phi operands are read at the end of the block they come from, so they
+    // are live out of it without being live into the phi's block
+    for (size_t i = 0; i < fn->len; i++) {
+        const OpentacStmt *stmt = fn->stmts + i;
+        if (stmt->tag.opcode != OPENTAC_OP_PHI) {
+            continue;
+        }
+        const struct OpentacPhiArg *args = fn->phis.args + stmt->left.ui64val;
+        for (size_t j = 0; j < stmt->right.ui64val; j++) {
+            if (args[j].value.tag == OPENTAC_VAL_REG) {
+                opentac_bitset_set(dest->live_out + args[j].pred * words, opentac_liveness_index(fn, args[j].value.val.regval));
+            }
+        }
+    }
+
+    // upward exposed uses and definitions of every block
+    for (size_t b = 0; b < cfg->len; b++) {
+        uint64_t *buse = use + b * words;
+        uint64_t *bdef = def + b * words;
+        for (size_t i = cfg->blocks[b].start; i < cfg->blocks[b].end; i++) {
+            OpentacRegister regs[3];
+            size_t len = opentac_stmt_uses(fn->stmts + i, regs);
+            for (size_t j = 0; j < len; j++) {
+                size_t index = opentac_liveness_index(fn, regs[j]);
+                if (!opentac_bitset_get(bdef, index)) {
+                    opentac_bitset_set(buse, index);
+                }
+            }
+            OpentacRegister reg;
+            if (opentac_stmt_def(fn->stmts + i, &reg)) {
+                opentac_bitset_set(bdef, opentac_liveness_index(fn, reg));
+            }
+        }
+    }
+
+    // blocks are in statement order, so visiting them backwards converges
+    // in few rounds for code without loops
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t b = cfg->len; b-- > 0;) {
+            uint64_t *out = dest->live_out + b * words;
+            const struct OpentacBlock *block = cfg->blocks + b;
+            for (size_t j = 0; j < block->nsucc; j++) {
+                opentac_bitset_union(out, dest->live_in + cfg->succs[block->succ + j] * words, words);
+            }
+            if (opentac_bitset_transfer(dest->live_in + b * words, out, use + b * words, def + b * words, words)) {
+                changed = true;
+            }
+        }
+    }
+}
+
+bool opentac_liveness_live_in(const struct OpentacLiveness *live, size_t block, size_t index) {
+    return opentac_bitset_get(live->live_in + block * live->words, index);
+}
+
+bool opentac_liveness_live_out(const struct OpentacLiveness *live, size_t block, size_t index) {
+    return opentac_bitset_get(live->live_out + block * live->words, index);
+}
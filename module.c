@@ -0,0 +1,646 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "include/opentac.h"
+
+#define OPENTAC_MODULE_ALIGN(x) (((x) + 7) & ~(uint64_t) 7)
+
+// where each type or string went while writing; open addressing, power of
+// two capacity, a NULL key marks an empty slot
+struct OpentacOffsets {
+    size_t cap;
+    const void **keys;
+    uint64_t *offsets;
+};
+
+static void opentac_offsets(struct OpentacOffsets *map, struct OpentacArena *arena, size_t len) {
+    map->cap = 16;
+    while (map->cap < len * 2) {
+        map->cap *= 2;
+    }
+    map->keys = opentac_arena_calloc(arena, map->cap, sizeof(const void *));
+    map->offsets = opentac_arena_alloc(arena, map->cap * sizeof(uint64_t));
+}
+
+static size_t opentac_offsets_slot(const struct OpentacOffsets *map, const void *key) {
+    size_t mask = map->cap - 1;
+    size_t slot = ((uintptr_t) key >> 4) * 0x9e3779b97f4a7c15ull >> 32 & mask;
+    while (map->keys[slot] && map->keys[slot] != key) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static void opentac_offsets_put(struct OpentacOffsets *map, const void *key, uint64_t offset) {
+    size_t slot = opentac_offsets_slot(map, key);
+    map->keys[slot] = key;
+    map->offsets[slot] = offset;
+}
+
+static uint64_t opentac_offsets_get(const struct OpentacOffsets *map, const void *key) {
+    if (!key) {
+        return 0;
+    }
+    size_t slot = opentac_offsets_slot(map, key);
+    opentac_assertf(map->keys[slot], "%s", "reference to a type or string that the builder does not own");
+    return map->offsets[slot];
+}
+
+// the parameter or element types of `type`
+static size_t opentac_module_type_elems(const OpentacType *type, OpentacType *const **elems) {
+    switch (type->tag) {
+    case OPENTAC_TYPE_FN:
+        *elems = type->fn.params;
+        return type->fn.len;
+    case OPENTAC_TYPE_TUPLE:
+        *elems = type->tuple.elems;
+        return type->tuple.len;
+    case OPENTAC_TYPE_STRUCT:
+    case OPENTAC_TYPE_UNION:
+        *elems = type->struc.elems;
+        return type->struc.len;
+    }
+    *elems = NULL;
+    return 0;
+}
+
+static void opentac_module_put_val(const struct OpentacOffsets *strings, int tag, OpentacVal *val) {
+    if (tag == OPENTAC_VAL_NAMED) {
+        val->ui64val = opentac_offsets_get(strings, val->name);
+    }
+}
+
+int opentac_module_write(OpentacBuilder *builder, FILE *file) {
+    opentac_assert(builder);
+    opentac_assert(file);
+
+    struct OpentacArena scratch;
+    opentac_arena(&scratch);
+    const struct OpentacTypeset *typeset = &builder->typeset;
+
+    // lay the file out first, so that every reference is known before any
+    // of it is written
+    struct OpentacModuleHeader header = {
+        .magic = OPENTAC_MODULE_MAGIC,
+        .version = OPENTAC_MODULE_VERSION,
+        .stmt_size = sizeof(OpentacStmt),
+        .byte_order = OPENTAC_MODULE_BYTE_ORDER,
+        .nitems = builder->len,
+        .ntypes = typeset->len,
+    };
+    uint64_t size = sizeof(struct OpentacModuleHeader);
+    header.items = size;
+    size += builder->len * sizeof(struct OpentacModuleItem);
+    header.types = size;
+    size += typeset->len * sizeof(struct OpentacModuleType);
+
+    struct OpentacOffsets types;
+    opentac_offsets(&types, &scratch, typeset->len);
+    uint64_t *elems = opentac_arena_alloc(&scratch, (typeset->len ? typeset->len : 1) * sizeof(uint64_t));
+    for (size_t i = 0; i < typeset->len; i++) {
+        OpentacType *const *list;
+        opentac_offsets_put(&types, typeset->types[i], header.types + i * sizeof(struct OpentacModuleType));
+        elems[i] = size;
+        size += opentac_module_type_elems(typeset->types[i], &list) * sizeof(uint64_t);
+    }
+
+    // parameters, statements, phi operands and register names of every
+    // function, in that order
+    uint64_t *fns = opentac_arena_alloc(&scratch, (builder->len ? builder->len : 1) * sizeof(uint64_t));
+    for (size_t i = 0; i < builder->len; i++) {
+        const OpentacFnBuilder *fn = &builder->items[i]->fn;
+        fns[i] = size;
+        if (builder->items[i]->tag != OPENTAC_ITEM_FN) {
+            continue;
+        }
+        size += fn->params.len * sizeof(struct OpentacModuleParam);
+        size += fn->len * sizeof(OpentacStmt);
+        size += fn->phis.len * sizeof(struct OpentacModulePhiArg);
+        size += fn->reg_names.len * sizeof(struct OpentacModuleRegName);
+    }
+
+    struct OpentacOffsets strings;
+    opentac_offsets(&strings, &scratch, builder->interner.len);
+    header.strings = size;
+    for (size_t slot = 0; slot < builder->interner.cap; slot++) {
+        const OpentacString *string = builder->interner.table[slot];
+        if (string) {
+            opentac_offsets_put(&strings, string, size);
+            size += OPENTAC_MODULE_ALIGN(sizeof(OpentacString) + string->len + 1);
+        }
+    }
+    header.strings_size = size - header.strings;
+    header.size = size;
+
+    uint8_t *data = calloc(1, size);
+    opentac_assert(data);
+    memcpy(data, &header, sizeof(header));
+
+    for (size_t i = 0; i < typeset->len; i++) {
+        const OpentacType *type = typeset->types[i];
+        struct OpentacModuleType *dest = (struct OpentacModuleType *) (data + header.types) + i;
+        OpentacType *const *list;
+        dest->size = type->size;
+        dest->align = type->align;
+        dest->tag = type->tag;
+        dest->len = opentac_module_type_elems(type, &list);
+        dest->elems = dest->len ? elems[i] : 0;
+        for (size_t k = 0; k < dest->len; k++) {
+            ((uint64_t *) (data + elems[i]))[k] = opentac_offsets_get(&types, list[k]);
+        }
+        switch (type->tag) {
+        case OPENTAC_TYPE_PTR:
+            dest->type = opentac_offsets_get(&types, type->ptr.pointee);
+            break;
+        case OPENTAC_TYPE_FN:
+            dest->type = opentac_offsets_get(&types, type->fn.result);
+            break;
+        case OPENTAC_TYPE_STRUCT:
+        case OPENTAC_TYPE_UNION:
+            dest->name = opentac_offsets_get(&strings, type->struc.name);
+            break;
+        case OPENTAC_TYPE_ARRAY:
+            dest->type = opentac_offsets_get(&types, type->array.elem_type);
+            dest->len = type->array.len;
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < builder->len; i++) {
+        const OpentacItem *item = builder->items[i];
+        struct OpentacModuleItem *dest = (struct OpentacModuleItem *) (data + header.items) + i;
+        dest->tag = item->tag;
+        if (item->tag == OPENTAC_ITEM_DECL) {
+            dest->name = opentac_offsets_get(&strings, item->decl.name);
+            dest->type = opentac_offsets_get(&types, item->decl.type);
+            continue;
+        }
+
+        const OpentacFnBuilder *fn = &item->fn;
+        uint64_t at = fns[i];
+        dest->ssa = fn->ssa;
+        dest->name = opentac_offsets_get(&strings, fn->name);
+        dest->param = fn->param;
+        dest->reg = fn->reg;
+        dest->label = fn->label;
+
+        dest->nparams = fn->params.len;
+        dest->params = at;
+        struct OpentacModuleParam *params = (struct OpentacModuleParam *) (data + at);
+        for (size_t k = 0; k < fn->params.len; k++) {
+            params[k].name = opentac_offsets_get(&strings, opentac_fn_name_of(fn, -(OpentacRegister) k - 1));
+            params[k].type = opentac_offsets_get(&types, fn->params.params[k]);
+        }
+        at += fn->params.len * sizeof(struct OpentacModuleParam);
+
+        dest->len = fn->len;
+        dest->stmts = at;
+        OpentacStmt *stmts = (OpentacStmt *) (data + at);
+        memcpy(stmts, fn->stmts, fn->len * sizeof(OpentacStmt));
+        for (size_t k = 0; k < fn->len; k++) {
+            opentac_module_put_val(&strings, stmts[k].tag.left, &stmts[k].left);
+            opentac_module_put_val(&strings, stmts[k].tag.right, &stmts[k].right);
+        }
+        at += fn->len * sizeof(OpentacStmt);
+
+        dest->nphis = fn->phis.len;
+        dest->phis = at;
+        struct OpentacModulePhiArg *phis = (struct OpentacModulePhiArg *) (data + at);
+        for (size_t k = 0; k < fn->phis.len; k++) {
+            phis[k].pred = fn->phis.args[k].pred;
+            phis[k].tag = fn->phis.args[k].value.tag;
+            phis[k].val = fn->phis.args[k].value.val;
+            opentac_module_put_val(&strings, phis[k].tag, &phis[k].val);
+        }
+        at += fn->phis.len * sizeof(struct OpentacModulePhiArg);
+
+        dest->nreg_names = fn->reg_names.len;
+        dest->reg_names = at;
+        struct OpentacModuleRegName *names = (struct OpentacModuleRegName *) (data + at);
+        for (size_t slot = 0, k = 0; slot < fn->reg_names.cap; slot++) {
+            if (fn->reg_names.entries[slot].name) {
+                names[k].reg = fn->reg_names.entries[slot].reg;
+                names[k++].name = opentac_offsets_get(&strings, fn->reg_names.entries[slot].name);
+            }
+        }
+    }
+
+    for (size_t slot = 0; slot < builder->interner.cap; slot++) {
+        const OpentacString *string = builder->interner.table[slot];
+        if (string) {
+            OpentacString *dest = (OpentacString *) (data + opentac_offsets_get(&strings, string));
+            dest->len = string->len;
+            dest->cap = string->len + 1;
+            memcpy(dest->data, string->data, string->len + 1);
+        }
+    }
+
+    int status = fwrite(data, 1, size, file) == size ? OPENTAC_MODULE_OK : OPENTAC_MODULE_IO;
+    free(data);
+    opentac_arena_destroy(&scratch);
+    return status;
+}
+
+// whether `len` records of `size` bytes starting at `offset` lie in the module
+static bool opentac_module_range(const struct OpentacModule *module, uint64_t offset, uint64_t len, uint64_t size) {
+    if (offset % 8 || offset > module->size) {
+        return false;
+    }
+    return !len || len <= (module->size - offset) / size;
+}
+
+static bool opentac_module_type_ok(const struct OpentacModule *module, uint64_t offset) {
+    const struct OpentacModuleHeader *header = module->header;
+    return offset >= header->types
+        && (offset - header->types) % sizeof(struct OpentacModuleType) == 0
+        && (offset - header->types) / sizeof(struct OpentacModuleType) < header->ntypes;
+}
+
+// types are written in the order they were made, so only structs and unions
+// may refer to types after them
+static bool opentac_module_type_before(const struct OpentacModule *module, uint64_t offset, const struct OpentacModuleType *type) {
+    return opentac_module_type_ok(module, offset) && module->data + offset < (const uint8_t *) type;
+}
+
+const void *opentac_module_at(const struct OpentacModule *module, uint64_t offset) {
+    opentac_assert(module);
+
+    return offset && offset < module->size ? module->data + offset : NULL;
+}
+
+const OpentacString *opentac_module_string(const struct OpentacModule *module, uint64_t offset) {
+    opentac_assert(module);
+
+    const struct OpentacModuleHeader *header = module->header;
+    if (offset < header->strings || offset % 8 || header->strings_size < sizeof(OpentacString) || offset - header->strings > header->strings_size - sizeof(OpentacString)) {
+        return NULL;
+    }
+    const OpentacString *string = (const OpentacString *) (module->data + offset);
+    uint64_t room = header->strings + header->strings_size - offset - sizeof(OpentacString);
+    if (string->len >= room || string->data[string->len]) {
+        return NULL;
+    }
+    return string;
+}
+
+static bool opentac_module_type_check(const struct OpentacModule *module, const struct OpentacModuleType *type) {
+    bool named = type->tag == OPENTAC_TYPE_STRUCT || type->tag == OPENTAC_TYPE_UNION;
+    switch (type->tag) {
+    case OPENTAC_TYPE_PTR:
+    case OPENTAC_TYPE_ARRAY:
+        return opentac_module_type_before(module, type->type, type);
+    case OPENTAC_TYPE_FN:
+    case OPENTAC_TYPE_TUPLE:
+    case OPENTAC_TYPE_STRUCT:
+    case OPENTAC_TYPE_UNION:
+        break;
+    default:
+        return type->tag <= OPENTAC_TYPE_F64;
+    }
+
+    if (type->tag == OPENTAC_TYPE_FN && !opentac_module_type_before(module, type->type, type)) {
+        return false;
+    }
+    if (named && !opentac_module_string(module, type->name)) {
+        return false;
+    }
+    if (!opentac_module_range(module, type->elems, type->len, sizeof(uint64_t)) || (type->len && !type->elems)) {
+        return false;
+    }
+    const uint64_t *elems = (const uint64_t *) (module->data + type->elems);
+    for (size_t k = 0; k < type->len; k++) {
+        if (named ? !opentac_module_type_ok(module, elems[k]) : !opentac_module_type_before(module, elems[k], type)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool opentac_module_item_check(const struct OpentacModule *module, const struct OpentacModuleItem *item) {
+    if (!opentac_module_string(module, item->name)) {
+        return false;
+    }
+    if (item->tag == OPENTAC_ITEM_DECL) {
+        return opentac_module_type_ok(module, item->type);
+    }
+    if (item->tag != OPENTAC_ITEM_FN) {
+        return false;
+    }
+
+    bool ok = opentac_module_range(module, item->params, item->nparams, sizeof(struct OpentacModuleParam))
+        && opentac_module_range(module, item->stmts, item->len, sizeof(OpentacStmt))
+        && opentac_module_range(module, item->phis, item->nphis, sizeof(struct OpentacModulePhiArg))
+        && opentac_module_range(module, item->reg_names, item->nreg_names, sizeof(struct OpentacModuleRegName));
+    if (!ok) {
+        return false;
+    }
+    const struct OpentacModuleParam *params = (const struct OpentacModuleParam *) (module->data + item->params);
+    for (size_t k = 0; k < item->nparams; k++) {
+        if (!opentac_module_string(module, params[k].name) || !opentac_module_type_ok(module, params[k].type)) {
+            return false;
+        }
+    }
+    const struct OpentacModuleRegName *names = (const struct OpentacModuleRegName *) (module->data + item->reg_names);
+    for (size_t k = 0; k < item->nreg_names; k++) {
+        if (!opentac_module_string(module, names[k].name)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int opentac_module_view(struct OpentacModule *module, const void *data, size_t size) {
+    opentac_assert(module);
+    opentac_assert(data);
+
+    module->data = data;
+    module->size = size;
+    module->mapped = false;
+    module->resolved = false;
+    module->header = data;
+    const struct OpentacModuleHeader *header = module->header;
+    if (size < sizeof(struct OpentacModuleHeader) || memcmp(header->magic, OPENTAC_MODULE_MAGIC, sizeof(header->magic))) {
+        return OPENTAC_MODULE_BAD_MAGIC;
+    }
+    if (header->version != OPENTAC_MODULE_VERSION || header->stmt_size != sizeof(OpentacStmt) || header->byte_order != OPENTAC_MODULE_BYTE_ORDER) {
+        return OPENTAC_MODULE_BAD_VERSION;
+    }
+
+    bool ok = header->size == size
+        && opentac_module_range(module, header->items, header->nitems, sizeof(struct OpentacModuleItem))
+        && opentac_module_range(module, header->types, header->ntypes, sizeof(struct OpentacModuleType))
+        && opentac_module_range(module, header->strings, header->strings_size, 1);
+    if (!ok) {
+        return OPENTAC_MODULE_CORRUPT;
+    }
+    module->items = (const struct OpentacModuleItem *) (module->data + header->items);
+    module->types = (const struct OpentacModuleType *) (module->data + header->types);
+
+    for (size_t i = 0; i < header->ntypes; i++) {
+        if (!opentac_module_type_check(module, module->types + i)) {
+            return OPENTAC_MODULE_CORRUPT;
+        }
+    }
+    for (size_t i = 0; i < header->nitems; i++) {
+        if (!opentac_module_item_check(module, module->items + i)) {
+            return OPENTAC_MODULE_CORRUPT;
+        }
+    }
+    return OPENTAC_MODULE_OK;
+}
+
+int opentac_module_open(struct OpentacModule *module, const char *path) {
+    opentac_assert(module);
+    opentac_assert(path);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return OPENTAC_MODULE_IO;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return OPENTAC_MODULE_IO;
+    }
+    if ((size_t) st.st_size < sizeof(struct OpentacModuleHeader)) {
+        close(fd);
+        return OPENTAC_MODULE_BAD_MAGIC;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return OPENTAC_MODULE_IO;
+    }
+
+    int status = opentac_module_view(module, data, st.st_size);
+    if (status != OPENTAC_MODULE_OK) {
+        munmap(data, st.st_size);
+        return status;
+    }
+    module->mapped = true;
+    return OPENTAC_MODULE_OK;
+}
+
+void opentac_module_close(struct OpentacModule *module) {
+    opentac_assert(module);
+
+    if (module->mapped) {
+        munmap((void *) module->data, module->size);
+    }
+    module->data = NULL;
+    module->size = 0;
+    module->mapped = false;
+    module->resolved = false;
+}
+
+struct OpentacModuleLoad {
+    OpentacBuilder *builder;
+    const struct OpentacModule *module;
+    // types loaded so far, by index
+    OpentacType **types;
+    struct OpentacArena scratch;
+};
+
+static OpentacString *opentac_load_string(struct OpentacModuleLoad *load, uint64_t offset) {
+    const OpentacString *string = opentac_module_string(load->module, offset);
+    return string ? opentac_intern(load->builder, string->data) : NULL;
+}
+
+static bool opentac_load_val(struct OpentacModuleLoad *load, int tag, OpentacVal *val) {
+    if (tag == OPENTAC_VAL_NAMED) {
+        val->name = opentac_load_string(load, val->ui64val);
+        return val->name;
+    }
+    return true;
+}
+
+static OpentacType *opentac_load_type(struct OpentacModuleLoad *load, uint64_t offset) {
+    OpentacBuilder *builder = load->builder;
+    size_t index = (offset - load->module->header->types) / sizeof(struct OpentacModuleType);
+    if (load->types[index]) {
+        return load->types[index];
+    }
+
+    const struct OpentacModuleType *type = load->module->types + index;
+    OpentacType **elems = NULL;
+    OpentacString *name = NULL;
+    if (type->tag == OPENTAC_TYPE_STRUCT || type->tag == OPENTAC_TYPE_UNION) {
+        // named first, so that the elements can refer back to it
+        name = opentac_load_string(load, type->name);
+        load->types[index] = opentac_type_named(builder, type->tag, name);
+    }
+    if (type->tag == OPENTAC_TYPE_FN || type->tag == OPENTAC_TYPE_TUPLE || type->tag == OPENTAC_TYPE_STRUCT || type->tag == OPENTAC_TYPE_UNION) {
+        const uint64_t *list = (const uint64_t *) (load->module->data + type->elems);
+        elems = opentac_arena_alloc(&load->scratch, (type->len ? type->len : 1) * sizeof(OpentacType *));
+        for (size_t k = 0; k < type->len; k++) {
+            elems[k] = opentac_load_type(load, list[k]);
+        }
+    }
+
+    OpentacType *result = NULL;
+    switch (type->tag) {
+    case OPENTAC_TYPE_UNIT:
+        result = opentac_type_unit(builder);
+        break;
+    case OPENTAC_TYPE_NEVER:
+        result = opentac_type_never(builder);
+        break;
+    case OPENTAC_TYPE_BOOL:
+        result = opentac_type_bool(builder);
+        break;
+    case OPENTAC_TYPE_I8:
+        result = opentac_type_i8(builder);
+        break;
+    case OPENTAC_TYPE_I16:
+        result = opentac_type_i16(builder);
+        break;
+    case OPENTAC_TYPE_I32:
+        result = opentac_type_i32(builder);
+        break;
+    case OPENTAC_TYPE_I64:
+        result = opentac_type_i64(builder);
+        break;
+    case OPENTAC_TYPE_UI8:
+        result = opentac_type_ui8(builder);
+        break;
+    case OPENTAC_TYPE_UI16:
+        result = opentac_type_ui16(builder);
+        break;
+    case OPENTAC_TYPE_UI32:
+        result = opentac_type_ui32(builder);
+        break;
+    case OPENTAC_TYPE_UI64:
+        result = opentac_type_ui64(builder);
+        break;
+    case OPENTAC_TYPE_F32:
+        result = opentac_type_f32(builder);
+        break;
+    case OPENTAC_TYPE_F64:
+        result = opentac_type_f64(builder);
+        break;
+    case OPENTAC_TYPE_PTR:
+        result = opentac_type_ptr(builder, opentac_load_type(load, type->type));
+        break;
+    case OPENTAC_TYPE_FN:
+        result = opentac_type_fn(builder, type->len, elems, opentac_load_type(load, type->type));
+        break;
+    case OPENTAC_TYPE_TUPLE:
+        result = opentac_type_tuple(builder, type->len, elems);
+        break;
+    case OPENTAC_TYPE_STRUCT:
+        result = type->len ? opentac_type_struct(builder, name, type->len, elems) : load->types[index];
+        break;
+    case OPENTAC_TYPE_UNION:
+        result = type->len ? opentac_type_union(builder, name, type->len, elems) : load->types[index];
+        break;
+    case OPENTAC_TYPE_ARRAY:
+        result = opentac_type_array(builder, opentac_load_type(load, type->type), type->len);
+        break;
+    }
+    // layouts are worked out again rather than taken from the file
+    result->size = 0;
+    result->align = 0;
+    load->types[index] = result;
+    return result;
+}
+
+static bool opentac_load_fn(struct OpentacModuleLoad *load, const struct OpentacModuleItem *item, bool in_place) {
+    OpentacBuilder *builder = load->builder;
+    const uint8_t *data = load->module->data;
+
+    opentac_build_function(builder, opentac_load_string(load, item->name));
+    OpentacFnBuilder *fn = &(*builder->current)->fn;
+    const struct OpentacModuleParam *params = (const struct OpentacModuleParam *) (data + item->params);
+    for (size_t k = 0; k < item->nparams; k++) {
+        opentac_build_function_param(builder, opentac_load_string(load, params[k].name), opentac_load_type(load, params[k].type));
+    }
+    const struct OpentacModuleRegName *names = (const struct OpentacModuleRegName *) (data + item->reg_names);
+    for (size_t k = 0; k < item->nreg_names; k++) {
+        opentac_fn_bind_int(builder, opentac_load_string(load, names[k].name), (uint32_t) names[k].reg);
+    }
+    fn->param = item->param;
+    fn->reg = item->reg;
+    fn->label = item->label;
+    fn->ssa = item->ssa;
+
+    // statements used in place are full, so that inserting any moves them
+    // into the arena first
+    size_t cap = item->len ? item->len : 1;
+    OpentacStmt *stmts;
+    if (in_place && item->len) {
+        stmts = (OpentacStmt *) (data + item->stmts);
+    } else {
+        stmts = opentac_arena_alloc(&builder->arena, cap * sizeof(OpentacStmt));
+        memcpy(stmts, data + item->stmts, item->len * sizeof(OpentacStmt));
+    }
+    bool ok = true;
+    for (size_t k = 0; k < item->len; k++) {
+        ok = opentac_load_val(load, stmts[k].tag.left, &stmts[k].left) && ok;
+        ok = opentac_load_val(load, stmts[k].tag.right, &stmts[k].right) && ok;
+    }
+    fn->stmts = stmts;
+    fn->len = item->len;
+    fn->cap = cap;
+    fn->current = stmts + item->len;
+
+    if (item->nphis) {
+        const struct OpentacModulePhiArg *phis = (const struct OpentacModulePhiArg *) (data + item->phis);
+        fn->phis.args = opentac_arena_alloc(&builder->arena, item->nphis * sizeof(struct OpentacPhiArg));
+        fn->phis.len = item->nphis;
+        fn->phis.cap = item->nphis;
+        for (size_t k = 0; k < item->nphis; k++) {
+            fn->phis.args[k].pred = phis[k].pred;
+            fn->phis.args[k].value.tag = phis[k].tag;
+            fn->phis.args[k].value.val = phis[k].val;
+            ok = opentac_load_val(load, phis[k].tag, &fn->phis.args[k].value.val) && ok;
+        }
+    }
+    opentac_fn_invalidate(fn);
+    opentac_finish_function(builder);
+    return ok;
+}
+
+static int opentac_module_load_items(OpentacBuilder *builder, const struct OpentacModule *module, bool in_place) {
+    const struct OpentacModuleHeader *header = module->header;
+    struct OpentacModuleLoad load = {
+        .builder = builder,
+        .module = module,
+    };
+    opentac_arena(&load.scratch);
+    load.types = opentac_arena_calloc(&load.scratch, header->ntypes ? header->ntypes : 1, sizeof(OpentacType *));
+
+    // every type, referenced or not, so the typeset comes back whole
+    for (size_t i = 0; i < header->ntypes; i++) {
+        opentac_load_type(&load, header->types + i * sizeof(struct OpentacModuleType));
+    }
+    bool ok = true;
+    for (size_t i = 0; i < header->nitems; i++) {
+        const struct OpentacModuleItem *item = module->items + i;
+        if (item->tag == OPENTAC_ITEM_DECL) {
+            opentac_build_decl(builder, opentac_load_string(&load, item->name), opentac_load_type(&load, item->type));
+        } else {
+            ok = opentac_load_fn(&load, item, in_place) && ok;
+        }
+    }
+
+    opentac_arena_destroy(&load.scratch);
+    return ok ? OPENTAC_MODULE_OK : OPENTAC_MODULE_CORRUPT;
+}
+
+int opentac_module_load(OpentacBuilder *builder, const struct OpentacModule *module) {
+    opentac_assert(builder);
+    opentac_assert(module);
+    opentac_assert(!module->resolved);
+
+    return opentac_module_load_items(builder, module, false);
+}
+
+int opentac_module_load_in_place(OpentacBuilder *builder, struct OpentacModule *module) {
+    opentac_assert(builder);
+    opentac_assert(module);
+    opentac_assert(module->mapped && !module->resolved);
+
+    module->resolved = true;
+    return opentac_module_load_items(builder, module, true);
+}
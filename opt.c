@@ -0,0 +1,915 @@
+#include "include/opentac.h"
+
+enum {
+    OPENTAC_LATTICE_TOP,
+    OPENTAC_LATTICE_CONST,
+    OPENTAC_LATTICE_BOTTOM,
+};
+
+struct OpentacLattice {
+    int state;
+    OpentacValue value;
+};
+
+// statements reading each register, phis included, as ranges of one array
+struct OpentacUsers {
+    size_t *user;
+    size_t *users;
+};
+
+static void opentac_opt_users(struct OpentacUsers *dest, struct OpentacArena *arena, const OpentacFnBuilder *fn, size_t nregs) {
+    dest->user = opentac_arena_calloc(arena, nregs + 1, sizeof(size_t));
+
+    for (int pass = 0; pass < 2; pass++) {
+        size_t *fill = NULL;
+        if (pass) {
+            for (size_t index = 0; index < nregs; index++) {
+                dest->user[index + 1] += dest->user[index];
+            }
+            dest->users = opentac_arena_alloc(arena, (dest->user[nregs] ? dest->user[nregs] : 1) * sizeof(size_t));
+            fill = opentac_arena_alloc(arena, (nregs ? nregs : 1) * sizeof(size_t));
+            memcpy(fill, dest->user, nregs * sizeof(size_t));
+        }
+
+        for (size_t i = 0; i < fn->len; i++) {
+            const OpentacStmt *stmt = fn->stmts + i;
+            OpentacRegister regs[3];
+            size_t len = opentac_stmt_uses(stmt, regs);
+            if (stmt->tag.opcode == OPENTAC_OP_PHI) {
+                const struct OpentacPhiArg *args = fn->phis.args + stmt->left.ui64val;
+                for (size_t k = 0; k < stmt->right.ui64val; k++) {
+                    if (args[k].value.tag == OPENTAC_VAL_REG) {
+                        size_t index = opentac_liveness_index(fn, args[k].value.val.regval);
+                        if (pass) {
+                            dest->users[fill[index]++] = i;
+                        } else {
+                            ++dest->user[index + 1];
+                        }
+                    }
+                }
+            }
+            for (size_t j = 0; j < len; j++) {
+                size_t index = opentac_liveness_index(fn, regs[j]);
+                if (pass) {
+                    dest->users[fill[index]++] = i;
+                } else {
+                    ++dest->user[index + 1];
+                }
+            }
+        }
+    }
+}
+
+// values only fill as much of the union as their type needs, so they are
+// compared by those bits alone, which also keeps 0.0 and -0.0 apart
+static uint64_t opentac_opt_bits(int tag, OpentacVal val) {
+    switch (tag) {
+    case OPENTAC_VAL_ERROR:
+        return 0;
+    case OPENTAC_VAL_BOOL:
+        return val.bval;
+    case OPENTAC_VAL_I8:
+    case OPENTAC_VAL_UI8:
+        return val.ui8val;
+    case OPENTAC_VAL_I16:
+    case OPENTAC_VAL_UI16:
+        return val.ui16val;
+    case OPENTAC_VAL_REG:
+    case OPENTAC_VAL_I32:
+    case OPENTAC_VAL_UI32:
+    case OPENTAC_VAL_F32:
+        return val.ui32val;
+    case OPENTAC_VAL_NAMED:
+        return (uint64_t) (uintptr_t) val.name;
+    case OPENTAC_VAL_PTR:
+        return (uint64_t) (uintptr_t) val.ptrval;
+    }
+    return val.ui64val;
+}
+
+static bool opentac_opt_same(OpentacValue a, OpentacValue b) {
+    return a.tag == b.tag && opentac_opt_bits(a.tag, a.val) == opentac_opt_bits(b.tag, b.val);
+}
+
+// statements defining each register, in the same layout
+static void opentac_opt_defs(struct OpentacUsers *dest, struct OpentacArena *arena, const OpentacFnBuilder *fn, size_t nregs) {
+    dest->user = opentac_arena_calloc(arena, nregs + 1, sizeof(size_t));
+
+    OpentacRegister reg;
+    for (size_t i = 0; i < fn->len; i++) {
+        if (opentac_stmt_def(fn->stmts + i, &reg)) {
+            ++dest->user[opentac_liveness_index(fn, reg) + 1];
+        }
+    }
+    for (size_t index = 0; index < nregs; index++) {
+        dest->user[index + 1] += dest->user[index];
+    }
+
+    dest->users = opentac_arena_alloc(arena, (dest->user[nregs] ? dest->user[nregs] : 1) * sizeof(size_t));
+    size_t *fill = opentac_arena_alloc(arena, (nregs ? nregs : 1) * sizeof(size_t));
+    memcpy(fill, dest->user, nregs * sizeof(size_t));
+    for (size_t i = 0; i < fn->len; i++) {
+        if (opentac_stmt_def(fn->stmts + i, &reg)) {
+            size_t index = opentac_liveness_index(fn, reg);
+            dest->users[fill[index]++] = i;
+        }
+    }
+}
+
+// the block containing statement `stmt`
+static size_t opentac_opt_block_of(const struct OpentacCfg *cfg, size_t stmt) {
+    size_t lo = 0;
+    size_t hi = cfg->len;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (cfg->blocks[mid].start <= stmt) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// after statements were rewritten in place, `ends` holds the statement that
+// ended each block before; phi operands from blocks that lost their edge are
+// dropped and the rest are renumbered
+static void opentac_opt_repair_phis(OpentacFnBuilder *fn, const size_t *ends) {
+    const struct OpentacCfg *cfg = opentac_fn_cfg(fn);
+
+    for (size_t i = 0; i < fn->len; i++) {
+        OpentacStmt *stmt = fn->stmts + i;
+        if (stmt->tag.opcode != OPENTAC_OP_PHI) {
+            continue;
+        }
+
+        const struct OpentacBlock *block = cfg->blocks + opentac_opt_block_of(cfg, i);
+        struct OpentacPhiArg *args = fn->phis.args + stmt->left.ui64val;
+        size_t len = 0;
+        for (size_t k = 0; k < stmt->right.ui64val; k++) {
+            size_t end = ends[args[k].pred];
+            if (end == SIZE_MAX) {
+                continue;
+            }
+            size_t pred = opentac_opt_block_of(cfg, end);
+            if (cfg->blocks[pred].end != end + 1) {
+                continue;
+            }
+            for (size_t j = 0; j < block->npred; j++) {
+                if (cfg->preds[block->pred + j] == pred) {
+                    args[len] = args[k];
+                    args[len++].pred = pred;
+                    break;
+                }
+            }
+        }
+        stmt->right.ui64val = len;
+    }
+}
+
+static void opentac_opt_nop(OpentacStmt *stmt) {
+    stmt->tag.opcode = OPENTAC_OP_NOP;
+    stmt->tag.left = OPENTAC_VAL_ERROR;
+    stmt->tag.right = OPENTAC_VAL_ERROR;
+}
+
+// the edge from `pred` to `succ` as an index into the successor array
+static size_t opentac_opt_edge(const struct OpentacCfg *cfg, size_t pred, size_t succ) {
+    const struct OpentacBlock *block = cfg->blocks + pred;
+    for (size_t j = 0; j < block->nsucc; j++) {
+        if (cfg->succs[block->succ + j] == succ) {
+            return block->succ + j;
+        }
+    }
+    return SIZE_MAX;
+}
+
+struct OpentacSccp {
+    OpentacFnBuilder *fn;
+    const struct OpentacCfg *cfg;
+    struct OpentacLattice *lattice;
+    struct OpentacUsers users;
+    bool *executable;
+    bool *edges;
+    size_t *block_of;
+    // pending edges and statements
+    size_t nflow;
+    size_t *flow;
+    size_t nssa;
+    size_t *ssa;
+};
+
+static struct OpentacLattice opentac_sccp_operand(const struct OpentacSccp *sccp, int tag, OpentacVal val) {
+    struct OpentacLattice lattice = { .state = OPENTAC_LATTICE_BOTTOM };
+    if (tag == OPENTAC_VAL_REG) {
+        return sccp->lattice[opentac_liveness_index(sccp->fn, val.regval)];
+    }
+    if (opentac_fold_constant(tag)) {
+        lattice.state = OPENTAC_LATTICE_CONST;
+        lattice.value.tag = tag;
+        lattice.value.val = val;
+    }
+    return lattice;
+}
+
+static void opentac_sccp_lower(struct OpentacSccp *sccp, OpentacRegister reg, struct OpentacLattice lattice) {
+    size_t index = opentac_liveness_index(sccp->fn, reg);
+    struct OpentacLattice *old = sccp->lattice + index;
+    // registers that start out unknown stay that way
+    if (old->state == lattice.state || old->state == OPENTAC_LATTICE_BOTTOM) {
+        return;
+    }
+    // values only ever move down the lattice
+    opentac_assert(lattice.state > old->state);
+
+    *old = lattice;
+    for (size_t i = sccp->users.user[index]; i < sccp->users.user[index + 1]; i++) {
+        sccp->ssa[sccp->nssa++] = sccp->users.users[i];
+    }
+}
+
+static void opentac_sccp_mark(struct OpentacSccp *sccp, size_t edge) {
+    if (!sccp->edges[edge]) {
+        sccp->edges[edge] = true;
+        sccp->flow[sccp->nflow++] = edge;
+    }
+}
+
+// evaluates `left op right`, where `right` is unused for unary operators
+static struct OpentacLattice opentac_sccp_eval(int opcode, struct OpentacLattice left, struct OpentacLattice right, bool binary) {
+    struct OpentacLattice result = { .state = OPENTAC_LATTICE_BOTTOM };
+    if (left.state == OPENTAC_LATTICE_BOTTOM || (binary && right.state == OPENTAC_LATTICE_BOTTOM)) {
+        return result;
+    }
+    if (left.state == OPENTAC_LATTICE_TOP || (binary && right.state == OPENTAC_LATTICE_TOP)) {
+        result.state = OPENTAC_LATTICE_TOP;
+        return result;
+    }
+
+    bool folded = binary
+        ? opentac_fold_binary(opcode, left.value, right.value, &result.value)
+        : opentac_fold_unary(opcode, left.value, &result.value);
+    if (folded) {
+        result.state = OPENTAC_LATTICE_CONST;
+    }
+    return result;
+}
+
+static void opentac_sccp_visit(struct OpentacSccp *sccp, size_t i) {
+    OpentacFnBuilder *fn = sccp->fn;
+    const struct OpentacCfg *cfg = sccp->cfg;
+    OpentacStmt *stmt = fn->stmts + i;
+    size_t b = sccp->block_of[i];
+    const struct OpentacBlock *block = cfg->blocks + b;
+    int opcode = stmt->tag.opcode;
+    OpentacRegister reg;
+
+    if (!sccp->executable[b]) {
+        return;
+    }
+
+    if (opcode == OPENTAC_OP_PHI) {
+        struct OpentacLattice meet = { .state = OPENTAC_LATTICE_TOP };
+        const struct OpentacPhiArg *args = fn->phis.args + stmt->left.ui64val;
+        for (size_t k = 0; k < stmt->right.ui64val && meet.state != OPENTAC_LATTICE_BOTTOM; k++) {
+            size_t edge = opentac_opt_edge(cfg, args[k].pred, b);
+            if (edge == SIZE_MAX || !sccp->edges[edge]) {
+                continue;
+            }
+            struct OpentacLattice arg = opentac_sccp_operand(sccp, args[k].value.tag, args[k].value.val);
+            if (arg.state == OPENTAC_LATTICE_TOP) {
+                continue;
+            }
+            if (arg.state == OPENTAC_LATTICE_BOTTOM || meet.state == OPENTAC_LATTICE_CONST) {
+                if (arg.state == OPENTAC_LATTICE_BOTTOM || !opentac_opt_same(arg.value, meet.value)) {
+                    meet.state = OPENTAC_LATTICE_BOTTOM;
+                }
+                continue;
+            }
+            meet = arg;
+        }
+        opentac_sccp_lower(sccp, stmt->target, meet);
+    } else if ((opcode & OPENTAC_OP_BRANCH) == OPENTAC_OP_BRANCH && opcode != OPENTAC_OP_BRANCH) {
+        struct OpentacLattice left = opentac_sccp_operand(sccp, stmt->tag.left, stmt->left);
+        struct OpentacLattice right = opentac_sccp_operand(sccp, stmt->tag.right, stmt->right);
+        struct OpentacLattice cond = opentac_sccp_eval(opcode & ~OPENTAC_OP_BRANCH, left, right, true);
+        size_t target = cfg->labels[stmt->label];
+        for (size_t j = 0; j < block->nsucc; j++) {
+            size_t succ = cfg->succs[block->succ + j];
+            bool taken = cond.state == OPENTAC_LATTICE_BOTTOM
+                || (cond.state == OPENTAC_LATTICE_CONST && cond.value.val.bval == (succ == target));
+            // a branch to the next block reaches it either way
+            if (taken || (cond.state == OPENTAC_LATTICE_CONST && block->nsucc == 1)) {
+                opentac_sccp_mark(sccp, block->succ + j);
+            }
+        }
+        return;
+    } else if (opentac_stmt_def(stmt, &reg)) {
+        struct OpentacLattice result = { .state = OPENTAC_LATTICE_BOTTOM };
+        struct OpentacLattice left = opentac_sccp_operand(sccp, stmt->tag.left, stmt->left);
+        if (opcode >= OPENTAC_OP_LT && opcode <= OPENTAC_OP_MOD) {
+            struct OpentacLattice right = opentac_sccp_operand(sccp, stmt->tag.right, stmt->right);
+            result = opentac_sccp_eval(opcode, left, right, true);
+        } else if (opcode == OPENTAC_OP_NOT || opcode == OPENTAC_OP_NEG || opcode == OPENTAC_OP_COPY) {
+            result = opentac_sccp_eval(opcode, left, left, false);
+        }
+        opentac_sccp_lower(sccp, reg, result);
+    }
+
+    // every other way out of a block is taken unconditionally
+    if (i == block->end - 1) {
+        for (size_t j = 0; j < block->nsucc; j++) {
+            opentac_sccp_mark(sccp, block->succ + j);
+        }
+    }
+}
+
+// replaces a use of a constant register by the constant itself
+static void opentac_sccp_substitute(const struct OpentacSccp *sccp, int *tag, OpentacVal *val) {
+    if (*tag != OPENTAC_VAL_REG) {
+        return;
+    }
+    const struct OpentacLattice *lattice = sccp->lattice + opentac_liveness_index(sccp->fn, val->regval);
+    if (lattice->state == OPENTAC_LATTICE_CONST) {
+        *tag = lattice->value.tag;
+        *val = lattice->value.val;
+    }
+}
+
+static void opentac_sccp_rewrite(struct OpentacSccp *sccp, size_t nregs) {
+    OpentacFnBuilder *fn = sccp->fn;
+
+    // definitions stay, as copies, only where a constant cannot go
+    bool *kept = calloc(nregs ? nregs : 1, sizeof(bool));
+    opentac_assert(kept);
+    for (size_t i = 0; i < fn->len; i++) {
+        OpentacStmt *stmt = fn->stmts + i;
+        if (stmt->tag.opcode == OPENTAC_OP_INDEX_ASSIGN) {
+            kept[opentac_liveness_index(fn, stmt->target)] = true;
+        }
+    }
+
+    for (size_t i = 0; i < fn->len; i++) {
+        OpentacStmt *stmt = fn->stmts + i;
+        int opcode = stmt->tag.opcode;
+
+        if (opcode == OPENTAC_OP_PHI) {
+            struct OpentacPhiArg *args = fn->phis.args + stmt->left.ui64val;
+            for (size_t k = 0; k < stmt->right.ui64val; k++) {
+                opentac_sccp_substitute(sccp, &args[k].value.tag, &args[k].value.val);
+            }
+        } else {
+            OpentacRegister *uses[3];
+            size_t len = opentac_stmt_use_refs(stmt, uses);
+            for (size_t j = 0; j < len; j++) {
+                int tag;
+                if (uses[j] == &stmt->left.regval) {
+                    tag = stmt->tag.left;
+                    opentac_sccp_substitute(sccp, &tag, &stmt->left);
+                    stmt->tag.left = tag;
+                } else if (uses[j] == &stmt->right.regval) {
+                    tag = stmt->tag.right;
+                    opentac_sccp_substitute(sccp, &tag, &stmt->right);
+                    stmt->tag.right = tag;
+                }
+            }
+        }
+
+        OpentacRegister reg;
+        if (opentac_stmt_def(stmt, &reg)) {
+            size_t index = opentac_liveness_index(fn, reg);
+            const struct OpentacLattice *lattice = sccp->lattice + index;
+            if (lattice->state == OPENTAC_LATTICE_CONST) {
+                if (kept[index]) {
+                    stmt->tag.opcode = OPENTAC_OP_COPY;
+                    stmt->tag.left = lattice->value.tag;
+                    stmt->tag.right = OPENTAC_VAL_ERROR;
+                    stmt->left = lattice->value.val;
+                } else {
+                    opentac_opt_nop(stmt);
+                }
+            }
+            continue;
+        }
+
+        if ((opcode & OPENTAC_OP_BRANCH) == OPENTAC_OP_BRANCH && opcode != OPENTAC_OP_BRANCH && sccp->executable[sccp->block_of[i]]) {
+            OpentacValue cond;
+            OpentacValue left = { .tag = stmt->tag.left, .val = stmt->left };
+            OpentacValue right = { .tag = stmt->tag.right, .val = stmt->right };
+            if (opentac_fold_binary(opcode & ~OPENTAC_OP_BRANCH, left, right, &cond)) {
+                if (cond.val.bval) {
+                    stmt->tag.opcode = OPENTAC_OP_BRANCH | OPENTAC_OP_NOP;
+                    stmt->tag.left = OPENTAC_VAL_ERROR;
+                    stmt->tag.right = OPENTAC_VAL_ERROR;
+                } else {
+                    opentac_opt_nop(stmt);
+                }
+            }
+        }
+    }
+
+    free(kept);
+}
+
+void opentac_fn_sccp(OpentacBuilder *builder, OpentacFnBuilder *fn) {
+    opentac_assert(builder);
+    opentac_assert(fn);
+    opentac_assert(fn->ssa);
+
+    struct OpentacArena scratch;
+    opentac_arena(&scratch);
+
+    const struct OpentacCfg *cfg = opentac_fn_cfg(fn);
+    size_t nregs = (size_t) fn->reg + (size_t) -fn->param;
+    size_t nedges = cfg->len ? cfg->blocks[cfg->len - 1].succ + cfg->blocks[cfg->len - 1].nsucc : 0;
+
+    struct OpentacSccp sccp = {
+        .fn = fn,
+        .cfg = cfg,
+        .lattice = opentac_arena_calloc(&scratch, nregs ? nregs : 1, sizeof(struct OpentacLattice)),
+        .executable = opentac_arena_calloc(&scratch, cfg->len ? cfg->len : 1, sizeof(bool)),
+        .edges = opentac_arena_calloc(&scratch, nedges ? nedges : 1, sizeof(bool)),
+        .block_of = opentac_arena_alloc(&scratch, (fn->len ? fn->len : 1) * sizeof(size_t)),
+        .flow = opentac_arena_alloc(&scratch, (nedges ? nedges : 1) * sizeof(size_t)),
+    };
+    opentac_opt_users(&sccp.users, &scratch, fn, nregs);
+    // every register is lowered at most twice, and each time queues its users
+    sccp.ssa = opentac_arena_alloc(&scratch, (sccp.users.user[nregs] * 2 + 1) * sizeof(size_t));
+
+    for (size_t b = 0; b < cfg->len; b++) {
+        for (size_t i = cfg->blocks[b].start; i < cfg->blocks[b].end; i++) {
+            sccp.block_of[i] = b;
+        }
+    }
+
+    // parameters, memory and registers defined more than once (those whose
+    // address is taken) are unknown
+    size_t *defs = opentac_arena_calloc(&scratch, nregs ? nregs : 1, sizeof(size_t));
+    for (size_t i = 0; i < fn->len; i++) {
+        OpentacRegister reg;
+        if (opentac_stmt_def(fn->stmts + i, &reg)) {
+            ++defs[opentac_liveness_index(fn, reg)];
+        }
+        if (fn->stmts[i].tag.opcode == OPENTAC_OP_REF && fn->stmts[i].tag.left == OPENTAC_VAL_REG) {
+            defs[opentac_liveness_index(fn, fn->stmts[i].left.regval)] += 2;
+        }
+    }
+    for (size_t index = 0; index < nregs; index++) {
+        if (index >= (size_t) fn->reg || defs[index] > 1) {
+            sccp.lattice[index].state = OPENTAC_LATTICE_BOTTOM;
+        }
+    }
+
+    if (cfg->len) {
+        sccp.executable[0] = true;
+        for (size_t i = cfg->blocks[0].start; i < cfg->blocks[0].end; i++) {
+            opentac_sccp_visit(&sccp, i);
+        }
+    }
+    while (sccp.nflow || sccp.nssa) {
+        while (sccp.nflow) {
+            size_t edge = sccp.flow[--sccp.nflow];
+            size_t b = cfg->succs[edge];
+            if (sccp.executable[b]) {
+                // only the phis can see the new edge
+                for (size_t i = cfg->blocks[b].start; i < cfg->blocks[b].end; i++) {
+                    if (fn->stmts[i].tag.opcode == OPENTAC_OP_PHI) {
+                        opentac_sccp_visit(&sccp, i);
+                    }
+                }
+                continue;
+            }
+            sccp.executable[b] = true;
+            for (size_t i = cfg->blocks[b].start; i < cfg->blocks[b].end; i++) {
+                opentac_sccp_visit(&sccp, i);
+            }
+        }
+        while (sccp.nssa) {
+            opentac_sccp_visit(&sccp, sccp.ssa[--sccp.nssa]);
+        }
+    }
+
+    size_t *ends = opentac_arena_alloc(&scratch, (cfg->len ? cfg->len : 1) * sizeof(size_t));
+    for (size_t b = 0; b < cfg->len; b++) {
+        ends[b] = cfg->blocks[b].end - 1;
+    }
+    opentac_sccp_rewrite(&sccp, nregs);
+    opentac_fn_invalidate(fn);
+    opentac_opt_repair_phis(fn, ends);
+
+    opentac_arena_destroy(&scratch);
+}
+
+// an available computation, chained into its hash bucket
+struct OpentacGvnEntry {
+    size_t next;
+    size_t stmt;
+};
+
+struct OpentacGvn {
+    OpentacFnBuilder *fn;
+    size_t mask;
+    size_t *buckets;
+    size_t nentries;
+    struct OpentacGvnEntry *entries;
+};
+
+static bool opentac_gvn_pure(int opcode) {
+    return (opcode >= OPENTAC_OP_LT && opcode <= OPENTAC_OP_MOD)
+        || opcode == OPENTAC_OP_NOT
+        || opcode == OPENTAC_OP_NEG
+        || opcode == OPENTAC_OP_REF;
+}
+
+static bool opentac_gvn_commutes(int opcode) {
+    switch (opcode) {
+    case OPENTAC_OP_EQ:
+    case OPENTAC_OP_NE:
+    case OPENTAC_OP_BITAND:
+    case OPENTAC_OP_BITXOR:
+    case OPENTAC_OP_BITOR:
+    case OPENTAC_OP_ADD:
+    case OPENTAC_OP_MUL:
+        return true;
+    }
+    return false;
+}
+
+// the same operation on the same operands hashes and compares the same
+// whichever way round the operands of a commutative operator are
+static void opentac_gvn_canonical(OpentacStmt *stmt) {
+    if (!opentac_gvn_commutes(stmt->tag.opcode)) {
+        return;
+    }
+    uint64_t left = opentac_opt_bits(stmt->tag.left, stmt->left);
+    uint64_t right = opentac_opt_bits(stmt->tag.right, stmt->right);
+    if (stmt->tag.left > stmt->tag.right || (stmt->tag.left == stmt->tag.right && left > right)) {
+        int tag = stmt->tag.left;
+        OpentacVal val = stmt->left;
+        stmt->tag.left = stmt->tag.right;
+        stmt->left = stmt->right;
+        stmt->tag.right = tag;
+        stmt->right = val;
+    }
+}
+
+static size_t opentac_gvn_hash(const OpentacStmt *stmt) {
+    uint64_t hash = stmt->tag.opcode;
+    hash = hash * 31 + stmt->tag.left;
+    hash = hash * 31 + opentac_opt_bits(stmt->tag.left, stmt->left);
+    hash = hash * 31 + stmt->tag.right;
+    hash = hash * 31 + opentac_opt_bits(stmt->tag.right, stmt->right);
+    // fold the high bits in, the table only looks at the low ones
+    hash ^= hash >> 29;
+    hash *= 0xbf58476d1ce4e5b9;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+static bool opentac_gvn_equal(const OpentacStmt *a, const OpentacStmt *b) {
+    return a->tag.opcode == b->tag.opcode
+        && a->tag.left == b->tag.left
+        && a->tag.right == b->tag.right
+        && opentac_opt_bits(a->tag.left, a->left) == opentac_opt_bits(b->tag.left, b->left)
+        && opentac_opt_bits(a->tag.right, a->right) == opentac_opt_bits(b->tag.right, b->right);
+}
+
+// returns the statement computing the same value as `stmt` if there is one,
+// otherwise makes `stmt` available to the blocks it dominates
+static size_t opentac_gvn_lookup(struct OpentacGvn *gvn, size_t stmt) {
+    const OpentacStmt *stmts = gvn->fn->stmts;
+    size_t bucket = opentac_gvn_hash(stmts + stmt) & gvn->mask;
+    for (size_t e = gvn->buckets[bucket]; e != SIZE_MAX; e = gvn->entries[e].next) {
+        if (opentac_gvn_equal(stmts + gvn->entries[e].stmt, stmts + stmt)) {
+            return gvn->entries[e].stmt;
+        }
+    }
+
+    gvn->entries[gvn->nentries] = (struct OpentacGvnEntry) { .next = gvn->buckets[bucket], .stmt = stmt };
+    gvn->buckets[bucket] = gvn->nentries++;
+    return SIZE_MAX;
+}
+
+// entries are removed in the reverse order they were added in, so each one
+// is still at the head of its bucket
+static void opentac_gvn_unwind(struct OpentacGvn *gvn, size_t mark) {
+    const OpentacStmt *stmts = gvn->fn->stmts;
+    while (gvn->nentries > mark) {
+        const struct OpentacGvnEntry *entry = gvn->entries + --gvn->nentries;
+        gvn->buckets[opentac_gvn_hash(stmts + entry->stmt) & gvn->mask] = entry->next;
+    }
+}
+
+void opentac_fn_gvn(OpentacBuilder *builder, OpentacFnBuilder *fn) {
+    opentac_assert(builder);
+    opentac_assert(fn);
+    opentac_assert(fn->ssa);
+
+    struct OpentacArena scratch;
+    opentac_arena(&scratch);
+
+    const struct OpentacCfg *cfg = opentac_fn_cfg(fn);
+    size_t nregs = (size_t) fn->reg + (size_t) -fn->param;
+    struct OpentacDominators dom;
+    opentac_dominators(&dom, &scratch, fn);
+
+    size_t nbuckets = 16;
+    while (nbuckets < fn->len) {
+        nbuckets *= 2;
+    }
+    struct OpentacGvn gvn = {
+        .fn = fn,
+        .mask = nbuckets - 1,
+        .buckets = opentac_arena_alloc(&scratch, nbuckets * sizeof(size_t)),
+        .entries = opentac_arena_alloc(&scratch, (fn->len ? fn->len : 1) * sizeof(struct OpentacGvnEntry)),
+    };
+    memset(gvn.buckets, 0xff, nbuckets * sizeof(size_t));
+
+    // registers defined more than once, by taking their address or in
+    // unreachable code, hold different values at different points; the
+    // parameters are defined once on entry already
+    size_t *defs = opentac_arena_calloc(&scratch, nregs ? nregs : 1, sizeof(size_t));
+    for (size_t index = fn->reg; index < nregs; index++) {
+        defs[index] = 1;
+    }
+    for (size_t i = 0; i < fn->len; i++) {
+        const OpentacStmt *stmt = fn->stmts + i;
+        OpentacRegister reg;
+        if (opentac_stmt_def(stmt, &reg)) {
+            ++defs[opentac_liveness_index(fn, reg)];
+        }
+        if (stmt->tag.opcode == OPENTAC_OP_REF && stmt->tag.left == OPENTAC_VAL_REG) {
+            defs[opentac_liveness_index(fn, stmt->left.regval)] += 2;
+        }
+    }
+
+    OpentacRegister *leader = opentac_arena_alloc(&scratch, (nregs ? nregs : 1) * sizeof(OpentacRegister));
+    for (size_t index = 0; index < nregs; index++) {
+        leader[index] = opentac_liveness_reg(fn, index);
+    }
+
+    size_t *stack = opentac_arena_alloc(&scratch, (cfg->len ? cfg->len : 1) * sizeof(size_t));
+    size_t *marks = opentac_arena_alloc(&scratch, (cfg->len ? cfg->len : 1) * sizeof(size_t));
+    size_t *next = opentac_arena_calloc(&scratch, cfg->len ? cfg->len : 1, sizeof(size_t));
+    size_t depth = 0;
+    if (cfg->len) {
+        stack[depth++] = 0;
+    }
+
+    // walking the dominator tree, a computation is available wherever the
+    // one that made it is; operands are renamed to their leaders first, so
+    // chains of redundant computations and copies collapse as well
+    bool enter = true;
+    while (depth) {
+        size_t b = stack[depth - 1];
+        const struct OpentacBlock *block = cfg->blocks + b;
+
+        if (enter) {
+            marks[b] = gvn.nentries;
+            for (size_t i = block->start; i < block->end; i++) {
+                OpentacStmt *stmt = fn->stmts + i;
+                if (stmt->tag.opcode == OPENTAC_OP_PHI) {
+                    continue;
+                }
+
+                bool numbered = true;
+                OpentacRegister *uses[3];
+                size_t len = opentac_stmt_use_refs(stmt, uses);
+                for (size_t j = 0; j < len; j++) {
+                    size_t index = opentac_liveness_index(fn, *uses[j]);
+                    *uses[j] = leader[index];
+                    numbered = numbered && defs[index] == 1;
+                }
+
+                OpentacRegister reg;
+                if (!numbered || !opentac_stmt_def(stmt, &reg)) {
+                    continue;
+                }
+                size_t index = opentac_liveness_index(fn, reg);
+                if (defs[index] != 1) {
+                    continue;
+                }
+
+                // a copy has the value of its source, so it goes away
+                // like any other repeated computation
+                if (stmt->tag.opcode == OPENTAC_OP_COPY && stmt->tag.left == OPENTAC_VAL_REG) {
+                    leader[index] = stmt->left.regval;
+                    opentac_opt_nop(stmt);
+                    continue;
+                }
+                if (!opentac_gvn_pure(stmt->tag.opcode)) {
+                    continue;
+                }
+
+                opentac_gvn_canonical(stmt);
+                size_t found = opentac_gvn_lookup(&gvn, i);
+                if (found != SIZE_MAX) {
+                    leader[index] = fn->stmts[found].target;
+                    opentac_opt_nop(stmt);
+                }
+            }
+        }
+
+        if (next[b] < dom.child[b + 1] - dom.child[b]) {
+            stack[depth++] = dom.children[dom.child[b] + next[b]++];
+            enter = true;
+        } else {
+            opentac_gvn_unwind(&gvn, marks[b]);
+            --depth;
+            enter = false;
+        }
+    }
+
+    // phis may read values from blocks visited after theirs
+    for (size_t i = 0; i < fn->len; i++) {
+        OpentacStmt *stmt = fn->stmts + i;
+        if (stmt->tag.opcode != OPENTAC_OP_PHI) {
+            continue;
+        }
+        struct OpentacPhiArg *args = fn->phis.args + stmt->left.ui64val;
+        for (size_t k = 0; k < stmt->right.ui64val; k++) {
+            if (args[k].value.tag == OPENTAC_VAL_REG) {
+                args[k].value.val.regval = leader[opentac_liveness_index(fn, args[k].value.val.regval)];
+            }
+        }
+    }
+
+    opentac_fn_invalidate(fn);
+    opentac_arena_destroy(&scratch);
+}
+
+// statements that are kept whether or not anything reads what they define
+static bool opentac_dce_root(const OpentacStmt *stmt) {
+    OpentacRegister reg;
+    switch (stmt->tag.opcode) {
+    case OPENTAC_OP_NOP:
+        return false;
+    case OPENTAC_OP_CALL:
+        return true;
+    }
+    return !opentac_stmt_def(stmt, &reg);
+}
+
+struct OpentacDce {
+    OpentacFnBuilder *fn;
+    struct OpentacUsers defs;
+    bool *reachable;
+    bool *live;
+    bool *needed;
+    size_t *block_of;
+    size_t nwork;
+    size_t *work;
+};
+
+static void opentac_dce_need(struct OpentacDce *dce, OpentacRegister reg) {
+    size_t index = opentac_liveness_index(dce->fn, reg);
+    if (!dce->needed[index]) {
+        dce->needed[index] = true;
+        dce->work[dce->nwork++] = index;
+    }
+}
+
+static void opentac_dce_mark(struct OpentacDce *dce, size_t i) {
+    OpentacFnBuilder *fn = dce->fn;
+    const OpentacStmt *stmt = fn->stmts + i;
+    if (dce->live[i] || !dce->reachable[dce->block_of[i]]) {
+        return;
+    }
+    dce->live[i] = true;
+
+    OpentacRegister regs[3];
+    size_t len = opentac_stmt_uses(stmt, regs);
+    for (size_t j = 0; j < len; j++) {
+        opentac_dce_need(dce, regs[j]);
+    }
+    if (stmt->tag.opcode == OPENTAC_OP_PHI) {
+        const struct OpentacPhiArg *args = fn->phis.args + stmt->left.ui64val;
+        for (size_t k = 0; k < stmt->right.ui64val; k++) {
+            if (args[k].value.tag == OPENTAC_VAL_REG) {
+                opentac_dce_need(dce, args[k].value.val.regval);
+            }
+        }
+    }
+}
+
+void opentac_fn_dce(OpentacBuilder *builder, OpentacFnBuilder *fn) {
+    opentac_assert(builder);
+    opentac_assert(fn);
+
+    struct OpentacArena scratch;
+    opentac_arena(&scratch);
+
+    const struct OpentacCfg *cfg = opentac_fn_cfg(fn);
+    size_t nregs = (size_t) fn->reg + (size_t) -fn->param;
+
+    struct OpentacDce dce = {
+        .fn = fn,
+        .reachable = opentac_arena_calloc(&scratch, cfg->len ? cfg->len : 1, sizeof(bool)),
+        .live = opentac_arena_calloc(&scratch, fn->len ? fn->len : 1, sizeof(bool)),
+        .needed = opentac_arena_calloc(&scratch, nregs ? nregs : 1, sizeof(bool)),
+        .block_of = opentac_arena_alloc(&scratch, (fn->len ? fn->len : 1) * sizeof(size_t)),
+        .work = opentac_arena_alloc(&scratch, (nregs > cfg->len ? nregs : cfg->len ? cfg->len : 1) * sizeof(size_t)),
+    };
+    opentac_opt_defs(&dce.defs, &scratch, fn, nregs);
+
+    for (size_t b = 0; b < cfg->len; b++) {
+        for (size_t i = cfg->blocks[b].start; i < cfg->blocks[b].end; i++) {
+            dce.block_of[i] = b;
+        }
+    }
+
+    // blocks reachable from the entry, the work list doubling as a stack
+    if (cfg->len) {
+        dce.reachable[0] = true;
+        dce.work[dce.nwork++] = 0;
+    }
+    while (dce.nwork) {
+        const struct OpentacBlock *block = cfg->blocks + dce.work[--dce.nwork];
+        for (size_t j = 0; j < block->nsucc; j++) {
+            size_t succ = cfg->succs[block->succ + j];
+            if (!dce.reachable[succ]) {
+                dce.reachable[succ] = true;
+                dce.work[dce.nwork++] = succ;
+            }
+        }
+    }
+
+    // registers whose address is taken may be read through it
+    for (size_t i = 0; i < fn->len; i++) {
+        const OpentacStmt *stmt = fn->stmts + i;
+        if (stmt->tag.opcode == OPENTAC_OP_REF && stmt->tag.left == OPENTAC_VAL_REG) {
+            opentac_dce_need(&dce, stmt->left.regval);
+        }
+        if (opentac_dce_root(stmt)) {
+            opentac_dce_mark(&dce, i);
+        }
+    }
+    // outside of ssa form a register is needed as a whole, so all of its
+    // definitions are kept
+    while (dce.nwork) {
+        size_t index = dce.work[--dce.nwork];
+        for (size_t j = dce.defs.user[index]; j < dce.defs.user[index + 1]; j++) {
+            opentac_dce_mark(&dce, dce.defs.users[j]);
+        }
+    }
+
+    // compacting in place, remembering where each block now ends for the
+    // phis; a block emptied out keeps a nop so that its edges survive
+    size_t *ends = opentac_arena_alloc(&scratch, (cfg->len ? cfg->len : 1) * sizeof(size_t));
+    size_t at = 0;
+    for (size_t b = 0; b < cfg->len; b++) {
+        const struct OpentacBlock *block = cfg->blocks + b;
+        ends[b] = SIZE_MAX;
+        if (!dce.reachable[b]) {
+            continue;
+        }
+        size_t start = at;
+        for (size_t i = block->start; i < block->end; i++) {
+            if (dce.live[i]) {
+                fn->stmts[at++] = fn->stmts[i];
+            }
+        }
+        if (at == start && fn->ssa) {
+            fn->stmts[at] = fn->stmts[block->end - 1];
+            opentac_opt_nop(fn->stmts + at++);
+        }
+        if (at != start) {
+            ends[b] = at - 1;
+        }
+    }
+    fn->len = at;
+    opentac_fn_invalidate(fn);
+    if (fn->ssa) {
+        opentac_opt_repair_phis(fn, ends);
+    }
+
+    opentac_arena_destroy(&scratch);
+}
+
+void opentac_fn_optimize(OpentacBuilder *builder, OpentacFnBuilder *fn) {
+    opentac_assert(builder);
+    opentac_assert(fn);
+
+    bool ssa = fn->ssa;
+    if (!ssa) {
+        opentac_fn_to_ssa(builder, fn);
+    }
+    opentac_fn_sccp(builder, fn);
+    opentac_fn_gvn(builder, fn);
+    opentac_fn_dce(builder, fn);
+    if (!ssa) {
+        opentac_fn_from_ssa(builder, fn);
+        // drops the nops kept for blocks that were emptied
+        opentac_fn_dce(builder, fn);
+    }
+}
+
+void opentac_optimize(OpentacBuilder *builder) {
+    opentac_assert(builder);
+
+    for (size_t i = 0; i < builder->len; i++) {
+        if (builder->items[i]->tag == OPENTAC_ITEM_FN) {
+            opentac_fn_optimize(builder, &builder->items[i]->fn);
+        }
+    }
+}
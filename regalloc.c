@@ -1,59 +1,120 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
 #include "include/opentac.h"
 
-static void opentac_alloc_remove(void *dest, size_t size, size_t len, void *intervals, size_t idx);
+// an allocator needs a fixed amount for its pools and active sets, and some
+// more for every statement of its function
+#define ALLOC_ARENA_BASE ((size_t) 16 * 1024)
+#define ALLOC_ARENA_PER_STMT ((size_t) 768)
 
-static void opentac_alloc_sort_live(struct OpentacInterval *intervals, size_t lo, size_t hi);
-static size_t opentac_alloc_partition_live(struct OpentacInterval *intervals, size_t lo, size_t hi);
+static void opentac_alloc_init(struct OpentacRegalloc *alloc, const struct OpentacTarget *target);
+static void opentac_alloc_sort_live(struct OpentacRegalloc *alloc);
 
-static void opentac_alloc_sort_active(struct OpentacInterval *live, struct OpentacActive *active, size_t lo, size_t hi);
-static size_t opentac_alloc_partition_active(struct OpentacInterval *live, struct OpentacActive *active, size_t lo, size_t hi);
+static void opentac_alloc_heap_push(struct OpentacRegalloc *alloc, struct OpentacActives *active, struct OpentacActive entry);
+static struct OpentacActive opentac_alloc_heap_remove(struct OpentacRegalloc *alloc, struct OpentacActives *active, size_t pos);
+static void opentac_alloc_free_reg(struct OpentacRegalloc *alloc, struct OpentacRegClass *rc, struct OpentacActive active);
+static void opentac_alloc_inactivate(struct OpentacRegalloc *alloc, struct OpentacActives *inactive, struct OpentacActive entry);
 
-static void opentac_alloc_memswap(void *a, void *b, size_t size, void *temp);
+static void opentac_alloc_fn(struct OpentacRegalloc *alloc, OpentacBuilder *builder, OpentacFnBuilder *fn);
+static void opentac_alloc_typed(struct OpentacRegalloc *alloc, OpentacFnBuilder *fn, OpentacType **types);
 
-static void opentac_alloc_fn(struct OpentacRegalloc *alloc, OpentacFnBuilder *fn);
-static void opentac_alloc_stmt(struct OpentacRegalloc *alloc, OpentacFnBuilder *fn, OpentacStmt *stmt, size_t idx);
-
-struct OpentacPurposePair {
-    size_t index;
-    struct OpentacPurpose purpose;
+struct OpentacAllocJob {
+    OpentacBuilder *builder;
+    struct OpentacFnAllocs *dest;
+    // the types of the registers of every function, see opentac_alloc_parallel
+    OpentacType ***types;
+    const struct OpentacTarget *target;
+    atomic_size_t next;
 };
 
 void opentac_alloc_linscan(struct OpentacRegalloc *alloc, size_t len, const char **registers) {
-    alloc->registers.len = len;
-    alloc->registers.cap = 32;
-    alloc->registers.registers = malloc(sizeof(struct OpentacMReg) * alloc->registers.cap);
+    struct OpentacTarget target = { .files[OPENTAC_REGCLASS_INT] = { .len = len, .registers = registers } };
+    opentac_alloc_linscan_target(alloc, &target);
+}
 
-    for (size_t i = 0; i < len; i++) {
-        alloc->registers.registers[i].name = registers[i];
+static bool opentac_alloc_listed(const struct OpentacRegFile *file, const char *name) {
+    for (size_t i = 0; i < file->len; i++) {
+        if (!strcmp(file->registers[i], name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void opentac_alloc_pool(struct OpentacRegalloc *alloc, struct OpentacPool *pool, size_t cap) {
+    pool->len = 0;
+    pool->cap = cap > 32 ? cap : 32;
+    pool->registers = opentac_arena_alloc(&alloc->arena, sizeof(struct OpentacMReg) * pool->cap);
+}
+
+void opentac_alloc_linscan_target(struct OpentacRegalloc *alloc, const struct OpentacTarget *target) {
+    opentac_arena(&alloc->arena);
+    opentac_alloc_init(alloc, target);
+}
+
+// sets up `alloc`, whose arena is already there
+static void opentac_alloc_init(struct OpentacRegalloc *alloc, const struct OpentacTarget *target) {
+    alloc->target = *target;
+
+    for (int c = 0; c < OPENTAC_REGCLASSES; c++) {
+        struct OpentacRegClass *rc = alloc->classes + c;
+        const struct OpentacRegFile *file = target->files + c;
+        rc->shared = c != OPENTAC_REGCLASS_INT && !file->len;
+        opentac_alloc_pool(alloc, &rc->registers, file->len);
+        opentac_alloc_pool(alloc, &rc->clobbered, file->len);
+        for (size_t i = 0; i < file->len; i++) {
+            struct OpentacMReg reg = { .name = file->registers[i] };
+            if (opentac_alloc_listed(target->clobbered + c, reg.name)) {
+                rc->clobbered.registers[rc->clobbered.len++] = reg;
+            } else {
+                rc->registers.registers[rc->registers.len++] = reg;
+            }
+        }
+
+        rc->active.len = 0;
+        rc->active.cap = 32;
+        rc->active.actives = opentac_arena_alloc(&alloc->arena, sizeof(struct OpentacActive) * rc->active.cap);
+        rc->inactive.len = 0;
+        rc->inactive.cap = 32;
+        rc->inactive.actives = opentac_arena_alloc(&alloc->arena, sizeof(struct OpentacActive) * rc->inactive.cap);
     }
     
     alloc->stack.len = 0;
     alloc->stack.cap = 32;
-    alloc->stack.intervals = malloc(sizeof(struct OpentacInterval) * alloc->stack.cap);
+    alloc->stack.intervals = opentac_arena_alloc(&alloc->arena, sizeof(struct OpentacInterval) * alloc->stack.cap);
     
     alloc->live.len = 0;
     alloc->live.cap = 32;
-    alloc->live.intervals = malloc(sizeof(struct OpentacInterval) * alloc->live.cap);
-    
-    alloc->active.len = 0;
-    alloc->active.cap = 32;
-    alloc->active.actives = malloc(sizeof(struct OpentacActive) * alloc->active.cap);
+    alloc->live.intervals = opentac_arena_alloc(&alloc->arena, sizeof(struct OpentacInterval) * alloc->live.cap);
     
+    alloc->slots.len = 0;
+    alloc->slots.cap = 0;
+    alloc->slots.slots = NULL;
+
     alloc->offset = 0;
+    alloc->base = 0;
+
+    alloc->fns = (struct OpentacAllocFns) { 0 };
+    alloc->ncalls = 0;
+    alloc->callcap = 0;
+    alloc->calls = NULL;
+    alloc->moves = (struct OpentacMoves) { 0 };
+    alloc->edges = (struct OpentacMoves) { 0 };
 }
 
 void opentac_alloc_add(struct OpentacRegalloc *alloc, struct OpentacInterval *interval) {
     if (interval->stack || interval->ti.size > 8) {
         if (alloc->stack.len == alloc->stack.cap) {
+            alloc->stack.intervals = opentac_arena_realloc(&alloc->arena, alloc->stack.intervals, alloc->stack.cap * sizeof(struct OpentacInterval), alloc->stack.cap * 2 * sizeof(struct OpentacInterval));
             alloc->stack.cap *= 2;
-            alloc->stack.intervals = realloc(alloc->stack.intervals, alloc->stack.cap * sizeof(struct OpentacInterval));
         }
 
         alloc->stack.intervals[alloc->stack.len++] = *interval;
     } else {
         if (alloc->live.len == alloc->live.cap) {
+            alloc->live.intervals = opentac_arena_realloc(&alloc->arena, alloc->live.intervals, alloc->live.cap * sizeof(struct OpentacInterval), alloc->live.cap * 2 * sizeof(struct OpentacInterval));
             alloc->live.cap *= 2;
-            alloc->live.intervals = realloc(alloc->live.intervals, alloc->live.cap * sizeof(struct OpentacInterval));
         }
 
         alloc->live.intervals[alloc->live.len++] = *interval;
@@ -67,327 +128,1240 @@ void opentac_alloc_find(struct OpentacRegalloc *alloc, OpentacBuilder *builder)
         case OPENTAC_ITEM_DECL:
             break;
         case OPENTAC_ITEM_FN:
-            opentac_alloc_fn(alloc, &item->fn);
+            opentac_alloc_fn(alloc, builder, &item->fn);
             break;
         }
     }
 }
 
-void opentac_alloc_regtable(struct OpentacRegisterTable *dest, struct OpentacRegalloc *alloc) {
-    size_t cap = 32;
+void opentac_alloc_function(struct OpentacRegalloc *alloc, OpentacBuilder *builder, OpentacFnBuilder *fn) {
+    opentac_alloc_fn(alloc, builder, fn);
+}
+
+static void *opentac_alloc_worker(void *arg) {
+    struct OpentacAllocJob *job = arg;
+    for (;;) {
+        size_t i = atomic_fetch_add(&job->next, 1);
+        if (i >= job->dest->len) {
+            break;
+        }
+
+        // sized by the function, as small functions need far less than a
+        // default chunk
+        struct OpentacFnAlloc *fa = job->dest->allocs + i;
+        opentac_arena_with_cap(&fa->alloc.arena, ALLOC_ARENA_BASE + ALLOC_ARENA_PER_STMT * fa->fn->len);
+        opentac_alloc_init(&fa->alloc, job->target);
+        opentac_alloc_typed(&fa->alloc, fa->fn, job->types[i]);
+        opentac_alloc_allocate(&fa->alloc);
+        opentac_alloc_regtable(&fa->table, &fa->alloc);
+    }
+    return NULL;
+}
+
+void opentac_alloc_parallel(struct OpentacFnAllocs *dest, OpentacBuilder *builder, size_t len, const char **registers, size_t nthreads) {
+    struct OpentacTarget target = { .files[OPENTAC_REGCLASS_INT] = { .len = len, .registers = registers } };
+    opentac_alloc_parallel_target(dest, builder, &target, nthreads);
+}
+
+void opentac_alloc_parallel_target(struct OpentacFnAllocs *dest, OpentacBuilder *builder, const struct OpentacTarget *target, size_t nthreads) {
+    opentac_assert(dest);
+    opentac_assert(builder);
+
     dest->len = 0;
-    dest->cap = cap;
-    dest->entries = malloc(cap * sizeof(struct OpentacRegEntry));
+    dest->allocs = malloc(sizeof(struct OpentacFnAlloc) * (builder->len ? builder->len : 1));
+    for (size_t i = 0; i < builder->len; i++) {
+        if (builder->items[i]->tag == OPENTAC_ITEM_FN) {
+            dest->allocs[dest->len++].fn = &builder->items[i]->fn;
+        }
+    }
+
+    // inference may add types to the builder and layouts are filled in as
+    // they are asked for, so both happen here before any worker reads them
+    OpentacType ***types = malloc(sizeof(OpentacType **) * (dest->len ? dest->len : 1));
+    for (size_t i = 0; i < dest->len; i++) {
+        OpentacFnBuilder *fn = dest->allocs[i].fn;
+        size_t nregs = (size_t) fn->reg + (size_t) -fn->param;
+        types[i] = malloc(sizeof(OpentacType *) * (nregs ? nregs : 1));
+        opentac_fn_infer(builder, fn, types[i]);
+    }
+    opentac_typeset_layout(builder);
+
+    if (!nthreads) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = online > 0 ? (size_t) online : 1;
+    }
+    if (nthreads > dest->len) {
+        nthreads = dest->len;
+    }
+
+    struct OpentacAllocJob job = {
+        .builder = builder,
+        .dest = dest,
+        .types = types,
+        .target = target,
+    };
+    atomic_init(&job.next, 0);
 
-    for (size_t i = 0; i < alloc->live.len; i++) {
-        if (dest->len == dest->cap) {
-            dest->cap *= 2;
-            dest->entries = realloc(dest->entries, dest->cap * sizeof(struct OpentacRegEntry));
+    // the calling thread is one of the workers
+    pthread_t *threads = malloc(sizeof(pthread_t) * (nthreads ? nthreads : 1));
+    size_t spawned = 0;
+    for (; spawned + 1 < nthreads; spawned++) {
+        if (pthread_create(threads + spawned, NULL, opentac_alloc_worker, &job)) {
+            break;
         }
+    }
+    opentac_alloc_worker(&job);
+    for (size_t i = 0; i < spawned; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    for (size_t i = 0; i < dest->len; i++) {
+        free(types[i]);
+    }
+    free(types);
+}
 
-        dest->entries[dest->len].key = opentac_string(alloc->live.intervals[i].name);
-        dest->entries[dest->len++].purpose = alloc->live.intervals[i].purpose;
+void opentac_alloc_parallel_destroy(struct OpentacFnAllocs *dest) {
+    for (size_t i = 0; i < dest->len; i++) {
+        opentac_alloc_destroy(&dest->allocs[i].alloc);
     }
+    free(dest->allocs);
+    dest->len = 0;
+    dest->allocs = NULL;
+}
 
-    for (size_t i = 0; i < alloc->stack.len; i++) {
-        if (dest->len == dest->cap) {
-            dest->cap *= 2;
-            dest->entries = realloc(dest->entries, dest->cap * sizeof(struct OpentacRegEntry));
+void opentac_alloc_regtable(struct OpentacRegisterTable *dest, struct OpentacRegalloc *alloc) {
+    size_t len = alloc->live.len + alloc->stack.len;
+    dest->len = 0;
+    dest->cap = len ? len : 1;
+    dest->entries = opentac_arena_alloc(&alloc->arena, dest->cap * sizeof(struct OpentacRegEntry));
+
+    for (size_t i = 0; i < len; i++) {
+        const struct OpentacInterval *interval = i < alloc->live.len ? alloc->live.intervals + i : alloc->stack.intervals + i - alloc->live.len;
+        dest->entries[dest->len++] = (struct OpentacRegEntry) {
+            .key = NULL,
+            .reg = interval->reg,
+            .purpose = interval->purpose,
+            .split = interval->split,
+            .start = interval->start,
+            .end = interval->end,
+        };
+    }
+}
+
+void opentac_alloc_regtable_names(struct OpentacRegisterTable *table, struct OpentacRegalloc *alloc) {
+    for (size_t i = 0; i < table->len; i++) {
+        // t + 8 hexadecimals + \0
+        char name[10];
+        OpentacRegister reg = table->entries[i].reg;
+        if (reg < 0) {
+            snprintf(name, sizeof(name), "p%x", -(reg + 1));
+        } else {
+            snprintf(name, sizeof(name), "t%x", reg);
         }
+        table->entries[i].key = opentac_arena_string(&alloc->arena, name);
+    }
+}
 
-        dest->entries[dest->len].key = opentac_string(alloc->stack.intervals[i].name);
-        dest->entries[dest->len++].purpose = alloc->stack.intervals[i].purpose;
+// ranges of one register while they are built back to front
+struct OpentacRanges {
+    size_t len;
+    size_t cap;
+    struct OpentacRange *ranges;
+};
+
+static void opentac_alloc_range(struct OpentacRegalloc *alloc, struct OpentacRanges *ranges, OpentacLifetime start, OpentacLifetime end) {
+    // only the most recently added range can touch one that comes before it
+    if (ranges->len && ranges->ranges[ranges->len - 1].start <= end + 1) {
+        struct OpentacRange *last = ranges->ranges + ranges->len - 1;
+        if (start < last->start) {
+            last->start = start;
+        }
+        if (end > last->end) {
+            last->end = end;
+        }
+        return;
     }
+
+    if (ranges->len == ranges->cap) {
+        size_t cap = ranges->cap ? ranges->cap * 2 : 4;
+        ranges->ranges = opentac_arena_realloc(&alloc->arena, ranges->ranges, ranges->cap * sizeof(struct OpentacRange), cap * sizeof(struct OpentacRange));
+        ranges->cap = cap;
+    }
+    ranges->ranges[ranges->len++] = (struct OpentacRange) { .start = start, .end = end };
 }
 
-static void opentac_alloc_fn(struct OpentacRegalloc *alloc, OpentacFnBuilder *fn) {
-    for (size_t i = 0; i < fn->len; i++) {
+// use positions of one register, also built back to front
+struct OpentacUses {
+    size_t len;
+    size_t cap;
+    OpentacLifetime *uses;
+};
+
+static void opentac_alloc_use(struct OpentacRegalloc *alloc, struct OpentacUses *uses, OpentacLifetime pos) {
+    // a statement may use a register twice, or use and define it
+    if (uses->len && uses->uses[uses->len - 1] == pos) {
+        return;
+    }
+    if (uses->len == uses->cap) {
+        size_t cap = uses->cap ? uses->cap * 2 : 4;
+        uses->uses = opentac_arena_realloc(&alloc->arena, uses->uses, uses->cap * sizeof(OpentacLifetime), cap * sizeof(OpentacLifetime));
+        uses->cap = cap;
+    }
+    uses->uses[uses->len++] = pos;
+}
+
+static void opentac_alloc_block(struct OpentacRegalloc *alloc, OpentacFnBuilder *fn, const struct OpentacLiveness *liveness, size_t b, struct OpentacRanges *ranges, struct OpentacUses *positions, uint64_t *live) {
+    const struct OpentacBlock *block = fn->cfg.blocks + b;
+    OpentacLifetime first = alloc->base + block->start;
+    OpentacLifetime last = alloc->base + block->end - 1;
+
+    // everything live out is live across the whole block until shortened
+    // by its definition
+    memcpy(live, liveness->live_out + b * liveness->words, liveness->words * sizeof(uint64_t));
+    for (size_t w = 0; w < liveness->words; w++) {
+        for (uint64_t word = live[w]; word; word &= word - 1) {
+            size_t index = w * 64 + __builtin_ctzll(word);
+            opentac_alloc_range(alloc, ranges + index, first, last);
+        }
+    }
+
+    for (size_t i = block->end; i-- > block->start;) {
         OpentacStmt *stmt = fn->stmts + i;
-        opentac_alloc_stmt(alloc, fn, stmt, i);
-    }
-}
-
-static void opentac_alloc_stmt(struct OpentacRegalloc *alloc, OpentacFnBuilder *fn, OpentacStmt *stmt, size_t idx) {
-    switch (stmt->tag.opcode) {
-    case OPENTAC_OP_ASSIGN_INDEX:
-    case OPENTAC_OP_LT:
-    case OPENTAC_OP_LE:
-    case OPENTAC_OP_EQ:
-    case OPENTAC_OP_NE:
-    case OPENTAC_OP_GT:
-    case OPENTAC_OP_GE:
-    case OPENTAC_OP_BITAND:
-    case OPENTAC_OP_BITXOR:
-    case OPENTAC_OP_BITOR:
-    case OPENTAC_OP_SHL:
-    case OPENTAC_OP_SHR:
-    case OPENTAC_OP_ROL:
-    case OPENTAC_OP_ROR:
-    case OPENTAC_OP_ADD:
-    case OPENTAC_OP_SUB:
-    case OPENTAC_OP_MUL:
-    case OPENTAC_OP_DIV:
-    case OPENTAC_OP_MOD:
-    case OPENTAC_OP_CALL:
-        if (stmt->tag.right == OPENTAC_VAL_NAMED) {
-            for (size_t i = 0; i < alloc->live.len; i++) {
-                if (strcmp(alloc->live.intervals[i].name, stmt->right.name->data) == 0) {
-                    alloc->live.intervals[i].end = idx;
-                }
-            }
-        } else if (stmt->tag.right == OPENTAC_VAL_REG) {
-            const char *name = NULL;
-            for (size_t i = 0; i < fn->name_table.len; i++) {
-                if ((int32_t) fn->name_table.entries[i].ival == stmt->right.regval) {
-                    name = fn->name_table.entries[i].key->data;
-                    break;
-                }
-            }
-            if (name) {
-                for (size_t i = 0; i < alloc->live.len; i++) {
-                    if (strcmp(alloc->live.intervals[i].name, name) == 0) {
-                        alloc->live.intervals[i].end = idx;
-                    }
-                }
+        OpentacLifetime pos = alloc->base + i;
+
+        OpentacRegister reg;
+        if (opentac_stmt_def(stmt, &reg)) {
+            size_t index = opentac_liveness_index(fn, reg);
+            if ((live[index / 64] >> (index % 64)) & 1) {
+                ranges[index].ranges[ranges[index].len - 1].start = pos;
+                live[index / 64] &= ~((uint64_t) 1 << (index % 64));
+            } else {
+                // never used, but it still needs somewhere to go
+                opentac_alloc_range(alloc, ranges + index, pos, pos);
             }
+            opentac_alloc_use(alloc, positions + index, pos);
         }
-        /* fallthrough */
-    case OPENTAC_OP_NOT:
-    case OPENTAC_OP_NEG:
-    case OPENTAC_OP_REF:
-    case OPENTAC_OP_DEREF:
-    case OPENTAC_OP_COPY: {
-        if (stmt->tag.left == OPENTAC_VAL_NAMED) {
-            for (size_t i = 0; i < alloc->live.len; i++) {
-                if (strcmp(alloc->live.intervals[i].name, stmt->left.name->data) == 0) {
-                    alloc->live.intervals[i].end = idx;
-                }
-            }
-        } else if (stmt->tag.left == OPENTAC_VAL_REG) {
-            const char *name = NULL;
-            for (size_t i = 0; i < fn->name_table.len; i++) {
-                if ((int32_t) fn->name_table.entries[i].ival == stmt->left.regval) {
-                    name = fn->name_table.entries[i].key->data;
-                    break;
-                }
+
+        OpentacRegister uses[3];
+        size_t len = opentac_stmt_uses(stmt, uses);
+        for (size_t j = 0; j < len; j++) {
+            size_t index = opentac_liveness_index(fn, uses[j]);
+            opentac_alloc_range(alloc, ranges + index, first, pos);
+            opentac_alloc_use(alloc, positions + index, pos);
+            live[index / 64] |= (uint64_t) 1 << (index % 64);
+        }
+    }
+}
+
+// intervals come from a backward walk over the blocks seeded with their
+// live-out sets, so values live around a loop cover all of it and dead
+// stretches become holes; lifetimes are offset by `base`, so functions
+// sharing one allocator never overlap and never compete for registers
+static void opentac_alloc_fn(struct OpentacRegalloc *alloc, OpentacBuilder *builder, OpentacFnBuilder *fn) {
+    size_t nregs = (size_t) fn->reg + (size_t) -fn->param;
+    OpentacType **types = opentac_arena_alloc(&alloc->arena, (nregs ? nregs : 1) * sizeof(OpentacType *));
+    opentac_fn_infer(builder, fn, types);
+    opentac_alloc_typed(alloc, fn, types);
+}
+
+// the room a register of `type` takes; scalars need no more than their own
+// size, anything else is carried in a machine word at least, like the
+// backends carry it
+static OpentacTypeInfo opentac_alloc_typeinfo(OpentacType *type) {
+    OpentacTypeInfo ti = opentac_type_layout(type);
+    if (type->tag >= OPENTAC_TYPE_BOOL && type->tag <= OPENTAC_TYPE_PTR) {
+        return ti;
+    }
+    return (OpentacTypeInfo) { .size = ti.size > 8 ? ti.size : 8, .align = ti.align > 8 ? ti.align : 8 };
+}
+
+static int opentac_alloc_regclass(const OpentacType *type) {
+    return type->tag == OPENTAC_TYPE_F32 || type->tag == OPENTAC_TYPE_F64 ? OPENTAC_REGCLASS_FLOAT : OPENTAC_REGCLASS_INT;
+}
+
+// how many of the calls at `calls`, in increasing order, fall strictly
+// inside one of `ranges`, so that the value has to survive them
+static size_t opentac_alloc_crossed(const struct OpentacRange *ranges, size_t len, const OpentacLifetime *calls, size_t ncalls) {
+    size_t n = 0;
+    size_t r = 0;
+    for (size_t k = 0; k < ncalls; k++) {
+        while (r < len && ranges[r].end <= calls[k]) {
+            r++;
+        }
+        if (r == len) {
+            break;
+        }
+        if (ranges[r].start < calls[k]) {
+            n++;
+        }
+    }
+    return n;
+}
+
+// finds the calls of `fn` and the registers the calling convention passes
+// arguments and returns results in; arguments are the operands of the
+// params a call takes, numbered within their class
+static size_t opentac_alloc_calls(struct OpentacRegalloc *alloc, OpentacFnBuilder *fn, OpentacType **types, OpentacLifetime *calls, const char **prefer) {
+    const struct OpentacTarget *target = &alloc->target;
+    size_t *pending = opentac_arena_alloc(&alloc->arena, (fn->len ? fn->len : 1) * sizeof(size_t));
+    size_t npending = 0;
+    size_t ncalls = 0;
+    for (size_t i = 0; i < fn->len; i++) {
+        const OpentacStmt *stmt = fn->stmts + i;
+        if (stmt->tag.opcode == OPENTAC_OP_PARAM) {
+            pending[npending++] = i;
+            continue;
+        }
+        if (stmt->tag.opcode != OPENTAC_OP_CALL) {
+            continue;
+        }
+        calls[ncalls++] = alloc->base + i;
+
+        size_t n = stmt->right.ui64val;
+        size_t first = n < npending ? npending - n : 0;
+        size_t used[OPENTAC_REGCLASSES] = { 0 };
+        for (size_t k = first; k < npending; k++) {
+            const OpentacStmt *param = fn->stmts + pending[k];
+            bool reg = param->tag.left == OPENTAC_VAL_REG;
+            size_t index = reg ? opentac_liveness_index(fn, param->left.regval) : 0;
+            int rc = reg ? opentac_alloc_regclass(types[index]) : param->tag.left == OPENTAC_VAL_F32 || param->tag.left == OPENTAC_VAL_F64 ? OPENTAC_REGCLASS_FLOAT : OPENTAC_REGCLASS_INT;
+            size_t arg = used[rc]++;
+            if (reg && !prefer[index] && arg < target->args[rc].len) {
+                prefer[index] = target->args[rc].registers[arg];
             }
-            if (name) {
-                for (size_t i = 0; i < alloc->live.len; i++) {
-                    if (strcmp(alloc->live.intervals[i].name, name) == 0) {
-                        alloc->live.intervals[i].end = idx;
-                    }
-                }
+        }
+        npending = first;
+
+        OpentacRegister result;
+        if (opentac_stmt_def(stmt, &result)) {
+            size_t index = opentac_liveness_index(fn, result);
+            if (!prefer[index]) {
+                prefer[index] = target->results[opentac_alloc_regclass(types[index])];
             }
         }
-        
-        int stack = 0;
-        // t + 8 hexadecimals + \0
-        char *name = malloc(10);
-        snprintf(name, 10, "t%x", stmt->target);
-        // TODO: placeholder typeinfo
-        OpentacTypeInfo ti = { .size = 8, .align = 8 };
+    }
+    return ncalls;
+}
+
+static void opentac_alloc_typed(struct OpentacRegalloc *alloc, OpentacFnBuilder *fn, OpentacType **types) {
+    struct OpentacLiveness liveness;
+    opentac_liveness(&liveness, &alloc->arena, fn);
+
+    struct OpentacRanges *ranges = opentac_arena_calloc(&alloc->arena, liveness.nregs ? liveness.nregs : 1, sizeof(struct OpentacRanges));
+    struct OpentacUses *positions = opentac_arena_calloc(&alloc->arena, liveness.nregs ? liveness.nregs : 1, sizeof(struct OpentacUses));
+    uint64_t *live = opentac_arena_alloc(&alloc->arena, (liveness.words ? liveness.words : 1) * sizeof(uint64_t));
+    for (size_t b = fn->cfg.len; b-- > 0;) {
+        opentac_alloc_block(alloc, fn, &liveness, b, ranges, positions, live);
+    }
+
+    // copies that start an interval hint at sharing the source's register;
+    // the ranges are still back to front, so the first one is last
+    OpentacRegister *hints = opentac_arena_alloc(&alloc->arena, (liveness.nregs ? liveness.nregs : 1) * sizeof(OpentacRegister));
+    bool *hinted = opentac_arena_calloc(&alloc->arena, liveness.nregs ? liveness.nregs : 1, sizeof(bool));
+    for (size_t i = 0; i < fn->len; i++) {
+        const OpentacStmt *stmt = fn->stmts + i;
+        if (stmt->tag.opcode != OPENTAC_OP_COPY || stmt->tag.left != OPENTAC_VAL_REG) {
+            continue;
+        }
+        size_t index = opentac_liveness_index(fn, stmt->target);
+        struct OpentacRanges *list = ranges + index;
+        if (list->len && list->ranges[list->len - 1].start == alloc->base + i) {
+            hints[index] = stmt->left.regval;
+            hinted[index] = true;
+        }
+    }
+
+    // calls are kept for the whole allocator, so that the pieces of split
+    // intervals can count the ones they cross again
+    if (alloc->ncalls + fn->len > alloc->callcap) {
+        size_t cap = alloc->callcap ? alloc->callcap : 16;
+        while (cap < alloc->ncalls + fn->len) {
+            cap *= 2;
+        }
+        alloc->calls = opentac_arena_realloc(&alloc->arena, alloc->calls, alloc->callcap * sizeof(OpentacLifetime), cap * sizeof(OpentacLifetime));
+        alloc->callcap = cap;
+    }
+    OpentacLifetime *calls = alloc->calls + alloc->ncalls;
+    const char **prefer = opentac_arena_calloc(&alloc->arena, liveness.nregs ? liveness.nregs : 1, sizeof(const char *));
+    size_t ncalls = opentac_alloc_calls(alloc, fn, types, calls, prefer);
+    alloc->ncalls += ncalls;
+
+    if (alloc->fns.len == alloc->fns.cap) {
+        size_t cap = alloc->fns.cap ? alloc->fns.cap * 2 : 4;
+        alloc->fns.fns = opentac_arena_realloc(&alloc->arena, alloc->fns.fns, alloc->fns.cap * sizeof(struct OpentacAllocFn), cap * sizeof(struct OpentacAllocFn));
+        alloc->fns.cap = cap;
+    }
+    alloc->fns.fns[alloc->fns.len++] = (struct OpentacAllocFn) { .fn = fn, .base = alloc->base, .liveness = liveness };
+
+    for (size_t index = 0; index < liveness.nregs; index++) {
+        struct OpentacRanges *list = ranges + index;
+        if (!list->len) {
+            continue;
+        }
+        for (size_t i = 0; i < list->len / 2; i++) {
+            struct OpentacRange temp = list->ranges[i];
+            list->ranges[i] = list->ranges[list->len - 1 - i];
+            list->ranges[list->len - 1 - i] = temp;
+        }
+        struct OpentacUses *uses = positions + index;
+        for (size_t i = 0; i < uses->len / 2; i++) {
+            OpentacLifetime temp = uses->uses[i];
+            uses->uses[i] = uses->uses[uses->len - 1 - i];
+            uses->uses[uses->len - 1 - i] = temp;
+        }
+
+        OpentacTypeInfo ti = opentac_alloc_typeinfo(types[index]);
         struct OpentacPurpose purpose = { .tag = OPENTAC_REG_SPILLED, .stack = 0 };
-        OpentacLifetime start = idx;
-        OpentacLifetime end = idx;
         struct OpentacInterval interval = {
-            .stack = stack,
-            .name = name,
+            .stack = 0,
+            .regclass = opentac_alloc_regclass(types[index]),
+            .reg = opentac_liveness_reg(fn, index),
             .ti = ti,
             .purpose = purpose,
-            .start = start,
-            .end = end
+            .start = list->ranges[0].start,
+            .end = list->ranges[list->len - 1].end,
+            .nranges = list->len,
+            .ranges = list->ranges,
+            .hinted = hinted[index],
+            .hint = hints[index],
+            .calls = opentac_alloc_crossed(list->ranges, list->len, calls, ncalls),
+            .prefer = prefer[index],
+            .nuses = uses->len,
+            .uses = uses->uses,
         };
         opentac_alloc_add(alloc, &interval);
     }
-        /* fallthrough */
-    case OPENTAC_OP_INDEX_ASSIGN:
-    case OPENTAC_OP_BRANCH | OPENTAC_OP_LT:
-    case OPENTAC_OP_BRANCH | OPENTAC_OP_LE:
-    case OPENTAC_OP_BRANCH | OPENTAC_OP_EQ:
-    case OPENTAC_OP_BRANCH | OPENTAC_OP_NE:
-    case OPENTAC_OP_BRANCH | OPENTAC_OP_GT:
-    case OPENTAC_OP_BRANCH | OPENTAC_OP_GE:
-        if (stmt->tag.right == OPENTAC_VAL_NAMED) {
-            for (size_t i = 0; i < alloc->live.len; i++) {
-                if (strcmp(alloc->live.intervals[i].name, stmt->right.name->data) == 0) {
-                    alloc->live.intervals[i].end = idx;
-                }
+
+    alloc->base += fn->len;
+}
+
+// the ranges of `interval`, which is one range if none were given
+static const struct OpentacRange *opentac_alloc_ranges(const struct OpentacInterval *interval, struct OpentacRange *whole, size_t *len) {
+    if (interval->nranges) {
+        *len = interval->nranges;
+        return interval->ranges;
+    }
+    *whole = (struct OpentacRange) { .start = interval->start, .end = interval->end };
+    *len = 1;
+    return whole;
+}
+
+// whether ranges `a` and `b` meet; `a` may be a slot's, which grows long,
+// so it is searched for the first range not ending before `b` starts
+static bool opentac_alloc_overlaps(const struct OpentacRange *a, size_t alen, const struct OpentacRange *b, size_t blen) {
+    size_t i = 0;
+    size_t hi = alen;
+    while (blen && i < hi) {
+        size_t mid = i + (hi - i) / 2;
+        if (a[mid].end < b[0].start) {
+            i = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    size_t j = 0;
+    while (i < alen && j < blen) {
+        if (a[i].start <= b[j].end && b[j].start <= a[i].end) {
+            return true;
+        }
+        if (a[i].end < b[j].end) {
+            i++;
+        } else {
+            j++;
+        }
+    }
+    return false;
+}
+
+// merges the ranges of an interval into those of the slot, growing them
+// in place and filling from the back so nothing is copied twice
+static void opentac_alloc_occupy(struct OpentacRegalloc *alloc, struct OpentacSlot *slot, const struct OpentacRange *ranges, size_t len) {
+    if (slot->nranges + len > slot->cap) {
+        size_t cap = slot->cap ? slot->cap * 2 : 16;
+        while (cap < slot->nranges + len) {
+            cap *= 2;
+        }
+        slot->ranges = opentac_arena_realloc(&alloc->arena, slot->ranges, slot->cap * sizeof(struct OpentacRange), cap * sizeof(struct OpentacRange));
+        slot->cap = cap;
+    }
+    size_t i = slot->nranges;
+    size_t j = len;
+    size_t n = slot->nranges + len;
+    while (j) {
+        bool mine = i && slot->ranges[i - 1].start > ranges[j - 1].start;
+        slot->ranges[--n] = mine ? slot->ranges[--i] : ranges[--j];
+    }
+    slot->nranges += len;
+}
+
+// the slot `interval` is spilled to: `prefer` if it is a slot the interval
+// never meets, else one whose intervals it never meets, preferring the
+// smallest that already fits and otherwise the one that grows least, or a
+// new one; slots only get their offsets at the end
+static size_t opentac_alloc_slot(struct OpentacRegalloc *alloc, const struct OpentacInterval *interval, size_t prefer) {
+    struct OpentacRange whole;
+    size_t len;
+    const struct OpentacRange *ranges = opentac_alloc_ranges(interval, &whole, &len);
+    OpentacTypeInfo ti = interval->ti;
+
+    size_t best = alloc->slots.len;
+    if (prefer < alloc->slots.len && !opentac_alloc_overlaps(alloc->slots.slots[prefer].ranges, alloc->slots.slots[prefer].nranges, ranges, len)) {
+        best = prefer;
+    }
+    for (size_t k = 0; best != prefer && k < alloc->slots.len; k++) {
+        const struct OpentacSlot *slot = alloc->slots.slots + k;
+        if (opentac_alloc_overlaps(slot->ranges, slot->nranges, ranges, len)) {
+            continue;
+        }
+        if (best == alloc->slots.len) {
+            best = k;
+            continue;
+        }
+        const struct OpentacSlot *other = alloc->slots.slots + best;
+        bool fits = slot->ti.size >= ti.size && slot->ti.align >= ti.align;
+        bool other_fits = other->ti.size >= ti.size && other->ti.align >= ti.align;
+        if (fits != other_fits ? fits : fits ? slot->ti.size < other->ti.size : slot->ti.size > other->ti.size) {
+            best = k;
+        }
+    }
+
+    if (best == alloc->slots.len) {
+        if (alloc->slots.len == alloc->slots.cap) {
+            size_t cap = alloc->slots.cap ? alloc->slots.cap * 2 : 16;
+            alloc->slots.slots = opentac_arena_realloc(&alloc->arena, alloc->slots.slots, alloc->slots.cap * sizeof(struct OpentacSlot), cap * sizeof(struct OpentacSlot));
+            alloc->slots.cap = cap;
+        }
+        alloc->slots.slots[alloc->slots.len++] = (struct OpentacSlot) { .ti = { .size = 0, .align = 1 } };
+    }
+
+    struct OpentacSlot *slot = alloc->slots.slots + best;
+    slot->ti.align = ti.align > slot->ti.align ? ti.align : slot->ti.align;
+    slot->ti.size = ti.size > slot->ti.size ? ti.size : slot->ti.size;
+    slot->ti.size = (slot->ti.size + slot->ti.align - 1) & ~(slot->ti.align - 1);
+    opentac_alloc_occupy(alloc, slot, ranges, len);
+    return best;
+}
+
+static int opentac_alloc_slot_cmp(const void *a, const void *b) {
+    const struct OpentacSlot *x = *(const struct OpentacSlot *const *) a;
+    const struct OpentacSlot *y = *(const struct OpentacSlot *const *) b;
+    if (x->ti.align != y->ti.align) {
+        return x->ti.align < y->ti.align ? 1 : -1;
+    }
+    return x->ti.size < y->ti.size ? 1 : x->ti.size > y->ti.size ? -1 : 0;
+}
+
+// places the slots below what the frame holds so far, the most aligned
+// first so that sizes, being multiples of their alignment, leave no gaps
+static void opentac_alloc_place_slots(struct OpentacRegalloc *alloc) {
+    size_t len = alloc->slots.len;
+    struct OpentacSlot **order = opentac_arena_alloc(&alloc->arena, (len ? len : 1) * sizeof(struct OpentacSlot *));
+    for (size_t k = 0; k < len; k++) {
+        order[k] = alloc->slots.slots + k;
+    }
+    qsort(order, len, sizeof(struct OpentacSlot *), opentac_alloc_slot_cmp);
+    for (size_t k = 0; k < len; k++) {
+        // addressed by how far below the frame base they start, so they
+        // stay aligned as long as the base is
+        OpentacTypeInfo ti = order[k]->ti;
+        alloc->offset = (alloc->offset + ti.size + ti.align - 1) & ~(uint64_t) (ti.align - 1);
+        order[k]->offset = alloc->offset;
+    }
+}
+
+// the class whose registers `interval` takes
+static struct OpentacRegClass *opentac_alloc_class(struct OpentacRegalloc *alloc, const struct OpentacInterval *interval) {
+    struct OpentacRegClass *rc = alloc->classes + interval->regclass;
+    return rc->shared ? alloc->classes + OPENTAC_REGCLASS_INT : rc;
+}
+
+// whether `interval` is live at `pos`, which lies in its lifetime
+static bool opentac_alloc_covers(const struct OpentacInterval *interval, OpentacLifetime pos) {
+    if (!interval->nranges) {
+        return interval->start <= pos && pos <= interval->end;
+    }
+    size_t lo = 0;
+    size_t hi = interval->nranges;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (interval->ranges[mid].end < pos) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < interval->nranges && interval->ranges[lo].start <= pos;
+}
+
+// whether `reg` is held by an inactive interval that is live again
+// somewhere `interval` is, which then cannot have it
+static bool opentac_alloc_reserved(const struct OpentacRegalloc *alloc, const struct OpentacRegClass *rc, const char *reg, const struct OpentacInterval *interval) {
+    struct OpentacRange whole;
+    size_t len;
+    const struct OpentacRange *ranges = opentac_alloc_ranges(interval, &whole, &len);
+    for (size_t j = 0; j < rc->inactive.len; j++) {
+        if (strcmp(rc->inactive.actives[j].reg.name, reg)) {
+            continue;
+        }
+        struct OpentacRange holder_whole;
+        size_t holder_len;
+        const struct OpentacRange *holder = opentac_alloc_ranges(alloc->live.intervals + rc->inactive.actives[j].index, &holder_whole, &holder_len);
+        if (opentac_alloc_overlaps(holder, holder_len, ranges, len)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// whether `source` is live anywhere `i` is after the copy from it that
+// starts `i`; at the copy itself one is read as the other is written
+static bool opentac_alloc_interferes(const struct OpentacInterval *source, const struct OpentacInterval *i) {
+    struct OpentacRange whole;
+    size_t len;
+    const struct OpentacRange *source_ranges = opentac_alloc_ranges(source, &whole, &len);
+    struct OpentacRange i_whole;
+    size_t i_len;
+    const struct OpentacRange *ranges = opentac_alloc_ranges(i, &i_whole, &i_len);
+    struct OpentacRange after = { .start = ranges[0].start + 1, .end = ranges[0].end };
+    if (after.start <= after.end && opentac_alloc_overlaps(source_ranges, len, &after, 1)) {
+        return true;
+    }
+    return opentac_alloc_overlaps(source_ranges, len, ranges + 1, i_len - 1);
+}
+
+// a copy takes over the register of its source if their ranges never meet
+// after it. A source that is live again later keeps the register too, and
+// waits for that in the inactive set
+static bool opentac_alloc_coalesce(struct OpentacRegalloc *alloc, struct OpentacRegClass *rc, size_t idx) {
+    struct OpentacInterval *i = alloc->live.intervals + idx;
+    for (size_t j = 0; j < rc->active.len; j++) {
+        const struct OpentacInterval *source = alloc->live.intervals + rc->active.actives[j].index;
+        // active intervals are live where `i` starts, so one with the
+        // hinted register is the source of this very copy
+        if (source->reg == i->hint && !(i->calls && rc->active.actives[j].clobbered) && !opentac_alloc_interferes(source, i) && !opentac_alloc_reserved(alloc, rc, rc->active.actives[j].reg.name, i)) {
+            struct OpentacActive shared = opentac_alloc_heap_remove(alloc, &rc->active, j);
+            if (source->end > i->start) {
+                opentac_alloc_inactivate(alloc, &rc->inactive, shared);
             }
-        } else if (stmt->tag.right == OPENTAC_VAL_REG) {
-            const char *name = NULL;
-            for (size_t i = 0; i < fn->name_table.len; i++) {
-                if ((int32_t) fn->name_table.entries[i].ival == stmt->right.regval) {
-                    name = fn->name_table.entries[i].key->data;
-                    break;
-                }
+            i->purpose.tag = OPENTAC_REG_ALLOCATED;
+            i->purpose.reg = shared.reg;
+            shared.index = idx;
+            opentac_alloc_heap_push(alloc, &rc->active, shared);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void opentac_alloc_pool_remove(struct OpentacPool *pool, size_t j) {
+    memmove(pool->registers + j, pool->registers + j + 1, (pool->len - j - 1) * sizeof(struct OpentacMReg));
+    --pool->len;
+}
+
+// takes a free register for `interval`: the one it prefers, then one that
+// calls leave alone if it has to survive any, and otherwise preferably one
+// they clobber, which keeps the others for values that need them. Registers
+// inactive intervals come back to while `interval` is live are passed over
+static bool opentac_alloc_take(const struct OpentacRegalloc *alloc, struct OpentacRegClass *rc, const struct OpentacInterval *interval, struct OpentacActive *dest) {
+    struct OpentacPool *pools[] = { &rc->clobbered, &rc->registers };
+    int first = interval->calls ? 1 : 0;
+    for (int k = first; interval->prefer && k < 2; k++) {
+        struct OpentacPool *pool = pools[k];
+        for (size_t j = 0; j < pool->len; j++) {
+            if (!strcmp(pool->registers[j].name, interval->prefer) && !opentac_alloc_reserved(alloc, rc, interval->prefer, interval)) {
+                dest->reg = pool->registers[j];
+                dest->clobbered = k == 0;
+                opentac_alloc_pool_remove(pool, j);
+                return true;
             }
-            if (name) {
-                for (size_t i = 0; i < alloc->live.len; i++) {
-                    if (strcmp(alloc->live.intervals[i].name, name) == 0) {
-                        alloc->live.intervals[i].end = idx;
-                    }
-                }
+        }
+    }
+    for (int k = first; k < 2; k++) {
+        struct OpentacPool *pool = pools[k];
+        for (size_t j = pool->len; j--;) {
+            if (!opentac_alloc_reserved(alloc, rc, pool->registers[j].name, interval)) {
+                dest->reg = pool->registers[j];
+                dest->clobbered = k == 0;
+                opentac_alloc_pool_remove(pool, j);
+                return true;
             }
         }
-        /* fallthrough */
-    case OPENTAC_OP_PARAM:
-    case OPENTAC_OP_RETURN:
-        if (stmt->tag.left == OPENTAC_VAL_NAMED) {
-            for (size_t i = 0; i < alloc->live.len; i++) {
-                if (strcmp(alloc->live.intervals[i].name, stmt->left.name->data) == 0) {
-                    alloc->live.intervals[i].end = idx;
-                }
+    }
+    return false;
+}
+
+// takes the register of an inactive interval back from its pool when the
+// interval is live again
+static void opentac_alloc_reclaim(struct OpentacRegClass *rc, struct OpentacActive active) {
+    struct OpentacPool *pool = active.clobbered ? &rc->clobbered : &rc->registers;
+    for (size_t j = 0; j < pool->len; j++) {
+        if (!strcmp(pool->registers[j].name, active.reg.name)) {
+            opentac_alloc_pool_remove(pool, j);
+            return;
+        }
+    }
+    opentac_assertf(false, "register %s of an inactive interval was given away", active.reg.name);
+}
+
+// the first use of `interval` at or after `pos`, UINT64_MAX if there is
+// none; an interval without known uses counts as used at its end, and one
+// still live after its last use flows around a loop and is used again
+// right after its end
+static OpentacLifetime opentac_alloc_next_use(const struct OpentacInterval *interval, OpentacLifetime pos) {
+    if (!interval->nuses) {
+        return pos <= interval->end ? interval->end : UINT64_MAX;
+    }
+    size_t lo = 0;
+    size_t hi = interval->nuses;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (interval->uses[mid] < pos) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < interval->nuses) {
+        return interval->uses[lo];
+    }
+    return pos <= interval->end ? interval->end + 1 : UINT64_MAX;
+}
+
+// splits the live interval at `idx` before `pos`, which lies after its
+// start and not after its end: it keeps what comes earlier and a new piece
+// appended to the live intervals takes the rest, whose index is returned;
+// both count the calls they cross again
+static size_t opentac_alloc_split(struct OpentacRegalloc *alloc, size_t idx, OpentacLifetime pos) {
+    if (alloc->live.len == alloc->live.cap) {
+        alloc->live.intervals = opentac_arena_realloc(&alloc->arena, alloc->live.intervals, alloc->live.cap * sizeof(struct OpentacInterval), alloc->live.cap * 2 * sizeof(struct OpentacInterval));
+        alloc->live.cap *= 2;
+    }
+    struct OpentacInterval *i = alloc->live.intervals + idx;
+    struct OpentacInterval *child = alloc->live.intervals + alloc->live.len;
+    *child = *i;
+    child->hinted = false;
+
+    if (i->nranges) {
+        size_t r = 0;
+        while (r < i->nranges && i->ranges[r].end < pos) {
+            r++;
+        }
+        // a range running across `pos` ends up in both
+        bool across = i->ranges[r].start < pos;
+        child->nranges = i->nranges - r;
+        child->ranges = opentac_arena_alloc(&alloc->arena, child->nranges * sizeof(struct OpentacRange));
+        memcpy(child->ranges, i->ranges + r, child->nranges * sizeof(struct OpentacRange));
+        if (across) {
+            child->ranges[0].start = pos;
+            i->ranges[r].end = pos - 1;
+        }
+        i->nranges = r + across;
+        i->end = i->ranges[i->nranges - 1].end;
+        child->start = child->ranges[0].start;
+    } else {
+        i->end = pos - 1;
+        child->start = pos;
+    }
+
+    size_t u = 0;
+    while (u < i->nuses && i->uses[u] < pos) {
+        u++;
+    }
+    child->uses = i->uses + u;
+    child->nuses = i->nuses - u;
+    i->nuses = u;
+
+    struct OpentacRange whole;
+    size_t len;
+    const struct OpentacRange *ranges = opentac_alloc_ranges(i, &whole, &len);
+    i->calls = opentac_alloc_crossed(ranges, len, alloc->calls, alloc->ncalls);
+    ranges = opentac_alloc_ranges(child, &whole, &len);
+    child->calls = opentac_alloc_crossed(ranges, len, alloc->calls, alloc->ncalls);
+
+    i->split = true;
+    child->split = true;
+    child->next = i->next;
+    i->next = alloc->live.len;
+    return alloc->live.len++;
+}
+
+// live intervals still to be allocated that were split off while
+// allocating, a heap by increasing start
+struct OpentacPending {
+    size_t len;
+    size_t cap;
+    size_t *indices;
+};
+
+static bool opentac_alloc_before(const struct OpentacRegalloc *alloc, size_t a, size_t b) {
+    return alloc->live.intervals[a].start < alloc->live.intervals[b].start;
+}
+
+static void opentac_alloc_defer(struct OpentacRegalloc *alloc, struct OpentacPending *pending, size_t idx) {
+    if (pending->len == pending->cap) {
+        size_t cap = pending->cap ? pending->cap * 2 : 16;
+        pending->indices = opentac_arena_realloc(&alloc->arena, pending->indices, pending->cap * sizeof(size_t), cap * sizeof(size_t));
+        pending->cap = cap;
+    }
+    size_t pos = pending->len++;
+    while (pos && opentac_alloc_before(alloc, idx, pending->indices[(pos - 1) / 2])) {
+        pending->indices[pos] = pending->indices[(pos - 1) / 2];
+        pos = (pos - 1) / 2;
+    }
+    pending->indices[pos] = idx;
+}
+
+static size_t opentac_alloc_undefer(struct OpentacRegalloc *alloc, struct OpentacPending *pending) {
+    size_t top = pending->indices[0];
+    size_t last = pending->indices[--pending->len];
+    size_t pos = 0;
+    for (;;) {
+        size_t min = 2 * pos + 1;
+        if (min >= pending->len) {
+            break;
+        }
+        if (min + 1 < pending->len && opentac_alloc_before(alloc, pending->indices[min + 1], pending->indices[min])) {
+            min++;
+        }
+        if (!opentac_alloc_before(alloc, pending->indices[min], last)) {
+            break;
+        }
+        pending->indices[pos] = pending->indices[min];
+        pos = min;
+    }
+    pending->indices[pos] = last;
+    return top;
+}
+
+// spills the live interval at `idx` from `pos` on, which is no earlier
+// than its start, until its next use; the rest, if any, is deferred and
+// gets another chance at a register there. A piece split off a spilled one
+// carries its slot and tries to stay there, so that nothing moves between
+// them
+static void opentac_alloc_spill_from(struct OpentacRegalloc *alloc, struct OpentacPending *pending, size_t idx, OpentacLifetime pos) {
+    size_t prefer = SIZE_MAX;
+    if (alloc->live.intervals[idx].split && alloc->live.intervals[idx].purpose.tag == OPENTAC_REG_SPILLED) {
+        prefer = alloc->live.intervals[idx].purpose.stack;
+    }
+    if (alloc->live.intervals[idx].start < pos) {
+        idx = opentac_alloc_split(alloc, idx, pos);
+    }
+    // split off inside a hole, so nothing needs to be stored before it
+    // starts again
+    if (alloc->live.intervals[idx].start > pos) {
+        opentac_alloc_defer(alloc, pending, idx);
+        return;
+    }
+    OpentacLifetime use = opentac_alloc_next_use(alloc->live.intervals + idx, pos + 1);
+    size_t rest = 0;
+    if (alloc->live.intervals[idx].nuses && use <= alloc->live.intervals[idx].end) {
+        rest = opentac_alloc_split(alloc, idx, use);
+        opentac_alloc_defer(alloc, pending, rest);
+    }
+    struct OpentacInterval *i = alloc->live.intervals + idx;
+    i->purpose.tag = OPENTAC_REG_SPILLED;
+    i->purpose.stack = opentac_alloc_slot(alloc, i, prefer);
+    if (rest) {
+        alloc->live.intervals[rest].purpose = i->purpose;
+    }
+}
+
+static bool opentac_alloc_same(struct OpentacPurpose a, struct OpentacPurpose b) {
+    if (a.tag != b.tag) {
+        return false;
+    }
+    return a.tag == OPENTAC_REG_ALLOCATED ? !strcmp(a.reg.name, b.reg.name) : a.stack == b.stack;
+}
+
+static void opentac_alloc_move(struct OpentacRegalloc *alloc, struct OpentacMoves *moves, struct OpentacMove move) {
+    if (moves->len == moves->cap) {
+        size_t cap = moves->cap ? moves->cap * 2 : 16;
+        moves->moves = opentac_arena_realloc(&alloc->arena, moves->moves, moves->cap * sizeof(struct OpentacMove), cap * sizeof(struct OpentacMove));
+        moves->cap = cap;
+    }
+    moves->moves[moves->len++] = move;
+}
+
+// the piece of the split interval starting at `idx` that holds the value at
+// `pos`, where it is live
+static const struct OpentacInterval *opentac_alloc_piece(const struct OpentacRegalloc *alloc, size_t idx, OpentacLifetime pos) {
+    const struct OpentacInterval *piece = alloc->live.intervals + idx;
+    while (piece->next && alloc->live.intervals[piece->next].start <= pos) {
+        piece = alloc->live.intervals + piece->next;
+    }
+    return piece;
+}
+
+// whether the value of `reg` from before `stmt` is still needed by it or
+// after it, rather than `stmt` defining it afresh
+static bool opentac_alloc_live_into(const OpentacStmt *stmt, OpentacRegister reg) {
+    OpentacRegister def;
+    if (!opentac_stmt_def(stmt, &def) || def != reg) {
+        return true;
+    }
+    OpentacRegister uses[3];
+    size_t len = opentac_stmt_uses(stmt, uses);
+    for (size_t k = 0; k < len; k++) {
+        if (uses[k] == reg) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int opentac_alloc_move_cmp(const void *a, const void *b) {
+    const struct OpentacMove *x = a;
+    const struct OpentacMove *y = b;
+    if (x->pos != y->pos) {
+        return x->pos < y->pos ? -1 : 1;
+    }
+    return x->succ < y->succ ? -1 : x->succ > y->succ ? 1 : 0;
+}
+
+// the block holding statement `stmt`
+static size_t opentac_alloc_block_at(const struct OpentacCfg *cfg, size_t stmt) {
+    size_t lo = 0;
+    size_t hi = cfg->len;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (cfg->blocks[mid].start <= stmt) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// the moves joining the pieces of split intervals: where a piece follows
+// another inside a block while the value is live, and on every edge along
+// which the value changes places. The first `roots` live intervals are
+// the first pieces, in increasing order of start
+static void opentac_alloc_resolve(struct OpentacRegalloc *alloc, size_t roots) {
+    size_t f = 0;
+    for (size_t idx = 0; idx < roots; idx++) {
+        const struct OpentacInterval *i = alloc->live.intervals + idx;
+        if (!i->split) {
+            continue;
+        }
+        while (f < alloc->fns.len && i->start >= alloc->fns.fns[f].base + alloc->fns.fns[f].fn->len) {
+            f++;
+        }
+        // intervals added by hand belong to no function
+        if (f == alloc->fns.len || i->start < alloc->fns.fns[f].base) {
+            continue;
+        }
+        const struct OpentacAllocFn *af = alloc->fns.fns + f;
+        const struct OpentacCfg *cfg = &af->fn->cfg;
+
+        const struct OpentacInterval *piece = i;
+        for (; piece->next; piece = alloc->live.intervals + piece->next) {
+            const struct OpentacInterval *next = alloc->live.intervals + piece->next;
+            if (piece->end + 1 != next->start || opentac_alloc_same(piece->purpose, next->purpose)) {
+                continue;
             }
-        } else if (stmt->tag.left == OPENTAC_VAL_REG) {
-            const char *name = NULL;
-            for (size_t i = 0; i < fn->name_table.len; i++) {
-                if ((int32_t) fn->name_table.entries[i].ival == stmt->left.regval) {
-                    name = fn->name_table.entries[i].key->data;
-                    break;
-                }
+            // block boundaries are left to the edges
+            size_t stmt = next->start - af->base;
+            if (cfg->blocks[opentac_alloc_block_at(cfg, stmt)].start == stmt) {
+                continue;
             }
-            if (name) {
-                for (size_t i = 0; i < alloc->live.len; i++) {
-                    if (strcmp(alloc->live.intervals[i].name, name) == 0) {
-                        alloc->live.intervals[i].end = idx;
-                    }
+            // nor does a piece take anything over where its statement
+            // defines the value without reading it, as a call does
+            if (!opentac_alloc_live_into(af->fn->stmts + stmt, i->reg)) {
+                continue;
+            }
+            opentac_alloc_move(alloc, &alloc->moves, (struct OpentacMove) {
+                .reg = i->reg,
+                .pos = next->start,
+                .src = piece->purpose,
+                .dst = next->purpose,
+            });
+        }
+
+        // only blocks the pieces cover can have the value live out
+        size_t index = opentac_liveness_index(af->fn, i->reg);
+        for (size_t b = opentac_alloc_block_at(cfg, i->start - af->base); b < cfg->len && af->base + cfg->blocks[b].start <= piece->end; b++) {
+            const struct OpentacBlock *block = cfg->blocks + b;
+            OpentacLifetime last = af->base + block->end - 1;
+            for (size_t k = 0; k < block->nsucc; k++) {
+                size_t s = cfg->succs[block->succ + k];
+                if (!opentac_liveness_live_in(&af->liveness, s, index)) {
+                    continue;
+                }
+                OpentacLifetime head = af->base + cfg->blocks[s].start;
+                const struct OpentacInterval *src = opentac_alloc_piece(alloc, idx, last);
+                const struct OpentacInterval *dst = opentac_alloc_piece(alloc, idx, head);
+                if (!opentac_alloc_same(src->purpose, dst->purpose)) {
+                    opentac_alloc_move(alloc, &alloc->edges, (struct OpentacMove) {
+                        .reg = i->reg,
+                        .edge = true,
+                        .pos = last,
+                        .succ = head,
+                        .src = src->purpose,
+                        .dst = dst->purpose,
+                    });
                 }
             }
         }
-    case OPENTAC_OP_BRANCH:
-    case OPENTAC_OP_NOP:
-        break;
+    }
+
+    if (alloc->moves.len) {
+        qsort(alloc->moves.moves, alloc->moves.len, sizeof(struct OpentacMove), opentac_alloc_move_cmp);
+    }
+    if (alloc->edges.len) {
+        qsort(alloc->edges.moves, alloc->edges.len, sizeof(struct OpentacMove), opentac_alloc_move_cmp);
     }
 }
 
+// second-chance binpacking: intervals are visited by increasing start, and
+// when no register is free whichever of the interval and those holding a
+// register it may take is next used last gets split where the interval
+// starts. Its piece from there is spilled up to its next use, and the piece
+// after that is visited again, getting a register if one is free there
 void opentac_alloc_allocate(struct OpentacRegalloc *alloc) {
-    opentac_alloc_sort_live(alloc->live.intervals, 0, alloc->live.len - 1);
+    opentac_alloc_sort_live(alloc);
 
-    size_t expire_len = 0;
-    size_t *expire = malloc(sizeof(size_t) * alloc->live.len);
-
-    size_t delta_len = 0;
-    struct OpentacPurposePair *delta = malloc(sizeof(struct OpentacPurposePair) * alloc->registers.len);
+    size_t roots = alloc->live.len;
+    struct OpentacPending pending = { 0 };
+    size_t next = 0;
+    while (next < roots || pending.len) {
+        // pieces carrying a value on go before intervals starting with
+        // them, so that they find their slot still free
+        size_t idx;
+        if (pending.len && (next == roots || !opentac_alloc_before(alloc, next, pending.indices[0]))) {
+            idx = opentac_alloc_undefer(alloc, &pending);
+        } else {
+            idx = next++;
+        }
 
-    for (size_t idx = 0; idx < alloc->live.len; idx++) {
         struct OpentacInterval *i = alloc->live.intervals + idx;
+        // classes are scanned together but only ever compete among
+        // themselves, so only the interval's own class is expired
+        struct OpentacRegClass *rc = opentac_alloc_class(alloc, i);
+        struct OpentacActives *active = &rc->active;
 
-        for (size_t idx0 = 0; idx0 < alloc->active.len; idx0++) {
-            size_t j = alloc->active.actives[idx0].index;
-            OpentacLifetime lt = alloc->live.intervals[j].end;
-            if (lt >= i->start) {
+        // the heap yields active intervals by increasing end
+        while (active->len) {
+            struct OpentacActive *top = active->actives;
+            if (alloc->live.intervals[top->index].end >= i->start) {
                 break;
             }
-            expire[expire_len++] = j;
+            struct OpentacActive expired = opentac_alloc_heap_remove(alloc, active, 0);
+            opentac_alloc_free_reg(alloc, rc, expired);
         }
 
-        for (size_t idx0 = 0; idx0 < expire_len; idx0++) {
-            size_t j = expire[idx0];
-            struct OpentacActive active;
-            opentac_alloc_remove(&active, sizeof(struct OpentacActive), alloc->active.len, alloc->active.actives, j);
-            if (alloc->registers.len == alloc->registers.cap) {
-                alloc->registers.cap *= 2;
-                alloc->registers.registers = realloc(alloc->registers.registers, sizeof(struct OpentacMReg) * alloc->registers.cap);
+        // intervals entering a hole lend their register out until their
+        // next range, and only to intervals that are dead again by then.
+        // Removing from the heap reorders it, so the scan starts over
+        for (size_t j = 0; j < active->len;) {
+            if (opentac_alloc_covers(alloc->live.intervals + active->actives[j].index, i->start)) {
+                j++;
+                continue;
             }
-            alloc->registers.registers[alloc->registers.len++] = active.reg;
-        }
-        expire_len = 0;
-
-        if (!alloc->registers.len) {
-            if (alloc->active.len) {
-                size_t j = alloc->active.len - 1;
-                struct OpentacActive *active = alloc->active.actives + j;
-                struct OpentacInterval *spill = alloc->live.intervals + active->index;
-                if (spill->end > i->end) {
-                    delta[delta_len].index = idx;
-                    delta[delta_len++].purpose = spill->purpose;
-                    alloc->offset += 8;
-                    delta[delta_len].index = active->index;
-                    delta[delta_len].purpose.tag = OPENTAC_REG_SPILLED;
-                    delta[delta_len++].purpose.stack = alloc->offset;
-                } else {
-                    alloc->offset += 8;
-                    delta[delta_len].index = idx;
-                    delta[delta_len].purpose.tag = OPENTAC_REG_SPILLED;
-                    delta[delta_len++].purpose.stack = alloc->offset;
-                }
+            struct OpentacActive hole = opentac_alloc_heap_remove(alloc, active, j);
+            opentac_alloc_free_reg(alloc, rc, hole);
+            opentac_alloc_inactivate(alloc, &rc->inactive, hole);
+            j = 0;
+        }
+        for (size_t j = 0; j < rc->inactive.len;) {
+            struct OpentacActive held = rc->inactive.actives[j];
+            const struct OpentacInterval *holder = alloc->live.intervals + held.index;
+            if (holder->end >= i->start && !opentac_alloc_covers(holder, i->start)) {
+                j++;
+                continue;
             }
+            rc->inactive.actives[j] = rc->inactive.actives[--rc->inactive.len];
+            if (holder->end >= i->start) {
+                opentac_alloc_reclaim(rc, held);
+                opentac_alloc_heap_push(alloc, active, held);
+            }
+        }
+
+        // a copy whose source is not live alongside it takes over the
+        // source's register, turning the move into a no-op
+        if (i->hinted && opentac_alloc_coalesce(alloc, rc, idx)) {
+            continue;
+        }
+
+        struct OpentacActive taken = { .index = idx };
+        if (opentac_alloc_take(alloc, rc, i, &taken)) {
+            i->purpose.tag = OPENTAC_REG_ALLOCATED;
+            i->purpose.reg = taken.reg;
+            opentac_alloc_heap_push(alloc, active, taken);
+            continue;
+        }
+
+        // the active set holds at most one interval per register, so
+        // finding the one used last is a short scan. Operands may live in
+        // memory, so a piece back for its second chance only takes a free
+        // register: evicting for it would just trade one value's loads and
+        // stores for another's
+        OpentacLifetime start = i->start;
+        size_t last = active->len;
+        OpentacLifetime farthest = 0;
+        for (size_t j = 0; idx < roots && j < active->len; j++) {
+            if ((i->calls && active->actives[j].clobbered) || opentac_alloc_reserved(alloc, rc, active->actives[j].reg.name, i)) {
+                continue;
+            }
+            OpentacLifetime use = opentac_alloc_next_use(alloc->live.intervals + active->actives[j].index, start);
+            if (last == active->len || use > farthest) {
+                last = j;
+                farthest = use;
+            }
+        }
+
+        if (last < active->len && farthest > opentac_alloc_next_use(i, start)) {
+            struct OpentacActive victim = opentac_alloc_heap_remove(alloc, active, last);
+            size_t spill = victim.index;
+            i->purpose.tag = OPENTAC_REG_ALLOCATED;
+            i->purpose.reg = victim.reg;
+            victim.index = idx;
+            opentac_alloc_heap_push(alloc, active, victim);
+            opentac_alloc_spill_from(alloc, &pending, spill, start);
         } else {
-            struct OpentacMReg reg = alloc->registers.registers[--alloc->registers.len];
-            delta[delta_len].index = idx;
-            delta[delta_len].purpose.tag = OPENTAC_REG_ALLOCATED;
-            delta[delta_len++].purpose.reg = reg;
-            opentac_alloc_sort_active(alloc->live.intervals, alloc->active.actives, 0, alloc->active.len - 1);
+            opentac_alloc_spill_from(alloc, &pending, idx, start);
         }
+    }
+
+    // whatever is too large for a register lives on the stack throughout
+    for (size_t idx = 0; idx < alloc->stack.len; idx++) {
+        struct OpentacInterval *i = alloc->stack.intervals + idx;
+        i->purpose.tag = OPENTAC_REG_SPILLED;
+        i->purpose.stack = opentac_alloc_slot(alloc, i, SIZE_MAX);
+    }
 
-        for (size_t idx0 = 0; idx0 < delta_len; idx0++) {
-            alloc->live.intervals[delta[idx0].index].purpose = delta[idx0].purpose;
+    // spilled intervals hold the index of their slot until slots are placed
+    opentac_alloc_place_slots(alloc);
+    for (size_t idx = 0; idx < alloc->live.len + alloc->stack.len; idx++) {
+        struct OpentacInterval *i = idx < alloc->live.len ? alloc->live.intervals + idx : alloc->stack.intervals + idx - alloc->live.len;
+        if (i->purpose.tag == OPENTAC_REG_SPILLED) {
+            i->purpose.stack = alloc->slots.slots[i->purpose.stack].offset;
         }
-        delta_len = 0;
     }
+    alloc->slots.len = 0;
 
-    free(expire);
-    free(delta);
+    opentac_alloc_resolve(alloc, roots);
 }
 
-static void opentac_alloc_remove(void *dest, size_t size, size_t len, void *ptr, size_t idx) {
-    memcpy(dest, ((uint8_t *) ptr) + idx * size, size);
-    memmove(((uint8_t *) ptr) + idx * size, ((uint8_t *) ptr) + (idx + 1) * size, (len - idx - 1) * size);
+void opentac_alloc_destroy(struct OpentacRegalloc *alloc) {
+    opentac_arena_destroy(&alloc->arena);
 }
 
-// quicksort
-static void opentac_alloc_sort_live(struct OpentacInterval *intervals, size_t lo, size_t hi) {
-    if (hi == (size_t) -1) {
-        return;
+static void opentac_alloc_free_reg(struct OpentacRegalloc *alloc, struct OpentacRegClass *rc, struct OpentacActive active) {
+    struct OpentacPool *pool = active.clobbered ? &rc->clobbered : &rc->registers;
+    struct OpentacMReg reg = active.reg;
+    if (pool->len == pool->cap) {
+        pool->registers = opentac_arena_realloc(&alloc->arena, pool->registers, sizeof(struct OpentacMReg) * pool->cap, sizeof(struct OpentacMReg) * pool->cap * 2);
+        pool->cap *= 2;
     }
-    if (lo < hi) {
-        size_t p = opentac_alloc_partition_live(intervals, lo, hi);
-        opentac_alloc_sort_live(intervals, lo, p - 1);
-        opentac_alloc_sort_live(intervals, p + 1, hi);
+    pool->registers[pool->len++] = reg;
+}
+
+static void opentac_alloc_inactivate(struct OpentacRegalloc *alloc, struct OpentacActives *inactive, struct OpentacActive entry) {
+    if (inactive->len == inactive->cap) {
+        inactive->actives = opentac_arena_realloc(&alloc->arena, inactive->actives, sizeof(struct OpentacActive) * inactive->cap, sizeof(struct OpentacActive) * inactive->cap * 2);
+        inactive->cap *= 2;
     }
+    inactive->actives[inactive->len++] = entry;
+}
+
+static OpentacLifetime opentac_alloc_heap_key(struct OpentacRegalloc *alloc, struct OpentacActives *active, size_t pos) {
+    return alloc->live.intervals[active->actives[pos].index].end;
+}
+
+static void opentac_alloc_heap_swap(struct OpentacActives *active, size_t a, size_t b) {
+    struct OpentacActive temp = active->actives[a];
+    active->actives[a] = active->actives[b];
+    active->actives[b] = temp;
 }
 
-static size_t opentac_alloc_partition_live(struct OpentacInterval *intervals, size_t lo, size_t hi) {
-    uint8_t temp[sizeof(struct OpentacInterval)];
-    uint64_t pivot = intervals[hi].start;
-    size_t i = lo;
-    for (size_t j = 0; j < hi; j++) {
-        if (intervals[j].start < pivot) {
-            opentac_alloc_memswap(intervals + i, intervals + j, sizeof(struct OpentacInterval), temp);
-            ++i;
+static void opentac_alloc_heap_up(struct OpentacRegalloc *alloc, struct OpentacActives *active, size_t pos) {
+    while (pos) {
+        size_t parent = (pos - 1) / 2;
+        if (opentac_alloc_heap_key(alloc, active, parent) <= opentac_alloc_heap_key(alloc, active, pos)) {
+            break;
         }
+        opentac_alloc_heap_swap(active, parent, pos);
+        pos = parent;
     }
-    opentac_alloc_memswap(intervals + i, intervals + hi, sizeof(struct OpentacInterval), temp);
-    return i;
 }
 
-static void opentac_alloc_sort_active(struct OpentacInterval *live, struct OpentacActive *active, size_t lo, size_t hi) {
-    if (hi == (size_t) -1) {
-        return;
+static void opentac_alloc_heap_down(struct OpentacRegalloc *alloc, struct OpentacActives *active, size_t pos) {
+    for (;;) {
+        size_t min = pos;
+        size_t left = 2 * pos + 1;
+        size_t right = left + 1;
+        if (left < active->len && opentac_alloc_heap_key(alloc, active, left) < opentac_alloc_heap_key(alloc, active, min)) {
+            min = left;
+        }
+        if (right < active->len && opentac_alloc_heap_key(alloc, active, right) < opentac_alloc_heap_key(alloc, active, min)) {
+            min = right;
+        }
+        if (min == pos) {
+            break;
+        }
+        opentac_alloc_heap_swap(active, min, pos);
+        pos = min;
     }
-    if (lo < hi) {
-        size_t p = opentac_alloc_partition_active(live, active, lo, hi);
-        opentac_alloc_sort_active(live, active, lo, p - 1);
-        opentac_alloc_sort_active(live, active, p + 1, hi);
+}
+
+static void opentac_alloc_heap_push(struct OpentacRegalloc *alloc, struct OpentacActives *active, struct OpentacActive entry) {
+    if (active->len == active->cap) {
+        active->actives = opentac_arena_realloc(&alloc->arena, active->actives, sizeof(struct OpentacActive) * active->cap, sizeof(struct OpentacActive) * active->cap * 2);
+        active->cap *= 2;
     }
+    active->actives[active->len] = entry;
+    opentac_alloc_heap_up(alloc, active, active->len++);
 }
 
-static size_t opentac_alloc_partition_active(struct OpentacInterval *live, struct OpentacActive *active, size_t lo, size_t hi) {
-    uint8_t temp[sizeof(struct OpentacActive)];
-    uint64_t pivot = live[hi].end;
-    size_t i = lo;
-    for (size_t j = 0; j < hi; j++) {
-        if (live[j].end < pivot) {
-            opentac_alloc_memswap(active + i, active + j, sizeof(struct OpentacActive), temp);
-            ++i;
-        }
+static struct OpentacActive opentac_alloc_heap_remove(struct OpentacRegalloc *alloc, struct OpentacActives *active, size_t pos) {
+    struct OpentacActive entry = active->actives[pos];
+    active->actives[pos] = active->actives[--active->len];
+    if (pos < active->len) {
+        opentac_alloc_heap_down(alloc, active, pos);
+        opentac_alloc_heap_up(alloc, active, pos);
     }
-    opentac_alloc_memswap(active + i, active + hi, sizeof(struct OpentacActive), temp);
-    return i;
+    return entry;
 }
 
-static void opentac_alloc_memswap(void *a, void *b, size_t size, void *temp) {
-    memcpy(temp, a, size);
-    memcpy(a, b, size);
-    memcpy(b, temp, size);
+// stable merge sort on start; temporaries are numbered in statement order,
+// so the common case is a single linear check
+static void opentac_alloc_sort_live(struct OpentacRegalloc *alloc) {
+    size_t len = alloc->live.len;
+    struct OpentacInterval *src = alloc->live.intervals;
+
+    size_t i = 1;
+    while (i < len && src[i - 1].start <= src[i].start) {
+        ++i;
+    }
+    if (i >= len) {
+        return;
+    }
+
+    // split pieces are appended to the sorted array later
+    struct OpentacInterval *dst = opentac_arena_alloc(&alloc->arena, alloc->live.cap * sizeof(struct OpentacInterval));
+    for (size_t width = 1; width < len; width *= 2) {
+        for (size_t lo = 0; lo < len; lo += 2 * width) {
+            size_t mid = lo + width < len ? lo + width : len;
+            size_t hi = lo + 2 * width < len ? lo + 2 * width : len;
+            size_t a = lo;
+            size_t b = mid;
+            size_t k = lo;
+            while (a < mid && b < hi) {
+                dst[k++] = src[b].start < src[a].start ? src[b++] : src[a++];
+            }
+            while (a < mid) {
+                dst[k++] = src[a++];
+            }
+            while (b < hi) {
+                dst[k++] = src[b++];
+            }
+        }
+        struct OpentacInterval *temp = src;
+        src = dst;
+        dst = temp;
+    }
+
+    alloc->live.intervals = src;
 }
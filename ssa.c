@@ -0,0 +1,590 @@
+#include "include/opentac.h"
+
+// growable list of block or register indices in a scratch arena
+struct OpentacIndexList {
+    size_t len;
+    size_t cap;
+    size_t *items;
+};
+
+static void opentac_index_push(struct OpentacArena *arena, struct OpentacIndexList *list, size_t item) {
+    if (list->len == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 4;
+        list->items = opentac_arena_realloc(arena, list->items, list->cap * sizeof(size_t), cap * sizeof(size_t));
+        list->cap = cap;
+    }
+    list->items[list->len++] = item;
+}
+
+static size_t opentac_dom_intersect(const size_t *idom, const size_t *order, size_t a, size_t b) {
+    while (a != b) {
+        while (order[a] > order[b]) {
+            a = idom[a];
+        }
+        while (order[b] > order[a]) {
+            b = idom[b];
+        }
+    }
+    return a;
+}
+
+// Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm"
+void opentac_dominators(struct OpentacDominators *dest, struct OpentacArena *arena, OpentacFnBuilder *fn) {
+    opentac_assert(dest);
+    opentac_assert(arena);
+    opentac_assert(fn);
+
+    const struct OpentacCfg *cfg = opentac_fn_cfg(fn);
+    size_t len = cfg->len;
+    size_t cap = len ? len : 1;
+
+    dest->len = len;
+    dest->idom = opentac_arena_alloc(arena, cap * sizeof(size_t));
+    dest->rpo = opentac_arena_alloc(arena, cap * sizeof(size_t));
+    dest->child = opentac_arena_calloc(arena, len + 1, sizeof(size_t));
+    dest->children = opentac_arena_alloc(arena, cap * sizeof(size_t));
+    dest->nrpo = 0;
+    for (size_t b = 0; b < len; b++) {
+        dest->idom[b] = SIZE_MAX;
+    }
+    if (!len) {
+        return;
+    }
+
+    // postorder with an explicit stack, `order` is the rpo position
+    size_t *order = opentac_arena_alloc(arena, cap * sizeof(size_t));
+    size_t *stack = opentac_arena_alloc(arena, cap * sizeof(size_t));
+    size_t *next = opentac_arena_calloc(arena, cap, sizeof(size_t));
+    bool *seen = opentac_arena_calloc(arena, cap, sizeof(bool));
+    size_t *post = opentac_arena_alloc(arena, cap * sizeof(size_t));
+    size_t npost = 0;
+    size_t depth = 0;
+    stack[depth++] = 0;
+    seen[0] = true;
+    while (depth) {
+        size_t b = stack[depth - 1];
+        const struct OpentacBlock *block = cfg->blocks + b;
+        if (next[b] < block->nsucc) {
+            size_t succ = cfg->succs[block->succ + next[b]++];
+            if (!seen[succ]) {
+                seen[succ] = true;
+                stack[depth++] = succ;
+            }
+        } else {
+            post[npost++] = b;
+            --depth;
+        }
+    }
+    for (size_t i = 0; i < npost; i++) {
+        size_t b = post[npost - 1 - i];
+        dest->rpo[i] = b;
+        order[b] = i;
+    }
+    dest->nrpo = npost;
+
+    dest->idom[0] = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 1; i < dest->nrpo; i++) {
+            size_t b = dest->rpo[i];
+            const struct OpentacBlock *block = cfg->blocks + b;
+            size_t idom = SIZE_MAX;
+            for (size_t j = 0; j < block->npred; j++) {
+                size_t pred = cfg->preds[block->pred + j];
+                if (dest->idom[pred] == SIZE_MAX) {
+                    continue;
+                }
+                idom = idom == SIZE_MAX ? pred : opentac_dom_intersect(dest->idom, order, pred, idom);
+            }
+            if (dest->idom[b] != idom) {
+                dest->idom[b] = idom;
+                changed = true;
+            }
+        }
+    }
+
+    // children in reverse postorder
+    for (size_t i = 1; i < dest->nrpo; i++) {
+        ++dest->child[dest->idom[dest->rpo[i]] + 1];
+    }
+    for (size_t b = 0; b < len; b++) {
+        dest->child[b + 1] += dest->child[b];
+    }
+    size_t *fill = opentac_arena_alloc(arena, cap * sizeof(size_t));
+    memcpy(fill, dest->child, len * sizeof(size_t));
+    for (size_t i = 1; i < dest->nrpo; i++) {
+        size_t b = dest->rpo[i];
+        dest->children[fill[dest->idom[b]]++] = b;
+    }
+}
+
+// registers are numbered like opentac_liveness_index, but against the
+// register count from before renaming started
+static size_t opentac_ssa_index(OpentacRegister reg, OpentacRegister nreg) {
+    return reg >= 0 ? (size_t) reg : (size_t) nreg + (size_t) (-(reg + 1));
+}
+
+static OpentacRegister opentac_ssa_reg(size_t index, OpentacRegister nreg) {
+    return index < (size_t) nreg ? (OpentacRegister) index : -(OpentacRegister) (index - nreg) - 1;
+}
+
+static size_t opentac_phi_push(OpentacBuilder *builder, OpentacFnBuilder *fn, size_t len) {
+    if (fn->phis.len + len > fn->phis.cap) {
+        size_t cap = fn->phis.cap ? fn->phis.cap : 32;
+        while (cap < fn->phis.len + len) {
+            cap *= 2;
+        }
+        fn->phis.args = opentac_arena_realloc(&builder->arena, fn->phis.args, fn->phis.cap * sizeof(struct OpentacPhiArg), cap * sizeof(struct OpentacPhiArg));
+        fn->phis.cap = cap;
+    }
+
+    size_t offset = fn->phis.len;
+    fn->phis.len += len;
+    return offset;
+}
+
+// replaces the statements of `fn` by `stmts`, leaving the cursor at the end
+static void opentac_fn_replace(OpentacFnBuilder *fn, OpentacStmt *stmts, size_t len, size_t cap) {
+    fn->stmts = stmts;
+    fn->len = len;
+    fn->cap = cap;
+    fn->current = fn->stmts + len;
+    opentac_fn_invalidate(fn);
+}
+
+// places a phi for every register at the iterated dominance frontier of its
+// definitions wherever it is live, and returns the phis of every block
+static struct OpentacIndexList *opentac_ssa_place(struct OpentacArena *arena, OpentacFnBuilder *fn, const struct OpentacDominators *dom, const struct OpentacLiveness *liveness, const bool *pinned, size_t *nphis) {
+    const struct OpentacCfg *cfg = &fn->cfg;
+    size_t nblocks = cfg->len;
+    size_t nregs = liveness->nregs;
+
+    struct OpentacIndexList *frontier = opentac_arena_calloc(arena, nblocks, sizeof(struct OpentacIndexList));
+    size_t *stamp = opentac_arena_calloc(arena, nblocks, sizeof(size_t));
+    for (size_t b = 0; b < nblocks; b++) {
+        const struct OpentacBlock *block = cfg->blocks + b;
+        if (block->npred < 2 || dom->idom[b] == SIZE_MAX) {
+            continue;
+        }
+        for (size_t j = 0; j < block->npred; j++) {
+            size_t runner = cfg->preds[block->pred + j];
+            if (dom->idom[runner] == SIZE_MAX) {
+                continue;
+            }
+            while (runner != dom->idom[b] && stamp[runner] != b + 1) {
+                stamp[runner] = b + 1;
+                opentac_index_push(arena, frontier + runner, b);
+                runner = dom->idom[runner];
+            }
+        }
+    }
+
+    // blocks defining each register
+    struct OpentacIndexList *defs = opentac_arena_calloc(arena, nregs ? nregs : 1, sizeof(struct OpentacIndexList));
+    size_t *last = opentac_arena_calloc(arena, nregs ? nregs : 1, sizeof(size_t));
+    for (size_t b = 0; b < nblocks; b++) {
+        if (dom->idom[b] == SIZE_MAX) {
+            continue;
+        }
+        for (size_t i = cfg->blocks[b].start; i < cfg->blocks[b].end; i++) {
+            OpentacRegister reg;
+            if (opentac_stmt_def(fn->stmts + i, &reg)) {
+                size_t index = opentac_liveness_index(fn, reg);
+                if (!pinned[index] && last[index] != b + 1) {
+                    last[index] = b + 1;
+                    opentac_index_push(arena, defs + index, b);
+                }
+            }
+        }
+    }
+
+    struct OpentacIndexList *phis = opentac_arena_calloc(arena, nblocks, sizeof(struct OpentacIndexList));
+    size_t *hasphi = opentac_arena_calloc(arena, nblocks, sizeof(size_t));
+    size_t *queued = opentac_arena_calloc(arena, nblocks, sizeof(size_t));
+    size_t *work = opentac_arena_alloc(arena, nblocks * sizeof(size_t));
+    *nphis = 0;
+    for (size_t index = 0; index < nregs; index++) {
+        size_t len = 0;
+        for (size_t i = 0; i < defs[index].len; i++) {
+            queued[defs[index].items[i]] = index + 1;
+            work[len++] = defs[index].items[i];
+        }
+        while (len) {
+            size_t b = work[--len];
+            for (size_t i = 0; i < frontier[b].len; i++) {
+                size_t d = frontier[b].items[i];
+                if (hasphi[d] == index + 1 || !opentac_liveness_live_in(liveness, d, index)) {
+                    continue;
+                }
+                hasphi[d] = index + 1;
+                opentac_index_push(arena, phis + d, index);
+                ++*nphis;
+                if (queued[d] != index + 1) {
+                    queued[d] = index + 1;
+                    work[len++] = d;
+                }
+            }
+        }
+    }
+
+    return phis;
+}
+
+struct OpentacRename {
+    size_t index;
+    OpentacRegister name;
+};
+
+void opentac_fn_to_ssa(OpentacBuilder *builder, OpentacFnBuilder *fn) {
+    opentac_assert(builder);
+    opentac_assert(fn);
+    opentac_assert(!fn->ssa);
+
+    struct OpentacArena scratch;
+    opentac_arena(&scratch);
+
+    const struct OpentacCfg *cfg = opentac_fn_cfg(fn);
+    // parameters and undefined registers flow in from the function entry,
+    // which a phi can only take as an argument if it is an edge, so an entry
+    // block that is also a branch target gets an empty block before it
+    if (cfg->len && cfg->blocks[0].npred) {
+        size_t cap = fn->cap > fn->len ? fn->cap : fn->len + 1;
+        OpentacStmt *stmts = opentac_arena_alloc(&builder->arena, cap * sizeof(OpentacStmt));
+        memset(stmts, 0, sizeof(OpentacStmt));
+        stmts[0].tag.opcode = OPENTAC_OP_NOP;
+        memcpy(stmts + 1, fn->stmts, fn->len * sizeof(OpentacStmt));
+        opentac_fn_replace(fn, stmts, fn->len + 1, cap);
+        cfg = opentac_fn_cfg(fn);
+    }
+    struct OpentacDominators dom;
+    opentac_dominators(&dom, &scratch, fn);
+    struct OpentacLiveness liveness;
+    opentac_liveness(&liveness, &scratch, fn);
+    size_t nregs = liveness.nregs;
+    OpentacRegister nreg = fn->reg;
+
+    // registers that have their address taken are left alone
+    bool *pinned = opentac_arena_calloc(&scratch, nregs ? nregs : 1, sizeof(bool));
+    for (size_t i = 0; i < fn->len; i++) {
+        if (fn->stmts[i].tag.opcode == OPENTAC_OP_REF && fn->stmts[i].tag.left == OPENTAC_VAL_REG) {
+            pinned[opentac_liveness_index(fn, fn->stmts[i].left.regval)] = true;
+        }
+    }
+
+    size_t nphis;
+    struct OpentacIndexList *phis = opentac_ssa_place(&scratch, fn, &dom, &liveness, pinned, &nphis);
+
+    // phis go at the head of their block, after its label
+    size_t len = fn->len + nphis;
+    size_t cap = fn->cap > len ? fn->cap : len;
+    OpentacStmt *stmts = opentac_arena_alloc(&builder->arena, cap * sizeof(OpentacStmt));
+    size_t *phivar = opentac_arena_alloc(&scratch, (len ? len : 1) * sizeof(size_t));
+    size_t at = 0;
+    for (size_t b = 0; b < cfg->len; b++) {
+        const struct OpentacBlock *block = cfg->blocks + b;
+        size_t i = block->start;
+        if (fn->stmts[i].tag.opcode == OPENTAC_OP_LABEL) {
+            stmts[at++] = fn->stmts[i++];
+        }
+        for (size_t j = 0; j < phis[b].len; j++) {
+            size_t offset = opentac_phi_push(builder, fn, block->npred);
+            for (size_t k = 0; k < block->npred; k++) {
+                fn->phis.args[offset + k].pred = cfg->preds[block->pred + k];
+                fn->phis.args[offset + k].value.tag = OPENTAC_VAL_ERROR;
+            }
+            OpentacStmt *phi = stmts + at;
+            phi->tag.opcode = OPENTAC_OP_PHI;
+            phi->tag.left = OPENTAC_VAL_UI64;
+            phi->tag.right = OPENTAC_VAL_UI64;
+            phi->target = opentac_ssa_reg(phis[b].items[j], nreg);
+            phi->left.ui64val = offset;
+            phi->right.ui64val = block->npred;
+            phivar[at++] = phis[b].items[j];
+        }
+        for (; i < block->end; i++) {
+            stmts[at++] = fn->stmts[i];
+        }
+    }
+    opentac_fn_replace(fn, stmts, len, cap);
+    cfg = opentac_fn_cfg(fn);
+
+    // rename along the dominator tree; the first definition of a register
+    // keeps its name and parameters are defined on entry
+    OpentacRegister *current = opentac_arena_alloc(&scratch, (nregs ? nregs : 1) * sizeof(OpentacRegister));
+    bool *named = opentac_arena_calloc(&scratch, nregs ? nregs : 1, sizeof(bool));
+    for (size_t index = 0; index < nregs; index++) {
+        current[index] = opentac_ssa_reg(index, nreg);
+        named[index] = index >= (size_t) nreg;
+    }
+
+    struct OpentacRename *undo = opentac_arena_alloc(&scratch, (len ? len : 1) * sizeof(struct OpentacRename));
+    size_t nundo = 0;
+    size_t *stack = opentac_arena_alloc(&scratch, (cfg->len ? cfg->len : 1) * sizeof(size_t));
+    size_t *marks = opentac_arena_alloc(&scratch, (cfg->len ? cfg->len : 1) * sizeof(size_t));
+    size_t *next = opentac_arena_calloc(&scratch, cfg->len ? cfg->len : 1, sizeof(size_t));
+    size_t depth = 0;
+    if (cfg->len) {
+        stack[depth++] = 0;
+    }
+
+    bool enter = true;
+    while (depth) {
+        size_t b = stack[depth - 1];
+        const struct OpentacBlock *block = cfg->blocks + b;
+
+        if (enter) {
+            marks[b] = nundo;
+            for (size_t i = block->start; i < block->end; i++) {
+                OpentacStmt *stmt = fn->stmts + i;
+                size_t index;
+                if (stmt->tag.opcode == OPENTAC_OP_PHI) {
+                    index = phivar[i];
+                } else {
+                    OpentacRegister *uses[3];
+                    size_t nuses = opentac_stmt_use_refs(stmt, uses);
+                    for (size_t j = 0; j < nuses; j++) {
+                        size_t use = opentac_ssa_index(*uses[j], nreg);
+                        if (!pinned[use]) {
+                            *uses[j] = current[use];
+                        }
+                    }
+
+                    OpentacRegister reg;
+                    if (!opentac_stmt_def(stmt, &reg)) {
+                        continue;
+                    }
+                    index = opentac_ssa_index(reg, nreg);
+                    if (pinned[index]) {
+                        continue;
+                    }
+                }
+
+                undo[nundo++] = (struct OpentacRename) { .index = index, .name = current[index] };
+                if (named[index]) {
+                    current[index] = fn->reg++;
+                } else {
+                    named[index] = true;
+                    current[index] = opentac_ssa_reg(index, nreg);
+                }
+                stmt->target = current[index];
+            }
+
+            for (size_t j = 0; j < block->nsucc; j++) {
+                const struct OpentacBlock *succ = cfg->blocks + cfg->succs[block->succ + j];
+                for (size_t i = succ->start; i < succ->end; i++) {
+                    OpentacStmt *stmt = fn->stmts + i;
+                    if (stmt->tag.opcode == OPENTAC_OP_LABEL || stmt->tag.opcode == OPENTAC_OP_NOP) {
+                        continue;
+                    }
+                    if (stmt->tag.opcode != OPENTAC_OP_PHI) {
+                        break;
+                    }
+                    struct OpentacPhiArg *args = fn->phis.args + stmt->left.ui64val;
+                    for (size_t k = 0; k < stmt->right.ui64val; k++) {
+                        if (args[k].pred == b) {
+                            args[k].value.tag = OPENTAC_VAL_REG;
+                            args[k].value.val.regval = current[phivar[i]];
+                        }
+                    }
+                }
+            }
+        }
+
+        if (next[b] < dom.child[b + 1] - dom.child[b]) {
+            stack[depth++] = dom.children[dom.child[b] + next[b]++];
+            enter = true;
+        } else {
+            while (nundo > marks[b]) {
+                --nundo;
+                current[undo[nundo].index] = undo[nundo].name;
+            }
+            --depth;
+            enter = false;
+        }
+    }
+
+    fn->ssa = true;
+    opentac_arena_destroy(&scratch);
+}
+
+struct OpentacCopy {
+    OpentacRegister target;
+    OpentacValue value;
+};
+
+static void opentac_ssa_emit_copy(OpentacStmt *stmt, OpentacRegister target, OpentacValue value) {
+    stmt->tag.opcode = OPENTAC_OP_COPY;
+    stmt->tag.left = value.tag;
+    stmt->tag.right = OPENTAC_VAL_ERROR;
+    stmt->target = target;
+    stmt->left = value.val;
+}
+
+// whether a copy other than copies[i] still reads the target of copies[i]
+static bool opentac_ssa_blocked(const struct OpentacCopy *copies, size_t len, size_t i) {
+    for (size_t j = 0; j < len; j++) {
+        if (j != i && copies[j].value.tag == OPENTAC_VAL_REG && copies[j].value.val.regval == copies[i].target) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// emits the parallel copy `copies` as a sequence, breaking cycles through a
+// new register; returns the number of statements written
+static size_t opentac_ssa_sequence(OpentacFnBuilder *fn, struct OpentacCopy *copies, size_t len, OpentacStmt *out) {
+    size_t at = 0;
+    while (len) {
+        size_t i = 0;
+        while (i < len && opentac_ssa_blocked(copies, len, i)) {
+            ++i;
+        }
+        if (i < len) {
+            if (copies[i].value.tag != OPENTAC_VAL_REG || copies[i].value.val.regval != copies[i].target) {
+                opentac_ssa_emit_copy(out + at++, copies[i].target, copies[i].value);
+            }
+            copies[i] = copies[--len];
+            continue;
+        }
+
+        // only cycles are left, so save one target and read it from there
+        OpentacRegister saved = copies[0].target;
+        OpentacRegister temp = fn->reg++;
+        opentac_ssa_emit_copy(out + at++, temp, (OpentacValue) { .tag = OPENTAC_VAL_REG, .val.regval = saved });
+        for (size_t j = 0; j < len; j++) {
+            if (copies[j].value.tag == OPENTAC_VAL_REG && copies[j].value.val.regval == saved) {
+                copies[j].value.val.regval = temp;
+            }
+        }
+    }
+    return at;
+}
+
+// collects the copies for the edge from `pred` into `succ`
+static size_t opentac_ssa_edge(const OpentacFnBuilder *fn, size_t pred, const struct OpentacBlock *succ, struct OpentacCopy *copies) {
+    size_t len = 0;
+    for (size_t i = succ->start; i < succ->end; i++) {
+        const OpentacStmt *stmt = fn->stmts + i;
+        if (stmt->tag.opcode == OPENTAC_OP_LABEL || stmt->tag.opcode == OPENTAC_OP_NOP) {
+            continue;
+        }
+        if (stmt->tag.opcode != OPENTAC_OP_PHI) {
+            break;
+        }
+        const struct OpentacPhiArg *args = fn->phis.args + stmt->left.ui64val;
+        for (size_t k = 0; k < stmt->right.ui64val; k++) {
+            if (args[k].pred == pred && args[k].value.tag != OPENTAC_VAL_ERROR) {
+                copies[len].target = stmt->target;
+                copies[len++].value = args[k].value;
+            }
+        }
+    }
+    return len;
+}
+
+void opentac_fn_from_ssa(OpentacBuilder *builder, OpentacFnBuilder *fn) {
+    opentac_assert(builder);
+    opentac_assert(fn);
+    opentac_assert(fn->ssa);
+
+    const struct OpentacCfg *cfg = opentac_fn_cfg(fn);
+
+    // each phi operand becomes at most one copy, plus at most one more per
+    // cycle, and a split edge adds a label and a jump
+    size_t nphis = 0;
+    for (size_t i = 0; i < fn->len; i++) {
+        if (fn->stmts[i].tag.opcode == OPENTAC_OP_PHI) {
+            ++nphis;
+        }
+    }
+    size_t nedges = cfg->len ? cfg->blocks[cfg->len - 1].succ + cfg->blocks[cfg->len - 1].nsucc : 0;
+    size_t cap = fn->len + fn->phis.len * 2 + nedges * 2;
+    if (cap < fn->cap) {
+        cap = fn->cap;
+    }
+    OpentacStmt *stmts = opentac_arena_alloc(&builder->arena, cap * sizeof(OpentacStmt));
+    struct OpentacCopy *copies = malloc(sizeof(struct OpentacCopy) * (nphis ? nphis : 1));
+    opentac_assert(copies);
+
+    // critical edges out of a conditional branch get a block of their own
+    // after the function, reached through a new label
+    struct OpentacSplit {
+        size_t pred;
+        size_t succ;
+        OpentacLabel label;
+    } *splits = malloc(sizeof(struct OpentacSplit) * (cfg->len ? cfg->len : 1));
+    opentac_assert(splits);
+    size_t nsplits = 0;
+
+    size_t at = 0;
+    for (size_t b = 0; b < cfg->len; b++) {
+        const struct OpentacBlock *block = cfg->blocks + b;
+        const OpentacStmt *last = fn->stmts + block->end - 1;
+        bool branches = (last->tag.opcode & OPENTAC_OP_BRANCH) == OPENTAC_OP_BRANCH;
+
+        for (size_t i = block->start; i < block->end - (branches ? 1 : 0); i++) {
+            if (fn->stmts[i].tag.opcode != OPENTAC_OP_PHI) {
+                stmts[at++] = fn->stmts[i];
+            }
+        }
+
+        if (block->nsucc == 1) {
+            // the only way out, so the copies go before the branch if any
+            size_t len = opentac_ssa_edge(fn, b, cfg->blocks + cfg->succs[block->succ], copies);
+            at += opentac_ssa_sequence(fn, copies, len, stmts + at);
+            if (branches) {
+                stmts[at++] = *last;
+            }
+            continue;
+        }
+
+        size_t branch = at;
+        if (branches) {
+            stmts[at++] = *last;
+        }
+        for (size_t j = 0; j < block->nsucc; j++) {
+            size_t succ = cfg->succs[block->succ + j];
+            size_t len = opentac_ssa_edge(fn, b, cfg->blocks + succ, copies);
+            if (!len) {
+                continue;
+            }
+            opentac_assertf(last->tag.opcode != (OPENTAC_OP_BRANCH | OPENTAC_OP_NOP), "%s", "cannot split the edges of an indirect branch");
+            if (succ == b + 1 && cfg->labels[last->label] != succ) {
+                // the fallthrough edge, its copies become a block of their
+                // own between the branch and its successor
+                at += opentac_ssa_sequence(fn, copies, len, stmts + at);
+            } else {
+                splits[nsplits].pred = b;
+                splits[nsplits].succ = succ;
+                splits[nsplits].label = fn->label++;
+                stmts[branch].label = splits[nsplits++].label;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < nsplits; i++) {
+        OpentacStmt *label = stmts + at++;
+        label->tag.opcode = OPENTAC_OP_LABEL;
+        label->tag.left = OPENTAC_VAL_ERROR;
+        label->tag.right = OPENTAC_VAL_ERROR;
+        label->label = splits[i].label;
+
+        size_t len = opentac_ssa_edge(fn, splits[i].pred, cfg->blocks + splits[i].succ, copies);
+        at += opentac_ssa_sequence(fn, copies, len, stmts + at);
+
+        const OpentacStmt *target = fn->stmts + cfg->blocks[splits[i].succ].start;
+        opentac_assert(target->tag.opcode == OPENTAC_OP_LABEL);
+        OpentacStmt *jump = stmts + at++;
+        jump->tag.opcode = OPENTAC_OP_BRANCH | OPENTAC_OP_NOP;
+        jump->tag.left = OPENTAC_VAL_ERROR;
+        jump->tag.right = OPENTAC_VAL_ERROR;
+        jump->label = target->label;
+    }
+
+    free(splits);
+    free(copies);
+    opentac_fn_replace(fn, stmts, at, cap);
+    fn->phis.len = 0;
+    fn->ssa = false;
+}
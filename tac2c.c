@@ -0,0 +1,27 @@
+#include <errno.h>
+#include "include/opentac.h"
+
+// translates the module in the file given, or stdin, to C on stdout
+int main(int argc, const char **argv) {
+    FILE *input = stdin;
+    if (argc >= 2) {
+        input = fopen(argv[1], "r");
+        if (!input) {
+            int err = errno;
+            fprintf(stderr, "error: %s: %s\n", argv[1], strerror(err));
+            return err;
+        }
+    }
+
+    OpentacBuilder *builder = opentac_parse(input);
+    fclose(input);
+    if (!builder) {
+        return 1;
+    }
+
+    opentac_optimize(builder);
+    int status = opentac_emit_c(builder, stdout);
+    opentac_builderp_destroy(builder);
+
+    return status;
+}
@@ -1,36 +1,472 @@
+#include <dlfcn.h>
 #include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "include/opentac.h"
+#include "include/opentac_interp.h"
+#include "include/opentac_jit.h"
 
-void yyerror(const char *error) {
-    fprintf(stderr, "error: %s\n", error);
+static const char *const opcodes[] = {
+    [OPENTAC_OP_LT] = "lt",
+    [OPENTAC_OP_LE] = "le",
+    [OPENTAC_OP_EQ] = "eq",
+    [OPENTAC_OP_NE] = "ne",
+    [OPENTAC_OP_GT] = "gt",
+    [OPENTAC_OP_GE] = "ge",
+    [OPENTAC_OP_BITAND] = "bitand",
+    [OPENTAC_OP_BITXOR] = "bitxor",
+    [OPENTAC_OP_BITOR] = "bitor",
+    [OPENTAC_OP_SHL] = "shl",
+    [OPENTAC_OP_SHR] = "shr",
+    [OPENTAC_OP_ROL] = "rol",
+    [OPENTAC_OP_ROR] = "ror",
+    [OPENTAC_OP_ADD] = "add",
+    [OPENTAC_OP_SUB] = "sub",
+    [OPENTAC_OP_MUL] = "mul",
+    [OPENTAC_OP_DIV] = "div",
+    [OPENTAC_OP_MOD] = "mod",
+    [OPENTAC_OP_CALL] = "call",
+    [OPENTAC_OP_NOT] = "not",
+    [OPENTAC_OP_NEG] = "neg",
+    [OPENTAC_OP_REF] = "ref",
+    [OPENTAC_OP_DEREF] = "deref",
+    [OPENTAC_OP_COPY] = "copy",
+    [OPENTAC_OP_PHI] = "phi",
+};
+
+// registers are named like the register table names them
+static void print_reg(OpentacRegister reg) {
+    if (reg < 0) {
+        printf("p%x", -(reg + 1));
+    } else {
+        printf("t%x", reg);
+    }
+}
+
+static void print_value(int tag, OpentacVal val) {
+    switch (tag) {
+    case OPENTAC_VAL_NAMED: printf("%s", val.name->data); break;
+    case OPENTAC_VAL_REG: print_reg(val.regval); break;
+    case OPENTAC_VAL_BOOL: printf(val.bval ? "true" : "false"); break;
+    case OPENTAC_VAL_I8: printf("%" PRId8 ":i8", val.i8val); break;
+    case OPENTAC_VAL_I16: printf("%" PRId16 ":i16", val.i16val); break;
+    case OPENTAC_VAL_I32: printf("%" PRId32 ":i32", val.i32val); break;
+    case OPENTAC_VAL_I64: printf("%" PRId64 ":i64", val.i64val); break;
+    case OPENTAC_VAL_UI8: printf("%" PRIu8 ":u8", val.ui8val); break;
+    case OPENTAC_VAL_UI16: printf("%" PRIu16 ":u16", val.ui16val); break;
+    case OPENTAC_VAL_UI32: printf("%" PRIu32 ":u32", val.ui32val); break;
+    case OPENTAC_VAL_UI64: printf("%" PRIu64 ":u64", val.ui64val); break;
+    case OPENTAC_VAL_F32: printf("%g:f32", val.fval); break;
+    case OPENTAC_VAL_F64: printf("%g:f64", val.dval); break;
+    default: printf("?"); break;
+    }
+}
+
+// prints the statements of `fn` in the syntax they are parsed from
+static void print_fn(const OpentacFnBuilder *fn) {
+    printf("%s:\n", fn->name->data);
+    for (size_t i = 0; i < fn->len; i++) {
+        const OpentacStmt *stmt = fn->stmts + i;
+        int opcode = stmt->tag.opcode;
+        if ((opcode & OPENTAC_OP_BRANCH) == OPENTAC_OP_BRANCH) {
+            int relop = opcode & ~OPENTAC_OP_BRANCH;
+            if (relop != OPENTAC_OP_NOP) {
+                printf("  if %s ", opcodes[relop]);
+                print_value(stmt->tag.left, stmt->left);
+                printf(", ");
+                print_value(stmt->tag.right, stmt->right);
+                printf(" branch l%" PRIx32 ";\n", stmt->label);
+            } else if (stmt->tag.left == OPENTAC_VAL_ERROR) {
+                printf("  branch l%" PRIx32 ";\n", stmt->label);
+            } else {
+                printf("  branch ");
+                print_value(stmt->tag.left, stmt->left);
+                printf(";\n");
+            }
+            continue;
+        }
+        switch (opcode) {
+        case OPENTAC_OP_NOP:
+            continue;
+        case OPENTAC_OP_LABEL:
+            printf("l%" PRIx32 ":\n", stmt->label);
+            continue;
+        case OPENTAC_OP_PARAM:
+        case OPENTAC_OP_RETURN:
+            printf(opcode == OPENTAC_OP_PARAM ? "  param " : "  return ");
+            print_value(stmt->tag.left, stmt->left);
+            printf(";\n");
+            continue;
+        case OPENTAC_OP_INDEX_ASSIGN:
+            printf("  ");
+            print_reg(stmt->target);
+            printf("[");
+            print_value(stmt->tag.left, stmt->left);
+            printf("] := ");
+            print_value(stmt->tag.right, stmt->right);
+            printf(";\n");
+            continue;
+        case OPENTAC_OP_ASSIGN_INDEX:
+            printf("  ");
+            print_reg(stmt->target);
+            printf(" := ");
+            print_value(stmt->tag.left, stmt->left);
+            printf("[");
+            print_value(stmt->tag.right, stmt->right);
+            printf("];\n");
+            continue;
+        case OPENTAC_OP_PHI:
+            printf("  ");
+            print_reg(stmt->target);
+            printf(" := phi");
+            for (size_t k = 0; k < stmt->right.ui64val; k++) {
+                const struct OpentacPhiArg *arg = fn->phis.args + stmt->left.ui64val + k;
+                printf("%s [%zu] ", k ? "," : "", arg->pred);
+                print_value(arg->value.tag, arg->value.val);
+            }
+            printf(";\n");
+            continue;
+        }
+        printf("  ");
+        print_reg(stmt->target);
+        printf(" := %s ", opcodes[opcode]);
+        print_value(stmt->tag.left, stmt->left);
+        if (stmt->tag.right != OPENTAC_VAL_ERROR) {
+            printf(", ");
+            print_value(stmt->tag.right, stmt->right);
+        }
+        printf(";\n");
+    }
+}
+
+// interprets `main`, which takes no parameters, returning false when there
+// is none or it fails
+static bool run_main(OpentacBuilder *builder, OpentacVal *result) {
+    struct OpentacInterp interp;
+    opentac_interp(&interp, builder);
+    const struct OpentacInterpFn *fn = opentac_interp_fn(&interp, "main");
+    OpentacVal none = { 0 };
+    bool ok = fn && !fn->nparams && opentac_interp_call(&interp, fn, &none, 0, result) == OPENTAC_INTERP_OK;
+    opentac_interp_destroy(&interp);
+    return ok;
+}
+
+// main returns `expected`, if `runs`, both after loading the module and
+// after optimizing it
+static bool check_loaded(OpentacBuilder *loaded, bool runs, OpentacVal expected, const char *how) {
+    for (int optimized = 0; runs && optimized < 2; optimized++) {
+        OpentacVal result;
+        if (!run_main(loaded, &result) || result.i64val != expected.i64val) {
+            fprintf(stderr, "error: main returns %" PRId64 " before writing the module and %" PRId64 " %s%s\n", expected.i64val, result.i64val, how, optimized ? " and optimized" : "");
+            return false;
+        }
+        opentac_optimize(loaded);
+    }
+    return true;
+}
+
+// writes the module to a file and maps it back, loading it both by copying
+// and in place, where optimizing writes to the mapping
+static bool check_module(OpentacBuilder *builder, bool runs, OpentacVal expected) {
+    char path[] = "/tmp/run_test.XXXXXX";
+    int fd = mkstemp(path);
+    FILE *file = fd < 0 ? NULL : fdopen(fd, "w");
+    if (!file) {
+        fprintf(stderr, "error: %s\n", strerror(errno));
+        return false;
+    }
+    int status = opentac_module_write(builder, file);
+    fclose(file);
+    struct OpentacModule module;
+    if (status == OPENTAC_MODULE_OK) {
+        status = opentac_module_open(&module, path);
+    }
+    unlink(path);
+    if (status != OPENTAC_MODULE_OK) {
+        fprintf(stderr, "error: the module does not read back: status %d\n", status);
+        return false;
+    }
+
+    OpentacBuilder copied;
+    opentac_builder(&copied);
+    status = opentac_module_load(&copied, &module);
+    bool ok = status == OPENTAC_MODULE_OK && check_loaded(&copied, runs, expected, "loaded");
+    opentac_builder_destroy(&copied);
+    if (ok) {
+        OpentacBuilder mapped;
+        opentac_builder(&mapped);
+        status = opentac_module_load_in_place(&mapped, &module);
+        ok = status == OPENTAC_MODULE_OK && check_loaded(&mapped, runs, expected, "loaded in place");
+        opentac_builder_destroy(&mapped);
+    }
+    if (status != OPENTAC_MODULE_OK) {
+        fprintf(stderr, "error: the module does not load: status %d\n", status);
+    }
+    opentac_module_close(&module);
+    return ok;
+}
+
+#define CALL_AS(type) do { type (*fn)(void); memcpy(&fn, &entry, sizeof(fn)); result = fn(); } while (0)
+
+// loads the shared object `make` built from the module through C and checks
+// that main, called as the type it is declared with, returns `expected`
+static bool check_native(OpentacBuilder *builder, const char *path, OpentacVal expected) {
+    void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    void *entry = handle ? dlsym(handle, OPENTAC_EMIT_C_PREFIX "main") : NULL;
+    if (!entry) {
+        fprintf(stderr, "error: %s\n", dlerror());
+        if (handle) {
+            dlclose(handle);
+        }
+        return false;
+    }
+    OpentacItem *decl = opentac_builder_find(builder, opentac_intern(builder, "main"), OPENTAC_ITEM_DECL);
+    int tag = decl && decl->decl.type->tag == OPENTAC_TYPE_FN ? decl->decl.type->fn.result->tag : OPENTAC_TYPE_I64;
+    int64_t result;
+    switch (tag) {
+    case OPENTAC_TYPE_I8: CALL_AS(int8_t); break;
+    case OPENTAC_TYPE_I16: CALL_AS(int16_t); break;
+    case OPENTAC_TYPE_I32: CALL_AS(int32_t); break;
+    case OPENTAC_TYPE_UI8: CALL_AS(uint8_t); break;
+    case OPENTAC_TYPE_UI16: CALL_AS(uint16_t); break;
+    case OPENTAC_TYPE_UI32: CALL_AS(uint32_t); break;
+    default: CALL_AS(int64_t); break;
+    }
+    dlclose(handle);
+    if (result != expected.i64val) {
+        fprintf(stderr, "error: main returns %" PRId64 " compiled through C but %" PRId64 " interpreted\n", result, expected.i64val);
+        return false;
+    }
+    return true;
+}
+
+#define ALLOC_THREADS 4
+
+static bool same_entry(const struct OpentacRegEntry *a, const struct OpentacRegEntry *b) {
+    if (a->reg != b->reg || a->purpose.tag != b->purpose.tag || a->split != b->split || a->start != b->start || a->end != b->end) {
+        return false;
+    }
+    switch (a->purpose.tag) {
+    case OPENTAC_REG_ALLOCATED: return !strcmp(a->purpose.reg.name, b->purpose.reg.name);
+    case OPENTAC_REG_SPILLED: return a->purpose.stack == b->purpose.stack;
+    default: return true;
+    }
+}
+
+// functions are allocated independently, so how many threads share the work
+// must not change any function's register table
+static bool same_tables(const struct OpentacFnAllocs *serial, const struct OpentacFnAllocs *parallel) {
+    if (serial->len != parallel->len) {
+        return false;
+    }
+    for (size_t i = 0; i < serial->len; i++) {
+        const struct OpentacRegisterTable *a = &serial->allocs[i].table;
+        const struct OpentacRegisterTable *b = &parallel->allocs[i].table;
+        if (serial->allocs[i].fn != parallel->allocs[i].fn || a->len != b->len) {
+            return false;
+        }
+        for (size_t k = 0; k < a->len; k++) {
+            if (!same_entry(a->entries + k, b->entries + k)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// compiles the module with fewer and fewer registers, so that intervals
+// get split and moved between registers and the stack, and checks that
+// main returns `expected` every time
+static bool check_jit(OpentacBuilder *builder, OpentacVal expected) {
+    static const size_t counts[] = { OPENTAC_JIT_REGISTERS, 5, 3, 2, 1 };
+    for (size_t k = 0; k < sizeof(counts) / sizeof(counts[0]); k++) {
+        struct OpentacTarget target = opentac_jit_target;
+        target.files[OPENTAC_REGCLASS_INT].len = counts[k];
+        struct OpentacFnAllocs serial;
+        opentac_alloc_parallel_target(&serial, builder, &target, 1);
+        struct OpentacFnAllocs allocs;
+        opentac_alloc_parallel_target(&allocs, builder, &target, ALLOC_THREADS);
+        bool same = same_tables(&serial, &allocs);
+        opentac_alloc_parallel_destroy(&serial);
+        if (!same) {
+            fprintf(stderr, "error: allocating with %zu registers on %d threads differs from one thread\n", counts[k], ALLOC_THREADS);
+            opentac_alloc_parallel_destroy(&allocs);
+            return false;
+        }
+        struct OpentacJit jit;
+        opentac_jit(&jit, builder, &allocs);
+        int64_t result = ((int64_t (*)(void)) opentac_jit_fn(&jit, "main")->entry)();
+        opentac_jit_destroy(&jit);
+        opentac_alloc_parallel_destroy(&allocs);
+        if (result != expected.i64val) {
+            fprintf(stderr, "error: main returns %" PRId64 " compiled with %zu registers but %" PRId64 " interpreted\n", result, counts[k], expected.i64val);
+            return false;
+        }
+    }
+    return true;
+}
+
+#define PARSE_THREADS 4
+
+struct ParseJob {
+    const char *path;
+    OpentacBuilder builder;
+    int status;
+};
+
+static void *parse_job(void *arg) {
+    struct ParseJob *job = arg;
+    opentac_builder(&job->builder);
+    FILE *file = fopen(job->path, "r");
+    job->status = file ? opentac_parse_ctx(&job->builder, file) : -1;
+    if (file) {
+        fclose(file);
+    }
+    return NULL;
+}
+
+// writes `builder` out as a module into a fresh buffer, returning its size
+static size_t module_bytes(OpentacBuilder *builder, char **bytes) {
+    size_t size = 0;
+    FILE *file = open_memstream(bytes, &size);
+    opentac_assert(file);
+    opentac_assert(opentac_module_write(builder, file) == OPENTAC_MODULE_OK);
+    fclose(file);
+    return size;
+}
+
+// parses `path` on several threads at once into separate builders and
+// checks that they all come out the same, byte for byte once written out
+static bool check_parse_concurrent(const char *path) {
+    struct ParseJob jobs[PARSE_THREADS];
+    pthread_t threads[PARSE_THREADS];
+    for (size_t i = 0; i < PARSE_THREADS; i++) {
+        jobs[i].path = path;
+        opentac_assert(pthread_create(threads + i, NULL, parse_job, jobs + i) == 0);
+    }
+    for (size_t i = 0; i < PARSE_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    bool same = true;
+    char *first = NULL;
+    size_t first_size = 0;
+    for (size_t i = 0; i < PARSE_THREADS; i++) {
+        if (jobs[i].status) {
+            fprintf(stderr, "error: %s does not parse on thread %zu\n", path, i);
+            same = false;
+        } else if (!first) {
+            first_size = module_bytes(&jobs[i].builder, &first);
+        } else {
+            char *bytes;
+            size_t size = module_bytes(&jobs[i].builder, &bytes);
+            if (size != first_size || memcmp(bytes, first, size)) {
+                fprintf(stderr, "error: %s parses differently on thread %zu\n", path, i);
+                same = false;
+            }
+            free(bytes);
+        }
+        opentac_builder_destroy(&jobs[i].builder);
+    }
+    free(first);
+    return same;
+}
+
+// lays out a tuple and an array holding a struct that is only declared, then
+// completes the struct and checks that both are laid out again
+static bool check_forward_layout(void) {
+    OpentacBuilder builder;
+    opentac_builder(&builder);
+    OpentacType *named = opentac_type_named(&builder, OPENTAC_TYPE_STRUCT, opentac_intern(&builder, "forward"));
+    OpentacType *pair[] = { opentac_type_i8(&builder), named };
+    OpentacType *tuple = opentac_type_tuple(&builder, 2, pair);
+    OpentacType *array = opentac_type_array(&builder, named, 3);
+    opentac_type_layout(tuple);
+    opentac_type_layout(array);
+
+    OpentacType *elems[] = { opentac_type_i64(&builder) };
+    opentac_type_struct(&builder, opentac_intern(&builder, "forward"), 1, elems);
+    OpentacTypeInfo ti = opentac_type_layout(tuple);
+    OpentacTypeInfo ai = opentac_type_layout(array);
+    bool ok = ti.size == 16 && ti.align == 8 && opentac_type_offset(tuple, 1) == 8 && ai.size == 24 && ai.align == 8;
+    if (!ok) {
+        fprintf(stderr, "error: layouts are stale after completing a struct\n");
+    }
+    opentac_builder_destroy(&builder);
+    return ok;
 }
 
 int main(int argc, const char **argv) {
+    if (!check_forward_layout()) {
+        return 1;
+    }
+
     FILE *input = stdin;
     if (argc >= 2) {
         input = fopen(argv[1], "r");
         if (!input) {
             int err = errno;
-            yyerror(strerror(err));
+            fprintf(stderr, "error: %s: %s\n", argv[1], strerror(err));
             return err;
         }
     }
 
+    // the parser reports what it failed on itself
     OpentacBuilder *builder = opentac_parse(input);
     fclose(input);
+    if (!builder) {
+        fprintf(stderr, "error: %s does not parse\n", argc >= 2 ? argv[1] : "stdin");
+        return 1;
+    }
+    if (argc >= 2 && !check_parse_concurrent(argv[1])) {
+        return 1;
+    }
 
+    // caller-saved registers first, so that the convention below can take
+    // a prefix of them and its arguments are all among them
     const char *registers[] = {
         "rax",
         "rcx",
         "rdx",
+        "rsi",
+        "rdi",
         "rbx",
     };
+    const char *float_registers[] = {
+        "xmm0",
+        "xmm1",
+        "xmm2",
+        "xmm3",
+    };
+    const char *args[] = {
+        "rdi",
+        "rsi",
+        "rdx",
+        "rcx",
+    };
+    struct OpentacTarget target = {
+        .files = {
+            [OPENTAC_REGCLASS_INT] = { .len = 6, .registers = registers },
+            [OPENTAC_REGCLASS_FLOAT] = { .len = 4, .registers = float_registers },
+        },
+        .clobbered = {
+            [OPENTAC_REGCLASS_INT] = { .len = 5, .registers = registers },
+            [OPENTAC_REGCLASS_FLOAT] = { .len = 4, .registers = float_registers },
+        },
+        .args = {
+            [OPENTAC_REGCLASS_INT] = { .len = 4, .registers = args },
+            [OPENTAC_REGCLASS_FLOAT] = { .len = 4, .registers = float_registers },
+        },
+        .results = { [OPENTAC_REGCLASS_INT] = "rax", [OPENTAC_REGCLASS_FLOAT] = "xmm0" },
+    };
     OpentacRegalloc alloc;
-    opentac_alloc_linscan(&alloc, 4, registers);
+    opentac_alloc_linscan_target(&alloc, &target);
     opentac_alloc_find(&alloc, builder);
     opentac_alloc_allocate(&alloc);
     struct OpentacRegisterTable table;
     opentac_alloc_regtable(&table, &alloc);
+    opentac_alloc_regtable_names(&table, &alloc);
 
     for (size_t i = 0; i < table.len; i++) {
         printf("%s: ", table.entries[i].key->data);
@@ -39,8 +475,47 @@ int main(int argc, const char **argv) {
         } else if (table.entries[i].purpose.tag == OPENTAC_REG_ALLOCATED) {
             printf("%s", table.entries[i].purpose.reg.name);
         }
+        if (table.entries[i].split) {
+            printf(" (%lu-%lu)", table.entries[i].start, table.entries[i].end);
+        }
         printf("\n");
     }
 
+    opentac_alloc_destroy(&alloc);
+
+    // optimizing must leave what main returns alone, and so must compiling
+    // it before and after, through C, and a round trip through the module
+    // format
+    OpentacVal before;
+    bool runs = run_main(builder, &before);
+    if (runs && !check_jit(builder, before)) {
+        return 1;
+    }
+    if (!check_module(builder, runs, before)) {
+        return 1;
+    }
+    if (runs && argc >= 3 && !check_native(builder, argv[2], before)) {
+        return 1;
+    }
+    opentac_optimize(builder);
+    for (size_t i = 0; i < builder->len; i++) {
+        if (builder->items[i]->tag == OPENTAC_ITEM_FN) {
+            print_fn(&builder->items[i]->fn);
+        }
+    }
+    OpentacVal after;
+    if (runs) {
+        if (!run_main(builder, &after) || after.i64val != before.i64val) {
+            fprintf(stderr, "error: main returns %" PRId64 " before optimizing and %" PRId64 " after\n", before.i64val, after.i64val);
+            return 1;
+        }
+        if (!check_jit(builder, after)) {
+            return 1;
+        }
+        printf("main: %" PRId64 "\n", after.i64val);
+    }
+
+    opentac_builderp_destroy(builder);
+
     return 0;
 }